@@ -0,0 +1,532 @@
+//
+// Created by redkc on 19/10/2026.
+//
+
+// Measures how long recording the raster pass takes with the ParallelCommandRecorder, for synthetic scenes with
+// tens of thousands of draws and an increasing number of threads. Every draw is its own vkCmdDrawIndexed, the way the
+// raster pass was recorded before it moved to a single indirect count draw, so this measures the recorder itself
+// rather than the renderer's current raster pass. The draws use a headless device, the renderer's own shaders and its
+// descriptor set layout. Nothing is submitted, only the CPU side of recording is measured, so any Vulkan device works,
+// lavapipe included.
+//
+// Usage: CommandRecordingBenchmark [--frames <count>] [draw counts...]
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+#include "app/JobSystem.h"
+#include "app/ParallelCommandRecorder.h"
+#include "model/Vertex.h"
+
+namespace {
+    constexpr uint32_t framesInFlight = 2;
+    constexpr uint32_t minDrawsPerThread = 256;
+    constexpr VkExtent2D extent = {800, 800};
+    constexpr VkFormat colorFormat = VK_FORMAT_B8G8R8A8_UNORM;
+
+    struct Options {
+        uint32_t frames = 50;
+        std::vector<uint32_t> drawCounts;
+    };
+
+    Options parseOptions(int argc, char *argv[]) {
+        Options options;
+        for (int i = 1; i < argc; i++) {
+            const std::string argument = argv[i];
+            if (argument == "--frames" && i + 1 < argc) {
+                options.frames = static_cast<uint32_t>(std::stoul(argv[++i]));
+            } else {
+                options.drawCounts.push_back(static_cast<uint32_t>(std::stoul(argument)));
+            }
+        }
+        if (options.drawCounts.empty()) {
+            options.drawCounts = {10000, 50000, 100000};
+        }
+        return options;
+    }
+
+    void check(VkResult result, const char *what) {
+        if (result != VK_SUCCESS) {
+            throw std::runtime_error(std::string("failed to ") + what + "!");
+        }
+    }
+
+    std::vector<char> readFile(const std::string &filename) {
+        std::ifstream file(filename, std::ios::ate | std::ios::binary);
+        if (!file.is_open()) {
+            throw std::runtime_error("failed to open file " + filename + "!");
+        }
+        std::vector<char> buffer(static_cast<size_t>(file.tellg()));
+        file.seekg(0);
+        file.read(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+        return buffer;
+    }
+
+    /**
+     * @brief Just enough of the raster path to record real draws: render pass, framebuffer, pipeline and buffers.
+     */
+    struct HeadlessRasterContext {
+        VkInstance instance = VK_NULL_HANDLE;
+        VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
+        VkDevice device = VK_NULL_HANDLE;
+        uint32_t queueFamilyIndex = 0;
+        std::string deviceName;
+
+        VkRenderPass renderPass = VK_NULL_HANDLE;
+        VkImage colorImage = VK_NULL_HANDLE;
+        VkDeviceMemory colorMemory = VK_NULL_HANDLE;
+        VkImageView colorView = VK_NULL_HANDLE;
+        VkFramebuffer framebuffer = VK_NULL_HANDLE;
+        VkDescriptorSetLayout descriptorSetLayout = VK_NULL_HANDLE;
+        VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+        VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+        VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+        VkPipeline pipeline = VK_NULL_HANDLE;
+        VkBuffer geometryBuffer = VK_NULL_HANDLE;
+        VkDeviceMemory geometryMemory = VK_NULL_HANDLE;
+        VkDeviceSize indexOffset = 0;
+
+        HeadlessRasterContext() {
+            createDevice();
+            createRenderTarget();
+            createPipeline();
+            createGeometry();
+        }
+
+        ~HeadlessRasterContext() {
+            vkDestroyBuffer(device, geometryBuffer, nullptr);
+            vkFreeMemory(device, geometryMemory, nullptr);
+            vkDestroyPipeline(device, pipeline, nullptr);
+            vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
+            vkDestroyDescriptorPool(device, descriptorPool, nullptr);
+            vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
+            vkDestroyFramebuffer(device, framebuffer, nullptr);
+            vkDestroyImageView(device, colorView, nullptr);
+            vkDestroyImage(device, colorImage, nullptr);
+            vkFreeMemory(device, colorMemory, nullptr);
+            vkDestroyRenderPass(device, renderPass, nullptr);
+            vkDestroyDevice(device, nullptr);
+            vkDestroyInstance(instance, nullptr);
+        }
+
+        uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) const {
+            VkPhysicalDeviceMemoryProperties memProperties;
+            vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memProperties);
+            for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++) {
+                if ((typeFilter & (1 << i)) && (memProperties.memoryTypes[i].propertyFlags & properties) == properties) {
+                    return i;
+                }
+            }
+            throw std::runtime_error("failed to find suitable memory type!");
+        }
+
+        void createDevice() {
+            VkApplicationInfo appInfo{};
+            appInfo.sType = VK_STRUCTURE_TYPE_APPLICATION_INFO;
+            appInfo.pApplicationName = "CommandRecordingBenchmark";
+            appInfo.apiVersion = VK_API_VERSION_1_2;
+
+            VkInstanceCreateInfo instanceInfo{};
+            instanceInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
+            instanceInfo.pApplicationInfo = &appInfo;
+            check(vkCreateInstance(&instanceInfo, nullptr, &instance), "create instance");
+
+            uint32_t deviceCount = 0;
+            vkEnumeratePhysicalDevices(instance, &deviceCount, nullptr);
+            std::vector<VkPhysicalDevice> devices(deviceCount);
+            vkEnumeratePhysicalDevices(instance, &deviceCount, devices.data());
+
+            // Any device with a graphics queue will do, recording cost is what is being measured
+            for (VkPhysicalDevice candidate: devices) {
+                uint32_t familyCount = 0;
+                vkGetPhysicalDeviceQueueFamilyProperties(candidate, &familyCount, nullptr);
+                std::vector<VkQueueFamilyProperties> families(familyCount);
+                vkGetPhysicalDeviceQueueFamilyProperties(candidate, &familyCount, families.data());
+                for (uint32_t i = 0; i < familyCount; i++) {
+                    if (families[i].queueFlags & VK_QUEUE_GRAPHICS_BIT) {
+                        physicalDevice = candidate;
+                        queueFamilyIndex = i;
+                        break;
+                    }
+                }
+                if (physicalDevice != VK_NULL_HANDLE) {
+                    break;
+                }
+            }
+            if (physicalDevice == VK_NULL_HANDLE) {
+                throw std::runtime_error("failed to find a GPU with a graphics queue!");
+            }
+
+            VkPhysicalDeviceProperties properties;
+            vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+            deviceName = properties.deviceName;
+
+            float queuePriority = 1.0f;
+            VkDeviceQueueCreateInfo queueInfo{};
+            queueInfo.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
+            queueInfo.queueFamilyIndex = queueFamilyIndex;
+            queueInfo.queueCount = 1;
+            queueInfo.pQueuePriorities = &queuePriority;
+
+            VkDeviceCreateInfo deviceInfo{};
+            deviceInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+            deviceInfo.queueCreateInfoCount = 1;
+            deviceInfo.pQueueCreateInfos = &queueInfo;
+            check(vkCreateDevice(physicalDevice, &deviceInfo, nullptr, &device), "create logical device");
+        }
+
+        void createRenderTarget() {
+            VkAttachmentDescription colorAttachment{};
+            colorAttachment.format = colorFormat;
+            colorAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+            colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+            colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+            colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+            colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+            colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+            colorAttachment.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+            VkAttachmentReference colorAttachmentRef{0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL};
+            VkSubpassDescription subpass{};
+            subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+            subpass.colorAttachmentCount = 1;
+            subpass.pColorAttachments = &colorAttachmentRef;
+
+            VkRenderPassCreateInfo renderPassInfo{};
+            renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+            renderPassInfo.attachmentCount = 1;
+            renderPassInfo.pAttachments = &colorAttachment;
+            renderPassInfo.subpassCount = 1;
+            renderPassInfo.pSubpasses = &subpass;
+            check(vkCreateRenderPass(device, &renderPassInfo, nullptr, &renderPass), "create render pass");
+
+            VkImageCreateInfo imageInfo{};
+            imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+            imageInfo.imageType = VK_IMAGE_TYPE_2D;
+            imageInfo.format = colorFormat;
+            imageInfo.extent = {extent.width, extent.height, 1};
+            imageInfo.mipLevels = 1;
+            imageInfo.arrayLayers = 1;
+            imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+            imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+            imageInfo.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+            imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+            check(vkCreateImage(device, &imageInfo, nullptr, &colorImage), "create image");
+
+            VkMemoryRequirements memRequirements;
+            vkGetImageMemoryRequirements(device, colorImage, &memRequirements);
+            VkMemoryAllocateInfo allocInfo{};
+            allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+            allocInfo.allocationSize = memRequirements.size;
+            allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits,
+                                                       VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+            check(vkAllocateMemory(device, &allocInfo, nullptr, &colorMemory), "allocate image memory");
+            vkBindImageMemory(device, colorImage, colorMemory, 0);
+
+            VkImageViewCreateInfo viewInfo{};
+            viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+            viewInfo.image = colorImage;
+            viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+            viewInfo.format = colorFormat;
+            viewInfo.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+            check(vkCreateImageView(device, &viewInfo, nullptr, &colorView), "create image view");
+
+            VkFramebufferCreateInfo framebufferInfo{};
+            framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+            framebufferInfo.renderPass = renderPass;
+            framebufferInfo.attachmentCount = 1;
+            framebufferInfo.pAttachments = &colorView;
+            framebufferInfo.width = extent.width;
+            framebufferInfo.height = extent.height;
+            framebufferInfo.layers = 1;
+            check(vkCreateFramebuffer(device, &framebufferInfo, nullptr, &framebuffer), "create framebuffer");
+        }
+
+        VkShaderModule createShaderModule(const std::string &path) const {
+            const std::vector<char> code = readFile(path);
+            VkShaderModuleCreateInfo createInfo{};
+            createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+            createInfo.codeSize = code.size();
+            createInfo.pCode = reinterpret_cast<const uint32_t *>(code.data());
+            VkShaderModule shaderModule;
+            check(vkCreateShaderModule(device, &createInfo, nullptr, &shaderModule), "create shader module");
+            return shaderModule;
+        }
+
+        void createPipeline() {
+            // Same bindings as the renderer's raster descriptor set
+            std::array<VkDescriptorSetLayoutBinding, 3> bindings{};
+            bindings[0] = {0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1, VK_SHADER_STAGE_VERTEX_BIT, nullptr};
+            bindings[1] = {1, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, VK_SHADER_STAGE_FRAGMENT_BIT, nullptr};
+            bindings[2] = {2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_VERTEX_BIT, nullptr};
+            VkDescriptorSetLayoutCreateInfo layoutInfo{};
+            layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+            layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+            layoutInfo.pBindings = bindings.data();
+            check(vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &descriptorSetLayout),
+                  "create descriptor set layout");
+
+            // The set is bound but never written, that is only invalid once the draws execute
+            std::array<VkDescriptorPoolSize, 3> poolSizes{};
+            poolSizes[0] = {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1};
+            poolSizes[1] = {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1};
+            poolSizes[2] = {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1};
+            VkDescriptorPoolCreateInfo poolInfo{};
+            poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+            poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+            poolInfo.pPoolSizes = poolSizes.data();
+            poolInfo.maxSets = 1;
+            check(vkCreateDescriptorPool(device, &poolInfo, nullptr, &descriptorPool), "create descriptor pool");
+
+            VkDescriptorSetAllocateInfo setInfo{};
+            setInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+            setInfo.descriptorPool = descriptorPool;
+            setInfo.descriptorSetCount = 1;
+            setInfo.pSetLayouts = &descriptorSetLayout;
+            check(vkAllocateDescriptorSets(device, &setInfo, &descriptorSet), "allocate descriptor sets");
+
+            VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+            pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+            pipelineLayoutInfo.setLayoutCount = 1;
+            pipelineLayoutInfo.pSetLayouts = &descriptorSetLayout;
+            check(vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &pipelineLayout),
+                  "create pipeline layout");
+
+            VkShaderModule vertShaderModule = createShaderModule("res/shaders/shaderVert.spv");
+            VkShaderModule fragShaderModule = createShaderModule("res/shaders/shaderFrag.spv");
+            std::array<VkPipelineShaderStageCreateInfo, 2> shaderStages{};
+            shaderStages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+            shaderStages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
+            shaderStages[0].module = vertShaderModule;
+            shaderStages[0].pName = "main";
+            shaderStages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+            shaderStages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+            shaderStages[1].module = fragShaderModule;
+            shaderStages[1].pName = "main";
+
+            auto bindingDescription = Vertex::getBindingDescription();
+            auto attributeDescriptions = Vertex::getAttributeDescriptions();
+            VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
+            vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+            vertexInputInfo.vertexBindingDescriptionCount = 1;
+            vertexInputInfo.pVertexBindingDescriptions = &bindingDescription;
+            vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributeDescriptions.size());
+            vertexInputInfo.pVertexAttributeDescriptions = attributeDescriptions.data();
+
+            VkPipelineInputAssemblyStateCreateInfo inputAssembly{};
+            inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+            inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+
+            VkPipelineViewportStateCreateInfo viewportState{};
+            viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+            viewportState.viewportCount = 1;
+            viewportState.scissorCount = 1;
+
+            VkPipelineRasterizationStateCreateInfo rasterizer{};
+            rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+            rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
+            rasterizer.lineWidth = 1.0f;
+            rasterizer.cullMode = VK_CULL_MODE_BACK_BIT;
+            rasterizer.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+
+            VkPipelineMultisampleStateCreateInfo multisampling{};
+            multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+            multisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+
+            VkPipelineColorBlendAttachmentState colorBlendAttachment{};
+            colorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT |
+                                                  VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+            VkPipelineColorBlendStateCreateInfo colorBlending{};
+            colorBlending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+            colorBlending.attachmentCount = 1;
+            colorBlending.pAttachments = &colorBlendAttachment;
+
+            std::array<VkDynamicState, 2> dynamicStates = {VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR};
+            VkPipelineDynamicStateCreateInfo dynamicState{};
+            dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+            dynamicState.dynamicStateCount = static_cast<uint32_t>(dynamicStates.size());
+            dynamicState.pDynamicStates = dynamicStates.data();
+
+            VkGraphicsPipelineCreateInfo pipelineInfo{};
+            pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+            pipelineInfo.stageCount = static_cast<uint32_t>(shaderStages.size());
+            pipelineInfo.pStages = shaderStages.data();
+            pipelineInfo.pVertexInputState = &vertexInputInfo;
+            pipelineInfo.pInputAssemblyState = &inputAssembly;
+            pipelineInfo.pViewportState = &viewportState;
+            pipelineInfo.pRasterizationState = &rasterizer;
+            pipelineInfo.pMultisampleState = &multisampling;
+            pipelineInfo.pColorBlendState = &colorBlending;
+            pipelineInfo.pDynamicState = &dynamicState;
+            pipelineInfo.layout = pipelineLayout;
+            pipelineInfo.renderPass = renderPass;
+            pipelineInfo.subpass = 0;
+            const VkResult result = vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr,
+                                                              &pipeline);
+
+            vkDestroyShaderModule(device, fragShaderModule, nullptr);
+            vkDestroyShaderModule(device, vertShaderModule, nullptr);
+            check(result, "create graphics pipeline");
+        }
+
+        void createGeometry() {
+            // A single triangle, every synthetic draw references it with its own offsets
+            const std::array<Vertex, 3> vertices = {
+                Vertex{{0.0f, -0.5f, 0.0f}, {0.5f, 0.0f}},
+                Vertex{{0.5f, 0.5f, 0.0f}, {1.0f, 1.0f}},
+                Vertex{{-0.5f, 0.5f, 0.0f}, {0.0f, 1.0f}}
+            };
+            const std::array<uint32_t, 3> indices = {0, 1, 2};
+            indexOffset = sizeof(vertices);
+
+            VkBufferCreateInfo bufferInfo{};
+            bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+            bufferInfo.size = sizeof(vertices) + sizeof(indices);
+            bufferInfo.usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT;
+            bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+            check(vkCreateBuffer(device, &bufferInfo, nullptr, &geometryBuffer), "create buffer");
+
+            VkMemoryRequirements memRequirements;
+            vkGetBufferMemoryRequirements(device, geometryBuffer, &memRequirements);
+            VkMemoryAllocateInfo allocInfo{};
+            allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+            allocInfo.allocationSize = memRequirements.size;
+            allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits,
+                                                       VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                                                       VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+            check(vkAllocateMemory(device, &allocInfo, nullptr, &geometryMemory), "allocate buffer memory");
+            vkBindBufferMemory(device, geometryBuffer, geometryMemory, 0);
+
+            void *data;
+            vkMapMemory(device, geometryMemory, 0, bufferInfo.size, 0, &data);
+            memcpy(data, vertices.data(), sizeof(vertices));
+            memcpy(static_cast<char *>(data) + indexOffset, indices.data(), sizeof(indices));
+            vkUnmapMemory(device, geometryMemory);
+        }
+
+        /**
+         * @brief One vkCmdDrawIndexed per draw. firstInstance is the draw index, the vertex shader reads its model
+         * matrix there like in the indirect draw.
+         */
+        void recordDraws(VkCommandBuffer commandBuffer, uint32_t begin, uint32_t end) const {
+            vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+
+            VkViewport viewport{0.0f, 0.0f, (float) extent.width, (float) extent.height, 0.0f, 1.0f};
+            vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+            VkRect2D scissor{{0, 0}, extent};
+            vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+
+            VkDeviceSize offset = 0;
+            vkCmdBindVertexBuffers(commandBuffer, 0, 1, &geometryBuffer, &offset);
+            vkCmdBindIndexBuffer(commandBuffer, geometryBuffer, indexOffset, VK_INDEX_TYPE_UINT32);
+            vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1,
+                                    &descriptorSet, 0, nullptr);
+
+            for (uint32_t i = begin; i < end; i++) {
+                vkCmdDrawIndexed(commandBuffer, 3, 1, 0, 0, i);
+            }
+        }
+    };
+
+    /**
+     * @return Average milliseconds to record one frame of drawCount draws.
+     */
+    double measure(const HeadlessRasterContext &context, uint32_t threadCount, uint32_t drawCount,
+                   uint32_t frames) {
+        JobSystem jobSystem(threadCount);
+        ParallelCommandRecorder recorder(context.device, context.queueFamilyIndex, framesInFlight, jobSystem);
+
+        VkCommandBufferInheritanceInfo inheritanceInfo{};
+        inheritanceInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+        inheritanceInfo.renderPass = context.renderPass;
+        inheritanceInfo.subpass = 0;
+        inheritanceInfo.framebuffer = context.framebuffer;
+
+        auto recordFrame = [&](uint32_t frame) {
+            VkCommandBuffer primary = recorder.beginFrame(frame % framesInFlight);
+
+            VkCommandBufferBeginInfo beginInfo{};
+            beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+            beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+            check(vkBeginCommandBuffer(primary, &beginInfo), "begin recording command buffer");
+
+            VkClearValue clearValue{};
+            VkRenderPassBeginInfo renderPassInfo{};
+            renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+            renderPassInfo.renderPass = context.renderPass;
+            renderPassInfo.framebuffer = context.framebuffer;
+            renderPassInfo.renderArea = {{0, 0}, extent};
+            renderPassInfo.clearValueCount = 1;
+            renderPassInfo.pClearValues = &clearValue;
+            vkCmdBeginRenderPass(primary, &renderPassInfo, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+
+            recorder.recordParallel(inheritanceInfo, drawCount, minDrawsPerThread,
+                                    [&](VkCommandBuffer secondary, uint32_t begin, uint32_t end) {
+                                        context.recordDraws(secondary, begin, end);
+                                    });
+            const std::vector<VkCommandBuffer> &secondaries = recorder.getSecondaries();
+            vkCmdExecuteCommands(primary, static_cast<uint32_t>(secondaries.size()), secondaries.data());
+
+            vkCmdEndRenderPass(primary);
+            check(vkEndCommandBuffer(primary), "record command buffer");
+        };
+
+        // The first frames allocate the secondary buffers and grow the pools
+        for (uint32_t frame = 0; frame < framesInFlight * 2; frame++) {
+            recordFrame(frame);
+        }
+
+        const auto start = std::chrono::high_resolution_clock::now();
+        for (uint32_t frame = 0; frame < frames; frame++) {
+            recordFrame(frame);
+        }
+        const auto end = std::chrono::high_resolution_clock::now();
+        return std::chrono::duration<double, std::milli>(end - start).count() / frames;
+    }
+}
+
+int main(int argc, char *argv[]) {
+    try {
+        const Options options = parseOptions(argc, argv);
+        HeadlessRasterContext context;
+
+        std::vector<uint32_t> threadCounts;
+        const uint32_t hardwareThreads = std::max(1u, std::thread::hardware_concurrency());
+        for (uint32_t threads = 1; threads < hardwareThreads; threads *= 2) {
+            threadCounts.push_back(threads);
+        }
+        threadCounts.push_back(hardwareThreads);
+
+        std::cout << "Command recording benchmark on " << context.deviceName << ", " << options.frames
+                << " frames per measurement" << std::endl;
+        for (uint32_t drawCount: options.drawCounts) {
+            std::cout << drawCount << " draws" << std::endl;
+            double singleThreaded = 0.0;
+            for (uint32_t threads: threadCounts) {
+                const double milliseconds = measure(context, threads, drawCount, options.frames);
+                if (threads == 1) {
+                    singleThreaded = milliseconds;
+                }
+                std::cout << "  " << std::setw(3) << threads << " threads " << std::fixed << std::setprecision(3)
+                        << std::setw(9) << milliseconds << " ms/frame (" << std::setprecision(2)
+                        << singleThreaded / milliseconds << "x)" << std::endl;
+            }
+        }
+    } catch (const std::exception &e) {
+        std::cerr << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
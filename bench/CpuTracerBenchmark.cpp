@@ -0,0 +1,229 @@
+//
+// Created by redkc on 19/10/2026.
+//
+
+// Measures the CPU tracer in million rays per second on the bundled models, for the scalar binary BVH, the SIMD wide
+// BVH and the compressed wide BVH, with coherent primary rays and with incoherent random rays. The memory footprint of
+// every layout is printed too.
+//
+// Usage: CpuTracerBenchmark [--threads <count>] [--rays <count>] [model paths...]
+
+#define STB_IMAGE_IMPLEMENTATION
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "cpu/Bvh.h"
+#include "cpu/CompressedWideBvh.h"
+#include "cpu/CpuRaytracer.h"
+#include "cpu/ModelTriangles.h"
+#include "cpu/SimdKernels.h"
+#include "cpu/WideBvh.h"
+#include "model/Model.h"
+
+namespace {
+    struct Options {
+        uint32_t threadCount = 0;
+        uint32_t rayCount = 1u << 20;
+        std::vector<std::string> models;
+    };
+
+    struct Result {
+        double megaRaysPerSecond;
+        uint64_t hitCount;
+    };
+
+    Options parseOptions(int argc, char *argv[]) {
+        Options options;
+        for (int i = 1; i < argc; i++) {
+            const std::string argument = argv[i];
+            if (argument == "--threads" && i + 1 < argc) {
+                options.threadCount = static_cast<uint32_t>(std::stoul(argv[++i]));
+            } else if (argument == "--rays" && i + 1 < argc) {
+                options.rayCount = static_cast<uint32_t>(std::stoul(argv[++i]));
+            } else {
+                options.models.push_back(argument);
+            }
+        }
+        if (options.threadCount == 0) {
+            options.threadCount = std::max(1u, std::thread::hardware_concurrency());
+        }
+        if (options.models.empty()) {
+            options.models = {"res/models/healingo/healingo.fbx", "res/models/shroom/shroom.fbx"};
+        }
+        return options;
+    }
+
+    /**
+     * @brief A camera placed diagonally above the scene and looking at its center, with the projection of raygen.
+     */
+    std::vector<cpu::Ray> createPrimaryRays(const cpu::BvhNode &sceneBounds, uint32_t rayCount) {
+        const glm::vec3 center = (sceneBounds.boundsMin + sceneBounds.boundsMax) * 0.5f;
+        const float radius = glm::length(sceneBounds.boundsMax - sceneBounds.boundsMin) * 0.5f;
+        const glm::vec3 eye = center + glm::normalize(glm::vec3(1.0f, 1.0f, 1.0f)) * radius * 1.5f;
+        const glm::mat4 viewInverse = glm::inverse(glm::lookAt(eye, center, glm::vec3(0.0f, 0.0f, 1.0f)));
+        const glm::mat4 projInverse = glm::inverse(glm::perspective(glm::radians(90.0f), 1.0f, 0.1f, 100.0f));
+
+        const uint32_t size = std::max(1u, static_cast<uint32_t>(std::sqrt(static_cast<double>(rayCount))));
+        std::vector<cpu::Ray> rays;
+        rays.reserve(static_cast<size_t>(size) * size);
+        for (uint32_t y = 0; y < size; y++) {
+            for (uint32_t x = 0; x < size; x++) {
+                rays.push_back(cpu::CpuRaytracer::generateRay(viewInverse, projInverse, x, y, size, size));
+            }
+        }
+        return rays;
+    }
+
+    /**
+     * @brief Random origins inside the scene bounds with uniformly distributed directions, like secondary bounces.
+     */
+    std::vector<cpu::Ray> createIncoherentRays(const cpu::BvhNode &sceneBounds, uint32_t rayCount) {
+        std::mt19937 generator(1234);
+        std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+        std::vector<cpu::Ray> rays(rayCount);
+        for (cpu::Ray &ray: rays) {
+            ray.origin = glm::mix(sceneBounds.boundsMin, sceneBounds.boundsMax,
+                                  glm::vec3(unit(generator), unit(generator), unit(generator)));
+            const float z = unit(generator) * 2.0f - 1.0f;
+            const float phi = unit(generator) * 6.28318530718f;
+            const float r = std::sqrt(std::max(0.0f, 1.0f - z * z));
+            ray.direction = glm::vec3(r * std::cos(phi), r * std::sin(phi), z);
+            ray.tMin = 0.001f;
+            ray.tMax = 10000.0f;
+        }
+        return rays;
+    }
+
+    template<typename Intersector>
+    Result trace(const std::vector<cpu::Ray> &rays, uint32_t threadCount, const Intersector &intersect) {
+        constexpr size_t blockSize = 4096;
+        std::atomic<size_t> nextBlock{0};
+        std::atomic<uint64_t> hitCount{0};
+        auto worker = [&]() {
+            uint64_t hits = 0;
+            for (size_t begin = nextBlock.fetch_add(blockSize); begin < rays.size();
+                 begin = nextBlock.fetch_add(blockSize)) {
+                const size_t end = std::min(begin + blockSize, rays.size());
+                for (size_t i = begin; i < end; i++) {
+                    cpu::Hit hit{};
+                    hits += intersect(rays[i], hit) ? 1 : 0;
+                }
+            }
+            hitCount += hits;
+        };
+
+        const auto start = std::chrono::high_resolution_clock::now();
+        std::vector<std::thread> threads;
+        for (uint32_t i = 1; i < threadCount; i++) {
+            threads.emplace_back(worker);
+        }
+        worker();
+        for (auto &thread: threads) {
+            thread.join();
+        }
+        const auto end = std::chrono::high_resolution_clock::now();
+
+        const double seconds = std::chrono::duration<double>(end - start).count();
+        return {static_cast<double>(rays.size()) / seconds / 1e6, hitCount};
+    }
+
+    void report(const std::string &name, const std::vector<cpu::Ray> &rays, const cpu::Bvh &bvh,
+                const cpu::WideBvh &wideBvh, const cpu::CompressedWideBvh &compressedBvh, uint32_t threadCount) {
+        const Result binary = trace(rays, threadCount, [&](const cpu::Ray &ray, cpu::Hit &hit) {
+            return bvh.intersect(ray, hit);
+        });
+        const Result wide = trace(rays, threadCount, [&](const cpu::Ray &ray, cpu::Hit &hit) {
+            return wideBvh.intersect(ray, hit);
+        });
+        const Result compressed = trace(rays, threadCount, [&](const cpu::Ray &ray, cpu::Hit &hit) {
+            return compressedBvh.intersect(ray, hit);
+        });
+
+        std::cout << "  " << std::left << std::setw(11) << name << std::right << std::fixed << std::setprecision(2)
+                << "binary " << std::setw(7) << binary.megaRaysPerSecond << "   wide " << std::setw(7)
+                << wide.megaRaysPerSecond << " (" << wide.megaRaysPerSecond / binary.megaRaysPerSecond
+                << "x)   compressed " << std::setw(7) << compressed.megaRaysPerSecond << " ("
+                << compressed.megaRaysPerSecond / binary.megaRaysPerSecond << "x) Mrays/s, "
+                << 100.0 * static_cast<double>(wide.hitCount) / static_cast<double>(rays.size()) << "% hit";
+        // All BVHs hold the same triangles, so apart from a few rays grazing shared edges the hits have to agree
+        for (const Result &result: {wide, compressed}) {
+            const uint64_t difference = binary.hitCount > result.hitCount
+                                            ? binary.hitCount - result.hitCount
+                                            : result.hitCount - binary.hitCount;
+            if (difference > rays.size() / 10000) {
+                std::cout << "  MISMATCH: " << binary.hitCount << " vs " << result.hitCount << " hits";
+            }
+        }
+        std::cout << std::endl;
+    }
+
+    double megabytes(size_t bytes) {
+        return static_cast<double>(bytes) / (1024.0 * 1024.0);
+    }
+}
+
+int main(int argc, char *argv[]) {
+    const Options options = parseOptions(argc, argv);
+    std::cout << "CPU tracer benchmark, " << cpu::simdInstructionSet() << " kernels, " << options.threadCount
+            << " threads, " << options.rayCount << " rays per set" << std::endl;
+
+    for (const std::string &path: options.models) {
+        try {
+            const Model model(path);
+            std::vector<cpu::Triangle> triangles = cpu::collectTriangles(model);
+            const size_t triangleCount = triangles.size();
+            if (triangleCount == 0) {
+                std::cout << path << ": no triangles, skipped" << std::endl;
+                continue;
+            }
+
+            cpu::BvhBuildSettings settings{};
+            settings.threadCount = options.threadCount;
+            settings.traversalCost = cpu::WideBvh::binaryTraversalCost;
+            const auto start = std::chrono::high_resolution_clock::now();
+            cpu::Bvh bvh;
+            bvh.build(std::move(triangles), settings);
+            cpu::WideBvh wideBvh;
+            wideBvh.build(bvh);
+            const auto wideEnd = std::chrono::high_resolution_clock::now();
+            cpu::CompressedWideBvh compressedBvh;
+            compressedBvh.build(bvh);
+            const auto compressedEnd = std::chrono::high_resolution_clock::now();
+
+            std::cout << path << ": " << triangleCount << " triangles, built in " << std::fixed
+                    << std::setprecision(1) << std::chrono::duration<double, std::milli>(wideEnd - start).count()
+                    << " ms, compressed in "
+                    << std::chrono::duration<double, std::milli>(compressedEnd - wideEnd).count() << " ms" << std::endl;
+            const size_t binaryNodeMemory = bvh.getNodes().size() * sizeof(cpu::BvhNode);
+            const size_t wideNodeMemory = wideBvh.getNodes().size() * sizeof(cpu::WideBvhNode);
+            std::cout << std::setprecision(2) << "  nodes      binary " << megabytes(binaryNodeMemory)
+                    << " MB   wide " << megabytes(wideNodeMemory) << " MB   compressed "
+                    << megabytes(compressedBvh.getNodeMemory()) << " MB   ("
+                    << wideBvh.getNodes().size() << " wide nodes)" << std::endl;
+            std::cout << "  triangles  binary " << megabytes(bvh.getTriangles().size() * sizeof(cpu::Triangle))
+                    << " MB   packed " << megabytes(wideBvh.getPacks().size() * sizeof(cpu::TrianglePack8))
+                    << " MB   (" << wideBvh.getPacks().size() << " packs)" << std::endl;
+
+            const cpu::BvhNode &sceneBounds = bvh.getNodes()[0];
+            report("primary", createPrimaryRays(sceneBounds, options.rayCount), bvh, wideBvh, compressedBvh,
+                   options.threadCount);
+            report("incoherent", createIncoherentRays(sceneBounds, options.rayCount), bvh, wideBvh, compressedBvh,
+                   options.threadCount);
+        } catch (const std::exception &e) {
+            std::cerr << path << ": " << e.what() << std::endl;
+        }
+    }
+    return EXIT_SUCCESS;
+}
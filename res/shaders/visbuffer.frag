@@ -0,0 +1,10 @@
+#version 450
+
+layout(location = 0) flat in uint instanceIndex;
+
+// Instance index + 1 and the triangle within its draw, zero is the clear value of pixels without geometry
+layout(location = 0) out uvec2 outIds;
+
+void main() {
+    outIds = uvec2(instanceIndex + 1, gl_PrimitiveID);
+}
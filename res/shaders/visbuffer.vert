@@ -0,0 +1,22 @@
+#version 450
+
+layout(binding = 0) uniform UniformBufferObject {
+    mat4 model;
+    mat4 view;
+    mat4 proj;
+} ubo;
+
+// Same draw records as the forward pass, the record's firstInstance is its index
+layout(std430, binding = 2) readonly buffer DrawData {
+    mat4 models[];
+} drawData;
+
+layout(location = 0) in vec3 inPosition;
+
+layout(location = 0) flat out uint instanceIndex;
+
+void main() {
+    mat4 model = ubo.model * drawData.models[gl_InstanceIndex];
+    gl_Position = ubo.proj * ubo.view * model * vec4(inPosition, 1.0);
+    instanceIndex = gl_InstanceIndex;
+}
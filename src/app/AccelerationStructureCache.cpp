@@ -0,0 +1,152 @@
+//
+// Created by redkc on 19/10/2026.
+//
+
+#include "AccelerationStructureCache.h"
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <random>
+#include <sstream>
+
+namespace {
+    constexpr uint32_t cacheMagic = 0x53414d56; // "VMAS"
+    constexpr uint32_t cacheVersion = 1;
+    constexpr uint64_t fnvPrime = 1099511628211ull;
+
+    struct CacheHeader {
+        uint32_t magic;
+        uint32_t version;
+        uint64_t geometryHash;
+        uint8_t deviceUUID[VK_UUID_SIZE];
+        uint8_t driverUUID[VK_UUID_SIZE];
+        uint32_t blobCount;
+        uint32_t reserved;
+    };
+}
+
+AccelerationStructureCache::AccelerationStructureCache(std::string directory) : directory(std::move(directory)) {
+}
+
+bool AccelerationStructureCache::load(const Key &key, std::vector<std::vector<uint8_t> > &blobs) const {
+    blobs.clear();
+
+    std::ifstream file(path(key), std::ios::binary | std::ios::ate);
+    if (!file.is_open()) {
+        return false;
+    }
+    // Every size read from the file is checked against what is left of it, a corrupt one cannot allocate more
+    uint64_t remaining = static_cast<uint64_t>(file.tellg());
+    file.seekg(0);
+    if (remaining < sizeof(CacheHeader)) {
+        return false;
+    }
+
+    CacheHeader header{};
+    if (!file.read(reinterpret_cast<char *>(&header), sizeof(header)) ||
+        header.magic != cacheMagic ||
+        header.version != cacheVersion ||
+        header.geometryHash != key.geometryHash ||
+        std::memcmp(header.deviceUUID, key.deviceUUID.data(), VK_UUID_SIZE) != 0 ||
+        std::memcmp(header.driverUUID, key.driverUUID.data(), VK_UUID_SIZE) != 0) {
+        return false;
+    }
+    remaining -= sizeof(header);
+    if (header.blobCount > remaining / sizeof(uint64_t)) {
+        return false;
+    }
+
+    blobs.resize(header.blobCount);
+    for (auto &blob: blobs) {
+        uint64_t size = 0;
+        if (remaining < sizeof(size) || !file.read(reinterpret_cast<char *>(&size), sizeof(size)) ||
+            size > remaining - sizeof(size)) {
+            blobs.clear();
+            return false;
+        }
+        remaining -= sizeof(size) + size;
+        blob.resize(size);
+        if (!file.read(reinterpret_cast<char *>(blob.data()), static_cast<std::streamsize>(size))) {
+            blobs.clear();
+            return false;
+        }
+    }
+    return true;
+}
+
+bool AccelerationStructureCache::store(const Key &key, const std::vector<std::vector<uint8_t> > &blobs) const {
+    std::error_code error;
+    std::filesystem::create_directories(directory, error);
+    if (error) {
+        return false;
+    }
+
+    // Written to a temporary file first so a crash never leaves a half written cache behind. The name is unique,
+    // two processes storing the same key would otherwise write into one temporary file.
+    const std::string finalPath = path(key);
+    std::ostringstream temporaryName;
+    temporaryName << finalPath << "." << std::hex << std::random_device{}() << ".tmp";
+    const std::string temporaryPath = temporaryName.str();
+    {
+        std::ofstream file(temporaryPath, std::ios::binary | std::ios::trunc);
+        if (!file.is_open()) {
+            return false;
+        }
+
+        CacheHeader header{};
+        header.magic = cacheMagic;
+        header.version = cacheVersion;
+        header.geometryHash = key.geometryHash;
+        std::memcpy(header.deviceUUID, key.deviceUUID.data(), VK_UUID_SIZE);
+        std::memcpy(header.driverUUID, key.driverUUID.data(), VK_UUID_SIZE);
+        header.blobCount = static_cast<uint32_t>(blobs.size());
+        file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+
+        for (const auto &blob: blobs) {
+            const uint64_t size = blob.size();
+            file.write(reinterpret_cast<const char *>(&size), sizeof(size));
+            file.write(reinterpret_cast<const char *>(blob.data()), static_cast<std::streamsize>(size));
+        }
+        if (!file.good()) {
+            file.close();
+            std::filesystem::remove(temporaryPath, error);
+            return false;
+        }
+    }
+
+    std::filesystem::rename(temporaryPath, finalPath, error);
+    if (error) {
+        std::filesystem::remove(temporaryPath, error);
+        return false;
+    }
+    return true;
+}
+
+uint64_t AccelerationStructureCache::hash(const void *data, size_t size, uint64_t seed) {
+    const auto *bytes = static_cast<const uint8_t *>(data);
+    uint64_t result = seed;
+    for (size_t i = 0; i < size; i++) {
+        result ^= bytes[i];
+        result *= fnvPrime;
+    }
+    return result;
+}
+
+VkDeviceSize AccelerationStructureCache::deserializedSize(const std::vector<uint8_t> &blob) {
+    // Serialized header: driver UUID, compatibility UUID, serialized size, deserialized size, handle count
+    constexpr size_t offset = 2 * VK_UUID_SIZE + sizeof(uint64_t);
+    if (blob.size() < offset + sizeof(uint64_t)) {
+        return 0;
+    }
+    uint64_t size = 0;
+    std::memcpy(&size, blob.data() + offset, sizeof(size));
+    return size;
+}
+
+std::string AccelerationStructureCache::path(const Key &key) const {
+    std::ostringstream name;
+    name << directory << "/blas_" << std::hex << std::setw(16) << std::setfill('0') << key.geometryHash << ".bin";
+    return name.str();
+}
@@ -0,0 +1,63 @@
+//
+// Created by redkc on 19/10/2026.
+//
+
+#ifndef ACCELERATIONSTRUCTURECACHE_H
+#define ACCELERATIONSTRUCTURECACHE_H
+#include <array>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "vulkan/vulkan.h"
+
+/**
+ * @brief Stores serialized acceleration structures on disk so static geometry does not have to be rebuilt on every
+ * launch.
+ *
+ * A cache file holds one serialized blob per acceleration structure, in build order. The file is keyed by a hash of
+ * the geometry and by the device and driver UUIDs, since serialized data can only be loaded by a compatible driver.
+ * The caller still has to check each blob with vkGetDeviceAccelerationStructureCompatibilityKHR before using it.
+ */
+class AccelerationStructureCache {
+public:
+    struct Key {
+        uint64_t geometryHash = 0;
+        std::array<uint8_t, VK_UUID_SIZE> deviceUUID{};
+        std::array<uint8_t, VK_UUID_SIZE> driverUUID{};
+    };
+
+    explicit AccelerationStructureCache(std::string directory);
+
+    /**
+     * @brief Reads the blobs stored for key.
+     *
+     * @return False when there is no cache file for the key or it is damaged, blobs is left empty then.
+     */
+    bool load(const Key &key, std::vector<std::vector<uint8_t> > &blobs) const;
+
+    /**
+     * @brief Writes the blobs for key, replacing any earlier file.
+     */
+    bool store(const Key &key, const std::vector<std::vector<uint8_t> > &blobs) const;
+
+    /**
+     * @brief 64-bit FNV-1a, chain calls through seed to hash several ranges.
+     */
+    static uint64_t hash(const void *data, size_t size, uint64_t seed = fnvOffsetBasis);
+
+    /**
+     * @brief Size of the acceleration structure a serialized blob deserializes into, read from the blob header.
+     */
+    static VkDeviceSize deserializedSize(const std::vector<uint8_t> &blob);
+
+    static constexpr uint64_t fnvOffsetBasis = 14695981039346656037ull;
+
+private:
+    std::string path(const Key &key) const;
+
+    std::string directory;
+};
+
+
+#endif //ACCELERATIONSTRUCTURECACHE_H
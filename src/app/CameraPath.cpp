@@ -0,0 +1,74 @@
+//
+// Created by redkc on 19/10/2026.
+//
+
+#include "CameraPath.h"
+
+#include <cstdint>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+#include <glm/gtc/type_ptr.hpp>
+
+namespace {
+    template<size_t N>
+    bool readFloats(std::istringstream &stream, float (&values)[N]) {
+        for (float &value: values) {
+            if (!(stream >> value)) {
+                return false;
+            }
+        }
+        return true;
+    }
+}
+
+std::vector<RaytracingCamera> CameraPath::load(const std::string &path, float aspect) {
+    std::ifstream file(path);
+    if (!file.is_open()) {
+        throw std::runtime_error("failed to open camera path " + path + "!");
+    }
+
+    std::vector<RaytracingCamera> cameras;
+    std::string line;
+    for (uint32_t lineNumber = 1; std::getline(file, line); lineNumber++) {
+        std::istringstream stream(line);
+        std::string keyword;
+        if (!(stream >> keyword) || keyword[0] == '#') {
+            continue;
+        }
+
+        bool valid = false;
+        if (keyword == "lookat") {
+            float values[9];
+            if (readFloats(stream, values)) {
+                // A failed read zeroes its target, the default has to stay untouched
+                float fovY = 90.0f;
+                if (float value; stream >> value) {
+                    fovY = value;
+                }
+                const glm::vec3 eye(values[0], values[1], values[2]);
+                const glm::vec3 target(values[3], values[4], values[5]);
+                const glm::vec3 up(values[6], values[7], values[8]);
+                cameras.push_back(RaytracingCamera::createLookAt(eye, target, up, fovY, aspect));
+                valid = true;
+            }
+        } else if (keyword == "matrices") {
+            float view[16];
+            float proj[16];
+            if (readFloats(stream, view) && readFloats(stream, proj)) {
+                cameras.push_back(RaytracingCamera::createFromMatrices(glm::make_mat4(view), glm::make_mat4(proj)));
+                valid = true;
+            }
+        }
+
+        if (!valid) {
+            throw std::runtime_error("invalid keyframe in " + path + " on line " + std::to_string(lineNumber));
+        }
+    }
+
+    if (cameras.empty()) {
+        throw std::runtime_error("camera path " + path + " has no keyframes");
+    }
+    return cameras;
+}
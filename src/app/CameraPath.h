@@ -0,0 +1,32 @@
+//
+// Created by redkc on 19/10/2026.
+//
+
+#ifndef CAMERAPATH_H
+#define CAMERAPATH_H
+#include <string>
+#include <vector>
+
+#include "RaytracingCamera.h"
+
+/**
+ * @brief Loads the viewpoints of a batch render, one camera per output frame.
+ *
+ * A camera path is a text file with one keyframe per line, blank lines and lines starting with # are skipped:
+ *
+ *     lookat <eye xyz> <target xyz> <up xyz> [fov y in degrees, 90 by default]
+ *     matrices <view, 16 values> <proj, 16 values>
+ *
+ * Matrices are column major like glm, so a dump of glm::value_ptr() can be pasted as is.
+ */
+class CameraPath {
+public:
+    /**
+     * @param aspect Width over height of the output, used by lookat keyframes.
+     * @throws std::runtime_error when the file cannot be read, has a malformed line or no keyframes.
+     */
+    static std::vector<RaytracingCamera> load(const std::string &path, float aspect);
+};
+
+
+#endif //CAMERAPATH_H
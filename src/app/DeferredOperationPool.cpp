@@ -0,0 +1,130 @@
+//
+// Created by redkc on 19/10/2026.
+//
+
+#include "DeferredOperationPool.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+DeferredOperationPool::DeferredOperationPool(VkDevice device, uint32_t threadCount) : device(device) {
+    vkCreateDeferredOperationKHR = reinterpret_cast<PFN_vkCreateDeferredOperationKHR>(vkGetDeviceProcAddr(
+        device, "vkCreateDeferredOperationKHR"));
+    vkDestroyDeferredOperationKHR = reinterpret_cast<PFN_vkDestroyDeferredOperationKHR>(vkGetDeviceProcAddr(
+        device, "vkDestroyDeferredOperationKHR"));
+    vkGetDeferredOperationMaxConcurrencyKHR = reinterpret_cast<PFN_vkGetDeferredOperationMaxConcurrencyKHR>(
+        vkGetDeviceProcAddr(device, "vkGetDeferredOperationMaxConcurrencyKHR"));
+    vkGetDeferredOperationResultKHR = reinterpret_cast<PFN_vkGetDeferredOperationResultKHR>(vkGetDeviceProcAddr(
+        device, "vkGetDeferredOperationResultKHR"));
+    vkDeferredOperationJoinKHR = reinterpret_cast<PFN_vkDeferredOperationJoinKHR>(vkGetDeviceProcAddr(
+        device, "vkDeferredOperationJoinKHR"));
+    if (!vkCreateDeferredOperationKHR || !vkDeferredOperationJoinKHR) {
+        throw std::runtime_error("failed to load VK_KHR_deferred_host_operations!");
+    }
+
+    if (threadCount == 0) {
+        threadCount = std::max(1u, std::thread::hardware_concurrency()) - 1;
+    }
+    workers.reserve(threadCount);
+    for (uint32_t i = 0; i < threadCount; i++) {
+        workers.emplace_back(&DeferredOperationPool::workerLoop, this);
+    }
+}
+
+DeferredOperationPool::~DeferredOperationPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wakeWorkers.notify_all();
+    for (auto &worker: workers) {
+        worker.join();
+    }
+}
+
+VkDeferredOperationKHR DeferredOperationPool::createOperation() const {
+    VkDeferredOperationKHR operation;
+    if (vkCreateDeferredOperationKHR(device, nullptr, &operation) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create deferred operation!");
+    }
+    return operation;
+}
+
+void DeferredOperationPool::destroyOperation(VkDeferredOperationKHR operation) const {
+    vkDestroyDeferredOperationKHR(device, operation, nullptr);
+}
+
+VkResult DeferredOperationPool::join(VkDeferredOperationKHR operation, VkResult deferredResult) {
+    // The command either finished on the calling thread or failed before it was deferred
+    if (deferredResult != VK_OPERATION_DEFERRED_KHR) {
+        return deferredResult == VK_OPERATION_NOT_DEFERRED_KHR ? VK_SUCCESS : deferredResult;
+    }
+
+    // The caller joins as well, so only invite as many workers as the driver can keep busy
+    const uint32_t maxConcurrency = vkGetDeferredOperationMaxConcurrencyKHR(device, operation);
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        currentOperation = operation;
+        invitedWorkers = std::min(static_cast<uint32_t>(workers.size()), maxConcurrency > 0 ? maxConcurrency - 1 : 0);
+        activeWorkers = invitedWorkers;
+        generation++;
+    }
+    wakeWorkers.notify_all();
+
+    joinUntilDone(device, vkDeferredOperationJoinKHR, operation);
+
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        workersFinished.wait(lock, [this]() { return activeWorkers == 0; });
+        currentOperation = VK_NULL_HANDLE;
+    }
+
+    return vkGetDeferredOperationResultKHR(device, operation);
+}
+
+uint32_t DeferredOperationPool::threadCount() const {
+    return static_cast<uint32_t>(workers.size());
+}
+
+void DeferredOperationPool::workerLoop() {
+    uint64_t joinedGeneration = 0;
+    while (true) {
+        VkDeferredOperationKHR operation;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wakeWorkers.wait(lock, [&]() {
+                return stopping || (generation != joinedGeneration && invitedWorkers > 0);
+            });
+            if (stopping) {
+                return;
+            }
+            joinedGeneration = generation;
+            invitedWorkers--;
+            operation = currentOperation;
+        }
+
+        joinUntilDone(device, vkDeferredOperationJoinKHR, operation);
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            activeWorkers--;
+        }
+        workersFinished.notify_all();
+    }
+}
+
+void DeferredOperationPool::joinUntilDone(VkDevice device, PFN_vkDeferredOperationJoinKHR joinFunction,
+                                          VkDeferredOperationKHR operation) {
+    while (true) {
+        const VkResult result = joinFunction(device, operation);
+        if (result == VK_SUCCESS || result == VK_THREAD_DONE_KHR) {
+            return;
+        }
+        if (result != VK_THREAD_IDLE_KHR) {
+            // Errors are reported through vkGetDeferredOperationResultKHR
+            return;
+        }
+        // Idle means there is no work for this thread right now, but more may show up
+        std::this_thread::yield();
+    }
+}
@@ -0,0 +1,74 @@
+//
+// Created by redkc on 19/10/2026.
+//
+
+#ifndef DEFERREDOPERATIONPOOL_H
+#define DEFERREDOPERATIONPOOL_H
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "vulkan/vulkan.h"
+
+/**
+ * @brief Worker threads that help the driver finish deferred host operations (VK_KHR_deferred_host_operations).
+ *
+ * A host acceleration structure build started with a VkDeferredOperationKHR returns straight away. The work is
+ * then done by every thread that joins the operation. The workers are started once and sleep until the next join.
+ */
+class DeferredOperationPool {
+public:
+    /**
+     * @param threadCount Number of worker threads, 0 picks one less than the number of hardware threads.
+     */
+    DeferredOperationPool(VkDevice device, uint32_t threadCount = 0);
+
+    ~DeferredOperationPool();
+
+    DeferredOperationPool(const DeferredOperationPool &) = delete;
+
+    DeferredOperationPool &operator=(const DeferredOperationPool &) = delete;
+
+    VkDeferredOperationKHR createOperation() const;
+
+    void destroyOperation(VkDeferredOperationKHR operation) const;
+
+    /**
+     * @brief Joins the operation from the calling thread and the workers, and blocks until it has completed.
+     *
+     * @param deferredResult The result returned by the command that was deferred.
+     * @return The result of the operation.
+     */
+    VkResult join(VkDeferredOperationKHR operation, VkResult deferredResult);
+
+    uint32_t threadCount() const;
+
+private:
+    void workerLoop();
+
+    static void joinUntilDone(VkDevice device, PFN_vkDeferredOperationJoinKHR joinFunction,
+                              VkDeferredOperationKHR operation);
+
+    VkDevice device;
+    PFN_vkCreateDeferredOperationKHR vkCreateDeferredOperationKHR;
+    PFN_vkDestroyDeferredOperationKHR vkDestroyDeferredOperationKHR;
+    PFN_vkGetDeferredOperationMaxConcurrencyKHR vkGetDeferredOperationMaxConcurrencyKHR;
+    PFN_vkGetDeferredOperationResultKHR vkGetDeferredOperationResultKHR;
+    PFN_vkDeferredOperationJoinKHR vkDeferredOperationJoinKHR;
+
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable wakeWorkers;
+    std::condition_variable workersFinished;
+    VkDeferredOperationKHR currentOperation = VK_NULL_HANDLE;
+    /** @brief Incremented for every join, so a worker never joins the same operation twice */
+    uint64_t generation = 0;
+    uint32_t invitedWorkers = 0;
+    uint32_t activeWorkers = 0;
+    bool stopping = false;
+};
+
+
+#endif //DEFERREDOPERATIONPOOL_H
@@ -0,0 +1,67 @@
+//
+// Created by redkc on 19/10/2026.
+//
+
+#include "DeletionQueue.h"
+
+#include <vector>
+
+void DeletionQueue::retire(std::function<void()> &&deleter) {
+    std::lock_guard<std::mutex> lock(mutex);
+    entries.push_back({frameValue, std::move(deleter)});
+}
+
+void DeletionQueue::retire(uint64_t frameValue, std::function<void()> &&deleter) {
+    std::lock_guard<std::mutex> lock(mutex);
+    entries.push_back({frameValue, std::move(deleter)});
+}
+
+void DeletionQueue::collect(uint64_t completedFrameValue) {
+    std::vector<std::function<void()> > ready;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (auto it = entries.begin(); it != entries.end();) {
+            if (it->frameValue <= completedFrameValue) {
+                ready.push_back(std::move(it->deleter));
+                it = entries.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+
+    // Deleters run outside of the lock, they are allowed to retire more resources
+    for (auto &deleter: ready) {
+        deleter();
+    }
+}
+
+void DeletionQueue::flushAll() {
+    std::deque<Entry> remaining;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        remaining.swap(entries);
+    }
+    for (auto &entry: remaining) {
+        entry.deleter();
+    }
+    // A deleter may have retired something else while we were flushing
+    if (pending() > 0) {
+        flushAll();
+    }
+}
+
+uint64_t DeletionQueue::advance() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return ++frameValue;
+}
+
+uint64_t DeletionQueue::currentFrame() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return frameValue;
+}
+
+size_t DeletionQueue::pending() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return entries.size();
+}
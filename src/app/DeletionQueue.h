@@ -0,0 +1,65 @@
+//
+// Created by redkc on 19/10/2026.
+//
+
+#ifndef DELETIONQUEUE_H
+#define DELETIONQUEUE_H
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+
+/**
+ * @brief Defers the destruction of GPU handles until the GPU is done with them.
+ *
+ * Every deleter is retired together with the frame value that last used the resource. Once the renderer
+ * knows that frame value has completed on the GPU (the frame timeline semaphore reached it), collect() runs all
+ * deleters whose value has been passed. This replaces the vkDeviceWaitIdle + destroy pattern.
+ */
+class DeletionQueue {
+public:
+    /**
+     * @brief Retires a deleter with the frame value that is currently being recorded.
+     */
+    void retire(std::function<void()> &&deleter);
+
+    /**
+     * @brief Retires a deleter with an explicit frame value.
+     *
+     * @param frameValue The frame value that last used the resource.
+     * @param deleter The function that releases the resource.
+     */
+    void retire(uint64_t frameValue, std::function<void()> &&deleter);
+
+    /**
+     * @brief Runs every deleter whose frame value is less than or equal to completedFrameValue.
+     */
+    void collect(uint64_t completedFrameValue);
+
+    /**
+     * @brief Runs every pending deleter. Only valid once the device is idle (e.g. on shutdown).
+     */
+    void flushAll();
+
+    /**
+     * @brief Moves on to the next frame value. Called once per rendered frame.
+     */
+    uint64_t advance();
+
+    uint64_t currentFrame() const;
+
+    size_t pending() const;
+
+private:
+    struct Entry {
+        uint64_t frameValue;
+        std::function<void()> deleter;
+    };
+
+    std::deque<Entry> entries;
+    uint64_t frameValue = 1;
+    mutable std::mutex mutex;
+};
+
+
+#endif //DELETIONQUEUE_H
@@ -0,0 +1,118 @@
+//
+// Created by redkc on 19/10/2026.
+//
+
+#include "FramePacer.h"
+
+#include <thread>
+
+namespace {
+    /** @brief sleep_until overshoots by up to a scheduler tick, the rest of the wait spins */
+    constexpr std::chrono::microseconds spinThreshold{1500};
+    constexpr std::chrono::milliseconds reportInterval{1000};
+    /** @brief Frames that never complete, e.g. after a device loss, are dropped instead of piling up */
+    constexpr size_t maxPendingFrames = 16;
+}
+
+FramePacer::FramePacer(uint32_t targetFrameRate) : targetFrameRate(targetFrameRate) {
+}
+
+void FramePacer::setTargetFrameRate(uint32_t framesPerSecond) {
+    targetFrameRate = framesPerSecond;
+    nextFrameStart = {};
+}
+
+uint32_t FramePacer::getTargetFrameRate() const {
+    return targetFrameRate;
+}
+
+void FramePacer::waitForFrameStart() {
+    if (targetFrameRate == 0) {
+        return;
+    }
+
+    const auto period = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(
+        1.0 / targetFrameRate));
+    const Clock::time_point now = Clock::now();
+    if (nextFrameStart == Clock::time_point{} || now >= nextFrameStart) {
+        nextFrameStart = now + period;
+        return;
+    }
+
+    if (nextFrameStart - now > spinThreshold) {
+        std::this_thread::sleep_until(nextFrameStart - spinThreshold);
+    }
+    while (Clock::now() < nextFrameStart) {
+        std::this_thread::yield();
+    }
+    nextFrameStart += period;
+}
+
+void FramePacer::markInputSampled(uint64_t frameValue) {
+    if (pending.size() >= maxPendingFrames) {
+        pending.pop_front();
+    }
+    FrameTimes times{};
+    times.frameValue = frameValue;
+    times.input = Clock::now();
+    pending.push_back(times);
+}
+
+void FramePacer::markSubmitted(uint64_t frameValue) {
+    if (FrameTimes *times = find(frameValue)) {
+        times->submit = Clock::now();
+    }
+}
+
+void FramePacer::markPresented(uint64_t frameValue) {
+    if (FrameTimes *times = find(frameValue)) {
+        times->present = Clock::now();
+    }
+}
+
+void FramePacer::markCompleted(uint64_t completedValue) {
+    const Clock::time_point now = Clock::now();
+    while (!pending.empty() && pending.front().frameValue <= completedValue) {
+        const FrameTimes &times = pending.front();
+        // A frame that was skipped before it got presented has nothing to report
+        if (times.submit != Clock::time_point{} && times.present != Clock::time_point{}) {
+            sums.inputToSubmit += milliseconds(times.input, times.submit);
+            sums.submitToPresent += milliseconds(times.submit, times.present);
+            sums.submitToGpuDone += milliseconds(times.submit, now);
+            sums.inputToGpuDone += milliseconds(times.input, now);
+            sums.frames++;
+        }
+        pending.pop_front();
+    }
+
+    if (reportStart == Clock::time_point{}) {
+        reportStart = now;
+    }
+    if (now - reportStart >= reportInterval && sums.frames > 0) {
+        const float frames = static_cast<float>(sums.frames);
+        stats.inputToSubmit = sums.inputToSubmit / frames;
+        stats.submitToPresent = sums.submitToPresent / frames;
+        stats.submitToGpuDone = sums.submitToGpuDone / frames;
+        stats.inputToGpuDone = sums.inputToGpuDone / frames;
+        stats.frames = sums.frames;
+        sums = {};
+        reportStart = now;
+    }
+}
+
+const FramePacer::Stats &FramePacer::getStats() const {
+    return stats;
+}
+
+FramePacer::FrameTimes *FramePacer::find(uint64_t frameValue) {
+    for (FrameTimes &times: pending) {
+        if (times.frameValue == frameValue) {
+            return &times;
+        }
+    }
+    return nullptr;
+}
+
+float FramePacer::milliseconds(Clock::time_point from, Clock::time_point to) {
+    return std::chrono::duration<float, std::chrono::milliseconds::period>(to - from).count();
+}
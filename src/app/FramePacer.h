@@ -0,0 +1,83 @@
+//
+// Created by redkc on 19/10/2026.
+//
+
+#ifndef FRAMEPACER_H
+#define FRAMEPACER_H
+#include <chrono>
+#include <cstdint>
+#include <deque>
+
+/**
+ * @brief Holds frames to a target rate and measures how old the input of a frame is at each step of its way out.
+ *
+ * The frame loop sleeps in waitForFrameStart() before it waits for the GPU and samples input, so any waiting
+ * happens while the input is still unread instead of after. The timestamps of a frame are keyed by its frame
+ * value, the value the frame timeline is signaled with, and it counts as done on the GPU once markCompleted() sees
+ * that value.
+ */
+class FramePacer {
+public:
+    /** @brief Averages over the last report interval, in milliseconds */
+    struct Stats {
+        float inputToSubmit = 0.0f;
+        float submitToPresent = 0.0f;
+        float submitToGpuDone = 0.0f;
+        /** @brief Lower bound of input to photon, scanout comes on top */
+        float inputToGpuDone = 0.0f;
+        uint32_t frames = 0;
+    };
+
+    /**
+     * @param targetFrameRate Frames per second to pace to, 0 does not pace.
+     */
+    explicit FramePacer(uint32_t targetFrameRate = 0);
+
+    void setTargetFrameRate(uint32_t framesPerSecond);
+
+    uint32_t getTargetFrameRate() const;
+
+    /**
+     * @brief Sleeps until the next frame is due. A frame that fell behind starts right away, without catching up.
+     */
+    void waitForFrameStart();
+
+    void markInputSampled(uint64_t frameValue);
+
+    void markSubmitted(uint64_t frameValue);
+
+    void markPresented(uint64_t frameValue);
+
+    /**
+     * @brief Every frame up to completedValue has finished on the GPU.
+     */
+    void markCompleted(uint64_t completedValue);
+
+    const Stats &getStats() const;
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct FrameTimes {
+        uint64_t frameValue = 0;
+        Clock::time_point input{};
+        Clock::time_point submit{};
+        Clock::time_point present{};
+    };
+
+    FrameTimes *find(uint64_t frameValue);
+
+    static float milliseconds(Clock::time_point from, Clock::time_point to);
+
+    uint32_t targetFrameRate;
+    Clock::time_point nextFrameStart{};
+    /** @brief Frames sampled but not yet done on the GPU, oldest first */
+    std::deque<FrameTimes> pending;
+
+    Clock::time_point reportStart{};
+    Stats sums{};
+    Stats stats{};
+};
+
+
+#endif //FRAMEPACER_H
@@ -0,0 +1,302 @@
+//
+// Created by redkc on 19/10/2026.
+//
+
+#include "FrameScheduler.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <utility>
+
+FrameScheduler::FrameScheduler(VkDevice device, const std::vector<VkQueue> &queues, uint32_t framesInFlight)
+    : device(device), framesInFlight(framesInFlight), slotValues(framesInFlight, 0) {
+    if (queues.empty()) {
+        throw std::runtime_error("frame scheduler needs at least one queue!");
+    }
+    for (VkQueue queue: queues) {
+        auto existing = std::find(this->queues.begin(), this->queues.end(), queue);
+        queueSlots.push_back(static_cast<uint32_t>(existing - this->queues.begin()));
+        if (existing == this->queues.end()) {
+            this->queues.push_back(queue);
+        }
+    }
+
+    vkQueueSubmit2KHR = reinterpret_cast<PFN_vkQueueSubmit2KHR>(vkGetDeviceProcAddr(device, "vkQueueSubmit2KHR"));
+    if (vkQueueSubmit2KHR == nullptr) {
+        throw std::runtime_error("failed to load vkQueueSubmit2KHR!");
+    }
+
+    VkSemaphoreTypeCreateInfo typeInfo{};
+    typeInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+    typeInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+    typeInfo.initialValue = 0;
+
+    VkSemaphoreCreateInfo semaphoreInfo{};
+    semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+    semaphoreInfo.pNext = &typeInfo;
+    if (vkCreateSemaphore(device, &semaphoreInfo, nullptr, &timeline) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create frame timeline semaphore!");
+    }
+
+    if (this->queues.size() > 1) {
+        queueTimelines.resize(this->queues.size(), VK_NULL_HANDLE);
+        queueTimelineValues.resize(this->queues.size(), 0);
+        for (VkSemaphore &queueTimeline: queueTimelines) {
+            if (vkCreateSemaphore(device, &semaphoreInfo, nullptr, &queueTimeline) != VK_SUCCESS) {
+                throw std::runtime_error("failed to create queue timeline semaphore!");
+            }
+        }
+    }
+}
+
+FrameScheduler::~FrameScheduler() {
+    for (VkSemaphore queueTimeline: queueTimelines) {
+        vkDestroySemaphore(device, queueTimeline, nullptr);
+    }
+    vkDestroySemaphore(device, timeline, nullptr);
+}
+
+uint32_t FrameScheduler::beginFrame(uint64_t frameValue) {
+    if (frameValue <= submittedValue) {
+        throw std::runtime_error("frame values have to increase from frame to frame!");
+    }
+    this->frameValue = frameValue;
+    frameSlot = static_cast<uint32_t>(frameCount++ % framesInFlight);
+    wait(slotValues[frameSlot]);
+    passes.clear();
+    return frameSlot;
+}
+
+uint32_t FrameScheduler::addPass(Pass pass) {
+    if (pass.queue >= queueSlots.size()) {
+        throw std::runtime_error("frame pass " + pass.name + " runs on an unknown queue!");
+    }
+    for (uint32_t dependency: pass.dependencies) {
+        if (dependency >= passes.size()) {
+            throw std::runtime_error("frame pass " + pass.name + " depends on an unknown pass!");
+        }
+    }
+    passes.push_back(std::move(pass));
+    return static_cast<uint32_t>(passes.size() - 1);
+}
+
+bool FrameScheduler::waitsOnOtherQueue(const Pass &pass) const {
+    for (uint32_t dependency: pass.dependencies) {
+        if (queueSlots[passes[dependency].queue] != queueSlots[pass.queue]) {
+            return true;
+        }
+    }
+    return false;
+}
+
+std::vector<uint32_t> FrameScheduler::sortPasses() const {
+    // Kahn's algorithm. Among the ready passes the ones without semaphore waits go first, so they can share a batch
+    // with what came before instead of being held back by a wait. Passes waiting on another queue go last, that work
+    // was submitted this very frame and is the least likely to be done, everything behind it on the queue would stall
+    std::vector<uint32_t> remainingDependencies(passes.size());
+    std::vector<std::vector<uint32_t> > dependents(passes.size());
+    for (uint32_t i = 0; i < passes.size(); i++) {
+        remainingDependencies[i] = static_cast<uint32_t>(passes[i].dependencies.size());
+        for (uint32_t dependency: passes[i].dependencies) {
+            dependents[dependency].push_back(i);
+        }
+    }
+
+    auto waitRank = [this](const Pass &pass) {
+        if (waitsOnOtherQueue(pass)) {
+            return 2;
+        }
+        return pass.waits.empty() ? 0 : 1;
+    };
+
+    std::vector<uint32_t> order;
+    std::vector<bool> scheduled(passes.size(), false);
+    while (order.size() < passes.size()) {
+        uint32_t next = UINT32_MAX;
+        for (uint32_t i = 0; i < passes.size(); i++) {
+            if (scheduled[i] || remainingDependencies[i] > 0) {
+                continue;
+            }
+            if (next == UINT32_MAX || waitRank(passes[i]) < waitRank(passes[next])) {
+                next = i;
+            }
+        }
+        if (next == UINT32_MAX) {
+            throw std::runtime_error("frame pass dependencies contain a cycle!");
+        }
+
+        scheduled[next] = true;
+        order.push_back(next);
+        for (uint32_t dependent: dependents[next]) {
+            remainingDependencies[dependent]--;
+        }
+    }
+    return order;
+}
+
+void FrameScheduler::submit() {
+    struct Batch {
+        std::vector<VkSemaphoreSubmitInfo> waits;
+        std::vector<VkCommandBufferSubmitInfo> commandBuffers;
+        std::vector<VkSemaphoreSubmitInfo> signals;
+        /** @brief A batch on another queue waits for this one, through the timeline of this queue */
+        bool signalsQueueTimeline = false;
+        uint64_t queueTimelineValue = 0;
+    };
+    struct QueueWait {
+        uint32_t queue;
+        uint32_t batch;
+        uint32_t waitingQueue;
+        uint32_t waitingBatch;
+    };
+
+    // Waits apply to the whole batch and signals cover everything before them, so a pass that waits starts a new
+    // batch and nothing is appended after a signal. Everything else is merged into the current batch of its queue.
+    std::vector<std::vector<Batch> > batches(queues.size());
+    std::vector<std::pair<uint32_t, uint32_t> > passBatches(passes.size());
+    std::vector<QueueWait> queueWaits;
+    for (uint32_t index: sortPasses()) {
+        const Pass &pass = passes[index];
+        const uint32_t queue = queueSlots[pass.queue];
+        std::vector<Batch> &queueBatches = batches[queue];
+        const bool waits = !pass.waits.empty() || waitsOnOtherQueue(pass);
+        if (queueBatches.empty() || !queueBatches.back().signals.empty() || queueBatches.back().signalsQueueTimeline ||
+            (waits && !queueBatches.back().commandBuffers.empty())) {
+            queueBatches.emplace_back();
+        }
+        const uint32_t batchIndex = static_cast<uint32_t>(queueBatches.size() - 1);
+        passBatches[index] = {queue, batchIndex};
+
+        for (uint32_t dependency: pass.dependencies) {
+            const auto [dependencyQueue, dependencyBatch] = passBatches[dependency];
+            if (dependencyQueue != queue) {
+                batches[dependencyQueue][dependencyBatch].signalsQueueTimeline = true;
+                queueWaits.push_back({dependencyQueue, dependencyBatch, queue, batchIndex});
+            }
+        }
+
+        Batch &batch = queueBatches.back();
+        batch.waits.insert(batch.waits.end(), pass.waits.begin(), pass.waits.end());
+        for (VkCommandBuffer commandBuffer: pass.commandBuffers) {
+            VkCommandBufferSubmitInfo commandBufferInfo{};
+            commandBufferInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_SUBMIT_INFO;
+            commandBufferInfo.commandBuffer = commandBuffer;
+            batch.commandBuffers.push_back(commandBufferInfo);
+        }
+        batch.signals.insert(batch.signals.end(), pass.signals.begin(), pass.signals.end());
+    }
+
+    // The frame is only complete once the other queues are done with it as well
+    for (uint32_t queue = 1; queue < queues.size(); queue++) {
+        if (!batches[queue].empty()) {
+            batches[queue].back().signalsQueueTimeline = true;
+            queueWaits.push_back({queue, static_cast<uint32_t>(batches[queue].size() - 1), 0, UINT32_MAX});
+        }
+    }
+
+    // Values are handed out in submission order, a timeline has to be signaled with increasing values
+    for (uint32_t queue = 0; queue < queueTimelines.size(); queue++) {
+        for (Batch &batch: batches[queue]) {
+            if (batch.signalsQueueTimeline) {
+                batch.queueTimelineValue = ++queueTimelineValues[queue];
+                batch.signals.push_back(semaphoreInfo(queueTimelines[queue], VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT,
+                                                      batch.queueTimelineValue));
+            }
+        }
+    }
+
+    std::vector<VkSemaphoreSubmitInfo> frameWaits;
+    for (const QueueWait &queueWait: queueWaits) {
+        const VkSemaphoreSubmitInfo wait = semaphoreInfo(queueTimelines[queueWait.queue],
+                                                         VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT,
+                                                         batches[queueWait.queue][queueWait.batch].queueTimelineValue);
+        if (queueWait.waitingBatch == UINT32_MAX) {
+            frameWaits.push_back(wait);
+        } else {
+            batches[queueWait.waitingQueue][queueWait.waitingBatch].waits.push_back(wait);
+        }
+    }
+
+    // The timeline is signaled every frame, even without work, so waiting on a slot never blocks forever. Waiting
+    // for the other queues gets a batch of its own, the work of the first queue does not have to wait for them.
+    std::vector<Batch> &frameBatches = batches[0];
+    if (frameBatches.empty() || !frameWaits.empty()) {
+        frameBatches.emplace_back();
+    }
+    frameBatches.back().waits.insert(frameBatches.back().waits.end(), frameWaits.begin(), frameWaits.end());
+    frameBatches.back().signals.push_back(semaphoreInfo(timeline, VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, frameValue));
+
+    // The first queue goes last, so the queue timelines it waits on are already signaled by submitted work
+    lastBatchCount = 0;
+    for (uint32_t queue = static_cast<uint32_t>(queues.size()); queue-- > 0;) {
+        if (batches[queue].empty()) {
+            continue;
+        }
+        std::vector<VkSubmitInfo2> submitInfos;
+        submitInfos.reserve(batches[queue].size());
+        for (const Batch &batch: batches[queue]) {
+            VkSubmitInfo2 submitInfo{};
+            submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO_2;
+            submitInfo.waitSemaphoreInfoCount = static_cast<uint32_t>(batch.waits.size());
+            submitInfo.pWaitSemaphoreInfos = batch.waits.data();
+            submitInfo.commandBufferInfoCount = static_cast<uint32_t>(batch.commandBuffers.size());
+            submitInfo.pCommandBufferInfos = batch.commandBuffers.data();
+            submitInfo.signalSemaphoreInfoCount = static_cast<uint32_t>(batch.signals.size());
+            submitInfo.pSignalSemaphoreInfos = batch.signals.data();
+            submitInfos.push_back(submitInfo);
+        }
+
+        if (vkQueueSubmit2KHR(queues[queue], static_cast<uint32_t>(submitInfos.size()), submitInfos.data(),
+                              VK_NULL_HANDLE) != VK_SUCCESS) {
+            throw std::runtime_error("failed to submit frame!");
+        }
+        lastBatchCount += static_cast<uint32_t>(submitInfos.size());
+    }
+    submittedValue = frameValue;
+    slotValues[frameSlot] = frameValue;
+    passes.clear();
+}
+
+uint64_t FrameScheduler::completedValue() const {
+    uint64_t value = 0;
+    if (vkGetSemaphoreCounterValue(device, timeline, &value) != VK_SUCCESS) {
+        throw std::runtime_error("failed to read frame timeline semaphore!");
+    }
+    return value;
+}
+
+void FrameScheduler::wait(uint64_t value) const {
+    if (value == 0) {
+        return;
+    }
+    VkSemaphoreWaitInfo waitInfo{};
+    waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+    waitInfo.semaphoreCount = 1;
+    waitInfo.pSemaphores = &timeline;
+    waitInfo.pValues = &value;
+    if (vkWaitSemaphores(device, &waitInfo, UINT64_MAX) != VK_SUCCESS) {
+        throw std::runtime_error("failed to wait for frame timeline semaphore!");
+    }
+}
+
+void FrameScheduler::waitSubmitted() const {
+    wait(submittedValue);
+}
+
+uint32_t FrameScheduler::getFrameSlot() const {
+    return frameSlot;
+}
+
+uint32_t FrameScheduler::getLastBatchCount() const {
+    return lastBatchCount;
+}
+
+VkSemaphoreSubmitInfo FrameScheduler::semaphoreInfo(VkSemaphore semaphore, VkPipelineStageFlags2 stageMask,
+                                                    uint64_t value) {
+    VkSemaphoreSubmitInfo info{};
+    info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO;
+    info.semaphore = semaphore;
+    info.stageMask = stageMask;
+    info.value = value;
+    return info;
+}
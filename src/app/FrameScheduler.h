@@ -0,0 +1,112 @@
+//
+// Created by redkc on 19/10/2026.
+//
+
+#ifndef FRAMESCHEDULER_H
+#define FRAMESCHEDULER_H
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "vulkan/vulkan.h"
+
+/**
+ * @brief Submits all GPU work of a frame from one dependency list, synchronized by a single timeline semaphore.
+ *
+ * Each frame is made of passes (acceleration structure update, trace, raster, ...). A pass lists the passes it
+ * depends on and the binary semaphores it waits on or signals, e.g. the swapchain acquire and present semaphores.
+ * submit() orders the passes and packs them into as few VkSubmitInfo2 batches as possible: a new batch only starts
+ * where a pass has to wait on a semaphore, so work without waits never sits behind an acquire. Every queue gets its
+ * batches in one vkQueueSubmit2 call, and the last batch of the first queue signals the timeline with the frame value.
+ *
+ * Passes can run on different queues, e.g. the trace on an async compute queue next to the raster work. A dependency
+ * between passes on different queues waits on a timeline semaphore of the queue that runs the dependency, and the
+ * frame only completes once every queue has finished its part of it. Queues given more than once are merged.
+ *
+ * The timeline value of a frame is the deletion queue frame value, so the completed value can be handed straight
+ * to DeletionQueue::collect().
+ */
+class FrameScheduler {
+public:
+    struct Pass {
+        std::string name;
+        /** @brief Index into the queues the scheduler was created with */
+        uint32_t queue = 0;
+        std::vector<VkCommandBuffer> commandBuffers;
+        /** @brief Indices returned by addPass() for passes of this frame that have to execute first */
+        std::vector<uint32_t> dependencies;
+        std::vector<VkSemaphoreSubmitInfo> waits;
+        std::vector<VkSemaphoreSubmitInfo> signals;
+    };
+
+    FrameScheduler(VkDevice device, const std::vector<VkQueue> &queues, uint32_t framesInFlight);
+
+    ~FrameScheduler();
+
+    FrameScheduler(const FrameScheduler &) = delete;
+
+    FrameScheduler &operator=(const FrameScheduler &) = delete;
+
+    /**
+     * @brief Waits until the frame that last used the returned slot has completed on the GPU.
+     *
+     * @param frameValue Monotonically increasing value of the frame, signaled on the timeline once it completes.
+     * @return The frame slot to use for per-frame resources.
+     */
+    uint32_t beginFrame(uint64_t frameValue);
+
+    /**
+     * @return Index of the pass, to be used in the dependency list of later passes.
+     */
+    uint32_t addPass(Pass pass);
+
+    /**
+     * @brief Submits the passes added since beginFrame() and signals the timeline with the frame value.
+     */
+    void submit();
+
+    uint64_t completedValue() const;
+
+    void wait(uint64_t value) const;
+
+    /**
+     * @brief Waits for everything submitted so far, without idling the whole device.
+     */
+    void waitSubmitted() const;
+
+    uint32_t getFrameSlot() const;
+
+    /** @brief Number of VkSubmitInfo2 batches the last frame needed */
+    uint32_t getLastBatchCount() const;
+
+    static VkSemaphoreSubmitInfo semaphoreInfo(VkSemaphore semaphore, VkPipelineStageFlags2 stageMask,
+                                               uint64_t value = 0);
+
+private:
+    std::vector<uint32_t> sortPasses() const;
+
+    bool waitsOnOtherQueue(const Pass &pass) const;
+
+    VkDevice device;
+    /** @brief Distinct queues, the first one signals the frame timeline */
+    std::vector<VkQueue> queues;
+    /** @brief Maps Pass::queue to an index into queues */
+    std::vector<uint32_t> queueSlots;
+    VkSemaphore timeline = VK_NULL_HANDLE;
+    /** @brief One timeline per queue for dependencies between queues, empty with a single queue */
+    std::vector<VkSemaphore> queueTimelines;
+    std::vector<uint64_t> queueTimelineValues;
+    PFN_vkQueueSubmit2KHR vkQueueSubmit2KHR;
+    uint32_t framesInFlight;
+    uint32_t frameSlot = 0;
+    uint64_t frameCount = 0;
+    uint64_t frameValue = 0;
+    uint64_t submittedValue = 0;
+    /** @brief Frame value that last used each slot */
+    std::vector<uint64_t> slotValues;
+    std::vector<Pass> passes;
+    uint32_t lastBatchCount = 0;
+};
+
+
+#endif //FRAMESCHEDULER_H
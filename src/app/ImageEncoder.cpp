@@ -0,0 +1,265 @@
+//
+// Created by redkc on 19/10/2026.
+//
+
+#include "ImageEncoder.h"
+
+#include <algorithm>
+#include <cctype>
+#include <fstream>
+#include <stdexcept>
+
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include <stb_image_write.h>
+
+namespace {
+    constexpr int jpgQuality = 95;
+
+    uint8_t toUnorm8(float value) {
+        return static_cast<uint8_t>(std::clamp(value, 0.0f, 1.0f) * 255.0f + 0.5f);
+    }
+
+    /** @brief Drops alpha, LDR files are written as RGB like the PPM of the CPU backend */
+    std::vector<uint8_t> toRgb8(const ImageEncoder::Job &job) {
+        const size_t pixelCount = static_cast<size_t>(job.width) * job.height;
+        std::vector<uint8_t> rgb(pixelCount * 3);
+        if (job.pixelFormat == ImageEncoder::PixelFormat::Bgra8) {
+            const auto *bgra = static_cast<const uint8_t *>(job.pixels);
+            for (size_t i = 0; i < pixelCount; i++) {
+                rgb[i * 3 + 0] = bgra[i * 4 + 2];
+                rgb[i * 3 + 1] = bgra[i * 4 + 1];
+                rgb[i * 3 + 2] = bgra[i * 4 + 0];
+            }
+        } else {
+            const auto *rgba = static_cast<const float *>(job.pixels);
+            for (size_t i = 0; i < pixelCount; i++) {
+                rgb[i * 3 + 0] = toUnorm8(rgba[i * 4 + 0]);
+                rgb[i * 3 + 1] = toUnorm8(rgba[i * 4 + 1]);
+                rgb[i * 3 + 2] = toUnorm8(rgba[i * 4 + 2]);
+            }
+        }
+        return rgb;
+    }
+
+    std::vector<float> toRgb32f(const ImageEncoder::Job &job) {
+        const size_t pixelCount = static_cast<size_t>(job.width) * job.height;
+        std::vector<float> rgb(pixelCount * 3);
+        if (job.pixelFormat == ImageEncoder::PixelFormat::Bgra8) {
+            const auto *bgra = static_cast<const uint8_t *>(job.pixels);
+            for (size_t i = 0; i < pixelCount; i++) {
+                rgb[i * 3 + 0] = bgra[i * 4 + 2] / 255.0f;
+                rgb[i * 3 + 1] = bgra[i * 4 + 1] / 255.0f;
+                rgb[i * 3 + 2] = bgra[i * 4 + 0] / 255.0f;
+            }
+        } else {
+            const auto *rgba = static_cast<const float *>(job.pixels);
+            for (size_t i = 0; i < pixelCount; i++) {
+                rgb[i * 3 + 0] = rgba[i * 4 + 0];
+                rgb[i * 3 + 1] = rgba[i * 4 + 1];
+                rgb[i * 3 + 2] = rgba[i * 4 + 2];
+            }
+        }
+        return rgb;
+    }
+
+    bool writePpm(const std::string &path, uint32_t width, uint32_t height, const std::vector<uint8_t> &rgb) {
+        std::ofstream file(path, std::ios::binary);
+        if (!file.is_open()) {
+            return false;
+        }
+        file << "P6\n" << width << " " << height << "\n255\n";
+        file.write(reinterpret_cast<const char *>(rgb.data()), static_cast<std::streamsize>(rgb.size()));
+        return file.good();
+    }
+
+    /** @brief Portable float map, a negative scale marks little endian and the rows go from bottom to top */
+    bool writePfm(const std::string &path, uint32_t width, uint32_t height, const std::vector<float> &rgb) {
+        std::ofstream file(path, std::ios::binary);
+        if (!file.is_open()) {
+            return false;
+        }
+        file << "PF\n" << width << " " << height << "\n-1.0\n";
+        const size_t rowSize = static_cast<size_t>(width) * 3;
+        for (uint32_t y = height; y-- > 0;) {
+            file.write(reinterpret_cast<const char *>(rgb.data() + y * rowSize),
+                       static_cast<std::streamsize>(rowSize * sizeof(float)));
+        }
+        return file.good();
+    }
+}
+
+ImageEncoder::ImageEncoder(uint32_t threadCount, uint32_t queueCapacity) {
+    if (threadCount == 0) {
+        threadCount = std::max(1u, std::thread::hardware_concurrency());
+    }
+    this->queueCapacity = queueCapacity != 0 ? queueCapacity : threadCount * 2;
+
+    workers.reserve(threadCount);
+    for (uint32_t i = 0; i < threadCount; i++) {
+        workers.emplace_back(&ImageEncoder::workerLoop, this);
+    }
+}
+
+ImageEncoder::~ImageEncoder() {
+    {
+        std::lock_guard lock(mutex);
+        stopping = true;
+    }
+    jobAvailable.notify_all();
+    for (std::thread &worker: workers) {
+        worker.join();
+    }
+}
+
+ImageEncoder::FileFormat ImageEncoder::fileFormat(const std::string &path) {
+    const size_t slash = path.find_last_of("/\\");
+    const size_t dot = path.find_last_of('.');
+    std::string extension;
+    if (dot != std::string::npos && (slash == std::string::npos || dot > slash)) {
+        extension = path.substr(dot + 1);
+    }
+    std::transform(extension.begin(), extension.end(), extension.begin(),
+                   [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+
+    if (extension == "ppm") {
+        return FileFormat::Ppm;
+    }
+    if (extension == "png") {
+        return FileFormat::Png;
+    }
+    if (extension == "jpg" || extension == "jpeg") {
+        return FileFormat::Jpg;
+    }
+    if (extension == "bmp") {
+        return FileFormat::Bmp;
+    }
+    if (extension == "tga") {
+        return FileFormat::Tga;
+    }
+    if (extension == "hdr") {
+        return FileFormat::Hdr;
+    }
+    if (extension == "pfm") {
+        return FileFormat::Pfm;
+    }
+    throw std::runtime_error("unsupported image format: " + path);
+}
+
+void ImageEncoder::submit(Job job) {
+    // Unsupported paths fail here on the renderer thread instead of on a worker
+    fileFormat(job.path);
+
+    std::unique_lock lock(mutex);
+    rethrowError();
+    if (queue.size() >= queueCapacity) {
+        const auto start = std::chrono::steady_clock::now();
+        progress.wait(lock, [this]() { return queue.size() < queueCapacity || firstError; });
+        blockedTime += std::chrono::steady_clock::now() - start;
+        rethrowError();
+    }
+    queue.push_back(std::move(job));
+    submittedCount++;
+    lock.unlock();
+    jobAvailable.notify_one();
+}
+
+void ImageEncoder::waitForFinished(uint64_t count) {
+    std::unique_lock lock(mutex);
+    progress.wait(lock, [this, count]() { return finishedCount >= count || firstError; });
+    rethrowError();
+}
+
+void ImageEncoder::waitIdle() {
+    std::unique_lock lock(mutex);
+    progress.wait(lock, [this]() { return finishedCount == submittedCount; });
+    rethrowError();
+}
+
+uint64_t ImageEncoder::finishedJobs() const {
+    std::lock_guard lock(mutex);
+    return finishedCount;
+}
+
+std::chrono::duration<double, std::milli> ImageEncoder::backpressureTime() const {
+    std::lock_guard lock(mutex);
+    return blockedTime;
+}
+
+uint32_t ImageEncoder::threadCount() const {
+    return static_cast<uint32_t>(workers.size());
+}
+
+void ImageEncoder::workerLoop() {
+    for (;;) {
+        Job job;
+        {
+            std::unique_lock lock(mutex);
+            jobAvailable.wait(lock, [this]() { return stopping || !queue.empty(); });
+            // Queued jobs still get written on shutdown, their owners wait for onDone
+            if (queue.empty()) {
+                return;
+            }
+            job = std::move(queue.front());
+            queue.pop_front();
+        }
+        progress.notify_all();
+
+        std::exception_ptr error;
+        try {
+            encode(job);
+        } catch (...) {
+            error = std::current_exception();
+        }
+        if (job.onDone) {
+            job.onDone();
+        }
+
+        {
+            std::lock_guard lock(mutex);
+            finishedCount++;
+            if (error && !firstError) {
+                firstError = error;
+            }
+        }
+        progress.notify_all();
+    }
+}
+
+void ImageEncoder::encode(const Job &job) {
+    const int width = static_cast<int>(job.width);
+    const int height = static_cast<int>(job.height);
+
+    bool written = false;
+    switch (fileFormat(job.path)) {
+        case FileFormat::Ppm:
+            written = writePpm(job.path, job.width, job.height, toRgb8(job));
+            break;
+        case FileFormat::Png:
+            written = stbi_write_png(job.path.c_str(), width, height, 3, toRgb8(job).data(), width * 3) != 0;
+            break;
+        case FileFormat::Jpg:
+            written = stbi_write_jpg(job.path.c_str(), width, height, 3, toRgb8(job).data(), jpgQuality) != 0;
+            break;
+        case FileFormat::Bmp:
+            written = stbi_write_bmp(job.path.c_str(), width, height, 3, toRgb8(job).data()) != 0;
+            break;
+        case FileFormat::Tga:
+            written = stbi_write_tga(job.path.c_str(), width, height, 3, toRgb8(job).data()) != 0;
+            break;
+        case FileFormat::Hdr:
+            written = stbi_write_hdr(job.path.c_str(), width, height, 3, toRgb32f(job).data()) != 0;
+            break;
+        case FileFormat::Pfm:
+            written = writePfm(job.path, job.width, job.height, toRgb32f(job));
+            break;
+    }
+    if (!written) {
+        throw std::runtime_error("failed to write " + job.path + "!");
+    }
+}
+
+void ImageEncoder::rethrowError() {
+    if (firstError) {
+        std::rethrow_exception(firstError);
+    }
+}
@@ -0,0 +1,120 @@
+//
+// Created by redkc on 19/10/2026.
+//
+
+#ifndef IMAGEENCODER_H
+#define IMAGEENCODER_H
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief Worker pool that encodes rendered frames into image files next to the renderer.
+ *
+ * The file format follows the extension of the path: ppm, png, jpg, bmp and tga are written as 8-bit LDR, hdr
+ * (Radiance) and pfm as 32-bit float HDR. Jobs wait in a bounded queue, a full queue blocks submit() until a worker
+ * takes the next job, so a renderer that outpaces the encoders slows down instead of piling up frames. The pixels
+ * of a job are not copied, onDone tells the owner when they are no longer read.
+ */
+class ImageEncoder {
+public:
+    enum class FileFormat {
+        Ppm,
+        Png,
+        Jpg,
+        Bmp,
+        Tga,
+        Hdr,
+        Pfm
+    };
+
+    enum class PixelFormat {
+        /** @brief 8-bit BGRA, the layout of the swapchain and the storage image */
+        Bgra8,
+        /** @brief Float RGBA, the layout of cpu::Image */
+        Rgba32f
+    };
+
+    struct Job {
+        std::string path;
+        uint32_t width = 0;
+        uint32_t height = 0;
+        PixelFormat pixelFormat = PixelFormat::Bgra8;
+        /** @brief Tightly packed rows, the first one at the top */
+        const void *pixels = nullptr;
+        /** @brief Called on the worker once pixels is no longer read, also when encoding failed */
+        std::function<void()> onDone;
+    };
+
+    /**
+     * @param threadCount Encoding threads, 0 uses every hardware thread.
+     * @param queueCapacity Jobs waiting for a thread before submit() blocks, 0 picks twice the thread count.
+     */
+    explicit ImageEncoder(uint32_t threadCount = 0, uint32_t queueCapacity = 0);
+
+    /**
+     * @brief Finishes every queued job.
+     */
+    ~ImageEncoder();
+
+    ImageEncoder(const ImageEncoder &) = delete;
+
+    ImageEncoder &operator=(const ImageEncoder &) = delete;
+
+    /**
+     * @throws std::runtime_error for an unsupported extension.
+     */
+    static FileFormat fileFormat(const std::string &path);
+
+    /**
+     * @brief Queues a job, blocks while the queue is full. Rethrows the first error of an earlier job.
+     */
+    void submit(Job job);
+
+    /**
+     * @brief Blocks until at least count jobs have been finished since the encoder was created.
+     */
+    void waitForFinished(uint64_t count);
+
+    /**
+     * @brief Blocks until every submitted job is finished. Rethrows the first error of a job.
+     */
+    void waitIdle();
+
+    uint64_t finishedJobs() const;
+
+    /** @brief Time submit() spent blocked on a full queue, the renderer outpaced the encoders for that long */
+    std::chrono::duration<double, std::milli> backpressureTime() const;
+
+    uint32_t threadCount() const;
+
+private:
+    void workerLoop();
+
+    static void encode(const Job &job);
+
+    void rethrowError();
+
+    std::vector<std::thread> workers;
+    uint32_t queueCapacity;
+    std::deque<Job> queue;
+    mutable std::mutex mutex;
+    std::condition_variable jobAvailable;
+    /** @brief Signaled when a job leaves the queue and when one finishes */
+    std::condition_variable progress;
+    uint64_t submittedCount = 0;
+    uint64_t finishedCount = 0;
+    std::chrono::duration<double, std::milli> blockedTime{0};
+    bool stopping = false;
+    std::exception_ptr firstError;
+};
+
+
+#endif //IMAGEENCODER_H
@@ -0,0 +1,109 @@
+//
+// Created by redkc on 19/10/2026.
+//
+
+#include "JobSystem.h"
+
+#include <algorithm>
+
+JobSystem::JobSystem(uint32_t threadCount) {
+    if (threadCount == 0) {
+        threadCount = std::max(1u, std::thread::hardware_concurrency());
+    }
+    // The caller is thread 0, the workers take the remaining indices
+    workers.reserve(threadCount - 1);
+    for (uint32_t i = 1; i < threadCount; i++) {
+        workers.emplace_back(&JobSystem::workerLoop, this, i);
+    }
+}
+
+JobSystem::~JobSystem() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wakeWorkers.notify_all();
+    for (auto &worker: workers) {
+        worker.join();
+    }
+}
+
+void JobSystem::parallelFor(uint32_t count, uint32_t minItemsPerThread, const Job &job) {
+    if (count == 0) {
+        return;
+    }
+
+    const uint32_t usefulThreads = (count + std::max(1u, minItemsPerThread) - 1) / std::max(1u, minItemsPerThread);
+    const uint32_t threads = std::min(threadCount(), usefulThreads);
+    if (threads == 1) {
+        job(0, count, 0);
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        currentJob = &job;
+        currentCount = count;
+        currentThreadCount = threads;
+        activeWorkers = threads - 1;
+        firstError = nullptr;
+        generation++;
+    }
+    wakeWorkers.notify_all();
+
+    runRange(0);
+
+    std::exception_ptr error;
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        workersFinished.wait(lock, [this]() { return activeWorkers == 0; });
+        currentJob = nullptr;
+        error = firstError;
+    }
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+
+uint32_t JobSystem::threadCount() const {
+    return static_cast<uint32_t>(workers.size()) + 1;
+}
+
+void JobSystem::workerLoop(uint32_t threadIndex) {
+    uint64_t joinedGeneration = 0;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wakeWorkers.wait(lock, [&]() {
+                return stopping || (generation != joinedGeneration && threadIndex < currentThreadCount);
+            });
+            if (stopping) {
+                return;
+            }
+            joinedGeneration = generation;
+        }
+
+        runRange(threadIndex);
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            activeWorkers--;
+        }
+        workersFinished.notify_all();
+    }
+}
+
+void JobSystem::runRange(uint32_t threadIndex) {
+    const uint32_t begin = static_cast<uint32_t>(static_cast<uint64_t>(currentCount) * threadIndex /
+                                                 currentThreadCount);
+    const uint32_t end = static_cast<uint32_t>(static_cast<uint64_t>(currentCount) * (threadIndex + 1) /
+                                               currentThreadCount);
+    try {
+        (*currentJob)(begin, end, threadIndex);
+    } catch (...) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!firstError) {
+            firstError = std::current_exception();
+        }
+    }
+}
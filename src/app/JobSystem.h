@@ -0,0 +1,67 @@
+//
+// Created by redkc on 19/10/2026.
+//
+
+#ifndef JOBSYSTEM_H
+#define JOBSYSTEM_H
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief Persistent worker threads that split a range of work items between them and the calling thread.
+ *
+ * Every thread gets one contiguous range and a stable thread index, so per-thread resources such as command pools
+ * can be indexed with it without any locking. The workers sleep between jobs.
+ */
+class JobSystem {
+public:
+    using Job = std::function<void(uint32_t begin, uint32_t end, uint32_t threadIndex)>;
+
+    /**
+     * @param threadCount Number of threads including the caller, 0 uses every hardware thread.
+     */
+    explicit JobSystem(uint32_t threadCount = 0);
+
+    ~JobSystem();
+
+    JobSystem(const JobSystem &) = delete;
+
+    JobSystem &operator=(const JobSystem &) = delete;
+
+    /**
+     * @brief Runs job over [0, count) split into one range per thread and blocks until every range is done.
+     *
+     * The calling thread always takes thread index 0. Fewer threads are used when a range would get less than
+     * minItemsPerThread items. The first exception thrown by a range is rethrown on the calling thread.
+     */
+    void parallelFor(uint32_t count, uint32_t minItemsPerThread, const Job &job);
+
+    /** @brief Number of threads including the caller, thread indices are below this */
+    uint32_t threadCount() const;
+
+private:
+    void workerLoop(uint32_t threadIndex);
+
+    void runRange(uint32_t threadIndex);
+
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable wakeWorkers;
+    std::condition_variable workersFinished;
+    const Job *currentJob = nullptr;
+    uint32_t currentCount = 0;
+    uint32_t currentThreadCount = 0;
+    /** @brief Incremented for every job, so a worker never runs the same job twice */
+    uint64_t generation = 0;
+    uint32_t activeWorkers = 0;
+    bool stopping = false;
+    std::exception_ptr firstError;
+};
+
+
+#endif //JOBSYSTEM_H
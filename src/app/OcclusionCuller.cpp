@@ -0,0 +1,553 @@
+//
+// Created by redkc on 19/10/2026.
+//
+
+#include "OcclusionCuller.h"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+namespace {
+    constexpr uint32_t cullGroupSize = 64;
+    constexpr uint32_t reduceGroupSize = 8;
+    constexpr VkDeviceSize countersSize = sizeof(OcclusionCuller::Stats);
+
+    /** @brief Push constants of cull.comp */
+    struct CullConstants {
+        glm::mat4 viewProjection;
+        glm::vec2 pyramidSize;
+        uint32_t instanceCount;
+        uint32_t phase;
+        uint32_t secondPhaseOffset;
+        uint32_t pyramidLevels;
+    };
+
+    VkMemoryBarrier memoryBarrier(VkAccessFlags srcAccess, VkAccessFlags dstAccess) {
+        VkMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        barrier.srcAccessMask = srcAccess;
+        barrier.dstAccessMask = dstAccess;
+        return barrier;
+    }
+}
+
+OcclusionCuller::OcclusionCuller(VkDevice device, VkPhysicalDevice physicalDevice, DeletionQueue &deletionQueue,
+                                 uint32_t frameSlots)
+    : device(device), physicalDevice(physicalDevice), deletionQueue(deletionQueue), frames(frameSlots) {
+    // Read before anything is created, so a missing binary does not leave half a culler behind
+    const std::vector<char> cullShader = readShaderFile("res/shaders/cullComp.spv");
+    const std::vector<char> reduceShader = readShaderFile("res/shaders/hizComp.spv");
+
+    // The counters are all a slot needs before its instances are known, the draw lists follow in setInstances()
+    for (FrameResources &resources: frames) {
+        createBuffer(countersSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT |
+                                   VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                     VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                     resources.counters, resources.countersMemory);
+        if (vkMapMemory(device, resources.countersMemory, 0, countersSize, 0, &resources.countersMapped) !=
+            VK_SUCCESS) {
+            throw std::runtime_error("failed to map cull counters!");
+        }
+        std::memset(resources.countersMapped, 0, countersSize);
+    }
+
+    // Every read is a texelFetch, the sampler only has to exist
+    VkSamplerCreateInfo samplerInfo{};
+    samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+    samplerInfo.magFilter = VK_FILTER_NEAREST;
+    samplerInfo.minFilter = VK_FILTER_NEAREST;
+    samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+    samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.maxLod = VK_LOD_CLAMP_NONE;
+    if (vkCreateSampler(device, &samplerInfo, nullptr, &sampler) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create depth pyramid sampler!");
+    }
+
+    createPipelines(cullShader, reduceShader);
+}
+
+OcclusionCuller::~OcclusionCuller() {
+    for (FrameResources &resources: frames) {
+        retireDrawLists(resources);
+    }
+    retirePyramid();
+
+    std::vector<std::pair<VkBuffer, VkDeviceMemory>> counters;
+    for (const FrameResources &resources: frames) {
+        counters.emplace_back(resources.counters, resources.countersMemory);
+    }
+    deletionQueue.retire([device = device, counters, sampler = sampler, cullSetLayout = cullSetLayout,
+                             reduceSetLayout = reduceSetLayout, cullPipelineLayout = cullPipelineLayout,
+                             reducePipelineLayout = reducePipelineLayout, cullPipeline = cullPipeline,
+                             reducePipeline = reducePipeline]() {
+        for (const auto &[buffer, memory]: counters) {
+            vkDestroyBuffer(device, buffer, nullptr);
+            vkFreeMemory(device, memory, nullptr);
+        }
+        vkDestroyPipeline(device, cullPipeline, nullptr);
+        vkDestroyPipeline(device, reducePipeline, nullptr);
+        vkDestroyPipelineLayout(device, cullPipelineLayout, nullptr);
+        vkDestroyPipelineLayout(device, reducePipelineLayout, nullptr);
+        vkDestroyDescriptorSetLayout(device, cullSetLayout, nullptr);
+        vkDestroyDescriptorSetLayout(device, reduceSetLayout, nullptr);
+        vkDestroySampler(device, sampler, nullptr);
+    });
+}
+
+void OcclusionCuller::setDepthImage(VkImageView depthView, VkExtent2D extent) {
+    // Frames in flight still build and read the old pyramid, it goes once they have completed
+    retirePyramid();
+    pyramid = {};
+
+    // A power of two below the depth buffer halves cleanly down to one texel
+    pyramid.extent = {std::bit_floor(std::max(extent.width, 1u)), std::bit_floor(std::max(extent.height, 1u))};
+    pyramid.levels = static_cast<uint32_t>(std::bit_width(std::max(pyramid.extent.width, pyramid.extent.height)));
+
+    VkImageCreateInfo imageInfo{};
+    imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    imageInfo.imageType = VK_IMAGE_TYPE_2D;
+    imageInfo.format = VK_FORMAT_R32_SFLOAT;
+    imageInfo.extent = {pyramid.extent.width, pyramid.extent.height, 1};
+    imageInfo.mipLevels = pyramid.levels;
+    imageInfo.arrayLayers = 1;
+    imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+    imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+    imageInfo.usage = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+    imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    if (vkCreateImage(device, &imageInfo, nullptr, &pyramid.image) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create depth pyramid!");
+    }
+
+    VkMemoryRequirements memRequirements;
+    vkGetImageMemoryRequirements(device, pyramid.image, &memRequirements);
+    VkMemoryAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    allocInfo.allocationSize = memRequirements.size;
+    allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    if (vkAllocateMemory(device, &allocInfo, nullptr, &pyramid.memory) != VK_SUCCESS) {
+        throw std::runtime_error("failed to allocate depth pyramid memory!");
+    }
+    vkBindImageMemory(device, pyramid.image, pyramid.memory, 0);
+
+    VkImageViewCreateInfo viewInfo{};
+    viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    viewInfo.image = pyramid.image;
+    viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    viewInfo.format = VK_FORMAT_R32_SFLOAT;
+    viewInfo.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, pyramid.levels, 0, 1};
+    if (vkCreateImageView(device, &viewInfo, nullptr, &pyramid.view) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create depth pyramid view!");
+    }
+    pyramid.levelViews.resize(pyramid.levels);
+    for (uint32_t level = 0; level < pyramid.levels; level++) {
+        viewInfo.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, level, 1, 0, 1};
+        if (vkCreateImageView(device, &viewInfo, nullptr, &pyramid.levelViews[level]) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create depth pyramid view!");
+        }
+    }
+
+    // The cull sets point at the pyramid too, so they are replaced with it instead of updated while in use
+    const uint32_t frameCount = static_cast<uint32_t>(frames.size());
+    std::array<VkDescriptorPoolSize, 3> poolSizes{};
+    poolSizes[0] = {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, pyramid.levels + frameCount};
+    poolSizes[1] = {VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, pyramid.levels};
+    poolSizes[2] = {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 4 * frameCount};
+    VkDescriptorPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+    poolInfo.pPoolSizes = poolSizes.data();
+    poolInfo.maxSets = pyramid.levels + frameCount;
+    if (vkCreateDescriptorPool(device, &poolInfo, nullptr, &pyramid.descriptorPool) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create depth pyramid descriptor pool!");
+    }
+
+    std::vector<VkDescriptorSetLayout> reduceLayouts(pyramid.levels, reduceSetLayout);
+    VkDescriptorSetAllocateInfo setInfo{};
+    setInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    setInfo.descriptorPool = pyramid.descriptorPool;
+    setInfo.descriptorSetCount = pyramid.levels;
+    setInfo.pSetLayouts = reduceLayouts.data();
+    pyramid.reduceSets.resize(pyramid.levels);
+    if (vkAllocateDescriptorSets(device, &setInfo, pyramid.reduceSets.data()) != VK_SUCCESS) {
+        throw std::runtime_error("failed to allocate depth pyramid descriptor sets!");
+    }
+
+    std::vector<VkDescriptorSetLayout> cullLayouts(frameCount, cullSetLayout);
+    setInfo.descriptorSetCount = frameCount;
+    setInfo.pSetLayouts = cullLayouts.data();
+    pyramid.cullSets.resize(frameCount);
+    if (vkAllocateDescriptorSets(device, &setInfo, pyramid.cullSets.data()) != VK_SUCCESS) {
+        throw std::runtime_error("failed to allocate cull descriptor sets!");
+    }
+
+    for (uint32_t level = 0; level < pyramid.levels; level++) {
+        VkDescriptorImageInfo sourceInfo{};
+        sourceInfo.sampler = sampler;
+        sourceInfo.imageView = level == 0 ? depthView : pyramid.levelViews[level - 1];
+        sourceInfo.imageLayout = level == 0 ? VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL : VK_IMAGE_LAYOUT_GENERAL;
+        VkDescriptorImageInfo destinationInfo{};
+        destinationInfo.imageView = pyramid.levelViews[level];
+        destinationInfo.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+        std::array<VkWriteDescriptorSet, 2> writes{};
+        writes[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        writes[0].dstSet = pyramid.reduceSets[level];
+        writes[0].dstBinding = 0;
+        writes[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        writes[0].descriptorCount = 1;
+        writes[0].pImageInfo = &sourceInfo;
+        writes[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        writes[1].dstSet = pyramid.reduceSets[level];
+        writes[1].dstBinding = 1;
+        writes[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+        writes[1].descriptorCount = 1;
+        writes[1].pImageInfo = &destinationInfo;
+        vkUpdateDescriptorSets(device, static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+    }
+
+    for (uint32_t frame = 0; frame < frameCount; frame++) {
+        if (frames[frame].capacity != 0) {
+            writeCullDescriptorSet(frame);
+        }
+    }
+}
+
+void OcclusionCuller::setInstances(uint32_t frame, VkBuffer instances, uint32_t capacity) {
+    FrameResources &resources = frames[frame];
+    resources.instances = instances;
+    if (capacity > resources.capacity) {
+        retireDrawLists(resources);
+        resources.capacity = capacity;
+        createBuffer(2 * capacity * sizeof(VkDrawIndexedIndirectCommand),
+                     VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+                     VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, resources.commands, resources.commandsMemory);
+        createBuffer(capacity * sizeof(uint32_t), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                     VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, resources.retest, resources.retestMemory);
+    }
+
+    if (pyramid.descriptorPool != VK_NULL_HANDLE) {
+        writeCullDescriptorSet(frame);
+    }
+}
+
+void OcclusionCuller::recordFirstPhase(VkCommandBuffer commandBuffer, uint32_t frame,
+                                       const glm::mat4 &viewProjection, uint32_t instanceCount) {
+    if (!pyramid.cleared) {
+        // Far plane everywhere, nothing counts as occluded until the pyramid has been built once
+        VkImageMemoryBarrier clearBarrier{};
+        clearBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        clearBarrier.srcAccessMask = 0;
+        clearBarrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        clearBarrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        clearBarrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+        clearBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        clearBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        clearBarrier.image = pyramid.image;
+        clearBarrier.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, pyramid.levels, 0, 1};
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0,
+                             nullptr, 0, nullptr, 1, &clearBarrier);
+
+        const VkClearColorValue farPlane{{1.0f, 1.0f, 1.0f, 1.0f}};
+        vkCmdClearColorImage(commandBuffer, pyramid.image, VK_IMAGE_LAYOUT_GENERAL, &farPlane, 1,
+                             &clearBarrier.subresourceRange);
+        pyramid.cleared = true;
+    }
+
+    vkCmdFillBuffer(commandBuffer, frames[frame].counters, 0, countersSize, 0);
+
+    // The pyramid was last written by the previous frame's second phase, or just cleared
+    const VkMemoryBarrier resetBarrier = memoryBarrier(VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+                                                       VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT |
+                                                       VK_ACCESS_INDIRECT_COMMAND_READ_BIT);
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                         VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, 0, 1,
+                         &resetBarrier, 0, nullptr, 0, nullptr);
+
+    recordCull(commandBuffer, frame, viewProjection, instanceCount, Phase::Visible);
+
+    // The first draw list is drawn next, the retest flags and the pyramid reads are followed by the second phase
+    const VkMemoryBarrier cullBarrier = memoryBarrier(VK_ACCESS_SHADER_WRITE_BIT,
+                                                      VK_ACCESS_INDIRECT_COMMAND_READ_BIT |
+                                                      VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                         VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1,
+                         &cullBarrier, 0, nullptr, 0, nullptr);
+}
+
+void OcclusionCuller::recordSecondPhase(VkCommandBuffer commandBuffer, uint32_t frame,
+                                        const glm::mat4 &viewProjection, uint32_t instanceCount) {
+    // Each level takes the farthest depth of the texels it covers in the level above
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, reducePipeline);
+    const VkMemoryBarrier levelBarrier = memoryBarrier(VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT);
+    for (uint32_t level = 0; level < pyramid.levels; level++) {
+        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, reducePipelineLayout, 0, 1,
+                                &pyramid.reduceSets[level], 0, nullptr);
+        const uint32_t width = std::max(pyramid.extent.width >> level, 1u);
+        const uint32_t height = std::max(pyramid.extent.height >> level, 1u);
+        vkCmdDispatch(commandBuffer, (width + reduceGroupSize - 1) / reduceGroupSize,
+                      (height + reduceGroupSize - 1) / reduceGroupSize, 1);
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                             VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &levelBarrier, 0, nullptr, 0, nullptr);
+    }
+
+    recordCull(commandBuffer, frame, viewProjection, instanceCount, Phase::Disoccluded);
+
+    // The host reads the counters back once the frame has completed
+    const VkMemoryBarrier cullBarrier = memoryBarrier(VK_ACCESS_SHADER_WRITE_BIT,
+                                                      VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_HOST_READ_BIT);
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                         VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &cullBarrier, 0,
+                         nullptr, 0, nullptr);
+}
+
+OcclusionCuller::IndirectDraws OcclusionCuller::getDraws(uint32_t frame, Phase phase) const {
+    const FrameResources &resources = frames[frame];
+    const uint32_t phaseIndex = static_cast<uint32_t>(phase);
+    IndirectDraws draws{};
+    draws.commands = resources.commands;
+    draws.commandOffset = phaseIndex * resources.capacity * sizeof(VkDrawIndexedIndirectCommand);
+    draws.count = resources.counters;
+    draws.countOffset = phaseIndex * sizeof(uint32_t);
+    draws.maxDrawCount = resources.capacity;
+    return draws;
+}
+
+OcclusionCuller::Stats OcclusionCuller::readStats(uint32_t frame) const {
+    Stats stats{};
+    std::memcpy(&stats, frames[frame].countersMapped, sizeof(stats));
+    return stats;
+}
+
+void OcclusionCuller::createPipelines(const std::vector<char> &cullShader,
+                                      const std::vector<char> &reduceShader) {
+    std::array<VkDescriptorSetLayoutBinding, 5> cullBindings{};
+    for (uint32_t binding = 0; binding < cullBindings.size(); binding++) {
+        cullBindings[binding].binding = binding;
+        cullBindings[binding].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        cullBindings[binding].descriptorCount = 1;
+        cullBindings[binding].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    }
+    cullBindings[4].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+
+    VkDescriptorSetLayoutCreateInfo layoutInfo{};
+    layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layoutInfo.bindingCount = static_cast<uint32_t>(cullBindings.size());
+    layoutInfo.pBindings = cullBindings.data();
+    if (vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &cullSetLayout) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create cull descriptor set layout!");
+    }
+
+    std::array<VkDescriptorSetLayoutBinding, 2> reduceBindings{};
+    reduceBindings[0].binding = 0;
+    reduceBindings[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    reduceBindings[0].descriptorCount = 1;
+    reduceBindings[0].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    reduceBindings[1].binding = 1;
+    reduceBindings[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+    reduceBindings[1].descriptorCount = 1;
+    reduceBindings[1].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    layoutInfo.bindingCount = static_cast<uint32_t>(reduceBindings.size());
+    layoutInfo.pBindings = reduceBindings.data();
+    if (vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &reduceSetLayout) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create depth pyramid descriptor set layout!");
+    }
+
+    VkPushConstantRange pushConstantRange{};
+    pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    pushConstantRange.offset = 0;
+    pushConstantRange.size = sizeof(CullConstants);
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutInfo.setLayoutCount = 1;
+    pipelineLayoutInfo.pSetLayouts = &cullSetLayout;
+    pipelineLayoutInfo.pushConstantRangeCount = 1;
+    pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+    if (vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &cullPipelineLayout) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create cull pipeline layout!");
+    }
+
+    pipelineLayoutInfo.pSetLayouts = &reduceSetLayout;
+    pipelineLayoutInfo.pushConstantRangeCount = 0;
+    pipelineLayoutInfo.pPushConstantRanges = nullptr;
+    if (vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &reducePipelineLayout) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create depth pyramid pipeline layout!");
+    }
+
+    VkComputePipelineCreateInfo pipelineInfo{};
+    pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    pipelineInfo.stage.pName = "main";
+
+    pipelineInfo.stage.module = createShaderModule(cullShader);
+    pipelineInfo.layout = cullPipelineLayout;
+    const VkResult cullResult = vkCreateComputePipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr,
+                                                         &cullPipeline);
+    vkDestroyShaderModule(device, pipelineInfo.stage.module, nullptr);
+    if (cullResult != VK_SUCCESS) {
+        throw std::runtime_error("failed to create cull pipeline!");
+    }
+
+    pipelineInfo.stage.module = createShaderModule(reduceShader);
+    pipelineInfo.layout = reducePipelineLayout;
+    const VkResult reduceResult = vkCreateComputePipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr,
+                                                           &reducePipeline);
+    vkDestroyShaderModule(device, pipelineInfo.stage.module, nullptr);
+    if (reduceResult != VK_SUCCESS) {
+        throw std::runtime_error("failed to create depth pyramid pipeline!");
+    }
+}
+
+void OcclusionCuller::createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties,
+                                   VkBuffer &buffer, VkDeviceMemory &memory) {
+    VkBufferCreateInfo bufferInfo{};
+    bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferInfo.size = size;
+    bufferInfo.usage = usage;
+    bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    if (vkCreateBuffer(device, &bufferInfo, nullptr, &buffer) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create cull buffer!");
+    }
+
+    VkMemoryRequirements memRequirements;
+    vkGetBufferMemoryRequirements(device, buffer, &memRequirements);
+    VkMemoryAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    allocInfo.allocationSize = memRequirements.size;
+    allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, properties);
+    if (vkAllocateMemory(device, &allocInfo, nullptr, &memory) != VK_SUCCESS) {
+        throw std::runtime_error("failed to allocate cull buffer memory!");
+    }
+    vkBindBufferMemory(device, buffer, memory, 0);
+}
+
+void OcclusionCuller::retireDrawLists(FrameResources &resources) {
+    if (resources.commands == VK_NULL_HANDLE) {
+        return;
+    }
+    deletionQueue.retire([device = device, commands = resources.commands, commandsMemory = resources.commandsMemory,
+                             retest = resources.retest, retestMemory = resources.retestMemory]() {
+        vkDestroyBuffer(device, commands, nullptr);
+        vkFreeMemory(device, commandsMemory, nullptr);
+        vkDestroyBuffer(device, retest, nullptr);
+        vkFreeMemory(device, retestMemory, nullptr);
+    });
+    resources.commands = VK_NULL_HANDLE;
+    resources.commandsMemory = VK_NULL_HANDLE;
+    resources.retest = VK_NULL_HANDLE;
+    resources.retestMemory = VK_NULL_HANDLE;
+    resources.capacity = 0;
+}
+
+void OcclusionCuller::retirePyramid() {
+    if (pyramid.image == VK_NULL_HANDLE) {
+        return;
+    }
+    // Destroying the pool frees the sets allocated from it
+    deletionQueue.retire([device = device, image = pyramid.image, memory = pyramid.memory, view = pyramid.view,
+                             levelViews = pyramid.levelViews, descriptorPool = pyramid.descriptorPool]() {
+        vkDestroyDescriptorPool(device, descriptorPool, nullptr);
+        for (VkImageView levelView: levelViews) {
+            vkDestroyImageView(device, levelView, nullptr);
+        }
+        vkDestroyImageView(device, view, nullptr);
+        vkDestroyImage(device, image, nullptr);
+        vkFreeMemory(device, memory, nullptr);
+    });
+    pyramid.image = VK_NULL_HANDLE;
+}
+
+void OcclusionCuller::writeCullDescriptorSet(uint32_t frame) {
+    const FrameResources &resources = frames[frame];
+    const std::array<VkDescriptorBufferInfo, 4> bufferInfos = {
+        VkDescriptorBufferInfo{resources.instances, 0, VK_WHOLE_SIZE},
+        VkDescriptorBufferInfo{resources.commands, 0, VK_WHOLE_SIZE},
+        VkDescriptorBufferInfo{resources.counters, 0, VK_WHOLE_SIZE},
+        VkDescriptorBufferInfo{resources.retest, 0, VK_WHOLE_SIZE},
+    };
+    VkDescriptorImageInfo pyramidInfo{};
+    pyramidInfo.sampler = sampler;
+    pyramidInfo.imageView = pyramid.view;
+    pyramidInfo.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+    std::array<VkWriteDescriptorSet, 5> writes{};
+    for (uint32_t binding = 0; binding < writes.size(); binding++) {
+        writes[binding].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        writes[binding].dstSet = pyramid.cullSets[frame];
+        writes[binding].dstBinding = binding;
+        writes[binding].descriptorCount = 1;
+        if (binding < bufferInfos.size()) {
+            writes[binding].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+            writes[binding].pBufferInfo = &bufferInfos[binding];
+        } else {
+            writes[binding].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+            writes[binding].pImageInfo = &pyramidInfo;
+        }
+    }
+    vkUpdateDescriptorSets(device, static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+}
+
+void OcclusionCuller::recordCull(VkCommandBuffer commandBuffer, uint32_t frame, const glm::mat4 &viewProjection,
+                                 uint32_t instanceCount, Phase phase) {
+    if (instanceCount == 0) {
+        return;
+    }
+
+    CullConstants constants{};
+    constants.viewProjection = viewProjection;
+    constants.pyramidSize = glm::vec2(pyramid.extent.width, pyramid.extent.height);
+    constants.instanceCount = instanceCount;
+    constants.phase = static_cast<uint32_t>(phase);
+    constants.secondPhaseOffset = frames[frame].capacity;
+    constants.pyramidLevels = pyramid.levels;
+
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, cullPipeline);
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, cullPipelineLayout, 0, 1,
+                            &pyramid.cullSets[frame], 0, nullptr);
+    vkCmdPushConstants(commandBuffer, cullPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(constants),
+                       &constants);
+    vkCmdDispatch(commandBuffer, (instanceCount + cullGroupSize - 1) / cullGroupSize, 1, 1);
+}
+
+std::vector<char> OcclusionCuller::readShaderFile(const std::string &fileName) {
+    std::ifstream file(fileName, std::ios::ate | std::ios::binary);
+    if (!file.is_open()) {
+        throw std::runtime_error("failed to open " + fileName +
+                                 ", the Shaders target compiles it into the build folder!");
+    }
+    std::vector<char> code(static_cast<size_t>(file.tellg()));
+    file.seekg(0);
+    file.read(code.data(), static_cast<std::streamsize>(code.size()));
+    return code;
+}
+
+VkShaderModule OcclusionCuller::createShaderModule(const std::vector<char> &code) {
+    VkShaderModuleCreateInfo createInfo{};
+    createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+    createInfo.codeSize = code.size();
+    createInfo.pCode = reinterpret_cast<const uint32_t *>(code.data());
+    VkShaderModule shaderModule;
+    if (vkCreateShaderModule(device, &createInfo, nullptr, &shaderModule) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create shader module!");
+    }
+    return shaderModule;
+}
+
+uint32_t OcclusionCuller::findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) {
+    VkPhysicalDeviceMemoryProperties memProperties;
+    vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memProperties);
+    for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++) {
+        if ((typeFilter & (1 << i)) && (memProperties.memoryTypes[i].propertyFlags & properties) == properties) {
+            return i;
+        }
+    }
+
+    throw std::runtime_error("failed to find suitable memory type!");
+}
@@ -0,0 +1,183 @@
+//
+// Created by redkc on 19/10/2026.
+//
+
+#ifndef OCCLUSIONCULLER_H
+#define OCCLUSIONCULLER_H
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "vulkan/vulkan.h"
+#include "DeletionQueue.h"
+
+/**
+ * @brief One scene instance as the cull shader reads it: the draw it makes when visible and its world space bounds
+ */
+struct CullInstance {
+    VkDrawIndexedIndirectCommand command;
+    uint32_t padding[3];
+    glm::vec4 boundsMin;
+    glm::vec4 boundsMax;
+};
+
+static_assert(sizeof(CullInstance) == 64, "CullInstance has to match the std430 layout of cull.comp");
+
+/**
+ * @brief Culls the instances of the raster pass on the GPU against the frustum and a hierarchical depth pyramid.
+ *
+ * Culling runs in two phases around the depth buffer. The first phase tests every instance against the pyramid
+ * built from the previous frame's depth and compacts the visible ones into the first draw list, which is drawn
+ * right away. The pyramid is then rebuilt from that depth, and the second phase tests the instances the first one
+ * found occluded again. Whatever became visible since the last frame goes into the second draw list, drawn on top
+ * of the first. Both lists are drawn with vkCmdDrawIndexedIndirectCount, the counts never come back to the CPU.
+ *
+ * Everything is recorded on the graphics queue, into the primary buffer of the raster pass. Buffers are per frame
+ * slot; the depth pyramid is shared, frames on the same queue build and read it in submission order.
+ */
+class OcclusionCuller {
+public:
+    enum class Phase : uint32_t {
+        /** @brief Visible in the previous frame's depth */
+        Visible = 0,
+        /** @brief Occluded in the previous frame's depth, but not in this one's */
+        Disoccluded = 1
+    };
+
+    /** @brief What a frame slot's last frame did, read once the frame has completed */
+    struct Stats {
+        uint32_t drawnFirstPhase = 0;
+        uint32_t drawnSecondPhase = 0;
+        uint32_t frustumCulled = 0;
+        uint32_t occlusionCulled = 0;
+    };
+
+    struct IndirectDraws {
+        VkBuffer commands = VK_NULL_HANDLE;
+        VkDeviceSize commandOffset = 0;
+        VkBuffer count = VK_NULL_HANDLE;
+        VkDeviceSize countOffset = 0;
+        uint32_t maxDrawCount = 0;
+    };
+
+    /**
+     * @param deletionQueue Replaced buffers, images and descriptor pools are retired through it.
+     */
+    OcclusionCuller(VkDevice device, VkPhysicalDevice physicalDevice, DeletionQueue &deletionQueue,
+                    uint32_t frameSlots);
+
+    /**
+     * @brief Retires every resource through the deletion queue.
+     */
+    ~OcclusionCuller();
+
+    OcclusionCuller(const OcclusionCuller &) = delete;
+
+    OcclusionCuller &operator=(const OcclusionCuller &) = delete;
+
+    /**
+     * @brief Builds a new pyramid for a depth buffer, after every swapchain recreation. The depth image needs
+     * sampled usage. Frames still in flight keep the old pyramid until they have completed.
+     */
+    void setDepthImage(VkImageView depthView, VkExtent2D extent);
+
+    /**
+     * @brief Points a frame slot at its instance records, one CullInstance each, and grows its draw lists to
+     * capacity instances. The frame that last used the slot has to be complete.
+     */
+    void setInstances(uint32_t frame, VkBuffer instances, uint32_t capacity);
+
+    /**
+     * @brief Resets the slot's counters and compacts the instances visible in the previous frame's depth. Recorded
+     * outside of a render pass, before the depth buffer is cleared.
+     */
+    void recordFirstPhase(VkCommandBuffer commandBuffer, uint32_t frame, const glm::mat4 &viewProjection,
+                          uint32_t instanceCount);
+
+    /**
+     * @brief Builds the pyramid from the depth of the first draw list and compacts the disoccluded instances.
+     * The depth image has to be in VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL and its writes made visible to
+     * compute shaders.
+     */
+    void recordSecondPhase(VkCommandBuffer commandBuffer, uint32_t frame, const glm::mat4 &viewProjection,
+                           uint32_t instanceCount);
+
+    IndirectDraws getDraws(uint32_t frame, Phase phase) const;
+
+    /**
+     * @brief Counters of the last frame that used the slot. That frame has to be complete, read before the slot
+     * records its next first phase.
+     */
+    Stats readStats(uint32_t frame) const;
+
+private:
+    struct FrameResources {
+        VkBuffer instances = VK_NULL_HANDLE;
+        uint32_t capacity = 0;
+        /** @brief Both draw lists, the second starts at capacity */
+        VkBuffer commands = VK_NULL_HANDLE;
+        VkDeviceMemory commandsMemory = VK_NULL_HANDLE;
+        /** @brief One flag per instance, set by the first phase for the second one */
+        VkBuffer retest = VK_NULL_HANDLE;
+        VkDeviceMemory retestMemory = VK_NULL_HANDLE;
+        /** @brief Both draw counts followed by the culled counts, host visible for readStats() */
+        VkBuffer counters = VK_NULL_HANDLE;
+        VkDeviceMemory countersMemory = VK_NULL_HANDLE;
+        void *countersMapped = nullptr;
+    };
+
+    /** @brief Everything that depends on the depth buffer, replaced as a whole */
+    struct Pyramid {
+        VkImage image = VK_NULL_HANDLE;
+        VkDeviceMemory memory = VK_NULL_HANDLE;
+        VkImageView view = VK_NULL_HANDLE;
+        std::vector<VkImageView> levelViews;
+        VkExtent2D extent{};
+        uint32_t levels = 0;
+        VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+        /** @brief One per level, reading the level above it or the depth buffer */
+        std::vector<VkDescriptorSet> reduceSets;
+        /** @brief One per frame slot */
+        std::vector<VkDescriptorSet> cullSets;
+        /** @brief A new pyramid holds no depth yet, it is cleared to the far plane on its first use */
+        bool cleared = false;
+    };
+
+    void createPipelines(const std::vector<char> &cullShader, const std::vector<char> &reduceShader);
+
+    void createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties,
+                      VkBuffer &buffer, VkDeviceMemory &memory);
+
+    void retireDrawLists(FrameResources &resources);
+
+    void retirePyramid();
+
+    void writeCullDescriptorSet(uint32_t frame);
+
+    void recordCull(VkCommandBuffer commandBuffer, uint32_t frame, const glm::mat4 &viewProjection,
+                    uint32_t instanceCount, Phase phase);
+
+    static std::vector<char> readShaderFile(const std::string &fileName);
+
+    VkShaderModule createShaderModule(const std::vector<char> &code);
+
+    uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties);
+
+    VkDevice device;
+    VkPhysicalDevice physicalDevice;
+    DeletionQueue &deletionQueue;
+    std::vector<FrameResources> frames;
+    Pyramid pyramid;
+    VkSampler sampler = VK_NULL_HANDLE;
+    VkDescriptorSetLayout cullSetLayout = VK_NULL_HANDLE;
+    VkDescriptorSetLayout reduceSetLayout = VK_NULL_HANDLE;
+    VkPipelineLayout cullPipelineLayout = VK_NULL_HANDLE;
+    VkPipelineLayout reducePipelineLayout = VK_NULL_HANDLE;
+    VkPipeline cullPipeline = VK_NULL_HANDLE;
+    VkPipeline reducePipeline = VK_NULL_HANDLE;
+};
+
+
+#endif //OCCLUSIONCULLER_H
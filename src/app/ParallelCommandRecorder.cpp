@@ -0,0 +1,126 @@
+//
+// Created by redkc on 19/10/2026.
+//
+
+#include "ParallelCommandRecorder.h"
+
+#include <stdexcept>
+
+ParallelCommandRecorder::ParallelCommandRecorder(VkDevice device, uint32_t queueFamilyIndex, uint32_t framesInFlight,
+                                                 JobSystem &jobSystem)
+    : device(device), jobSystem(jobSystem), pools(framesInFlight), primaries(framesInFlight) {
+    VkCommandPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+    poolInfo.queueFamilyIndex = queueFamilyIndex;
+
+    for (uint32_t i = 0; i < framesInFlight; i++) {
+        pools[i].resize(jobSystem.threadCount());
+        for (ThreadPool &threadPool: pools[i]) {
+            if (vkCreateCommandPool(device, &poolInfo, nullptr, &threadPool.pool) != VK_SUCCESS) {
+                throw std::runtime_error("failed to create command pool!");
+            }
+        }
+
+        VkCommandBufferAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        allocInfo.commandPool = pools[i][0].pool;
+        allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        allocInfo.commandBufferCount = 1;
+        if (vkAllocateCommandBuffers(device, &allocInfo, &primaries[i]) != VK_SUCCESS) {
+            throw std::runtime_error("failed to allocate command buffers!");
+        }
+    }
+}
+
+ParallelCommandRecorder::~ParallelCommandRecorder() {
+    // Destroying a pool frees every buffer allocated from it
+    for (auto &framePools: pools) {
+        for (ThreadPool &threadPool: framePools) {
+            vkDestroyCommandPool(device, threadPool.pool, nullptr);
+        }
+    }
+}
+
+VkCommandBuffer ParallelCommandRecorder::beginFrame(uint32_t frame) {
+    this->frame = frame;
+    for (ThreadPool &threadPool: pools[frame]) {
+        if (vkResetCommandPool(device, threadPool.pool, 0) != VK_SUCCESS) {
+            throw std::runtime_error("failed to reset command pool!");
+        }
+        threadPool.usedSecondaries = 0;
+    }
+    recorded.clear();
+    return primaries[frame];
+}
+
+void ParallelCommandRecorder::recordParallel(const VkCommandBufferInheritanceInfo &inheritance, uint32_t count,
+                                             uint32_t minItemsPerThread, const RangeRecorder &record) {
+    // Every thread writes only its own slot, the order of the slots is the order of the ranges
+    std::vector<VkCommandBuffer> rangeBuffers(jobSystem.threadCount(), VK_NULL_HANDLE);
+    jobSystem.parallelFor(count, minItemsPerThread, [&](uint32_t begin, uint32_t end, uint32_t threadIndex) {
+        if (begin == end) {
+            return;
+        }
+        VkCommandBuffer commandBuffer = acquireSecondary(threadIndex);
+        beginSecondary(commandBuffer, inheritance);
+        record(commandBuffer, begin, end);
+        if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
+            throw std::runtime_error("failed to record command buffer!");
+        }
+        rangeBuffers[threadIndex] = commandBuffer;
+    });
+
+    for (VkCommandBuffer commandBuffer: rangeBuffers) {
+        if (commandBuffer != VK_NULL_HANDLE) {
+            recorded.push_back(commandBuffer);
+        }
+    }
+}
+
+void ParallelCommandRecorder::recordOnCallingThread(const VkCommandBufferInheritanceInfo &inheritance,
+                                                    const std::function<void(VkCommandBuffer commandBuffer)> &record) {
+    // The calling thread is thread 0 of the job system, so its pool is never used concurrently
+    VkCommandBuffer commandBuffer = acquireSecondary(0);
+    beginSecondary(commandBuffer, inheritance);
+    record(commandBuffer);
+    if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
+        throw std::runtime_error("failed to record command buffer!");
+    }
+    recorded.push_back(commandBuffer);
+}
+
+const std::vector<VkCommandBuffer> &ParallelCommandRecorder::getSecondaries() const {
+    return recorded;
+}
+
+VkCommandBuffer ParallelCommandRecorder::acquireSecondary(uint32_t threadIndex) {
+    ThreadPool &threadPool = pools[frame][threadIndex];
+    if (threadPool.usedSecondaries == threadPool.secondaries.size()) {
+        VkCommandBufferAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        allocInfo.commandPool = threadPool.pool;
+        allocInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+        allocInfo.commandBufferCount = 1;
+        VkCommandBuffer commandBuffer;
+        if (vkAllocateCommandBuffers(device, &allocInfo, &commandBuffer) != VK_SUCCESS) {
+            throw std::runtime_error("failed to allocate command buffers!");
+        }
+        threadPool.secondaries.push_back(commandBuffer);
+    }
+    return threadPool.secondaries[threadPool.usedSecondaries++];
+}
+
+void ParallelCommandRecorder::beginSecondary(VkCommandBuffer commandBuffer,
+                                             const VkCommandBufferInheritanceInfo &inheritance) const {
+    VkCommandBufferBeginInfo beginInfo{};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    if (inheritance.renderPass != VK_NULL_HANDLE) {
+        beginInfo.flags |= VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+    }
+    beginInfo.pInheritanceInfo = &inheritance;
+    if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS) {
+        throw std::runtime_error("failed to begin recording command buffer!");
+    }
+}
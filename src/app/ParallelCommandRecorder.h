@@ -0,0 +1,81 @@
+//
+// Created by redkc on 19/10/2026.
+//
+
+#ifndef PARALLELCOMMANDRECORDER_H
+#define PARALLELCOMMANDRECORDER_H
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include "vulkan/vulkan.h"
+#include "JobSystem.h"
+
+/**
+ * @brief Records a frame's commands on every thread of a JobSystem, into secondary command buffers.
+ *
+ * Each frame slot has one transient command pool per thread, so threads never share a pool and a whole slot is
+ * reset with one vkResetCommandPool per thread instead of freeing buffers. Secondary buffers are allocated the first
+ * time they are needed and reused afterwards. The primary buffer of a slot comes from the pool of thread 0.
+ */
+class ParallelCommandRecorder {
+public:
+    using RangeRecorder = std::function<void(VkCommandBuffer commandBuffer, uint32_t begin, uint32_t end)>;
+
+    ParallelCommandRecorder(VkDevice device, uint32_t queueFamilyIndex, uint32_t framesInFlight,
+                            JobSystem &jobSystem);
+
+    ~ParallelCommandRecorder();
+
+    ParallelCommandRecorder(const ParallelCommandRecorder &) = delete;
+
+    ParallelCommandRecorder &operator=(const ParallelCommandRecorder &) = delete;
+
+    /**
+     * @brief Resets every pool of the slot. The GPU has to be done with the frame that last used it.
+     *
+     * @return The primary command buffer of the slot, ready to begin.
+     */
+    VkCommandBuffer beginFrame(uint32_t frame);
+
+    /**
+     * @brief Splits [0, count) between the threads, each records its range into its own secondary buffer.
+     *
+     * The secondary buffers are begun with the inheritance info and ended around the call to record.
+     */
+    void recordParallel(const VkCommandBufferInheritanceInfo &inheritance, uint32_t count,
+                        uint32_t minItemsPerThread, const RangeRecorder &record);
+
+    /**
+     * @brief Records one secondary buffer on the calling thread, for work that is not thread safe like the UI.
+     */
+    void recordOnCallingThread(const VkCommandBufferInheritanceInfo &inheritance,
+                               const std::function<void(VkCommandBuffer commandBuffer)> &record);
+
+    /**
+     * @brief Secondary buffers recorded since beginFrame(), in order, for vkCmdExecuteCommands.
+     */
+    const std::vector<VkCommandBuffer> &getSecondaries() const;
+
+private:
+    struct ThreadPool {
+        VkCommandPool pool = VK_NULL_HANDLE;
+        std::vector<VkCommandBuffer> secondaries;
+        uint32_t usedSecondaries = 0;
+    };
+
+    VkCommandBuffer acquireSecondary(uint32_t threadIndex);
+
+    void beginSecondary(VkCommandBuffer commandBuffer, const VkCommandBufferInheritanceInfo &inheritance) const;
+
+    VkDevice device;
+    JobSystem &jobSystem;
+    uint32_t frame = 0;
+    /** @brief Indexed [frame][thread] */
+    std::vector<std::vector<ThreadPool> > pools;
+    std::vector<VkCommandBuffer> primaries;
+    std::vector<VkCommandBuffer> recorded;
+};
+
+
+#endif //PARALLELCOMMANDRECORDER_H
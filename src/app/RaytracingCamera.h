@@ -0,0 +1,38 @@
+//
+// Created by redkc on 19/10/2026.
+//
+
+#ifndef RAYTRACINGCAMERA_H
+#define RAYTRACINGCAMERA_H
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+/**
+ * @brief The matrices raygen.rgen builds its primary rays from. Every backend takes them from here so their
+ * images line up pixel for pixel.
+ */
+struct RaytracingCamera {
+    glm::mat4 viewInverse;
+    glm::mat4 projInverse;
+
+    static RaytracingCamera createDefault(float aspect) {
+        return createLookAt(glm::vec3(2.0f, 2.0f, 2.0f), glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f),
+                            90.0f, aspect);
+    }
+
+    static RaytracingCamera createLookAt(const glm::vec3 &eye, const glm::vec3 &target, const glm::vec3 &up,
+                                         float fovYDegrees, float aspect) {
+        return createFromMatrices(glm::lookAt(eye, target, up),
+                                  glm::perspective(glm::radians(fovYDegrees), aspect, 0.1f, 100.0f));
+    }
+
+    static RaytracingCamera createFromMatrices(const glm::mat4 &view, const glm::mat4 &proj) {
+        RaytracingCamera camera{};
+        camera.projInverse = glm::inverse(proj);
+        camera.viewInverse = glm::inverse(view);
+        return camera;
+    }
+};
+
+
+#endif //RAYTRACINGCAMERA_H
@@ -0,0 +1,189 @@
+//
+// Created by redkc on 19/10/2026.
+//
+
+#include "ReadbackRing.h"
+
+#include <stdexcept>
+
+ReadbackRing::ReadbackRing(VkDevice device, VkPhysicalDevice physicalDevice, VkDeviceSize frameSize,
+                           uint32_t slotCount)
+    : device(device), physicalDevice(physicalDevice), frameSize(frameSize), slots(slotCount) {
+    if (slotCount == 0) {
+        throw std::runtime_error("readback ring needs at least one slot!");
+    }
+
+    try {
+        for (Slot &slot: slots) {
+            createSlot(slot);
+        }
+    } catch (...) {
+        // Slots created before the failure would leak, the destructor never runs for a throwing constructor
+        destroySlots();
+        throw;
+    }
+}
+
+ReadbackRing::~ReadbackRing() {
+    destroySlots();
+}
+
+void ReadbackRing::createSlot(Slot &slot) {
+    VkBufferCreateInfo bufferInfo{};
+    bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferInfo.size = frameSize;
+    bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+    bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    if (vkCreateBuffer(device, &bufferInfo, nullptr, &slot.buffer) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create readback buffer!");
+    }
+
+    VkMemoryRequirements memRequirements;
+    vkGetBufferMemoryRequirements(device, slot.buffer, &memRequirements);
+
+    // Every slot has its own allocation, so invalidating one never has to care about the atom size
+    VkMemoryAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    allocInfo.allocationSize = memRequirements.size;
+    allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits);
+    if (vkAllocateMemory(device, &allocInfo, nullptr, &slot.memory) != VK_SUCCESS) {
+        throw std::runtime_error("failed to allocate readback buffer memory!");
+    }
+    if (vkBindBufferMemory(device, slot.buffer, slot.memory, 0) != VK_SUCCESS) {
+        throw std::runtime_error("failed to bind readback buffer memory!");
+    }
+
+    // Only a successful map is stored, destroySlots() unmaps whatever has a pointer
+    void *mapped = nullptr;
+    if (vkMapMemory(device, slot.memory, 0, VK_WHOLE_SIZE, 0, &mapped) != VK_SUCCESS) {
+        throw std::runtime_error("failed to map readback buffer memory!");
+    }
+    slot.mapped = mapped;
+}
+
+void ReadbackRing::destroySlots() {
+    for (Slot &slot: slots) {
+        if (slot.mapped != nullptr) {
+            vkUnmapMemory(device, slot.memory);
+        }
+        if (slot.memory != VK_NULL_HANDLE) {
+            vkFreeMemory(device, slot.memory, nullptr);
+        }
+        vkDestroyBuffer(device, slot.buffer, nullptr);
+        slot = Slot{};
+    }
+}
+
+bool ReadbackRing::hasFreeSlot() const {
+    std::lock_guard lock(mutex);
+    return slots[nextSlot].state == SlotState::Free;
+}
+
+bool ReadbackRing::recordCopy(VkCommandBuffer commandBuffer, VkImage image, VkExtent3D extent, uint64_t frameValue) {
+    std::lock_guard lock(mutex);
+    Slot &slot = slots[nextSlot];
+    if (slot.state != SlotState::Free) {
+        return false;
+    }
+
+    VkBufferImageCopy copyRegion{};
+    copyRegion.imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1};
+    copyRegion.imageExtent = extent;
+    vkCmdCopyImageToBuffer(commandBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, slot.buffer, 1, &copyRegion);
+
+    // Makes the copy visible to the host once the timeline says the frame is done
+    VkBufferMemoryBarrier hostBarrier{};
+    hostBarrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    hostBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    hostBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+    hostBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    hostBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    hostBarrier.buffer = slot.buffer;
+    hostBarrier.size = VK_WHOLE_SIZE;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 0, nullptr,
+                         1, &hostBarrier, 0, nullptr);
+
+    slot.state = SlotState::Pending;
+    slot.frameValue = frameValue;
+    nextSlot = (nextSlot + 1) % static_cast<uint32_t>(slots.size());
+    return true;
+}
+
+std::optional<ReadbackRing::Frame> ReadbackRing::poll(uint64_t completedValue) {
+    std::lock_guard lock(mutex);
+    Slot *oldest = nullptr;
+    uint32_t oldestIndex = 0;
+    for (uint32_t i = 0; i < slots.size(); i++) {
+        if (slots[i].state == SlotState::Pending && (oldest == nullptr || slots[i].frameValue < oldest->frameValue)) {
+            oldest = &slots[i];
+            oldestIndex = i;
+        }
+    }
+    if (oldest == nullptr || oldest->frameValue > completedValue) {
+        return std::nullopt;
+    }
+
+    if (!hostCoherent) {
+        VkMappedMemoryRange range{};
+        range.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+        range.memory = oldest->memory;
+        range.offset = 0;
+        range.size = VK_WHOLE_SIZE;
+        if (vkInvalidateMappedMemoryRanges(device, 1, &range) != VK_SUCCESS) {
+            throw std::runtime_error("failed to invalidate readback buffer memory!");
+        }
+    }
+
+    oldest->state = SlotState::Held;
+    Frame frame{};
+    frame.slot = oldestIndex;
+    frame.frameValue = oldest->frameValue;
+    frame.data = oldest->mapped;
+    frame.size = frameSize;
+    return frame;
+}
+
+void ReadbackRing::release(uint32_t slot) {
+    std::lock_guard lock(mutex);
+    slots[slot].state = SlotState::Free;
+}
+
+uint64_t ReadbackRing::oldestPendingValue() const {
+    std::lock_guard lock(mutex);
+    uint64_t value = 0;
+    for (const Slot &slot: slots) {
+        if (slot.state == SlotState::Pending && (value == 0 || slot.frameValue < value)) {
+            value = slot.frameValue;
+        }
+    }
+    return value;
+}
+
+bool ReadbackRing::isHostCached() const {
+    return hostCached;
+}
+
+uint32_t ReadbackRing::findMemoryType(uint32_t typeFilter) {
+    VkPhysicalDeviceMemoryProperties memProperties;
+    vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memProperties);
+
+    // Cached first, coherent cached memory is not available everywhere
+    const VkMemoryPropertyFlags candidates[] = {
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT |
+        VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+    };
+    for (VkMemoryPropertyFlags properties: candidates) {
+        for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++) {
+            const VkMemoryPropertyFlags flags = memProperties.memoryTypes[i].propertyFlags;
+            if ((typeFilter & (1 << i)) && (flags & properties) == properties) {
+                hostCached = (flags & VK_MEMORY_PROPERTY_HOST_CACHED_BIT) != 0;
+                hostCoherent = (flags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) != 0;
+                return i;
+            }
+        }
+    }
+
+    throw std::runtime_error("failed to find host visible memory for the readback ring!");
+}
@@ -0,0 +1,110 @@
+//
+// Created by redkc on 19/10/2026.
+//
+
+#ifndef READBACKRING_H
+#define READBACKRING_H
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <vector>
+
+#include "vulkan/vulkan.h"
+
+/**
+ * @brief Ring of persistently mapped buffers the rendered image is copied into for the CPU to read.
+ *
+ * recordCopy() puts the copy of a frame into the next slot and tags the slot with the frame value, the value the
+ * frame timeline is signaled with. poll() hands out the oldest slot whose frame value the timeline has reached and
+ * never waits, so the render loop keeps going while consumers, e.g. encoders on worker threads, read the pixels.
+ * A consumer gives the slot back with release(). The slots prefer host cached memory, reading uncached memory
+ * from the CPU is many times slower.
+ *
+ * Slots are used in order, a frame finds no free slot while the oldest one is still in flight or held by a consumer.
+ */
+class ReadbackRing {
+public:
+    struct Frame {
+        uint32_t slot = 0;
+        uint64_t frameValue = 0;
+        /** @brief Tightly packed rows of the copied image */
+        const void *data = nullptr;
+        VkDeviceSize size = 0;
+    };
+
+    /**
+     * @param frameSize Bytes of one copied image.
+     */
+    ReadbackRing(VkDevice device, VkPhysicalDevice physicalDevice, VkDeviceSize frameSize, uint32_t slotCount);
+
+    /**
+     * @brief The GPU has to be done with every slot.
+     */
+    ~ReadbackRing();
+
+    ReadbackRing(const ReadbackRing &) = delete;
+
+    ReadbackRing &operator=(const ReadbackRing &) = delete;
+
+    bool hasFreeSlot() const;
+
+    /**
+     * @brief Records the copy of an image in VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL into the next slot.
+     *
+     * @return False without recording anything when the next slot is not free, the frame is then not read back.
+     */
+    bool recordCopy(VkCommandBuffer commandBuffer, VkImage image, VkExtent3D extent, uint64_t frameValue);
+
+    /**
+     * @brief The oldest frame the GPU has finished copying, the data stays valid until the slot is released.
+     *
+     * @param completedValue Value the frame timeline has reached.
+     */
+    std::optional<Frame> poll(uint64_t completedValue);
+
+    /**
+     * @brief Gives a slot handed out by poll() back to the ring, may be called from any thread.
+     */
+    void release(uint32_t slot);
+
+    /** @brief Frame value of the oldest copy still in flight, 0 when there is none */
+    uint64_t oldestPendingValue() const;
+
+    bool isHostCached() const;
+
+private:
+    enum class SlotState {
+        Free,
+        /** @brief The copy is recorded, the GPU may not have finished it yet */
+        Pending,
+        /** @brief Handed out by poll(), until released */
+        Held
+    };
+
+    struct Slot {
+        VkBuffer buffer = VK_NULL_HANDLE;
+        VkDeviceMemory memory = VK_NULL_HANDLE;
+        void *mapped = nullptr;
+        SlotState state = SlotState::Free;
+        uint64_t frameValue = 0;
+    };
+
+    void createSlot(Slot &slot);
+
+    /** @brief Releases every slot created so far, shared by the destructor and a failed constructor */
+    void destroySlots();
+
+    uint32_t findMemoryType(uint32_t typeFilter);
+
+    VkDevice device;
+    VkPhysicalDevice physicalDevice;
+    VkDeviceSize frameSize;
+    bool hostCached = false;
+    bool hostCoherent = false;
+    std::vector<Slot> slots;
+    uint32_t nextSlot = 0;
+    mutable std::mutex mutex;
+};
+
+
+#endif //READBACKRING_H
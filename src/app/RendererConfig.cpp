@@ -0,0 +1,159 @@
+//
+// Created by redkc on 19/10/2026.
+//
+
+#include "RendererConfig.h"
+
+#include "ImageEncoder.h"
+
+#include <cstdlib>
+#include <filesystem>
+#include <iostream>
+#include <stdexcept>
+
+namespace {
+    uint32_t parseUnsigned(const std::string &option, const std::string &value) {
+        try {
+            size_t parsed = 0;
+            const unsigned long result = std::stoul(value, &parsed);
+            if (parsed != value.size()) {
+                throw std::invalid_argument(value);
+            }
+            return static_cast<uint32_t>(result);
+        } catch (const std::exception &) {
+            throw std::runtime_error("invalid value for " + option + ": " + value);
+        }
+    }
+
+    PresentMode parsePresentMode(const std::string &option, const std::string &value) {
+        if (value == "fifo") {
+            return PresentMode::Fifo;
+        }
+        if (value == "fifo-relaxed") {
+            return PresentMode::FifoRelaxed;
+        }
+        if (value == "mailbox") {
+            return PresentMode::Mailbox;
+        }
+        if (value == "immediate") {
+            return PresentMode::Immediate;
+        }
+        throw std::runtime_error("invalid value for " + option + ": " + value);
+    }
+
+    RasterMode parseRasterMode(const std::string &option, const std::string &value) {
+        if (value == "forward") {
+            return RasterMode::Forward;
+        }
+        if (value == "visibility") {
+            return RasterMode::VisibilityBuffer;
+        }
+        throw std::runtime_error("invalid value for " + option + ": " + value);
+    }
+}
+
+RendererConfig RendererConfig::fromArguments(int argc, char *argv[]) {
+    RendererConfig config;
+    for (int i = 1; i < argc; i++) {
+        const std::string argument = argv[i];
+        auto value = [&]() -> std::string {
+            if (i + 1 >= argc) {
+                throw std::runtime_error("missing value for " + argument);
+            }
+            return argv[++i];
+        };
+
+        if (argument == "--cpu") {
+            config.backend = RendererBackend::Cpu;
+        } else if (argument == "--vulkan") {
+            config.backend = RendererBackend::Vulkan;
+        } else if (argument == "--no-cpu-fallback") {
+            config.allowCpuFallback = false;
+        } else if (argument == "--no-bvh-snapshot") {
+            config.useBvhSnapshot = false;
+        } else if (argument == "--no-async-compute") {
+            config.asyncCompute = false;
+        } else if (argument == "--cache-dir") {
+            config.cacheDirectory = value();
+        } else if (argument == "--model") {
+            config.modelPath = value();
+        } else if (argument == "--width") {
+            config.width = parseUnsigned(argument, value());
+        } else if (argument == "--height") {
+            config.height = parseUnsigned(argument, value());
+        } else if (argument == "--output") {
+            config.outputPath = value();
+        } else if (argument == "--camera-path") {
+            config.cameraPath = value();
+        } else if (argument == "--threads") {
+            config.threadCount = parseUnsigned(argument, value());
+        } else if (argument == "--present-mode") {
+            config.presentMode = parsePresentMode(argument, value());
+        } else if (argument == "--raster-mode") {
+            config.rasterMode = parseRasterMode(argument, value());
+        } else if (argument == "--target-fps") {
+            config.targetFrameRate = parseUnsigned(argument, value());
+        } else if (argument == "--help" || argument == "-h") {
+            printUsage(argv[0]);
+            std::exit(EXIT_SUCCESS);
+        } else {
+            throw std::runtime_error("unknown option: " + argument);
+        }
+    }
+
+    if (config.width == 0 || config.height == 0) {
+        throw std::runtime_error("the image size has to be at least 1x1");
+    }
+    if (!config.cameraPath.empty() && config.outputPath.empty()) {
+        throw std::runtime_error("--camera-path needs --output to name the frames");
+    }
+    if (!config.outputPath.empty()) {
+        // Fails before any rendering starts
+        ImageEncoder::fileFormat(config.outputPath);
+    }
+    return config;
+}
+
+std::string RendererConfig::frameOutputPath(uint32_t frame) const {
+    std::string number = std::to_string(frame);
+    if (number.size() < 4) {
+        number.insert(0, 4 - number.size(), '0');
+    }
+
+    // Only a dot in the file name starts the extension, not one in a directory
+    const size_t slash = outputPath.find_last_of("/\\");
+    const size_t dot = outputPath.find_last_of('.');
+    if (dot == std::string::npos || (slash != std::string::npos && dot < slash)) {
+        return outputPath + "_" + number;
+    }
+    return outputPath.substr(0, dot) + "_" + number + outputPath.substr(dot);
+}
+
+std::string RendererConfig::cacheDirectoryPath() const {
+    if (!cacheDirectory.empty()) {
+        return cacheDirectory;
+    }
+    return (std::filesystem::path(modelPath).parent_path() / "cache").string();
+}
+
+void RendererConfig::printUsage(const char *programName) {
+    std::cout << "Usage: " << programName << " [options]\n"
+            << "  --vulkan            Render with the Vulkan ray tracing pipeline (default)\n"
+            << "  --cpu               Render with the CPU BVH backend\n"
+            << "  --no-cpu-fallback   Fail instead of switching to the CPU when no ray tracing GPU is found\n"
+            << "  --no-bvh-snapshot   Always rebuild the CPU BVH instead of mapping it from the cache directory\n"
+            << "  --cache-dir <path>  Directory of the BVH snapshots and acceleration structures, cache/ next to\n"
+            << "                      the model by default\n"
+            << "  --no-async-compute  Trace on the graphics queue even when a separate compute queue exists\n"
+            << "  --model <path>      Model to load\n"
+            << "  --width <pixels>    Width of the ray traced image\n"
+            << "  --height <pixels>   Height of the ray traced image\n"
+            << "  --output <file>     Render one frame into a file and exit, without opening a window. The\n"
+            << "                      extension picks the format: ppm, png, jpg, bmp, tga, hdr or pfm\n"
+            << "  --camera-path <f>   Render every keyframe of a camera path file, frames are numbered after --output\n"
+            << "  --threads <count>   CPU worker threads, 0 uses every hardware thread\n"
+            << "  --present-mode <m>  fifo (default), fifo-relaxed, mailbox or immediate\n"
+            << "  --raster-mode <m>   forward (default) or visibility, which shades each pixel of the raster\n"
+            << "                      window once from a buffer of triangle and instance IDs\n"
+            << "  --target-fps <fps>  Pace the frame loop to this rate, 0 does not pace (default)\n";
+}
@@ -0,0 +1,87 @@
+//
+// Created by redkc on 19/10/2026.
+//
+
+#ifndef RENDERERCONFIG_H
+#define RENDERERCONFIG_H
+#include <cstdint>
+#include <string>
+
+enum class RendererBackend {
+    Vulkan,
+    Cpu
+};
+
+/**
+ * @brief Swapchain present modes, modes the surface does not support fall back to Fifo.
+ */
+enum class PresentMode {
+    Fifo,
+    FifoRelaxed,
+    Mailbox,
+    Immediate
+};
+
+/**
+ * @brief How the raster window shades its pixels
+ */
+enum class RasterMode {
+    /** @brief Every rasterized fragment is shaded, overdrawn ones included */
+    Forward,
+    /** @brief Rasterization only stores triangle and instance IDs, a compute pass shades each pixel once */
+    VisibilityBuffer
+};
+
+/**
+ * @brief Options picked on the command line, shared by every backend.
+ */
+struct RendererConfig {
+    RendererBackend backend = RendererBackend::Vulkan;
+    std::string modelPath = "res/models/healingo/healingo.fbx";
+    uint32_t width = 800;
+    uint32_t height = 800;
+    /**
+     * @brief When set, a single frame is rendered into this file and the program exits. The Vulkan backend then
+     * runs headless, without SDL windows or surfaces, so it also works on render nodes and software drivers.
+     */
+    std::string outputPath;
+    /** @brief Renders every keyframe of this CameraPath file into its own numbered output file */
+    std::string cameraPath;
+    /** @brief Worker threads for the CPU backend and for image encoding, 0 uses every hardware thread */
+    uint32_t threadCount = 0;
+    /** @brief Fall back to the CPU backend when no GPU with ray tracing support is found */
+    bool allowCpuFallback = true;
+    /** @brief Map the CPU BVH from the cache directory instead of rebuilding it, and write it there after a build */
+    bool useBvhSnapshot = true;
+    /** @brief BVH snapshots and serialized acceleration structures, empty uses cache/ next to the model */
+    std::string cacheDirectory;
+    /** @brief Trace on a separate compute queue family when the device has one, next to the raster work */
+    bool asyncCompute = true;
+    PresentMode presentMode = PresentMode::Fifo;
+    /** @brief Falls back to Forward on devices without the visibility buffer's requirements */
+    RasterMode rasterMode = RasterMode::Forward;
+    /** @brief Frames per second the frame loop is paced to, 0 runs as fast as the present mode allows */
+    uint32_t targetFrameRate = 0;
+
+    /**
+     * @brief Parses the command line, throws std::runtime_error on unknown or malformed options.
+     */
+    static RendererConfig fromArguments(int argc, char *argv[]);
+
+    /**
+     * @brief File of one frame of a camera path, the frame number goes in front of the extension of the output
+     * path, e.g. out.ppm becomes out_0007.ppm.
+     */
+    std::string frameOutputPath(uint32_t frame) const;
+
+    /**
+     * @brief The cache directory, independent of the working directory the program was started from unless
+     * --cache-dir was given a relative path.
+     */
+    std::string cacheDirectoryPath() const;
+
+    static void printUsage(const char *programName);
+};
+
+
+#endif //RENDERERCONFIG_H
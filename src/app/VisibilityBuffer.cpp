@@ -0,0 +1,587 @@
+//
+// Created by redkc on 19/10/2026.
+//
+
+#include "VisibilityBuffer.h"
+
+#include <array>
+#include <fstream>
+#include <stdexcept>
+
+#include "model/Vertex.h"
+
+namespace {
+    constexpr uint32_t resolveGroupSize = 8;
+    /** @brief Instance index + 1 and triangle index, both full 32 bit */
+    constexpr VkFormat idFormat = VK_FORMAT_R32G32_UINT;
+    /** @brief Half floats so the blit's sRGB encode does not band, unlike an 8 bit linear image would */
+    constexpr VkFormat colorFormat = VK_FORMAT_R16G16B16A16_SFLOAT;
+    constexpr uint32_t resolveBindingCount = 8;
+
+    bool hasFormatFeatures(VkPhysicalDevice physicalDevice, VkFormat format, VkFormatFeatureFlags features) {
+        VkFormatProperties properties;
+        vkGetPhysicalDeviceFormatProperties(physicalDevice, format, &properties);
+        return (properties.optimalTilingFeatures & features) == features;
+    }
+
+    VkImageMemoryBarrier imageBarrier(VkImage image, VkImageLayout oldLayout, VkImageLayout newLayout,
+                                      VkAccessFlags srcAccess, VkAccessFlags dstAccess) {
+        VkImageMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        barrier.srcAccessMask = srcAccess;
+        barrier.dstAccessMask = dstAccess;
+        barrier.oldLayout = oldLayout;
+        barrier.newLayout = newLayout;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.image = image;
+        barrier.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+        return barrier;
+    }
+}
+
+bool VisibilityBuffer::isSupported(VkPhysicalDevice physicalDevice, VkFormat swapChainFormat) {
+    // gl_PrimitiveID in a fragment shader needs the Geometry capability, the queried features are all enabled
+    VkPhysicalDeviceFeatures features;
+    vkGetPhysicalDeviceFeatures(physicalDevice, &features);
+    return features.geometryShader &&
+           hasFormatFeatures(physicalDevice, idFormat, VK_FORMAT_FEATURE_COLOR_ATTACHMENT_BIT |
+                                                       VK_FORMAT_FEATURE_STORAGE_IMAGE_BIT) &&
+           hasFormatFeatures(physicalDevice, colorFormat, VK_FORMAT_FEATURE_STORAGE_IMAGE_BIT |
+                                                          VK_FORMAT_FEATURE_BLIT_SRC_BIT) &&
+           hasFormatFeatures(physicalDevice, swapChainFormat, VK_FORMAT_FEATURE_BLIT_DST_BIT);
+}
+
+VisibilityBuffer::VisibilityBuffer(VkDevice device, VkPhysicalDevice physicalDevice, DeletionQueue &deletionQueue,
+                                   uint32_t frameSlots, VkFormat depthFormat, VkPipelineLayout rasterPipelineLayout,
+                                   const Geometry &geometry)
+    : device(device), physicalDevice(physicalDevice), deletionQueue(deletionQueue), geometry(geometry),
+      frames(frameSlots) {
+    // Read before anything is created, a missing binary is the likeliest reason for the renderer to fall back
+    const std::vector<char> vertShader = readShaderFile("res/shaders/visbufferVert.spv");
+    const std::vector<char> fragShader = readShaderFile("res/shaders/visbufferFrag.spv");
+    const std::vector<char> resolveShader = readShaderFile("res/shaders/visresolveComp.spv");
+
+    try {
+        createRenderPasses(depthFormat);
+        createPipelines(rasterPipelineLayout, vertShader, fragShader, resolveShader);
+    } catch (...) {
+        // The destructor does not run when the constructor throws, the caller keeps going without this object
+        retireObjects();
+        throw;
+    }
+}
+
+VisibilityBuffer::~VisibilityBuffer() {
+    retireTargets();
+    retireObjects();
+}
+
+void VisibilityBuffer::retireObjects() {
+    // Destroying a null handle is a no-op, so this also covers a partially constructed object
+    deletionQueue.retire([device = device, renderPass = renderPass, lateRenderPass = lateRenderPass,
+                             pipeline = pipeline, resolveSetLayout = resolveSetLayout,
+                             resolvePipelineLayout = resolvePipelineLayout, resolvePipeline = resolvePipeline]() {
+        vkDestroyPipeline(device, pipeline, nullptr);
+        vkDestroyPipeline(device, resolvePipeline, nullptr);
+        vkDestroyPipelineLayout(device, resolvePipelineLayout, nullptr);
+        vkDestroyDescriptorSetLayout(device, resolveSetLayout, nullptr);
+        vkDestroyRenderPass(device, renderPass, nullptr);
+        vkDestroyRenderPass(device, lateRenderPass, nullptr);
+    });
+}
+
+void VisibilityBuffer::setDepthImage(VkImageView depthView, VkExtent2D extent) {
+    // Frames in flight still draw into and resolve the old targets, they go once those have completed
+    retireTargets();
+    targets = {};
+    targets.extent = extent;
+
+    createImage(idFormat, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_STORAGE_BIT, targets.idImage,
+                targets.idMemory, targets.idView);
+    createImage(colorFormat, VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT, targets.colorImage,
+                targets.colorMemory, targets.colorView);
+
+    std::array<VkImageView, 2> attachments = {targets.idView, depthView};
+    VkFramebufferCreateInfo framebufferInfo{};
+    framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+    framebufferInfo.renderPass = renderPass;
+    framebufferInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
+    framebufferInfo.pAttachments = attachments.data();
+    framebufferInfo.width = extent.width;
+    framebufferInfo.height = extent.height;
+    framebufferInfo.layers = 1;
+    if (vkCreateFramebuffer(device, &framebufferInfo, nullptr, &targets.framebuffer) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create visibility buffer framebuffer!");
+    }
+
+    // The resolve sets point at the images too, so they are replaced with them instead of updated while in use
+    const uint32_t frameCount = static_cast<uint32_t>(frames.size());
+    std::array<VkDescriptorPoolSize, 4> poolSizes{};
+    poolSizes[0] = {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, frameCount};
+    poolSizes[1] = {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, frameCount};
+    poolSizes[2] = {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 4 * frameCount};
+    poolSizes[3] = {VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 2 * frameCount};
+    VkDescriptorPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+    poolInfo.pPoolSizes = poolSizes.data();
+    poolInfo.maxSets = frameCount;
+    if (vkCreateDescriptorPool(device, &poolInfo, nullptr, &targets.descriptorPool) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create visibility buffer descriptor pool!");
+    }
+
+    std::vector<VkDescriptorSetLayout> layouts(frameCount, resolveSetLayout);
+    VkDescriptorSetAllocateInfo setInfo{};
+    setInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    setInfo.descriptorPool = targets.descriptorPool;
+    setInfo.descriptorSetCount = frameCount;
+    setInfo.pSetLayouts = layouts.data();
+    targets.resolveSets.resize(frameCount);
+    if (vkAllocateDescriptorSets(device, &setInfo, targets.resolveSets.data()) != VK_SUCCESS) {
+        throw std::runtime_error("failed to allocate visibility buffer descriptor sets!");
+    }
+
+    for (uint32_t frame = 0; frame < frameCount; frame++) {
+        if (frames[frame].instances != VK_NULL_HANDLE) {
+            writeResolveDescriptorSet(frame);
+        }
+    }
+}
+
+void VisibilityBuffer::setFrameInputs(uint32_t frame, VkBuffer uniforms, VkBuffer instances, VkBuffer drawData) {
+    frames[frame] = {uniforms, instances, drawData};
+    if (targets.descriptorPool != VK_NULL_HANDLE) {
+        writeResolveDescriptorSet(frame);
+    }
+}
+
+void VisibilityBuffer::beginRenderPass(VkCommandBuffer commandBuffer, OcclusionCuller::Phase phase) const {
+    VkRenderPassBeginInfo renderPassInfo{};
+    renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+    renderPassInfo.renderPass = phase == OcclusionCuller::Phase::Visible ? renderPass : lateRenderPass;
+    renderPassInfo.framebuffer = targets.framebuffer;
+    renderPassInfo.renderArea.offset = {0, 0};
+    renderPassInfo.renderArea.extent = targets.extent;
+
+    // Zero IDs mark pixels without geometry, the late pass ignores the values
+    std::array<VkClearValue, 2> clearValues{};
+    clearValues[0].color.uint32[0] = 0;
+    clearValues[0].color.uint32[1] = 0;
+    clearValues[1].depthStencil = {1.0f, 0};
+    renderPassInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
+    renderPassInfo.pClearValues = clearValues.data();
+
+    vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+}
+
+void VisibilityBuffer::recordResolve(VkCommandBuffer commandBuffer, uint32_t frame, Output output,
+                                     VkImage swapChainImage, VkExtent2D swapChainExtent) const {
+    // The previous frame's blit is the last reader of the shaded image, its content is overwritten completely
+    const VkImageMemoryBarrier colorBarrier = imageBarrier(targets.colorImage, VK_IMAGE_LAYOUT_UNDEFINED,
+                                                           VK_IMAGE_LAYOUT_GENERAL, 0, VK_ACCESS_SHADER_WRITE_BIT);
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0,
+                         nullptr, 0, nullptr, 1, &colorBarrier);
+
+    const uint32_t outputMode = static_cast<uint32_t>(output);
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, resolvePipeline);
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, resolvePipelineLayout, 0, 1,
+                            &targets.resolveSets[frame], 0, nullptr);
+    vkCmdPushConstants(commandBuffer, resolvePipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(outputMode),
+                       &outputMode);
+    vkCmdDispatch(commandBuffer, (targets.extent.width + resolveGroupSize - 1) / resolveGroupSize,
+                  (targets.extent.height + resolveGroupSize - 1) / resolveGroupSize, 1);
+
+    // The swapchain image waits for its acquire semaphore at the color attachment stage, the blit chains onto it.
+    // The blit converts to the swapchain format, sRGB encoding included.
+    const std::array<VkImageMemoryBarrier, 2> blitBarriers = {
+        imageBarrier(targets.colorImage, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                     VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_TRANSFER_READ_BIT),
+        imageBarrier(swapChainImage, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 0,
+                     VK_ACCESS_TRANSFER_WRITE_BIT)
+    };
+    vkCmdPipelineBarrier(commandBuffer,
+                         VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+                         VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr,
+                         static_cast<uint32_t>(blitBarriers.size()), blitBarriers.data());
+
+    VkImageBlit blit{};
+    blit.srcSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1};
+    blit.srcOffsets[1] = {static_cast<int32_t>(targets.extent.width), static_cast<int32_t>(targets.extent.height), 1};
+    blit.dstSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1};
+    blit.dstOffsets[1] = {static_cast<int32_t>(swapChainExtent.width), static_cast<int32_t>(swapChainExtent.height), 1};
+    vkCmdBlitImage(commandBuffer, targets.colorImage, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, swapChainImage,
+                   VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &blit, VK_FILTER_NEAREST);
+
+    // The UI is drawn on top by the late render pass, which loads the image
+    const VkImageMemoryBarrier uiBarrier = imageBarrier(swapChainImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                                                        VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+                                                        VK_ACCESS_TRANSFER_WRITE_BIT,
+                                                        VK_ACCESS_COLOR_ATTACHMENT_READ_BIT |
+                                                        VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT);
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+                         0, 0, nullptr, 0, nullptr, 1, &uiBarrier);
+}
+
+void VisibilityBuffer::createRenderPasses(VkFormat depthFormat) {
+    VkAttachmentDescription idAttachment{};
+    idAttachment.format = idFormat;
+    idAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+    idAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+    idAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+    idAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    idAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    idAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    idAttachment.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+    // Same depth handling as the forward passes, the depth pyramid is built between the two
+    VkAttachmentDescription depthAttachment{};
+    depthAttachment.format = depthFormat;
+    depthAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+    depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+    depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+    depthAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    depthAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    depthAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    depthAttachment.finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+    VkAttachmentReference idAttachmentRef{0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL};
+    VkAttachmentReference depthAttachmentRef{1, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL};
+
+    VkSubpassDescription subpass{};
+    subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+    subpass.colorAttachmentCount = 1;
+    subpass.pColorAttachments = &idAttachmentRef;
+    subpass.pDepthStencilAttachment = &depthAttachmentRef;
+
+    // The IDs and the depth are shared by the frames in flight, the previous frame's resolve reads the IDs and
+    // its UI pass is the last to use the depth
+    std::array<VkSubpassDependency, 2> dependencies{};
+    dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
+    dependencies[0].dstSubpass = 0;
+    dependencies[0].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT |
+                                   VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT |
+                                   VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT |
+                                   VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+    dependencies[0].srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+    dependencies[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT |
+                                   VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+    dependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT |
+                                    VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+    // The depth pyramid reads the depth right after the pass
+    dependencies[1].srcSubpass = 0;
+    dependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
+    dependencies[1].srcStageMask = VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+    dependencies[1].srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+    dependencies[1].dstStageMask = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+    dependencies[1].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+    std::array<VkAttachmentDescription, 2> attachments = {idAttachment, depthAttachment};
+    VkRenderPassCreateInfo renderPassInfo{};
+    renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+    renderPassInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
+    renderPassInfo.pAttachments = attachments.data();
+    renderPassInfo.subpassCount = 1;
+    renderPassInfo.pSubpasses = &subpass;
+    renderPassInfo.dependencyCount = static_cast<uint32_t>(dependencies.size());
+    renderPassInfo.pDependencies = dependencies.data();
+    if (vkCreateRenderPass(device, &renderPassInfo, nullptr, &renderPass) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create visibility buffer render pass!");
+    }
+
+    // The late pass hands the IDs to the resolve and the depth, still readable, to the UI pass that follows
+    attachments[0].loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+    attachments[0].initialLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+    attachments[0].finalLayout = VK_IMAGE_LAYOUT_GENERAL;
+    attachments[1].loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+    attachments[1].storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    attachments[1].initialLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    attachments[1].finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+    dependencies[0].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT |
+                                   VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+    dependencies[0].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+    dependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT |
+                                    VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT |
+                                    VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+    dependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT |
+                                   VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+    dependencies[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT |
+                                    VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+    if (vkCreateRenderPass(device, &renderPassInfo, nullptr, &lateRenderPass) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create visibility buffer render pass!");
+    }
+}
+
+void VisibilityBuffer::createPipelines(VkPipelineLayout rasterPipelineLayout, const std::vector<char> &vertShader,
+                                       const std::vector<char> &fragShader, const std::vector<char> &resolveShader) {
+    VkShaderModule vertShaderModule = createShaderModule(vertShader);
+    VkShaderModule fragShaderModule = createShaderModule(fragShader);
+
+    std::array<VkPipelineShaderStageCreateInfo, 2> shaderStages{};
+    shaderStages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    shaderStages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
+    shaderStages[0].module = vertShaderModule;
+    shaderStages[0].pName = "main";
+    shaderStages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    shaderStages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+    shaderStages[1].module = fragShaderModule;
+    shaderStages[1].pName = "main";
+
+    // Only the position is rasterized, the resolve fetches everything else itself
+    auto bindingDescription = Vertex::getBindingDescription();
+    auto attributeDescriptions = Vertex::getAttributeDescriptions();
+    VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
+    vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+    vertexInputInfo.vertexBindingDescriptionCount = 1;
+    vertexInputInfo.pVertexBindingDescriptions = &bindingDescription;
+    vertexInputInfo.vertexAttributeDescriptionCount = 1;
+    vertexInputInfo.pVertexAttributeDescriptions = &attributeDescriptions[0];
+
+    VkPipelineInputAssemblyStateCreateInfo inputAssembly{};
+    inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+    inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+
+    VkPipelineViewportStateCreateInfo viewportState{};
+    viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+    viewportState.viewportCount = 1;
+    viewportState.scissorCount = 1;
+
+    VkPipelineRasterizationStateCreateInfo rasterizer{};
+    rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+    rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
+    rasterizer.lineWidth = 1.0f;
+    rasterizer.cullMode = VK_CULL_MODE_BACK_BIT;
+    rasterizer.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+
+    VkPipelineMultisampleStateCreateInfo multisampling{};
+    multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+    multisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+
+    // Integer attachments cannot blend, the IDs are plain writes
+    VkPipelineColorBlendAttachmentState colorBlendAttachment{};
+    colorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT;
+    colorBlendAttachment.blendEnable = VK_FALSE;
+
+    VkPipelineColorBlendStateCreateInfo colorBlending{};
+    colorBlending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+    colorBlending.attachmentCount = 1;
+    colorBlending.pAttachments = &colorBlendAttachment;
+
+    VkPipelineDepthStencilStateCreateInfo depthStencil{};
+    depthStencil.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+    depthStencil.depthTestEnable = VK_TRUE;
+    depthStencil.depthWriteEnable = VK_TRUE;
+    depthStencil.depthCompareOp = VK_COMPARE_OP_LESS;
+    depthStencil.maxDepthBounds = 1.0f;
+
+    std::array<VkDynamicState, 2> dynamicStates = {VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR};
+    VkPipelineDynamicStateCreateInfo dynamicState{};
+    dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+    dynamicState.dynamicStateCount = static_cast<uint32_t>(dynamicStates.size());
+    dynamicState.pDynamicStates = dynamicStates.data();
+
+    VkGraphicsPipelineCreateInfo pipelineInfo{};
+    pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+    pipelineInfo.stageCount = static_cast<uint32_t>(shaderStages.size());
+    pipelineInfo.pStages = shaderStages.data();
+    pipelineInfo.pVertexInputState = &vertexInputInfo;
+    pipelineInfo.pInputAssemblyState = &inputAssembly;
+    pipelineInfo.pViewportState = &viewportState;
+    pipelineInfo.pRasterizationState = &rasterizer;
+    pipelineInfo.pMultisampleState = &multisampling;
+    pipelineInfo.pDepthStencilState = &depthStencil;
+    pipelineInfo.pColorBlendState = &colorBlending;
+    pipelineInfo.pDynamicState = &dynamicState;
+    pipelineInfo.layout = rasterPipelineLayout;
+    pipelineInfo.renderPass = renderPass;
+    pipelineInfo.subpass = 0;
+    const VkResult graphicsResult = vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr,
+                                                              &pipeline);
+    vkDestroyShaderModule(device, fragShaderModule, nullptr);
+    vkDestroyShaderModule(device, vertShaderModule, nullptr);
+    if (graphicsResult != VK_SUCCESS) {
+        throw std::runtime_error("failed to create visibility buffer pipeline!");
+    }
+
+    // Bindings as in visresolve.comp: uniforms, texture, draw data, instances, vertices, indices, IDs, output
+    std::array<VkDescriptorSetLayoutBinding, resolveBindingCount> bindings{};
+    for (uint32_t binding = 0; binding < bindings.size(); binding++) {
+        bindings[binding].binding = binding;
+        bindings[binding].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        bindings[binding].descriptorCount = 1;
+        bindings[binding].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    }
+    bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+    bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    bindings[6].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+    bindings[7].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+
+    VkDescriptorSetLayoutCreateInfo layoutInfo{};
+    layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+    layoutInfo.pBindings = bindings.data();
+    if (vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &resolveSetLayout) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create visibility resolve descriptor set layout!");
+    }
+
+    VkPushConstantRange pushConstantRange{};
+    pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    pushConstantRange.offset = 0;
+    pushConstantRange.size = sizeof(uint32_t);
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutInfo.setLayoutCount = 1;
+    pipelineLayoutInfo.pSetLayouts = &resolveSetLayout;
+    pipelineLayoutInfo.pushConstantRangeCount = 1;
+    pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+    if (vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &resolvePipelineLayout) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create visibility resolve pipeline layout!");
+    }
+
+    VkComputePipelineCreateInfo resolveInfo{};
+    resolveInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    resolveInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    resolveInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    resolveInfo.stage.module = createShaderModule(resolveShader);
+    resolveInfo.stage.pName = "main";
+    resolveInfo.layout = resolvePipelineLayout;
+    const VkResult resolveResult = vkCreateComputePipelines(device, VK_NULL_HANDLE, 1, &resolveInfo, nullptr,
+                                                            &resolvePipeline);
+    vkDestroyShaderModule(device, resolveInfo.stage.module, nullptr);
+    if (resolveResult != VK_SUCCESS) {
+        throw std::runtime_error("failed to create visibility resolve pipeline!");
+    }
+}
+
+void VisibilityBuffer::createImage(VkFormat format, VkImageUsageFlags usage, VkImage &image, VkDeviceMemory &memory,
+                                   VkImageView &view) {
+    VkImageCreateInfo imageInfo{};
+    imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    imageInfo.imageType = VK_IMAGE_TYPE_2D;
+    imageInfo.format = format;
+    imageInfo.extent = {targets.extent.width, targets.extent.height, 1};
+    imageInfo.mipLevels = 1;
+    imageInfo.arrayLayers = 1;
+    imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+    imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+    imageInfo.usage = usage;
+    imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    if (vkCreateImage(device, &imageInfo, nullptr, &image) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create visibility buffer image!");
+    }
+
+    VkMemoryRequirements memRequirements;
+    vkGetImageMemoryRequirements(device, image, &memRequirements);
+    VkMemoryAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    allocInfo.allocationSize = memRequirements.size;
+    allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    if (vkAllocateMemory(device, &allocInfo, nullptr, &memory) != VK_SUCCESS) {
+        throw std::runtime_error("failed to allocate visibility buffer image memory!");
+    }
+    vkBindImageMemory(device, image, memory, 0);
+
+    VkImageViewCreateInfo viewInfo{};
+    viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    viewInfo.image = image;
+    viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    viewInfo.format = format;
+    viewInfo.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+    if (vkCreateImageView(device, &viewInfo, nullptr, &view) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create visibility buffer image view!");
+    }
+}
+
+void VisibilityBuffer::retireTargets() {
+    if (targets.idImage == VK_NULL_HANDLE) {
+        return;
+    }
+    // Destroying the pool frees the sets allocated from it
+    deletionQueue.retire([device = device, targets = targets]() {
+        vkDestroyDescriptorPool(device, targets.descriptorPool, nullptr);
+        vkDestroyFramebuffer(device, targets.framebuffer, nullptr);
+        vkDestroyImageView(device, targets.idView, nullptr);
+        vkDestroyImage(device, targets.idImage, nullptr);
+        vkFreeMemory(device, targets.idMemory, nullptr);
+        vkDestroyImageView(device, targets.colorView, nullptr);
+        vkDestroyImage(device, targets.colorImage, nullptr);
+        vkFreeMemory(device, targets.colorMemory, nullptr);
+    });
+    targets.idImage = VK_NULL_HANDLE;
+}
+
+void VisibilityBuffer::writeResolveDescriptorSet(uint32_t frame) {
+    const FrameInputs &inputs = frames[frame];
+    const VkDescriptorBufferInfo uniformInfo{inputs.uniforms, 0, VK_WHOLE_SIZE};
+    const std::array<VkDescriptorBufferInfo, 4> storageInfos = {
+        VkDescriptorBufferInfo{inputs.drawData, 0, VK_WHOLE_SIZE},
+        VkDescriptorBufferInfo{inputs.instances, 0, VK_WHOLE_SIZE},
+        VkDescriptorBufferInfo{geometry.vertices, 0, VK_WHOLE_SIZE},
+        VkDescriptorBufferInfo{geometry.indices, 0, VK_WHOLE_SIZE},
+    };
+    const VkDescriptorImageInfo textureInfo{geometry.textureSampler, geometry.textureView,
+                                            VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL};
+    const std::array<VkDescriptorImageInfo, 2> storageImageInfos = {
+        VkDescriptorImageInfo{VK_NULL_HANDLE, targets.idView, VK_IMAGE_LAYOUT_GENERAL},
+        VkDescriptorImageInfo{VK_NULL_HANDLE, targets.colorView, VK_IMAGE_LAYOUT_GENERAL},
+    };
+
+    std::array<VkWriteDescriptorSet, resolveBindingCount> writes{};
+    for (uint32_t binding = 0; binding < writes.size(); binding++) {
+        writes[binding].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        writes[binding].dstSet = targets.resolveSets[frame];
+        writes[binding].dstBinding = binding;
+        writes[binding].descriptorCount = 1;
+    }
+    writes[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+    writes[0].pBufferInfo = &uniformInfo;
+    writes[1].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    writes[1].pImageInfo = &textureInfo;
+    for (uint32_t i = 0; i < storageInfos.size(); i++) {
+        writes[2 + i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        writes[2 + i].pBufferInfo = &storageInfos[i];
+    }
+    for (uint32_t i = 0; i < storageImageInfos.size(); i++) {
+        writes[6 + i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+        writes[6 + i].pImageInfo = &storageImageInfos[i];
+    }
+    vkUpdateDescriptorSets(device, static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+}
+
+std::vector<char> VisibilityBuffer::readShaderFile(const std::string &fileName) {
+    std::ifstream file(fileName, std::ios::ate | std::ios::binary);
+    if (!file.is_open()) {
+        throw std::runtime_error("failed to open " + fileName +
+                                 ", the Shaders target compiles it into the build folder!");
+    }
+    std::vector<char> code(static_cast<size_t>(file.tellg()));
+    file.seekg(0);
+    file.read(code.data(), static_cast<std::streamsize>(code.size()));
+    return code;
+}
+
+VkShaderModule VisibilityBuffer::createShaderModule(const std::vector<char> &code) {
+    VkShaderModuleCreateInfo createInfo{};
+    createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+    createInfo.codeSize = code.size();
+    createInfo.pCode = reinterpret_cast<const uint32_t *>(code.data());
+    VkShaderModule shaderModule;
+    if (vkCreateShaderModule(device, &createInfo, nullptr, &shaderModule) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create shader module!");
+    }
+    return shaderModule;
+}
+
+uint32_t VisibilityBuffer::findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) {
+    VkPhysicalDeviceMemoryProperties memProperties;
+    vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memProperties);
+    for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++) {
+        if ((typeFilter & (1 << i)) && (memProperties.memoryTypes[i].propertyFlags & properties) == properties) {
+            return i;
+        }
+    }
+
+    throw std::runtime_error("failed to find suitable memory type!");
+}
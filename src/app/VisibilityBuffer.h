@@ -0,0 +1,166 @@
+//
+// Created by redkc on 19/10/2026.
+//
+
+#ifndef VISIBILITYBUFFER_H
+#define VISIBILITYBUFFER_H
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "vulkan/vulkan.h"
+#include "DeletionQueue.h"
+#include "OcclusionCuller.h"
+
+/**
+ * @brief Raster path that shades every pixel exactly once, however much overdraw the scene has.
+ *
+ * The culler's two draw lists are rasterized into an ID image instead of the swapchain. Each pixel keeps the index
+ * of its instance and of its triangle within the draw, nothing else runs per fragment. A full-screen compute pass
+ * then reads the triangle back from the vertex and index buffers, interpolates its attributes at the pixel and
+ * shades it, and the result is blitted into the swapchain image. The IDs can be shown instead of the shading.
+ *
+ * The ID image and the depth buffer form one framebuffer, used by two render passes that match the culler's
+ * phases. The first leaves the depth for the depth pyramid, the second the IDs for the resolve.
+ */
+class VisibilityBuffer {
+public:
+    /** @brief What the resolve writes into the swapchain image */
+    enum class Output : uint32_t {
+        Shaded = 0,
+        InstanceIds = 1,
+        TriangleIds = 2
+    };
+
+    /** @brief Shared by every frame, alive as long as the visibility buffer */
+    struct Geometry {
+        /** @brief Vertex buffer of the raster pass, it needs storage buffer usage */
+        VkBuffer vertices = VK_NULL_HANDLE;
+        /** @brief 32 bit index buffer of the raster pass, it needs storage buffer usage */
+        VkBuffer indices = VK_NULL_HANDLE;
+        VkImageView textureView = VK_NULL_HANDLE;
+        VkSampler textureSampler = VK_NULL_HANDLE;
+    };
+
+    /**
+     * @brief Whether the device can write gl_PrimitiveID from a fragment shader and blit the shaded image into
+     * swapchain images of the given format
+     */
+    static bool isSupported(VkPhysicalDevice physicalDevice, VkFormat swapChainFormat);
+
+    /**
+     * @param rasterPipelineLayout Layout of the forward pass, the ID pass binds the same per frame descriptor set.
+     * @param deletionQueue Replaced images, framebuffers and descriptor pools are retired through it.
+     * @throws std::runtime_error When a shader binary is missing or a pipeline cannot be created. Nothing is left
+     * behind, the caller can fall back to the forward pass.
+     */
+    VisibilityBuffer(VkDevice device, VkPhysicalDevice physicalDevice, DeletionQueue &deletionQueue,
+                     uint32_t frameSlots, VkFormat depthFormat, VkPipelineLayout rasterPipelineLayout,
+                     const Geometry &geometry);
+
+    /**
+     * @brief Retires every resource through the deletion queue.
+     */
+    ~VisibilityBuffer();
+
+    VisibilityBuffer(const VisibilityBuffer &) = delete;
+
+    VisibilityBuffer &operator=(const VisibilityBuffer &) = delete;
+
+    /**
+     * @brief Builds a new ID image, shaded image and framebuffer around a depth buffer, after every swapchain
+     * recreation. Frames still in flight keep the old ones until they have completed.
+     */
+    void setDepthImage(VkImageView depthView, VkExtent2D extent);
+
+    /**
+     * @brief Points a frame slot at its uniforms and instance records. The frame that last used the slot has to be
+     * complete.
+     *
+     * @param instances One CullInstance per scene instance
+     * @param drawData One model matrix per scene instance
+     */
+    void setFrameInputs(uint32_t frame, VkBuffer uniforms, VkBuffer instances, VkBuffer drawData);
+
+    /**
+     * @brief Begins the ID pass of a cull phase with secondary buffer contents. The first phase clears the IDs and
+     * the depth, the second one draws on top of them.
+     */
+    void beginRenderPass(VkCommandBuffer commandBuffer, OcclusionCuller::Phase phase) const;
+
+    /**
+     * @brief Shades the IDs left by the second ID pass and blits the result into a swapchain image, which is left
+     * in VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL for the UI. Recorded outside of a render pass.
+     */
+    void recordResolve(VkCommandBuffer commandBuffer, uint32_t frame, Output output, VkImage swapChainImage,
+                       VkExtent2D swapChainExtent) const;
+
+    /** @brief Render pass the ID pipeline and the secondary buffers of both ID passes are compatible with */
+    VkRenderPass getRenderPass() const { return renderPass; }
+
+    VkFramebuffer getFramebuffer() const { return targets.framebuffer; }
+
+    /** @brief Draws with the forward pass's vertex input and descriptor set, writes IDs instead of colors */
+    VkPipeline getPipeline() const { return pipeline; }
+
+private:
+    struct FrameInputs {
+        VkBuffer uniforms = VK_NULL_HANDLE;
+        VkBuffer instances = VK_NULL_HANDLE;
+        VkBuffer drawData = VK_NULL_HANDLE;
+    };
+
+    /** @brief Everything that depends on the depth buffer, replaced as a whole */
+    struct Targets {
+        VkImage idImage = VK_NULL_HANDLE;
+        VkDeviceMemory idMemory = VK_NULL_HANDLE;
+        VkImageView idView = VK_NULL_HANDLE;
+        VkImage colorImage = VK_NULL_HANDLE;
+        VkDeviceMemory colorMemory = VK_NULL_HANDLE;
+        VkImageView colorView = VK_NULL_HANDLE;
+        VkFramebuffer framebuffer = VK_NULL_HANDLE;
+        VkExtent2D extent{};
+        VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+        /** @brief One per frame slot */
+        std::vector<VkDescriptorSet> resolveSets;
+    };
+
+    void createRenderPasses(VkFormat depthFormat);
+
+    void createPipelines(VkPipelineLayout rasterPipelineLayout, const std::vector<char> &vertShader,
+                         const std::vector<char> &fragShader, const std::vector<char> &resolveShader);
+
+    void createImage(VkFormat format, VkImageUsageFlags usage, VkImage &image, VkDeviceMemory &memory,
+                     VkImageView &view);
+
+    void retireTargets();
+
+    /** @brief Retires the render passes, pipelines and layouts, shared by the destructor and a failed constructor */
+    void retireObjects();
+
+    void writeResolveDescriptorSet(uint32_t frame);
+
+    static std::vector<char> readShaderFile(const std::string &fileName);
+
+    VkShaderModule createShaderModule(const std::vector<char> &code);
+
+    uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties);
+
+    VkDevice device;
+    VkPhysicalDevice physicalDevice;
+    DeletionQueue &deletionQueue;
+    Geometry geometry;
+    std::vector<FrameInputs> frames;
+    Targets targets;
+    /** @brief Clears the IDs and the depth and leaves the depth for the depth pyramid */
+    VkRenderPass renderPass = VK_NULL_HANDLE;
+    /** @brief Compatible with renderPass, loads both and leaves the IDs for the resolve */
+    VkRenderPass lateRenderPass = VK_NULL_HANDLE;
+    VkPipeline pipeline = VK_NULL_HANDLE;
+    VkDescriptorSetLayout resolveSetLayout = VK_NULL_HANDLE;
+    VkPipelineLayout resolvePipelineLayout = VK_NULL_HANDLE;
+    VkPipeline resolvePipeline = VK_NULL_HANDLE;
+};
+
+
+#endif //VISIBILITYBUFFER_H
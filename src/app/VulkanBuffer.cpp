@@ -9,11 +9,46 @@
 */
 
 #include "VulkanBuffer.h"
+#include "VulkanResources.h"
 
 #include <cassert>
+#include <cstring>
+#include <utility>
 
 namespace vks
 {	
+	Buffer::Buffer(Buffer&& other) noexcept
+	{
+		*this = std::move(other);
+	}
+
+	/**
+	* Take over the handles of another buffer, releasing the ones currently held
+	*/
+	Buffer& Buffer::operator=(Buffer&& other) noexcept
+	{
+		if (this != &other)
+		{
+			destroy();
+			device = other.device;
+			deletionQueue = other.deletionQueue;
+			buffer = std::exchange(other.buffer, VK_NULL_HANDLE);
+			memory = std::exchange(other.memory, VK_NULL_HANDLE);
+			descriptor = other.descriptor;
+			size = std::exchange(other.size, 0);
+			alignment = other.alignment;
+			mapped = std::exchange(other.mapped, nullptr);
+			usageFlags = other.usageFlags;
+			memoryPropertyFlags = other.memoryPropertyFlags;
+		}
+		return *this;
+	}
+
+	Buffer::~Buffer()
+	{
+		destroy();
+	}
+
 	/** 
 	* Map a memory range of this buffer. If successful, mapped points to the specified buffer range.
 	* 
@@ -122,16 +157,38 @@ namespace vks
 
 	/** 
 	* Release all Vulkan resources held by this buffer
+	*
+	* @note If a deletion queue is set the handles are only destroyed once the GPU is done with them
 	*/
 	void Buffer::destroy()
 	{
-		if (buffer)
+		if (!buffer && !memory)
+		{
+			return;
+		}
+		ResourceTracker::onRelease(ResourceType::Buffer, size);
+		auto deleter = [device = device, buffer = buffer, memory = memory]()
+		{
+			if (buffer)
+			{
+				vkDestroyBuffer(device, buffer, nullptr);
+			}
+			if (memory)
+			{
+				vkFreeMemory(device, memory, nullptr);
+			}
+		};
+		if (deletionQueue)
 		{
-			vkDestroyBuffer(device, buffer, nullptr);
+			deletionQueue->retire(deleter);
 		}
-		if (memory)
+		else
 		{
-			vkFreeMemory(device, memory, nullptr);
+			deleter();
 		}
+		buffer = VK_NULL_HANDLE;
+		memory = VK_NULL_HANDLE;
+		mapped = nullptr;
+		size = 0;
 	}
 };
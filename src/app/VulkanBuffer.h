@@ -13,16 +13,20 @@
 #include <vector>
 
 #include "vulkan/vulkan.h"
+#include "DeletionQueue.h"
 
 namespace vks
 {	
 	/**
 	* @brief Encapsulates access to a Vulkan buffer backed up by device memory
 	* @note To be filled by an external source like the VulkanDevice
+	* @note Move-only, the buffer owns its handles and releases them on destruction
 	*/
 	struct Buffer
 	{
-		VkDevice device;
+		VkDevice device = VK_NULL_HANDLE;
+		/** @brief If set, destroy() hands the handles to this queue instead of destroying them right away */
+		DeletionQueue* deletionQueue = nullptr;
 		VkBuffer buffer = VK_NULL_HANDLE;
 		VkDeviceMemory memory = VK_NULL_HANDLE;
 		VkDescriptorBufferInfo descriptor;
@@ -33,6 +37,12 @@ namespace vks
 		VkBufferUsageFlags usageFlags;
 		/** @brief Memory property flags to be filled by external source at buffer creation (to query at some later point) */
 		VkMemoryPropertyFlags memoryPropertyFlags;
+		Buffer() = default;
+		Buffer(const Buffer&) = delete;
+		Buffer& operator=(const Buffer&) = delete;
+		Buffer(Buffer&& other) noexcept;
+		Buffer& operator=(Buffer&& other) noexcept;
+		~Buffer();
 		VkResult map(VkDeviceSize size = VK_WHOLE_SIZE, VkDeviceSize offset = 0);
 		void unmap();
 		VkResult bind(VkDeviceSize offset = 0);
@@ -4,7 +4,27 @@
 
 #include "VulkanMiragePathtracer.h"
 
+#include <cmath>
+#include <limits>
+#include <glm/gtc/constants.hpp>
+
+#include "CameraPath.h"
+#include "ImageEncoder.h"
+#include "RaytracingCamera.h"
+
+VulkanMiragePathtracer::VulkanMiragePathtracer(const RendererConfig &config)
+    : presentMode(config.presentMode), rasterMode(config.rasterMode), framePacer(config.targetFrameRate),
+      config(config), headless(!config.outputPath.empty()) {
+}
+
 void VulkanMiragePathtracer::run() {
+    if (headless) {
+        initVulkan();
+        renderToFile();
+        cleanup();
+        return;
+    }
+
     initWindow();
     initWindow2();
     initVulkan();
@@ -27,8 +47,8 @@ void VulkanMiragePathtracer::initWindow() {
 void VulkanMiragePathtracer::initWindow2() {
     window2 = SDL_CreateWindow("My App",
                               SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED,
-                              800, 800,
-                              SDL_WINDOW_VULKAN | SDL_WINDOW_SHOWN);
+                              static_cast<int>(config.width), static_cast<int>(config.height),
+                              SDL_WINDOW_VULKAN | SDL_WINDOW_RESIZABLE | SDL_WINDOW_SHOWN);
 
     // Check if window was created successfully
     if (window2 == nullptr) {
@@ -51,13 +71,13 @@ void VulkanMiragePathtracer::createDescriptorSets() {
 
     for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
         VkDescriptorBufferInfo bufferInfo{};
-        bufferInfo.buffer = uniformBuffers[i];
+        bufferInfo.buffer = uniformBuffers[i].buffer;
         bufferInfo.offset = 0;
         bufferInfo.range = sizeof(UniformBufferObject);
 
         VkDescriptorImageInfo imageInfo{};
         imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-        imageInfo.imageView = textureImageView;
+        imageInfo.imageView = textureImage.view;
         imageInfo.sampler = textureSampler;
 
         std::array<VkWriteDescriptorSet, 2> descriptorWrites{};
@@ -84,7 +104,7 @@ void VulkanMiragePathtracer::createDescriptorSets() {
 }
 
 void VulkanMiragePathtracer::createTextureImageView() {
-    textureImageView = createImageView(textureImage, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_ASPECT_COLOR_BIT);
+    textureImage.view = createImageView(textureImage.image, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_ASPECT_COLOR_BIT);
 }
 
 void VulkanMiragePathtracer::createTextureSampler() {
@@ -115,87 +135,42 @@ void VulkanMiragePathtracer::createTextureSampler() {
 void VulkanMiragePathtracer::createDepthResources() {
     VkFormat depthFormat = findDepthFormat();
 
-    createImage(swapChainExtent.width, swapChainExtent.height, depthFormat, VK_IMAGE_TILING_OPTIMAL,
-                VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, depthImage,
-                depthImageMemory);
-    depthImageView = createImageView(depthImage, depthFormat, VK_IMAGE_ASPECT_DEPTH_BIT);
-}
+    // Replacing the wrapper retires the previous depth buffer through the deletion queue
+    depthImage = createVksImage(swapChainExtent.width, swapChainExtent.height, depthFormat,
+                                VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT);
+    depthImage.view = createImageView(depthImage.image, depthFormat, VK_IMAGE_ASPECT_DEPTH_BIT);
 
-void VulkanMiragePathtracer::loadModel() {
-    model = new Model("res/models/healingo/healingo.fbx");
-}
-
-void VulkanMiragePathtracer::createAccelerationStructure() {
-    VkAccelerationStructureBuildGeometryInfoKHR buildGeometryInfo = {};
-    buildGeometryInfo.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_BUILD_GEOMETRY_INFO_KHR;
-    buildGeometryInfo.flags = VK_BUILD_ACCELERATION_STRUCTURE_PREFER_FAST_TRACE_BIT_KHR;
-    buildGeometryInfo.mode = VK_BUILD_ACCELERATION_STRUCTURE_MODE_BUILD_KHR;
-    buildGeometryInfo.type = VK_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL_KHR;
-    buildGeometryInfo.geometryCount = 1;
-
-    uint32_t primitiveCount = 1;
-
-    VkAccelerationStructureBuildSizesInfoKHR sizeInfo = {};
-    sizeInfo.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_BUILD_SIZES_INFO_KHR;
-    vkGetAccelerationStructureBuildSizesKHR(device, VK_ACCELERATION_STRUCTURE_BUILD_TYPE_DEVICE_KHR, &buildGeometryInfo,
-                                            &primitiveCount, &sizeInfo);
-
-
-    // Creating the Buffer and allocating the memory for the acceleration structure
-    createBuffer(
-        sizeInfo.accelerationStructureSize,
-        VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_STORAGE_BIT_KHR,
-        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-        lowASBuffer,
-        lowASBufferMemory);
-
-    VkBuffer scratchBuffer;
-    VkDeviceMemory scratchBufferMemory;
-    createBuffer(
-        sizeInfo.buildScratchSize,
-        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
-        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-        scratchBuffer,
-        scratchBufferMemory);
-
-    // Create acceleration structure
-    VkAccelerationStructureCreateInfoKHR accelerationStructureInfo = {};
-    accelerationStructureInfo.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_CREATE_INFO_KHR;
-    accelerationStructureInfo.buffer = lowASBuffer;
-    accelerationStructureInfo.size = sizeInfo.accelerationStructureSize;
-    accelerationStructureInfo.type = VK_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL_KHR;
-
-    // Error checking omitted for brevity
-    if (vkCreateAccelerationStructureKHR(device, &accelerationStructureInfo, nullptr, &bottomLevelAS.handle) !=
-        VK_SUCCESS) {
-        throw std::runtime_error("failed to create acceleration structure!");
+    // The depth pyramid and the visibility buffer follow the depth buffer, on creation they do not exist yet
+    if (occlusionCuller) {
+        occlusionCuller->setDepthImage(depthImage.view, swapChainExtent);
     }
+    if (visibilityBuffer) {
+        visibilityBuffer->setDepthImage(depthImage.view, swapChainExtent);
+    }
+}
 
-    // Building the structure
-    buildGeometryInfo.dstAccelerationStructure = bottomLevelAS.handle;
-
-    VkAccelerationStructureBuildRangeInfoKHR rangeInfo;
-    rangeInfo.primitiveCount = primitiveCount;
-    rangeInfo.primitiveOffset = 0x0;
-    rangeInfo.firstVertex = 0;
-    rangeInfo.transformOffset = 0x0;
-
-    const VkAccelerationStructureBuildRangeInfoKHR *pRangeInfo = &rangeInfo;
+void VulkanMiragePathtracer::loadModel() {
+    model = new Model(config.modelPath);
 
-    vkCmdBuildAccelerationStructuresKHR(
-        commandBuffers[0],
-        1,
-        &buildGeometryInfo,
-        &pRangeInfo);
+    // Meshes without a whole triangle get no BLAS, every later BLAS index is shifted against the mesh index
+    blasMeshIndices.clear();
+    for (uint32_t i = 0; i < model->meshes.size(); i++) {
+        if (model->meshes[i]->indices.size() >= 3) {
+            blasMeshIndices.push_back(i);
+        }
+    }
 }
 
-
 void VulkanMiragePathtracer::prepareRaytracing() {
     // Get ray tracing pipeline properties, which will be used later on in the sample
     rayTracingPipelineProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_RAY_TRACING_PIPELINE_PROPERTIES_KHR;
     VkPhysicalDeviceProperties2 deviceProperties2{};
     deviceProperties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
     deviceProperties2.pNext = &rayTracingPipelineProperties;
+    accelerationStructureProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ACCELERATION_STRUCTURE_PROPERTIES_KHR;
+    rayTracingPipelineProperties.pNext = &accelerationStructureProperties;
+    physicalDeviceIdProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ID_PROPERTIES;
+    accelerationStructureProperties.pNext = &physicalDeviceIdProperties;
     vkGetPhysicalDeviceProperties2(physicalDevice, &deviceProperties2);
 
     // Get acceleration structure properties, which will be used later on in the sample
@@ -212,6 +187,18 @@ void VulkanMiragePathtracer::prepareRaytracing() {
         device, "vkCmdBuildAccelerationStructuresKHR"));
     vkBuildAccelerationStructuresKHR = reinterpret_cast<PFN_vkBuildAccelerationStructuresKHR>(vkGetDeviceProcAddr(
         device, "vkBuildAccelerationStructuresKHR"));
+    vkCmdWriteAccelerationStructuresPropertiesKHR = reinterpret_cast<
+        PFN_vkCmdWriteAccelerationStructuresPropertiesKHR>(vkGetDeviceProcAddr(
+        device, "vkCmdWriteAccelerationStructuresPropertiesKHR"));
+    vkCmdCopyAccelerationStructureKHR = reinterpret_cast<PFN_vkCmdCopyAccelerationStructureKHR>(vkGetDeviceProcAddr(
+        device, "vkCmdCopyAccelerationStructureKHR"));
+    vkCmdCopyAccelerationStructureToMemoryKHR = reinterpret_cast<PFN_vkCmdCopyAccelerationStructureToMemoryKHR>(
+        vkGetDeviceProcAddr(device, "vkCmdCopyAccelerationStructureToMemoryKHR"));
+    vkCmdCopyMemoryToAccelerationStructureKHR = reinterpret_cast<PFN_vkCmdCopyMemoryToAccelerationStructureKHR>(
+        vkGetDeviceProcAddr(device, "vkCmdCopyMemoryToAccelerationStructureKHR"));
+    vkGetDeviceAccelerationStructureCompatibilityKHR = reinterpret_cast<
+        PFN_vkGetDeviceAccelerationStructureCompatibilityKHR>(vkGetDeviceProcAddr(
+        device, "vkGetDeviceAccelerationStructureCompatibilityKHR"));
     vkCreateAccelerationStructureKHR = reinterpret_cast<PFN_vkCreateAccelerationStructureKHR>(vkGetDeviceProcAddr(
         device, "vkCreateAccelerationStructureKHR"));
     vkDestroyAccelerationStructureKHR = reinterpret_cast<PFN_vkDestroyAccelerationStructureKHR>(vkGetDeviceProcAddr(
@@ -221,170 +208,257 @@ void VulkanMiragePathtracer::prepareRaytracing() {
     vkGetAccelerationStructureDeviceAddressKHR = reinterpret_cast<PFN_vkGetAccelerationStructureDeviceAddressKHR>(
         vkGetDeviceProcAddr(device, "vkGetAccelerationStructureDeviceAddressKHR"));
     vkCmdTraceRaysKHR = reinterpret_cast<PFN_vkCmdTraceRaysKHR>(vkGetDeviceProcAddr(device, "vkCmdTraceRaysKHR"));
+    // Host builds need the feature and a pool of threads to join the deferred operations. A discrete GPU builds
+    // faster on its own, and the host build blocks initialization just the same
+    VkPhysicalDeviceProperties buildDeviceProperties{};
+    vkGetPhysicalDeviceProperties(physicalDevice, &buildDeviceProperties);
+    useHostAccelerationStructureBuilds = preferHostAccelerationStructureBuilds &&
+                                         buildDeviceProperties.deviceType != VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU &&
+                                         accelerationStructureFeatures.accelerationStructureHostCommands;
+    if (useHostAccelerationStructureBuilds) {
+        deferredOperationPool = std::make_unique<DeferredOperationPool>(device);
+        std::cout << "Building acceleration structures on the host with " << deferredOperationPool->threadCount() + 1
+                << " threads" << std::endl;
+    }
+
     vkGetRayTracingShaderGroupHandlesKHR = reinterpret_cast<PFN_vkGetRayTracingShaderGroupHandlesKHR>(
         vkGetDeviceProcAddr(device, "vkGetRayTracingShaderGroupHandlesKHR"));
     vkCreateRayTracingPipelinesKHR = reinterpret_cast<PFN_vkCreateRayTracingPipelinesKHR>(vkGetDeviceProcAddr(
         device, "vkCreateRayTracingPipelinesKHR"));
 
     // Create the acceleration structures used to render the ray traced scene
-    createBottomLevelAccelerationStructure();
+    createBottomLevelAccelerationStructures();
     createTopLevelAccelerationStructure();
 }
 
-void VulkanMiragePathtracer::buildCommandBuffers() {
-    // if (resized)
-    drawCmdBuffers.resize(MAX_FRAMES_IN_FLIGHT);
-    
-    VkCommandBufferAllocateInfo allocInfo{};
-    allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-    allocInfo.commandPool = raytracingCommandPool;
-    allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-    allocInfo.commandBufferCount = (uint32_t) drawCmdBuffers.size();
+void VulkanMiragePathtracer::createRaytracingCommandBuffers() {
+    // Allocated once and re-recorded only when their bindings change. The trace only depends on the frame slot, the
+    // copy also on the swapchain image it writes.
+    auto allocate = [this](VkCommandPool pool, size_t count) {
+        std::vector<VkCommandBuffer> handles(count);
+
+        VkCommandBufferAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        allocInfo.commandPool = pool;
+        allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        allocInfo.commandBufferCount = (uint32_t) handles.size();
+
+        if (vkAllocateCommandBuffers(device, &allocInfo, handles.data()) != VK_SUCCESS) {
+            throw std::runtime_error("failed to allocate command buffers!");
+        }
+
+        std::vector<vks::CommandBuffer> commandBuffers(handles.size());
+        for (size_t i = 0; i < handles.size(); i++) {
+            commandBuffers[i].device = device;
+            commandBuffers[i].deletionQueue = &deletionQueue;
+            commandBuffers[i].pool = pool;
+            commandBuffers[i].handle = handles[i];
+            vks::ResourceTracker::onCreate(vks::ResourceType::CommandBuffer, 0);
+        }
+        return commandBuffers;
+    };
+
+    traceCmdBuffers = allocate(raytracingCommandPool, MAX_FRAMES_IN_FLIGHT);
+    drawCmdBuffers = allocate(raytracingCopyCommandPool, MAX_FRAMES_IN_FLIGHT * raycastSwapChainImages.size());
+    markRaytracingCommandBuffersDirty();
+}
+
+void VulkanMiragePathtracer::markRaytracingCommandBuffersDirty() {
+    raytracingCommandBuffersDirty.assign(MAX_FRAMES_IN_FLIGHT, true);
+}
+
+uint32_t VulkanMiragePathtracer::raytracingCommandBufferIndex(uint32_t frame, uint32_t imageIndex) const {
+    return frame * static_cast<uint32_t>(raycastSwapChainImages.size()) + imageIndex;
+}
+
+void VulkanMiragePathtracer::recordRaytracingCommandBuffers(uint32_t frame) {
+    // Only this slot's buffers, image and descriptor set are touched and its last frame is done, so nothing has to
+    // wait. The other slot keeps its old size until it comes around.
+    const VkExtent2D extent = raytracingOutputExtent();
+    if (storageImages[frame].extent.width != extent.width || storageImages[frame].extent.height != extent.height) {
+        createStorageImage(frame, extent);
+        writeStorageImageDescriptor(frame);
+    }
+
+    recordTraceCommandBuffer(frame);
+    for (uint32_t imageIndex = 0; imageIndex < raycastSwapChainImages.size(); imageIndex++) {
+        recordRaytracingCommandBuffer(frame, imageIndex);
+    }
+    raytracingCommandBuffersDirty[frame] = false;
+}
+
+void VulkanMiragePathtracer::recordTraceCommandBuffer(uint32_t frame) {
+    VkCommandBuffer commandBuffer = traceCmdBuffers[frame].handle;
+    const vks::Image &storageImage = storageImages[frame];
+
+    VkCommandBufferBeginInfo cmdBufInfo{};
+    cmdBufInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
 
-    if (vkAllocateCommandBuffers(device, &allocInfo, drawCmdBuffers.data()) != VK_SUCCESS) {
-        throw std::runtime_error("failed to allocate command buffers!");
+    VK_CHECK_RESULT(vkBeginCommandBuffer(commandBuffer, &cmdBufInfo));
+
+    recordTraceRays(commandBuffer, frame);
+
+    // Release the output to the graphics family, the copy acquires it with the same layouts. With a single family
+    // this is the barrier between the trace and the copy.
+    if (computeQueueFamily != graphicsQueueFamily) {
+        storageImageBarrier(commandBuffer, storageImage.image, VK_IMAGE_LAYOUT_GENERAL,
+                            VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, computeQueueFamily, graphicsQueueFamily,
+                            VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_KHR, VK_ACCESS_SHADER_WRITE_BIT,
+                            VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0);
+    } else {
+        storageImageBarrier(commandBuffer, storageImage.image, VK_IMAGE_LAYOUT_GENERAL,
+                            VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED,
+                            VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_KHR, VK_ACCESS_SHADER_WRITE_BIT,
+                            VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT);
     }
-    
+
+    VK_CHECK_RESULT(vkEndCommandBuffer(commandBuffer));
+}
+
+void VulkanMiragePathtracer::recordTraceRays(VkCommandBuffer commandBuffer, uint32_t frame) {
+    const vks::Image &storageImage = storageImages[frame];
+
+    // Every pixel is written, the previous contents are discarded and need no transfer back from the graphics
+    // family. The copy that last read the image finished before this frame slot was handed out again.
+    storageImageBarrier(commandBuffer, storageImage.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL,
+                        VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED,
+                        VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, 0,
+                        VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_KHR, VK_ACCESS_SHADER_WRITE_BIT);
+
+    /*
+        Dispatch the ray tracing commands
+    */
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_RAY_TRACING_KHR, raytracingPipeline);
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_RAY_TRACING_KHR, raytracingPipelineLayout, 0, 1,
+                            &raytracingDescriptorSets[frame], 0, 0);
+
+    vkCmdTraceRaysKHR(
+        commandBuffer,
+        &shaderBindingTableRegions.raygen,
+        &shaderBindingTableRegions.miss,
+        &shaderBindingTableRegions.hit,
+        &shaderBindingTableRegions.callable,
+        storageImage.extent.width,
+        storageImage.extent.height,
+        1);
+}
+
+void VulkanMiragePathtracer::recordRaytracingCommandBuffer(uint32_t frame, uint32_t imageIndex) {
+    VkCommandBuffer commandBuffer = drawCmdBuffers[raytracingCommandBufferIndex(frame, imageIndex)].handle;
+    const vks::Image &storageImage = storageImages[frame];
+
     VkCommandBufferBeginInfo cmdBufInfo{};
     cmdBufInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
 
     VkImageSubresourceRange subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
 
-    for (int32_t i = 0; i < drawCmdBuffers.size(); ++i) {
-        VK_CHECK_RESULT(vkBeginCommandBuffer(drawCmdBuffers[i], &cmdBufInfo));
-
-        /*
-            Setup the buffer regions pointing to the shaders in our shader binding table
-        */
-
-        const uint32_t handleSizeAligned = alignedSize(rayTracingPipelineProperties.shaderGroupHandleSize,
-                                                       rayTracingPipelineProperties.shaderGroupHandleAlignment);
-
-        VkStridedDeviceAddressRegionKHR raygenShaderSbtEntry{};
-        raygenShaderSbtEntry.deviceAddress = getBufferDeviceAddress(raygenShaderBindingTable.buffer);
-        raygenShaderSbtEntry.stride = handleSizeAligned;
-        raygenShaderSbtEntry.size = handleSizeAligned;
-
-        VkStridedDeviceAddressRegionKHR missShaderSbtEntry{};
-        missShaderSbtEntry.deviceAddress = getBufferDeviceAddress(missShaderBindingTable.buffer);
-        missShaderSbtEntry.stride = handleSizeAligned;
-        missShaderSbtEntry.size = handleSizeAligned;
-
-        VkStridedDeviceAddressRegionKHR hitShaderSbtEntry{};
-        hitShaderSbtEntry.deviceAddress = getBufferDeviceAddress(hitShaderBindingTable.buffer);
-        hitShaderSbtEntry.stride = handleSizeAligned;
-        hitShaderSbtEntry.size = handleSizeAligned;
-
-        VkStridedDeviceAddressRegionKHR callableShaderSbtEntry{};
-
-        /*
-            Dispatch the ray tracing commands
-        */
-        vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_RAY_TRACING_KHR, raytracingPipeline);
-        vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_RAY_TRACING_KHR, raytracingPipelineLayout, 0, 1,
-                                &raytracingDescriptorSet, 0, 0);
-
-        vkCmdTraceRaysKHR(
-            drawCmdBuffers[i],
-            &raygenShaderSbtEntry,
-            &missShaderSbtEntry,
-            &hitShaderSbtEntry,
-            &callableShaderSbtEntry,
-            800,
-            800,
-            1);
-
-        /*
-            Copy ray tracing output to swap chain image
-        */
-
-        // Prepare current swap chain image as transfer destination
-        // Prepare current swap chain image as transfer destination
-       setImageLayout( //BUG
-            drawCmdBuffers[i],
-            raycastSwapChainImages[i],
-            VK_IMAGE_LAYOUT_UNDEFINED,
-            VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-            subresourceRange);
-
-        // Prepare ray tracing output image as transfer source
-        setImageLayout(
-            drawCmdBuffers[i],
-            storageImage.image,
-            VK_IMAGE_LAYOUT_GENERAL,
-            VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
-            subresourceRange);
-        VkImageCopy copyRegion{};
-        copyRegion.srcSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1};
-        copyRegion.srcOffset = {0, 0, 0};
-        copyRegion.dstSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1};
-        copyRegion.dstOffset = {0, 0, 0};
-        copyRegion.extent = {800, 800, 1};
-        vkCmdCopyImage(drawCmdBuffers[i], storageImage.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
-                       raycastSwapChainImages[i], VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &copyRegion);
-
-        // Transition swap chain image back for presentation
-        setImageLayout( //BUG
-                    drawCmdBuffers[i],
-                    raycastSwapChainImages[i],
-                    VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-                    VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
-                    subresourceRange);
-
-        // Transition ray tracing output image back to general layout
-       setImageLayout(
-            drawCmdBuffers[i],
-            storageImage.image,
-            VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
-            VK_IMAGE_LAYOUT_GENERAL,
-            subresourceRange);
-
-        VK_CHECK_RESULT(vkEndCommandBuffer(drawCmdBuffers[i]));
+    VK_CHECK_RESULT(vkBeginCommandBuffer(commandBuffer, &cmdBufInfo));
+
+    // Acquire the output released by the trace, the semaphore wait of the pass orders it after the release
+    if (computeQueueFamily != graphicsQueueFamily) {
+        storageImageBarrier(commandBuffer, storageImage.image, VK_IMAGE_LAYOUT_GENERAL,
+                            VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, computeQueueFamily, graphicsQueueFamily,
+                            VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, 0,
+                            VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT);
     }
+
+    /*
+        Copy ray tracing output to swap chain image
+    */
+
+    // Prepare the acquired swap chain image as transfer destination
+    setImageLayout(
+        commandBuffer,
+        raycastSwapChainImages[imageIndex],
+        VK_IMAGE_LAYOUT_UNDEFINED,
+        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+        subresourceRange);
+
+    VkImageCopy copyRegion{};
+    copyRegion.srcSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1};
+    copyRegion.srcOffset = {0, 0, 0};
+    copyRegion.dstSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1};
+    copyRegion.dstOffset = {0, 0, 0};
+    copyRegion.extent = storageImage.extent;
+    vkCmdCopyImage(commandBuffer, storageImage.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                   raycastSwapChainImages[imageIndex], VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &copyRegion);
+
+    // Transition swap chain image back for presentation
+    setImageLayout(
+        commandBuffer,
+        raycastSwapChainImages[imageIndex],
+        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+        VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
+        subresourceRange);
+
+    VK_CHECK_RESULT(vkEndCommandBuffer(commandBuffer));
 }
 
 void VulkanMiragePathtracer::initVulkan() {
     loadModel();
     createInstance();
     setupDebugMessenger();
-    createSurface();
+    if (!headless) {
+        createSurface();
+    }
     pickPhysicalDevice();
     createLogicalDevice();
-    createSwapChain();
-    createImageViews();
-    createRenderPass();
-    createDescriptorSetLayout();
-    createGraphicsPipeline();
+    // The one-time commands of the ray tracing setup come from this pool as well
     createCommandPool();
-    createDepthResources();
-    createFramebuffers();
-    createTextureImage();
-    createTextureImageView();
-    createTextureSampler();
-    createVertexBuffer();
-    createIndexBuffer();
-    createUniformBuffers();
-    createDescriptorPool();
-    createDescriptorSets();
-    createCommandBuffers();
-    createSyncObjects();
+    if (!headless) {
+        createSwapChain();
+        createImageViews();
+        createRenderPass();
+        createDescriptorSetLayout();
+        createGraphicsPipeline();
+        createDepthResources();
+        createFramebuffers();
+        createTextureImage();
+        createTextureImageView();
+        createTextureSampler();
+        createVertexBuffer();
+        createIndexBuffer();
+        createUniformBuffers();
+        createDescriptorPool();
+        createDescriptorSets();
+        createRasterDrawBuffers();
+        createCommandBuffers();
+        createSyncObjects();
+    }
 
     //Raytracing
+    // The acceleration structure update buffers come from the ray tracing pool
+    createCommandPool2();
     prepareRaytracing();
-    createSurface2();
-    createSwapChain2();
-    createStorageImage();
+    if (!headless) {
+        createSurface2();
+        createSwapChain2();
+    }
+    createStorageImages();
     createUniformBuffer();
     createRayTracingPipeline();
     createShaderBindingTable();
     createDescriptorSets2();
-    createCommandPool2();
-    buildCommandBuffers();
-    createSyncObjects2();
+    if (!headless) {
+        createRaytracingCommandBuffers();
+        createSyncObjects2();
+    } else {
+        // Without the raster pass there is nothing to run next to the trace, everything goes to the graphics queue
+        frameScheduler = std::make_unique<FrameScheduler>(device, std::vector<VkQueue>{graphicsQueue},
+                                                          MAX_FRAMES_IN_FLIGHT);
+    }
+
+    // Uploads and builds went through one-time commands on the graphics queue, the compute queue reads their
+    // results without a semaphore in between
+    VK_CHECK_RESULT(vkQueueWaitIdle(graphicsQueue));
 }
 
 void VulkanMiragePathtracer::createInstance() {
+    // Headless runs on machines without a Vulkan driver or SDK fail here, the CPU renderer can still make the image
     if (enableValidationLayers && !checkValidationLayerSupport()) {
+        if (headless) {
+            throw NoSuitableDeviceError("validation layers requested, but not available!");
+        }
         throw std::runtime_error("validation layers requested, but not available!");
     }
 
@@ -421,6 +495,9 @@ void VulkanMiragePathtracer::createInstance() {
     VkResult res;
     res = vkCreateInstance(&createInfo, nullptr, &instance);
     if (res != VK_SUCCESS) {
+        if (headless) {
+            throw NoSuitableDeviceError("failed to create instance!");
+        }
         throw std::runtime_error("failed to create instance!");
     }
 }
@@ -436,6 +513,15 @@ void VulkanMiragePathtracer::setupDebugMessenger() {
 }
 
 std::vector<const char *> VulkanMiragePathtracer::getRequiredExtensions() {
+    if (headless) {
+        // No window and no surface, only the debug messenger may be needed
+        std::vector<const char *> extensions;
+        if (enableValidationLayers) {
+            extensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
+        }
+        return extensions;
+    }
+
     unsigned int extension_count;
     if (!SDL_Vulkan_GetInstanceExtensions(window, &extension_count, nullptr)) {
         throw std::runtime_error("Getting SDL instance vulkan extensions failed!");
@@ -459,88 +545,317 @@ void VulkanMiragePathtracer::mainLoop() {
     SDL_Event event;
     bool isRunning = true;
     while (isRunning) {
+        // Nothing is shown while both windows are minimized, sleep until the next event instead of spinning
+        if (isMinimized && raytracingWindowMinimized) {
+            if (SDL_WaitEvent(&event)) {
+                ImGui_ImplSDL2_ProcessEvent(&event);
+                isRunning = handleEvent(event);
+            }
+            continue;
+        }
+
+        if (presentModeChanged) {
+            applyPresentMode();
+        }
+
+        // Everything that can block comes before the input is read: the pacing sleep, the frame slot and the
+        // swapchain images. What the frame shows is then as fresh as it can be when recording starts.
+        framePacer.waitForFrameStart();
+        acquireFrame();
+        framePacer.markCompleted(completedFrameValue());
+
         while (SDL_PollEvent(&event)) {
             ImGui_ImplSDL2_ProcessEvent(&event); // Forward your event to backend
-            switch (event.type) {
-                case SDL_WINDOWEVENT:
-                    switch (event.window.event) {
-                        case SDL_WINDOWEVENT_RESIZED:
-                            framebufferResized = true;
-                            break;
-                        case SDL_WINDOWEVENT_MINIMIZED:
-                            isMinimized = true;
-                            break;
-                    }
-                    break;
-
-                case SDL_QUIT:
-                    isRunning = false;
-                    break;
-            }
+            isRunning = handleEvent(event) && isRunning;
         }
 
         ImGui_ImplVulkan_NewFrame();
         ImGui_ImplSDL2_NewFrame();
         ImGui::NewFrame();
         ImGui::Begin("My ImGui Window");
+        ImGui::Text("Frame time: %.2f ms", averageFrameTime);
+        ImGui::Text("Instances drawn: %u + %u disoccluded", cullStats.drawnFirstPhase, cullStats.drawnSecondPhase);
+        ImGui::Text("Instances culled: %u frustum, %u occlusion", cullStats.frustumCulled,
+                    cullStats.occlusionCulled);
+        drawRasterModeUi();
+        drawFramePacingUi();
+        drawSceneUi();
         ImGui::End();
+        if (spinSceneCopies) {
+            spinSceneInstances();
+        }
+        framePacer.markInputSampled(deletionQueue.currentFrame());
         drawFrame();
-        drawFrame2();
 
-        vkDeviceWaitIdle(device);
+        deletionQueue.advance();
+        collectRetiredResources();
+        recordFrameTime();
+    }
+}
+
+bool VulkanMiragePathtracer::handleEvent(const SDL_Event &event) {
+    switch (event.type) {
+        case SDL_WINDOWEVENT: {
+            // Each window has its own swapchain, only the one that changed is recreated
+            const bool raytracingWindow = event.window.windowID == SDL_GetWindowID(window2);
+            bool &resized = raytracingWindow ? raytracingWindowResized : framebufferResized;
+            bool &minimized = raytracingWindow ? raytracingWindowMinimized : isMinimized;
+            switch (event.window.event) {
+                case SDL_WINDOWEVENT_SIZE_CHANGED:
+                    resized = true;
+                    break;
+                case SDL_WINDOWEVENT_MINIMIZED:
+                    minimized = true;
+                    break;
+                case SDL_WINDOWEVENT_RESTORED:
+                    minimized = false;
+                    resized = true;
+                    break;
+            }
+            break;
+        }
+
+        case SDL_QUIT:
+            return false;
+    }
+    return true;
+}
+
+void VulkanMiragePathtracer::renderToFile() {
+    const float aspect = config.width / (float) config.height;
+    std::vector<RaytracingCamera> cameras;
+    if (config.cameraPath.empty()) {
+        cameras.push_back(RaytracingCamera::createDefault(aspect));
+    } else {
+        cameras = CameraPath::load(config.cameraPath, aspect);
+    }
+    const uint64_t firstFrameValue = deletionQueue.currentFrame();
+    auto outputPath = [this, firstFrameValue](uint64_t frameValue) {
+        if (config.cameraPath.empty()) {
+            return config.outputPath;
+        }
+        return config.frameOutputPath(static_cast<uint32_t>(frameValue - firstFrameValue));
+    };
+
+    ReadbackRing readbackRing(device, physicalDevice, static_cast<VkDeviceSize>(config.width) * config.height * 4,
+                              readbackRingSize);
+
+    std::vector<VkCommandBuffer> commandBuffers(MAX_FRAMES_IN_FLIGHT);
+    VkCommandBufferAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    allocInfo.commandPool = commandPool;
+    allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    allocInfo.commandBufferCount = static_cast<uint32_t>(commandBuffers.size());
+    VK_CHECK_RESULT(vkAllocateCommandBuffers(device, &allocInfo, commandBuffers.data()));
+
+    // Finished frames are encoded straight from their readback slot, the encoder gives the slot back once the file
+    // is written. Declared after the ring, so queued jobs are finished before the ring goes away.
+    ImageEncoder imageEncoder(config.threadCount);
+    auto encodeCompletedFrames = [&]() {
+        while (std::optional<ReadbackRing::Frame> frame = readbackRing.poll(frameScheduler->completedValue())) {
+            ImageEncoder::Job job;
+            job.path = outputPath(frame->frameValue);
+            job.width = config.width;
+            job.height = config.height;
+            job.pixelFormat = ImageEncoder::PixelFormat::Bgra8;
+            job.pixels = frame->data;
+            job.onDone = [&readbackRing, slot = frame->slot]() { readbackRing.release(slot); };
+            imageEncoder.submit(std::move(job));
+        }
+    };
+
+    const auto start = std::chrono::high_resolution_clock::now();
+    for (const RaytracingCamera &camera: cameras) {
+        const uint64_t frameValue = deletionQueue.currentFrame();
+        currentFrame = frameScheduler->beginFrame(frameValue);
+
+        // Offline output must not drop frames, a full ring waits for the GPU first and then for the encoders
+        encodeCompletedFrames();
+        for (;;) {
+            // Read before the check, a job finishing in between must not be waited for
+            const uint64_t finishedJobs = imageEncoder.finishedJobs();
+            if (readbackRing.hasFreeSlot()) {
+                break;
+            }
+            if (const uint64_t pendingValue = readbackRing.oldestPendingValue()) {
+                frameScheduler->wait(pendingValue);
+            } else {
+                imageEncoder.waitForFinished(finishedJobs + 1);
+            }
+            encodeCompletedFrames();
+        }
+
+        VkCommandBuffer commandBuffer = commandBuffers[currentFrame];
+        updateUniformBuffers(currentFrame, camera);
+        recordReadback(commandBuffer, currentFrame, readbackRing, frameValue);
+
+        FrameScheduler::Pass readbackPass;
+        readbackPass.name = "trace and readback";
+        readbackPass.commandBuffers = {commandBuffer};
+        frameScheduler->addPass(std::move(readbackPass));
+        frameScheduler->submit();
+
+        deletionQueue.advance();
+        collectRetiredResources();
+    }
+    frameScheduler->waitSubmitted();
+    encodeCompletedFrames();
+    imageEncoder.waitIdle();
+    const auto end = std::chrono::high_resolution_clock::now();
+
+    const double seconds = std::chrono::duration<double>(end - start).count();
+    std::cout << "Vulkan rendered " << cameras.size() << " frame(s) in " << seconds * 1000.0 << " ms ("
+            << cameras.size() / seconds << " fps, " << (readbackRing.isHostCached() ? "cached" : "uncached")
+            << " readback, " << imageEncoder.threadCount() << " encoder threads stalled the renderer for "
+            << imageEncoder.backpressureTime().count() << " ms)" << std::endl;
+
+    vkFreeCommandBuffers(device, commandPool, static_cast<uint32_t>(commandBuffers.size()), commandBuffers.data());
+}
+
+void VulkanMiragePathtracer::recordReadback(VkCommandBuffer commandBuffer, uint32_t frame, ReadbackRing &readbackRing,
+                                            uint64_t frameValue) {
+    const vks::Image &storageImage = storageImages[frame];
+
+    VkCommandBufferBeginInfo beginInfo{};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    VK_CHECK_RESULT(vkBeginCommandBuffer(commandBuffer, &beginInfo));
+
+    recordTraceRays(commandBuffer, frame);
+    storageImageBarrier(commandBuffer, storageImage.image, VK_IMAGE_LAYOUT_GENERAL,
+                        VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED,
+                        VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_KHR, VK_ACCESS_SHADER_WRITE_BIT,
+                        VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT);
+    if (!readbackRing.recordCopy(commandBuffer, storageImage.image, storageImage.extent, frameValue)) {
+        throw std::runtime_error("no free readback slot for frame " + std::to_string(frameValue) + "!");
     }
+
+    VK_CHECK_RESULT(vkEndCommandBuffer(commandBuffer));
 }
 
 void VulkanMiragePathtracer::cleanup() {
-    ImGui_ImplVulkan_Shutdown();
-    ImGui_ImplSDL2_Shutdown();
-    ImGui::DestroyContext();
+    vkDeviceWaitIdle(device);
+
+    if (!headless) {
+        ImGui_ImplVulkan_Shutdown();
+        ImGui_ImplSDL2_Shutdown();
+        ImGui::DestroyContext();
+    }
 
+    // The draw record buffers, the culler, the visibility buffer and the raster geometry, texture, uniforms and depth
+    // buffer retire through the deletion queue like the ray tracing resources
+    visibilityBuffer.reset();
+    occlusionCuller.reset();
+    rasterDrawBuffers.clear();
+    vertexBuffer.destroy();
+    indexBuffer.destroy();
+    uniformBuffers.clear();
+    textureImage.destroy();
+    depthImage.destroy();
+    cleanupRaytracing();
+    deletionQueue.flushAll();
+    reportLeakedResources();
+
+    if (!headless) {
+        cleanupRaster();
+    }
+    frameScheduler.reset();
+    rasterRecorder.reset();
+    jobSystem.reset();
+
+    vkDestroyCommandPool(device, commandPool, nullptr);
+
+    vkDestroyDevice(device, nullptr);
+
+    if (enableValidationLayers) {
+        DestroyDebugUtilsMessengerEXT(instance, debugMessenger, nullptr);
+    }
+
+    if (!headless) {
+        vkDestroySurfaceKHR(instance, surface, nullptr);
+        vkDestroySurfaceKHR(instance, surface2, nullptr);
+    }
+    vkDestroyInstance(instance, nullptr);
+    if (!headless) {
+        SDL_DestroyWindow(window2);
+        SDL_DestroyWindow(window);
+        SDL_Quit();
+    }
+}
+
+void VulkanMiragePathtracer::cleanupRaster() {
     cleanupSwapChain();
 
     vkDestroyPipeline(device, graphicsPipeline, nullptr);
     vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
     vkDestroyRenderPass(device, renderPass, nullptr);
-
-    for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
-        vkDestroyBuffer(device, uniformBuffers[i], nullptr);
-        vkFreeMemory(device, uniformBuffersMemory[i], nullptr);
-    }
+    vkDestroyRenderPass(device, lateRenderPass, nullptr);
 
     vkDestroyDescriptorPool(device, descriptorPool, nullptr);
 
     vkDestroySampler(device, textureSampler, nullptr);
-    vkDestroyImageView(device, textureImageView, nullptr);
-
-    vkDestroyImage(device, textureImage, nullptr);
-    vkFreeMemory(device, textureImageMemory, nullptr);
 
     vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
 
-    vkDestroyBuffer(device, indexBuffer, nullptr);
-    vkFreeMemory(device, indexBufferMemory, nullptr);
-
-    vkDestroyBuffer(device, vertexBuffer, nullptr);
-    vkFreeMemory(device, vertexBufferMemory, nullptr);
-
     for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
         vkDestroySemaphore(device, renderFinishedSemaphores[i], nullptr);
         vkDestroySemaphore(device, imageAvailableSemaphores[i], nullptr);
-        vkDestroyFence(device, inFlightFences[i], nullptr);
     }
+}
 
-    vkDestroyCommandPool(device, commandPool, nullptr);
+void VulkanMiragePathtracer::cleanupRaytracing() {
+    // The owning wrappers hand their handles to the deletion queue, flushed by the caller
+    drawCmdBuffers.clear();
+    traceCmdBuffers.clear();
+    tlasUpdateCmdBuffers.clear();
+    instanceBuffers.clear();
+    tlasScratchBuffer.destroy();
+    topLevelAS.destroy();
+    bottomLevelAccelerationStructures.clear();
+    vertexBuffer2.destroy();
+    indexBuffer2.destroy();
+    unformBuffer2.destroy();
+    ubos.clear();
+    raygenShaderBindingTable.destroy();
+    missShaderBindingTable.destroy();
+    hitShaderBindingTable.destroy();
+    storageImages.clear();
+    deferredOperationPool.reset();
+
+    vkDestroyPipeline(device, raytracingPipeline, nullptr);
+    vkDestroyPipelineLayout(device, raytracingPipelineLayout, nullptr);
+    vkDestroyDescriptorPool(device, rayTracingDescriptorPool, nullptr);
+    vkDestroyDescriptorSetLayout(device, raytracingDescriptorSetLayout, nullptr);
+
+    // Headless runs never create the semaphores or the swapchain
+    for (size_t i = 0; i < renderFinishedSemaphores2.size(); i++) {
+        vkDestroySemaphore(device, renderFinishedSemaphores2[i], nullptr);
+        vkDestroySemaphore(device, imageAvailableSemaphores2[i], nullptr);
+    }
 
-    vkDestroyDevice(device, nullptr);
+    deletionQueue.retire([device = device, raytracingCommandPool = raytracingCommandPool,
+                             raytracingCopyCommandPool = raytracingCopyCommandPool,
+                             raycastingSwapChain = raycastingSwapChain]() {
+        vkDestroyCommandPool(device, raytracingCommandPool, nullptr);
+        vkDestroyCommandPool(device, raytracingCopyCommandPool, nullptr);
+        if (raycastingSwapChain != VK_NULL_HANDLE) {
+            vkDestroySwapchainKHR(device, raycastingSwapChain, nullptr);
+        }
+    });
+}
 
-    if (enableValidationLayers) {
-        DestroyDebugUtilsMessengerEXT(instance, debugMessenger, nullptr);
+void VulkanMiragePathtracer::reportLeakedResources() {
+    if (vks::ResourceTracker::totalLiveCount() == 0) {
+        return;
     }
 
-    vkDestroySurfaceKHR(instance, surface, nullptr);
-    vkDestroyInstance(instance, nullptr);
-    SDL_DestroyWindow(window);
-    SDL_Quit();
+    for (size_t i = 0; i < static_cast<size_t>(vks::ResourceType::Count); i++) {
+        auto type = static_cast<vks::ResourceType>(i);
+        if (vks::ResourceTracker::liveCount(type) != 0) {
+            std::cerr << "Leaked " << vks::ResourceTracker::liveCount(type) << " " << vks::ResourceTracker::name(type)
+                    << "(s), " << vks::ResourceTracker::liveBytes(type) << " bytes" << std::endl;
+        }
+    }
 }
 
 void VulkanMiragePathtracer::createRenderPass() {
@@ -551,23 +866,25 @@ void VulkanMiragePathtracer::createRenderPass() {
     colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
     colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
     colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    // The late render pass presents, the first one leaves the image to it
     colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-    colorAttachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+    colorAttachment.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
 
     VkAttachmentReference colorAttachmentRef{};
     colorAttachmentRef.attachment = 0;
     colorAttachmentRef.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
 
 
+    // The depth pyramid is built from the first pass's depth, between the two passes
     VkAttachmentDescription depthAttachment{};
     depthAttachment.format = findDepthFormat();
     depthAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
     depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-    depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
     depthAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
     depthAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
     depthAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-    depthAttachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+    depthAttachment.finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
 
     VkAttachmentReference depthAttachmentRef{};
     depthAttachmentRef.attachment = 1;
@@ -579,15 +896,25 @@ void VulkanMiragePathtracer::createRenderPass() {
     subpass.pColorAttachments = &colorAttachmentRef;
     subpass.pDepthStencilAttachment = &depthAttachmentRef;
 
-    VkSubpassDependency dependency{};
-    dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
-    dependency.dstSubpass = 0;
-    dependency.srcAccessMask = 0;
-    dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT |
-                              VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
-    dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT |
-                              VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
-    dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+    // The depth is shared by the frames in flight, the previous frame's late pass has to be done writing it
+    std::array<VkSubpassDependency, 2> dependencies{};
+    dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
+    dependencies[0].dstSubpass = 0;
+    dependencies[0].srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+    dependencies[0].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT |
+                                   VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT |
+                                   VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+    dependencies[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT |
+                                   VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+    dependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT |
+                                    VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+    // The depth pyramid reads the depth right after the pass
+    dependencies[1].srcSubpass = 0;
+    dependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
+    dependencies[1].srcStageMask = VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+    dependencies[1].srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+    dependencies[1].dstStageMask = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+    dependencies[1].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
 
     std::array<VkAttachmentDescription, 2> attachments = {colorAttachment, depthAttachment};
     VkRenderPassCreateInfo renderPassInfo{};
@@ -596,12 +923,40 @@ void VulkanMiragePathtracer::createRenderPass() {
     renderPassInfo.pAttachments = attachments.data();
     renderPassInfo.subpassCount = 1;
     renderPassInfo.pSubpasses = &subpass;
-    renderPassInfo.dependencyCount = 1;
-    renderPassInfo.pDependencies = &dependency;
+    renderPassInfo.dependencyCount = static_cast<uint32_t>(dependencies.size());
+    renderPassInfo.pDependencies = dependencies.data();
 
     if (vkCreateRenderPass(device, &renderPassInfo, nullptr, &renderPass) != VK_SUCCESS) {
         throw std::runtime_error("failed to create render pass!");
     }
+
+    // The late pass continues where the first one stopped, with the same attachments so pipelines and framebuffers
+    // work with both
+    attachments[0].loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+    attachments[0].initialLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+    attachments[0].finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+    attachments[1].loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+    attachments[1].storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    attachments[1].initialLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    attachments[1].finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+    VkSubpassDependency lateDependency{};
+    lateDependency.srcSubpass = VK_SUBPASS_EXTERNAL;
+    lateDependency.dstSubpass = 0;
+    lateDependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT |
+                                  VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+    lateDependency.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+    lateDependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT |
+                                  VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+    lateDependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT |
+                                   VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT |
+                                   VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+    renderPassInfo.dependencyCount = 1;
+    renderPassInfo.pDependencies = &lateDependency;
+
+    if (vkCreateRenderPass(device, &renderPassInfo, nullptr, &lateRenderPass) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create render pass!");
+    }
 }
 
 
@@ -646,20 +1001,28 @@ void VulkanMiragePathtracer::pickPhysicalDevice() {
     uint32_t deviceCount = 0;
     vkEnumeratePhysicalDevices(instance, &deviceCount, nullptr);
     if (deviceCount == 0) {
-        throw std::runtime_error("failed to find GPUs with Vulkan support!");
+        throw NoSuitableDeviceError("failed to find GPUs with Vulkan support!");
     }
     std::vector<VkPhysicalDevice> devices(deviceCount);
     vkEnumeratePhysicalDevices(instance, &deviceCount, devices.data());
 
     for (const auto &device: devices) {
-        if (isDeviceSuitable(device)) {
+        if (!isDeviceSuitable(device)) {
+            continue;
+        }
+        VkPhysicalDeviceProperties properties;
+        vkGetPhysicalDeviceProperties(device, &properties);
+        const bool isDiscreteGPU = properties.deviceType == VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU;
+        if (physicalDevice == VK_NULL_HANDLE || isDiscreteGPU) {
             physicalDevice = device;
+        }
+        if (isDiscreteGPU) {
             break;
         }
     }
 
     if (physicalDevice == VK_NULL_HANDLE) {
-        throw std::runtime_error("failed to find a suitable GPU!");
+        throw NoSuitableDeviceError("failed to find a suitable GPU!");
     }
 }
 
@@ -672,7 +1035,9 @@ void VulkanMiragePathtracer::createLogicalDevice() {
     queueCreateInfo.queueCount = 1;
 
     std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
-    std::set<uint32_t> uniqueQueueFamilies = {indices.graphicsFamily.value(), indices.presentFamily.value()};
+    std::set<uint32_t> uniqueQueueFamilies = {
+        indices.graphicsFamily.value(), indices.presentFamily.value(), indices.computeFamily.value()
+    };
 
     float queuePriority = 1.0f;
     for (uint32_t queueFamily: uniqueQueueFamilies) {
@@ -690,8 +1055,12 @@ void VulkanMiragePathtracer::createLogicalDevice() {
     VkPhysicalDeviceAccelerationStructureFeaturesKHR accelerationFeatures{};
     VkPhysicalDeviceRayTracingPipelineFeaturesKHR rayTracingFeatures{};
     VkPhysicalDeviceBufferDeviceAddressFeatures bufferDeviceAddressFeatures{};
+    VkPhysicalDeviceTimelineSemaphoreFeatures timelineSemaphoreFeatures{};
+    VkPhysicalDeviceSynchronization2FeaturesKHR synchronization2Features{};
 
     bufferDeviceAddressFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_BUFFER_DEVICE_ADDRESS_FEATURES;
+    timelineSemaphoreFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES;
+    synchronization2Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SYNCHRONIZATION_2_FEATURES_KHR;
     rayTracingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_RAY_TRACING_PIPELINE_FEATURES_KHR;
     accelerationFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ACCELERATION_STRUCTURE_FEATURES_KHR;
 
@@ -701,25 +1070,30 @@ void VulkanMiragePathtracer::createLogicalDevice() {
 
     accelerationFeatures.pNext = &rayTracingFeatures;
     rayTracingFeatures.pNext = &bufferDeviceAddressFeatures;
+    bufferDeviceAddressFeatures.pNext = &timelineSemaphoreFeatures;
+    timelineSemaphoreFeatures.pNext = &synchronization2Features;
 
     vkGetPhysicalDeviceFeatures2(physicalDevice, &deviceFeatures2);
 
+    // Only the KHR ray tracing path is used, the NV extension is missing on non-NVIDIA devices and lavapipe
     std::vector<const char *> extensions = {
-        VK_KHR_SWAPCHAIN_EXTENSION_NAME,
         VK_KHR_ACCELERATION_STRUCTURE_EXTENSION_NAME,
         VK_KHR_RAY_TRACING_PIPELINE_EXTENSION_NAME,
         VK_KHR_DEFERRED_HOST_OPERATIONS_EXTENSION_NAME,
         VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME,
         VK_KHR_BUFFER_DEVICE_ADDRESS_EXTENSION_NAME,
         VK_KHR_SPIRV_1_4_EXTENSION_NAME,
-        VK_NV_RAY_TRACING_EXTENSION_NAME,
-        VK_KHR_SHADER_FLOAT_CONTROLS_EXTENSION_NAME
+        VK_KHR_SHADER_FLOAT_CONTROLS_EXTENSION_NAME,
+        VK_KHR_SYNCHRONIZATION_2_EXTENSION_NAME
     };
+    if (!headless) {
+        extensions.push_back(VK_KHR_SWAPCHAIN_EXTENSION_NAME);
+        // The raster pass draws every instance with vkCmdDrawIndexedIndirectCount
+        extensions.push_back(VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME);
+    }
 
-    deviceFeatures2.features.sparseBinding = VK_TRUE; // Enable sparse binding
-    deviceFeatures2.features.sparseResidencyBuffer = VK_TRUE; // Enable residency
-    deviceFeatures2.features.sparseResidencyImage2D = VK_TRUE;
-    deviceFeatures2.features.sparseResidencyImage3D = VK_TRUE;
+    // The queried features are enabled as they are. Sparse residency is not used, forcing it on fails device
+    // creation where it is missing.
 
     VkDeviceCreateInfo createInfo{};
     createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
@@ -729,6 +1103,9 @@ void VulkanMiragePathtracer::createLogicalDevice() {
     createInfo.pEnabledFeatures = nullptr;
 
     bufferDeviceAddressFeatures.bufferDeviceAddress = VK_TRUE;
+    // The frame scheduler submits with vkQueueSubmit2 and synchronizes on a timeline semaphore
+    timelineSemaphoreFeatures.timelineSemaphore = VK_TRUE;
+    synchronization2Features.synchronization2 = VK_TRUE;
 
 
     createInfo.enabledExtensionCount = extensions.size();
@@ -747,6 +1124,10 @@ void VulkanMiragePathtracer::createLogicalDevice() {
 
     vkGetDeviceQueue(device, indices.presentFamily.value(), 0, &presentQueue);
     vkGetDeviceQueue(device, indices.graphicsFamily.value(), 0, &graphicsQueue);
+    vkGetDeviceQueue(device, indices.computeFamily.value(), 0, &computeQueue);
+    graphicsQueueFamily = indices.graphicsFamily.value();
+    computeQueueFamily = indices.computeFamily.value();
+    sharedQueueFamilies = {graphicsQueueFamily, computeQueueFamily};
 }
 
 void VulkanMiragePathtracer::createGraphicsPipeline() {
@@ -921,41 +1302,46 @@ bool VulkanMiragePathtracer::isDeviceSuitable(VkPhysicalDevice device) {
         VK_KHR_SHADER_FLOAT_CONTROLS_EXTENSION_NAME
     };
 
-    const std::vector<const char *> deviceExtensions = {
-        VK_KHR_SWAPCHAIN_EXTENSION_NAME,
+    std::vector<const char *> deviceExtensions = {
+        VK_KHR_SYNCHRONIZATION_2_EXTENSION_NAME,
     };
+    if (!headless) {
+        deviceExtensions.push_back(VK_KHR_SWAPCHAIN_EXTENSION_NAME);
+        deviceExtensions.push_back(VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME);
+    }
 
-    VkPhysicalDeviceProperties deviceProperties;
     VkPhysicalDeviceFeatures2 deviceFeatures2{};
 
     VkPhysicalDeviceAccelerationStructureFeaturesKHR accelerationFeatures{};
     VkPhysicalDeviceRayTracingPipelineFeaturesKHR rayTracingFeatures{};
+    VkPhysicalDeviceTimelineSemaphoreFeatures timelineSemaphoreFeatures{};
+    VkPhysicalDeviceSynchronization2FeaturesKHR synchronization2Features{};
 
     rayTracingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_RAY_TRACING_PIPELINE_FEATURES_KHR;
     accelerationFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ACCELERATION_STRUCTURE_FEATURES_KHR;
+    timelineSemaphoreFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES;
+    synchronization2Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SYNCHRONIZATION_2_FEATURES_KHR;
 
     deviceFeatures2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
     deviceFeatures2.pNext = &accelerationFeatures;
     accelerationFeatures.pNext = &rayTracingFeatures;
+    rayTracingFeatures.pNext = &timelineSemaphoreFeatures;
+    timelineSemaphoreFeatures.pNext = &synchronization2Features;
 
 
-    vkGetPhysicalDeviceProperties(device, &deviceProperties);
     vkGetPhysicalDeviceFeatures2(device, &deviceFeatures2);
 
     VkPhysicalDeviceFeatures supportedFeatures;
     vkGetPhysicalDeviceFeatures(device, &supportedFeatures);
 
-    // Checking for Discrete GPU
-    bool isDiscreteGPU = deviceProperties.deviceType == VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU;
-
     // Checking for ray tracing support
     bool isRayTracingSupported = checkDeviceExtensionSupport(device, ray_tracing_extensions);
 
     bool extensionsSupported = checkDeviceExtensionSupport(device, deviceExtensions);
 
     bool swapChainAdequate = false;
-    if (extensionsSupported) {
-        SwapChainSupportDetails swapChainSupport = querySwapChainSupport(device);
+    if (extensionsSupported && !headless) {
+        SwapChainSupportDetails swapChainSupport = querySwapChainSupport(device, surface);
         swapChainAdequate = !swapChainSupport.formats.empty() && !swapChainSupport.presentModes.empty();
     }
 
@@ -963,9 +1349,19 @@ bool VulkanMiragePathtracer::isDeviceSuitable(VkPhysicalDevice device) {
         isRayTracingSupported = false;
     }
 
-    return deviceFeatures2.features.sparseResidencyBuffer && isDiscreteGPU && isRayTracingSupported &&
-           findQueueFamilies(device).isComplete() && extensionsSupported &&
-           swapChainAdequate && supportedFeatures.samplerAnisotropy;
+    if (!timelineSemaphoreFeatures.timelineSemaphore || !synchronization2Features.synchronization2) {
+        extensionsSupported = false;
+    }
+
+    // Headless runs only trace and read back, on render nodes and on software implementations like lavapipe
+    if (headless) {
+        return isRayTracingSupported && findQueueFamilies(device).isComplete() && extensionsSupported;
+    }
+
+    // Integrated GPUs with ray tracing qualify as well, pickPhysicalDevice still prefers a discrete one
+    return isRayTracingSupported && findQueueFamilies(device).isComplete() && extensionsSupported &&
+           swapChainAdequate && supportedFeatures.samplerAnisotropy && supportedFeatures.multiDrawIndirect &&
+           supportedFeatures.drawIndirectFirstInstance;
 }
 
 void VulkanMiragePathtracer::initImgui() {
@@ -1015,8 +1411,13 @@ QueueFamilyIndices VulkanMiragePathtracer::findQueueFamilies(VkPhysicalDevice de
             indices.graphicsFamily = i;
         }
 
+        // Nothing is presented headless, the graphics family stands in so the device setup stays the same
         VkBool32 presentSupport = false;
-        vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface, &presentSupport);
+        if (headless) {
+            presentSupport = (queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT) != 0;
+        } else {
+            vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface, &presentSupport);
+        }
 
         if (presentSupport) {
             indices.presentFamily = i;
@@ -1029,6 +1430,21 @@ QueueFamilyIndices VulkanMiragePathtracer::findQueueFamilies(VkPhysicalDevice de
         i++;
     }
 
+    // A family with compute but without graphics usually maps to separate hardware queues, so tracing there
+    // overlaps with the raster work instead of being serialized behind it
+    if (config.asyncCompute) {
+        for (uint32_t family = 0; family < queueFamilyCount; family++) {
+            const VkQueueFlags flags = queueFamilies[family].queueFlags;
+            if ((flags & VK_QUEUE_COMPUTE_BIT) && !(flags & VK_QUEUE_GRAPHICS_BIT)) {
+                indices.computeFamily = family;
+                break;
+            }
+        }
+    }
+    if (!indices.computeFamily.has_value()) {
+        indices.computeFamily = indices.graphicsFamily;
+    }
+
     return indices;
 }
 
@@ -1076,7 +1492,7 @@ VkFormat VulkanMiragePathtracer::findDepthFormat() {
     return findSupportedFormat(
         {VK_FORMAT_D32_SFLOAT, VK_FORMAT_D32_SFLOAT_S8_UINT, VK_FORMAT_D24_UNORM_S8_UINT},
         VK_IMAGE_TILING_OPTIMAL,
-        VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT
+        VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT
     );
 }
 
@@ -1139,25 +1555,27 @@ void VulkanMiragePathtracer::DestroyDebugUtilsMessengerEXT(VkInstance instance,
     }
 }
 
-SwapChainSupportDetails VulkanMiragePathtracer::querySwapChainSupport(VkPhysicalDevice device) {
+SwapChainSupportDetails VulkanMiragePathtracer::querySwapChainSupport(VkPhysicalDevice device,
+                                                                      VkSurfaceKHR presentSurface) {
     SwapChainSupportDetails details;
 
-    vkGetPhysicalDeviceSurfaceCapabilitiesKHR(device, surface, &details.capabilities);
+    vkGetPhysicalDeviceSurfaceCapabilitiesKHR(device, presentSurface, &details.capabilities);
 
     uint32_t formatCount;
-    vkGetPhysicalDeviceSurfaceFormatsKHR(device, surface, &formatCount, nullptr);
+    vkGetPhysicalDeviceSurfaceFormatsKHR(device, presentSurface, &formatCount, nullptr);
 
     if (formatCount != 0) {
         details.formats.resize(formatCount);
-        vkGetPhysicalDeviceSurfaceFormatsKHR(device, surface, &formatCount, details.formats.data());
+        vkGetPhysicalDeviceSurfaceFormatsKHR(device, presentSurface, &formatCount, details.formats.data());
     }
 
     uint32_t presentModeCount;
-    vkGetPhysicalDeviceSurfacePresentModesKHR(device, surface, &presentModeCount, nullptr);
+    vkGetPhysicalDeviceSurfacePresentModesKHR(device, presentSurface, &presentModeCount, nullptr);
 
     if (presentModeCount != 0) {
         details.presentModes.resize(presentModeCount);
-        vkGetPhysicalDeviceSurfacePresentModesKHR(device, surface, &presentModeCount, details.presentModes.data());
+        vkGetPhysicalDeviceSurfacePresentModesKHR(device, presentSurface, &presentModeCount,
+                                                  details.presentModes.data());
     }
     return details;
 }
@@ -1176,13 +1594,30 @@ VkSurfaceFormatKHR VulkanMiragePathtracer::chooseSwapSurfaceFormat(
 
 VkPresentModeKHR VulkanMiragePathtracer::chooseSwapPresentMode(
     const std::vector<VkPresentModeKHR> &availablePresentModes) {
-    /*for (const auto &availablePresentMode: availablePresentModes) {
-        if (availablePresentMode == VK_PRESENT_MODE_MAILBOX_KHR) {
-            return availablePresentMode;
-        }
-    }*/
+    VkPresentModeKHR requested = VK_PRESENT_MODE_FIFO_KHR;
+    switch (presentMode) {
+        case PresentMode::Fifo:
+            requested = VK_PRESENT_MODE_FIFO_KHR;
+            break;
+        case PresentMode::FifoRelaxed:
+            requested = VK_PRESENT_MODE_FIFO_RELAXED_KHR;
+            break;
+        case PresentMode::Mailbox:
+            requested = VK_PRESENT_MODE_MAILBOX_KHR;
+            break;
+        case PresentMode::Immediate:
+            requested = VK_PRESENT_MODE_IMMEDIATE_KHR;
+            break;
+    }
 
-    return VK_PRESENT_MODE_FIFO_KHR;
+    // FIFO is the only mode every surface has to support
+    activePresentMode = VK_PRESENT_MODE_FIFO_KHR;
+    for (const auto &availablePresentMode: availablePresentModes) {
+        if (availablePresentMode == requested) {
+            activePresentMode = availablePresentMode;
+        }
+    }
+    return activePresentMode;
 }
 
 VkExtent2D VulkanMiragePathtracer::chooseSwapExtent(const VkSurfaceCapabilitiesKHR &capabilities, SDL_Window *window) {
@@ -1207,7 +1642,7 @@ VkExtent2D VulkanMiragePathtracer::chooseSwapExtent(const VkSurfaceCapabilitiesK
 }
 
 void VulkanMiragePathtracer::createSwapChain() {
-    SwapChainSupportDetails swapChainSupport = querySwapChainSupport(physicalDevice);
+    SwapChainSupportDetails swapChainSupport = querySwapChainSupport(physicalDevice, surface);
 
     VkSurfaceFormatKHR surfaceFormat = chooseSwapSurfaceFormat(swapChainSupport.formats);
     VkPresentModeKHR presentMode = chooseSwapPresentMode(swapChainSupport.presentModes);
@@ -1228,7 +1663,8 @@ void VulkanMiragePathtracer::createSwapChain() {
     createInfo.imageColorSpace = surfaceFormat.colorSpace;
     createInfo.imageExtent = extent;
     createInfo.imageArrayLayers = 1;
-    createInfo.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+    // The visibility buffer blits its shaded image in
+    createInfo.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
 
     QueueFamilyIndices indices = findQueueFamilies(physicalDevice);
     uint32_t queueFamilyIndices[] = {indices.graphicsFamily.value(), indices.presentFamily.value()};
@@ -1247,7 +1683,8 @@ void VulkanMiragePathtracer::createSwapChain() {
     createInfo.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
     createInfo.presentMode = presentMode;
     createInfo.clipped = VK_TRUE;
-    createInfo.oldSwapchain = VK_NULL_HANDLE;
+    // The previous swap chain (if any) stays alive until retired, this lets in-flight images finish presenting
+    createInfo.oldSwapchain = swapChain;
 
     if (vkCreateSwapchainKHR(device, &createInfo, nullptr, &swapChain) != VK_SUCCESS) {
         throw std::runtime_error("failed to create swap chain!");
@@ -1262,13 +1699,12 @@ void VulkanMiragePathtracer::createSwapChain() {
 }
 
 void VulkanMiragePathtracer::createSwapChain2() {
-    SwapChainSupportDetails swapChainSupport = querySwapChainSupport(physicalDevice);
+    SwapChainSupportDetails swapChainSupport = querySwapChainSupport(physicalDevice, surface2);
 
     VkSurfaceFormatKHR surfaceFormat = chooseSwapSurfaceFormat(swapChainSupport.formats);
     VkPresentModeKHR presentMode = chooseSwapPresentMode(swapChainSupport.presentModes);
-    VkExtent2D extent {};
-    extent.height = 800;
-    extent.width = 800;
+    // Follows the window, the trace is resized with it
+    VkExtent2D extent = chooseSwapExtent(swapChainSupport.capabilities, window2);
     uint32_t imageCount = swapChainSupport.capabilities.minImageCount + 1;
 
     if (swapChainSupport.capabilities.maxImageCount > 0 && imageCount > swapChainSupport.capabilities.maxImageCount) {
@@ -1303,7 +1739,8 @@ void VulkanMiragePathtracer::createSwapChain2() {
     createInfo.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
     createInfo.presentMode = presentMode;
     createInfo.clipped = VK_TRUE;
-    createInfo.oldSwapchain = VK_NULL_HANDLE;
+    // The old swapchain, if any, is retired by the caller once the frames still presenting from it are done
+    createInfo.oldSwapchain = raycastingSwapChain;
 
     VK_CHECK_RESULT(vkCreateSwapchainKHR(device, &createInfo, nullptr, &raycastingSwapChain))
 
@@ -1321,7 +1758,7 @@ void VulkanMiragePathtracer::createFramebuffers() {
     for (size_t i = 0; i < swapChainImageViews.size(); i++) {
         std::array<VkImageView, 2> attachments = {
             swapChainImageViews[i],
-            depthImageView
+            depthImage.view
         };
 
         VkFramebufferCreateInfo framebufferInfo{};
@@ -1353,16 +1790,20 @@ void VulkanMiragePathtracer::createCommandPool() {
 }
 
 void VulkanMiragePathtracer::createCommandPool2() {
-    QueueFamilyIndices queueFamilyIndices = findQueueFamilies(physicalDevice);
-
     VkCommandPoolCreateInfo poolInfo{};
     poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
     poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
-    poolInfo.queueFamilyIndex = queueFamilyIndices.graphicsFamily.value();
+    poolInfo.queueFamilyIndex = computeQueueFamily;
 
     if (vkCreateCommandPool(device, &poolInfo, nullptr, &raytracingCommandPool) != VK_SUCCESS) {
         throw std::runtime_error("failed to create command pool!");
     }
+
+    // The swapchain images belong to the graphics family, the copy into them stays there
+    poolInfo.queueFamilyIndex = graphicsQueueFamily;
+    if (vkCreateCommandPool(device, &poolInfo, nullptr, &raytracingCopyCommandPool) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create command pool!");
+    }
 }
 
 void VulkanMiragePathtracer::createTextureImage() {
@@ -1388,13 +1829,13 @@ void VulkanMiragePathtracer::createTextureImage() {
 
     stbi_image_free(pixels);
 
-    createImage(texWidth, texHeight, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_TILING_OPTIMAL,
-                VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-                textureImage, textureImageMemory);
-    transitionImageLayout(textureImage, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_LAYOUT_UNDEFINED,
+    textureImage = createVksImage(texWidth, texHeight, VK_FORMAT_R8G8B8A8_SRGB,
+                                  VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT);
+    transitionImageLayout(textureImage.image, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_LAYOUT_UNDEFINED,
                           VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
-    copyBufferToImage(stagingBuffer, textureImage, static_cast<uint32_t>(texWidth), static_cast<uint32_t>(texHeight));
-    transitionImageLayout(textureImage, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+    copyBufferToImage(stagingBuffer, textureImage.image, static_cast<uint32_t>(texWidth),
+                      static_cast<uint32_t>(texHeight));
+    transitionImageLayout(textureImage.image, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
                           VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
 
     vkDestroyBuffer(device, stagingBuffer, nullptr);
@@ -1411,35 +1852,104 @@ void VulkanMiragePathtracer::check_vk_result(VkResult err) {
 
 
 void VulkanMiragePathtracer::createCommandBuffers() {
-    commandBuffers.resize(MAX_FRAMES_IN_FLIGHT);
-
-    VkCommandBufferAllocateInfo allocInfo{};
-    allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-    allocInfo.commandPool = commandPool;
-    allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-    allocInfo.commandBufferCount = (uint32_t) commandBuffers.size();
-
-    if (vkAllocateCommandBuffers(device, &allocInfo, commandBuffers.data()) != VK_SUCCESS) {
-        throw std::runtime_error("failed to allocate command buffers!");
-    }
+    // Frame recording gets its own pools per frame slot, commandPool is left to one-time commands. Every raster list
+    // is a single indirect draw and records on the calling thread, so one thread and one pool per slot are enough.
+    jobSystem = std::make_unique<JobSystem>(1);
+    QueueFamilyIndices queueFamilyIndices = findQueueFamilies(physicalDevice);
+    rasterRecorder = std::make_unique<ParallelCommandRecorder>(device, queueFamilyIndices.graphicsFamily.value(),
+                                                               MAX_FRAMES_IN_FLIGHT, *jobSystem);
 }
 
 
 void VulkanMiragePathtracer::recordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t imageIndex) {
     VkCommandBufferBeginInfo beginInfo{};
     beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
 
     if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS) {
         throw std::runtime_error("failed to begin recording command buffer!");
     }
 
+    // The visibility buffer draws the same lists, only into its ID image instead of the swapchain image
+    const bool useVisibilityBuffer = rasterMode == RasterMode::VisibilityBuffer;
+    const VkPipeline pipeline = useVisibilityBuffer ? visibilityBuffer->getPipeline() : graphicsPipeline;
+
+    VkCommandBufferInheritanceInfo inheritanceInfo{};
+    inheritanceInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+    inheritanceInfo.renderPass = useVisibilityBuffer ? visibilityBuffer->getRenderPass() : renderPass;
+    inheritanceInfo.subpass = 0;
+    inheritanceInfo.framebuffer = useVisibilityBuffer
+                                      ? visibilityBuffer->getFramebuffer()
+                                      : swapChainFramebuffers[imageIndex];
+
+    // Two passes around the depth pyramid: the first draws what the previous frame's depth shows, the second
+    // what this frame's depth uncovered. Each list is a single indirect draw, recording costs the same for any
+    // number of instances.
+    const uint32_t instanceCount = static_cast<uint32_t>(sceneInstances.size());
+    rasterRecorder->recordOnCallingThread(inheritanceInfo, [&](VkCommandBuffer secondary) {
+        recordRasterDraws(secondary, pipeline, OcclusionCuller::Phase::Visible);
+    });
+    occlusionCuller->recordFirstPhase(commandBuffer, currentFrame, rasterViewProjection, instanceCount);
+
+    if (useVisibilityBuffer) {
+        visibilityBuffer->beginRenderPass(commandBuffer, OcclusionCuller::Phase::Visible);
+    } else {
+        beginRasterRenderPass(commandBuffer, renderPass, imageIndex);
+    }
+    vkCmdExecuteCommands(commandBuffer, 1, rasterRecorder->getSecondaries().data());
+    vkCmdEndRenderPass(commandBuffer);
+
+    occlusionCuller->recordSecondPhase(commandBuffer, currentFrame, rasterViewProjection, instanceCount);
+
+    if (!useVisibilityBuffer) {
+        inheritanceInfo.renderPass = lateRenderPass;
+    }
+    rasterRecorder->recordOnCallingThread(inheritanceInfo, [&](VkCommandBuffer secondary) {
+        recordRasterDraws(secondary, pipeline, OcclusionCuller::Phase::Disoccluded);
+    });
+
+    // With the IDs complete every pixel is shaded once, however many triangles were drawn over it. The result
+    // lands in the swapchain image and the late pass below only adds the UI.
+    uint32_t firstLateSecondary = 1;
+    if (useVisibilityBuffer) {
+        visibilityBuffer->beginRenderPass(commandBuffer, OcclusionCuller::Phase::Disoccluded);
+        vkCmdExecuteCommands(commandBuffer, 1, rasterRecorder->getSecondaries().data() + 1);
+        vkCmdEndRenderPass(commandBuffer);
+
+        visibilityBuffer->recordResolve(commandBuffer, currentFrame, visibilityOutput, swapChainImages[imageIndex],
+                                        swapChainExtent);
+        inheritanceInfo.renderPass = lateRenderPass;
+        inheritanceInfo.framebuffer = swapChainFramebuffers[imageIndex];
+        firstLateSecondary = 2;
+    }
+
+    // ImGui draw data is recorded after the scene
+    ImGui::Render();
+    rasterRecorder->recordOnCallingThread(inheritanceInfo, [&](VkCommandBuffer secondary) {
+        ImGui_ImplVulkan_RenderDrawData(ImGui::GetDrawData(), secondary);
+    });
+
+    const std::vector<VkCommandBuffer> &secondaries = rasterRecorder->getSecondaries();
+    beginRasterRenderPass(commandBuffer, lateRenderPass, imageIndex);
+    vkCmdExecuteCommands(commandBuffer, static_cast<uint32_t>(secondaries.size() - firstLateSecondary),
+                         secondaries.data() + firstLateSecondary);
+    vkCmdEndRenderPass(commandBuffer);
+
+    if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
+        throw std::runtime_error("failed to record command buffer!");
+    }
+}
+
+void VulkanMiragePathtracer::beginRasterRenderPass(VkCommandBuffer commandBuffer, VkRenderPass pass,
+                                                   uint32_t imageIndex) {
     VkRenderPassBeginInfo renderPassInfo{};
     renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-    renderPassInfo.renderPass = renderPass;
+    renderPassInfo.renderPass = pass;
     renderPassInfo.framebuffer = swapChainFramebuffers[imageIndex];
     renderPassInfo.renderArea.offset = {0, 0};
     renderPassInfo.renderArea.extent = swapChainExtent;
 
+    // Only the first pass clears, the late pass ignores the values
     std::array<VkClearValue, 2> clearValues{};
     clearValues[0].color = {{0.0f, 0.0f, 0.0f, 1.0f}};
     clearValues[1].depthStencil = {1.0f, 0};
@@ -1447,9 +1957,13 @@ void VulkanMiragePathtracer::recordCommandBuffer(VkCommandBuffer commandBuffer,
     renderPassInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
     renderPassInfo.pClearValues = clearValues.data();
 
-    vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+    // Everything inside the render pass comes from secondary buffers, the draws are recorded in parallel
+    vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+}
 
-    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline);
+void VulkanMiragePathtracer::recordRasterDraws(VkCommandBuffer commandBuffer, VkPipeline pipeline,
+                                               OcclusionCuller::Phase phase) {
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
 
     VkViewport viewport{};
     viewport.x = 0.0f;
@@ -1465,212 +1979,250 @@ void VulkanMiragePathtracer::recordCommandBuffer(VkCommandBuffer commandBuffer,
     scissor.extent = swapChainExtent;
     vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
 
-    VkBuffer vertexBuffers[] = {vertexBuffer};
+    VkBuffer vertexBuffers[] = {vertexBuffer.buffer};
     VkDeviceSize offsets[] = {0};
     vkCmdBindVertexBuffers(commandBuffer, 0, 1, vertexBuffers, offsets);
 
-    vkCmdBindIndexBuffer(commandBuffer, indexBuffer, 0, VK_INDEX_TYPE_UINT32);
+    vkCmdBindIndexBuffer(commandBuffer, indexBuffer.buffer, 0, VK_INDEX_TYPE_UINT32);
 
     vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1,
                             &descriptorSets[currentFrame], 0, nullptr);
 
-    vkCmdDrawIndexed(commandBuffer, static_cast<uint32_t>(model->meshes[0].get()->indices.size()), 1, 0, 0, 0);
-
-    // Rendering
-    // (Your code clears your framebuffer, renders your other stuff etc.)
-    ImGui::Render(); //I hope it's correct
-    ImGui_ImplVulkan_RenderDrawData(ImGui::GetDrawData(), commandBuffers[currentFrame]);
-    // (Your code calls vkCmdEndRenderPass, vkQueueSubmit, vkQueuePresentKHR etc.)
+    // Commands and count are written by the cull shader, the CPU never learns how many instances are visible
+    const OcclusionCuller::IndirectDraws draws = occlusionCuller->getDraws(currentFrame, phase);
+    vkCmdDrawIndexedIndirectCountKHR(commandBuffer, draws.commands, draws.commandOffset, draws.count,
+                                     draws.countOffset, draws.maxDrawCount, sizeof(VkDrawIndexedIndirectCommand));
+}
 
-    vkCmdEndRenderPass(commandBuffer);
+void VulkanMiragePathtracer::acquireFrame() {
+    // Waits on the timeline until the frame that last used this slot is done, for both outputs at once
+    currentFrame = frameScheduler->beginFrame(deletionQueue.currentFrame());
+
+    // A minimized window has no extent to create a swapchain with, it is skipped until it is restored. An out of
+    // date swapchain only skips its own window, the other one still gets its frame.
+    rasterImageAcquired = false;
+    if (!isMinimized) {
+        const VkResult result = vkAcquireNextImageKHR(device, swapChain, UINT64_MAX,
+                                                      imageAvailableSemaphores[currentFrame], VK_NULL_HANDLE,
+                                                      &acquiredImageIndex);
+        if (result == VK_ERROR_OUT_OF_DATE_KHR) {
+            recreateSwapChain();
+        } else if (result == VK_SUCCESS || result == VK_SUBOPTIMAL_KHR) {
+            rasterImageAcquired = true;
+        } else {
+            throw std::runtime_error("failed to acquire swap chain image!");
+        }
+    }
 
-    if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
-        throw std::runtime_error("failed to record command buffer!");
+    raytracingImageAcquired = false;
+    if (!raytracingWindowMinimized) {
+        const VkResult result = vkAcquireNextImageKHR(device, raycastingSwapChain, UINT64_MAX,
+                                                      imageAvailableSemaphores2[currentFrame], VK_NULL_HANDLE,
+                                                      &acquiredRaytracingImageIndex);
+        if (result == VK_ERROR_OUT_OF_DATE_KHR) {
+            recreateRaytracingSwapChain();
+        } else if (result == VK_SUCCESS || result == VK_SUBOPTIMAL_KHR) {
+            raytracingImageAcquired = true;
+        } else {
+            throw std::runtime_error("failed to acquire swap chain image!");
+        }
     }
 }
 
 void VulkanMiragePathtracer::drawFrame() {
-    vkWaitForFences(device, 1, &inFlightFences[currentFrame], VK_TRUE, UINT64_MAX);
-
-    uint32_t imageIndex;
-    VkResult result = vkAcquireNextImageKHR(device, swapChain, UINT64_MAX, imageAvailableSemaphores[currentFrame],
-                                            VK_NULL_HANDLE, &imageIndex);
-
-    if (result == VK_ERROR_OUT_OF_DATE_KHR) {
-        recreateSwapChain();
-        return;
-    } else if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR) {
-        throw std::runtime_error("failed to acquire swap chain image!");
+    const bool drawRaster = rasterImageAcquired;
+    const bool drawRaytracing = raytracingImageAcquired;
+    const uint32_t imageIndex = acquiredImageIndex;
+    const uint32_t raytracingImageIndex = acquiredRaytracingImageIndex;
+
+    // Uniforms are written right before recording, the input they are built from is as recent as possible.
+    // Uploads are host coherent writes, they are visible to everything submitted below
+    VkCommandBuffer rasterCommandBuffer = VK_NULL_HANDLE;
+    if (drawRaster) {
+        updateUniformBuffer(currentFrame);
+        if (rasterDrawRecordsDirty[currentFrame]) {
+            writeRasterDrawRecords(currentFrame);
+        }
+        // The slot's previous frame has completed, its counters are final until the first phase resets them
+        cullStats = occlusionCuller->readStats(currentFrame);
+        rasterCommandBuffer = rasterRecorder->beginFrame(currentFrame);
+        recordCommandBuffer(rasterCommandBuffer, imageIndex);
+    } else {
+        // The UI is rendered by the raster pass, without it the frame still has to be ended
+        ImGui::EndFrame();
     }
 
-    updateUniformBuffer(currentFrame);
-
-    vkResetFences(device, 1, &inFlightFences[currentFrame]);
-
-
-    vkResetCommandBuffer(commandBuffers[currentFrame], /*VkCommandBufferResetFlagBits*/ 0);
-    recordCommandBuffer(commandBuffers[currentFrame], imageIndex);
-
-
-    VkSubmitInfo submitInfo{};
-    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-
-    VkSemaphore waitSemaphores[] = {imageAvailableSemaphores[currentFrame]};
-    VkPipelineStageFlags waitStages[] = {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
-    submitInfo.waitSemaphoreCount = 1;
-    submitInfo.pWaitSemaphores = waitSemaphores;
-    submitInfo.pWaitDstStageMask = waitStages;
-
-    submitInfo.commandBufferCount = 1;
+    // Growing the TLAS replaces its handle and rewrites the descriptor sets, which marks the pre-recorded trace
+    // dirty. It has to happen before the dirty check, or the trace below would still reference the retired TLAS.
+    VkCommandBuffer tlasCommandBuffer = updateTopLevelAccelerationStructure(currentFrame);
 
-        submitInfo.pCommandBuffers = &commandBuffers[currentFrame];
-       // submitInfo.pCommandBuffers = &drawCmdBuffers[currentFrame];
-    
-
-    VkSemaphore signalSemaphores[] = {renderFinishedSemaphores[currentFrame]};
-    submitInfo.signalSemaphoreCount = 1;
-    submitInfo.pSignalSemaphores = signalSemaphores;
-
-    if (vkQueueSubmit(graphicsQueue, 1, &submitInfo, inFlightFences[currentFrame]) != VK_SUCCESS) {
-        throw std::runtime_error("failed to submit draw command buffer!");
+    // The trace itself is pre-recorded, it only has to be recorded again after its bindings or its size changed.
+    // A resized slot has a new storage image, the uniforms below already use its aspect ratio.
+    if (drawRaytracing) {
+        if (raytracingCommandBuffersDirty[currentFrame]) {
+            recordRaytracingCommandBuffers(currentFrame);
+        }
+        updateUniformBuffers(currentFrame);
     }
 
-    VkPresentInfoKHR presentInfo{};
-    presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
-
-    presentInfo.waitSemaphoreCount = 1;
-    presentInfo.pWaitSemaphores = signalSemaphores;
-
-    VkSwapchainKHR swapChains[] = {swapChain};
-    presentInfo.swapchainCount = 1;
-    presentInfo.pSwapchains = swapChains;
-
-    presentInfo.pImageIndices = &imageIndex;
-
-    result = vkQueuePresentKHR(presentQueue, &presentInfo);
-
-    if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR || framebufferResized) {
-        framebufferResized = false;
-        recreateSwapChain();
-    } else if (result != VK_SUCCESS) {
-        throw std::runtime_error("failed to present swap chain image!");
+    // Acceleration structure update and trace run on the compute queue, which is the graphics queue when the
+    // device has no separate compute family
+    FrameScheduler::Pass accelerationStructurePass{};
+    accelerationStructurePass.name = "acceleration structure update";
+    accelerationStructurePass.queue = computeQueueSlot;
+    if (tlasCommandBuffer != VK_NULL_HANDLE) {
+        accelerationStructurePass.commandBuffers.push_back(tlasCommandBuffer);
     }
-
-    currentFrame = (currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
-}
-void VulkanMiragePathtracer::drawFrame2() {
-    vkWaitForFences(device, 1, &inFlightFences2[currentFrame2], VK_TRUE, UINT64_MAX);
-
-    uint32_t imageIndex;
-    VkResult result = vkAcquireNextImageKHR(device, raycastingSwapChain, UINT64_MAX, imageAvailableSemaphores2[currentFrame2],
-                                            VK_NULL_HANDLE, &imageIndex);
-    if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR) {
-        throw std::runtime_error("failed to acquire swap chain image!");
+    const uint32_t accelerationStructurePassIndex = frameScheduler->addPass(std::move(accelerationStructurePass));
+
+    // The trace can run before the image is acquired, only the copy into it has to wait
+    uint32_t tracePassIndex = 0;
+    if (drawRaytracing) {
+        FrameScheduler::Pass tracePass{};
+        tracePass.name = "trace";
+        tracePass.queue = computeQueueSlot;
+        tracePass.commandBuffers = {traceCmdBuffers[currentFrame].handle};
+        tracePass.dependencies = {accelerationStructurePassIndex};
+        tracePassIndex = frameScheduler->addPass(std::move(tracePass));
     }
 
-    vkResetFences(device, 1, &inFlightFences2[currentFrame2]);
-    
-    vkResetCommandBuffer(drawCmdBuffers[currentFrame2], /*VkCommandBufferResetFlagBits*/ 0);
-    buildCommandBuffers();
-
-    VkSubmitInfo submitInfo{};
-    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-    submitInfo.commandBufferCount = 1;
-    submitInfo.pCommandBuffers = &drawCmdBuffers[currentFrame2];
-    
-    VkSemaphore waitSemaphores[] = {imageAvailableSemaphores2[currentFrame2]};
-    VkPipelineStageFlags waitStages[] = {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
-    submitInfo.waitSemaphoreCount = 1;
-    submitInfo.pWaitSemaphores = waitSemaphores;
-    submitInfo.pWaitDstStageMask = waitStages;
-
-    submitInfo.commandBufferCount = 1;
-
-        submitInfo.pCommandBuffers = &drawCmdBuffers[currentFrame2];
-    
-    
+    // Raster and UI do not depend on the ray traced output, they only wait for their own swapchain image and
+    // overlap with the trace
+    if (drawRaster) {
+        FrameScheduler::Pass rasterPass{};
+        rasterPass.name = "raster and ui";
+        rasterPass.queue = graphicsQueueSlot;
+        rasterPass.commandBuffers = {rasterCommandBuffer};
+        rasterPass.waits = {
+            FrameScheduler::semaphoreInfo(imageAvailableSemaphores[currentFrame],
+                                          VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT)
+        };
+        rasterPass.signals = {
+            FrameScheduler::semaphoreInfo(renderFinishedSemaphores[currentFrame],
+                                          VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT)
+        };
+        frameScheduler->addPass(std::move(rasterPass));
+    }
 
-    VkSemaphore signalSemaphores[] = {renderFinishedSemaphores2[currentFrame2]};
-    submitInfo.signalSemaphoreCount = 1;
-    submitInfo.pSignalSemaphores = signalSemaphores;
+    if (drawRaytracing) {
+        // The swapchain images belong to the graphics family, the copy acquires the storage image from the trace
+        FrameScheduler::Pass copyPass{};
+        copyPass.name = "ray traced output copy";
+        copyPass.queue = graphicsQueueSlot;
+        copyPass.commandBuffers = {
+            drawCmdBuffers[raytracingCommandBufferIndex(currentFrame, raytracingImageIndex)].handle
+        };
+        copyPass.dependencies = {tracePassIndex};
+        copyPass.waits = {
+            FrameScheduler::semaphoreInfo(imageAvailableSemaphores2[currentFrame], VK_PIPELINE_STAGE_2_TRANSFER_BIT)
+        };
+        copyPass.signals = {
+            FrameScheduler::semaphoreInfo(renderFinishedSemaphores2[currentFrame],
+                                          VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT)
+        };
+        frameScheduler->addPass(std::move(copyPass));
+    }
 
-    if (vkQueueSubmit(graphicsQueue, 1, &submitInfo, inFlightFences2[currentFrame2]) != VK_SUCCESS) {
-        throw std::runtime_error("failed to submit draw command buffer!");
+    frameScheduler->submit();
+    framePacer.markSubmitted(deletionQueue.currentFrame());
+
+    // Both windows are presented with one call
+    std::vector<VkSemaphore> presentWaitSemaphores;
+    std::vector<VkSwapchainKHR> presentSwapChains;
+    std::vector<uint32_t> presentImageIndices;
+    if (drawRaytracing) {
+        presentWaitSemaphores.push_back(renderFinishedSemaphores2[currentFrame]);
+        presentSwapChains.push_back(raycastingSwapChain);
+        presentImageIndices.push_back(raytracingImageIndex);
+    }
+    if (drawRaster) {
+        presentWaitSemaphores.push_back(renderFinishedSemaphores[currentFrame]);
+        presentSwapChains.push_back(swapChain);
+        presentImageIndices.push_back(imageIndex);
+    }
+    if (presentSwapChains.empty()) {
+        return;
     }
+    std::vector<VkResult> presentResults(presentSwapChains.size(), VK_SUCCESS);
 
     VkPresentInfoKHR presentInfo{};
     presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
-
-    presentInfo.waitSemaphoreCount = 1;
-    presentInfo.pWaitSemaphores = signalSemaphores;
-
-    VkSwapchainKHR swapChains[] = {raycastingSwapChain};
-    presentInfo.swapchainCount = 1;
-    presentInfo.pSwapchains = swapChains;
-
-    presentInfo.pImageIndices = &imageIndex;
-
-    result = vkQueuePresentKHR(presentQueue, &presentInfo);
-
-    currentFrame2 = (currentFrame2 + 1) % MAX_FRAMES_IN_FLIGHT;
+    presentInfo.waitSemaphoreCount = static_cast<uint32_t>(presentWaitSemaphores.size());
+    presentInfo.pWaitSemaphores = presentWaitSemaphores.data();
+    presentInfo.swapchainCount = static_cast<uint32_t>(presentSwapChains.size());
+    presentInfo.pSwapchains = presentSwapChains.data();
+    presentInfo.pImageIndices = presentImageIndices.data();
+    presentInfo.pResults = presentResults.data();
+
+    vkQueuePresentKHR(presentQueue, &presentInfo);
+    framePacer.markPresented(deletionQueue.currentFrame());
+
+    // Recreation retires the old swapchain and what was built on it, the images just presented stay valid until
+    // this frame has completed
+    if (drawRaytracing) {
+        const VkResult result = presentResults[0];
+        if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR || raytracingWindowResized) {
+            raytracingWindowResized = false;
+            recreateRaytracingSwapChain();
+        } else if (result != VK_SUCCESS) {
+            throw std::runtime_error("failed to present swap chain image!");
+        }
+    }
+    if (drawRaster) {
+        const VkResult result = presentResults.back();
+        if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR || framebufferResized) {
+            framebufferResized = false;
+            recreateSwapChain();
+        } else if (result != VK_SUCCESS) {
+            throw std::runtime_error("failed to present swap chain image!");
+        }
+    }
 }
 
 void VulkanMiragePathtracer::createSyncObjects() {
     imageAvailableSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
     renderFinishedSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
-    inFlightFences.resize(MAX_FRAMES_IN_FLIGHT);
 
     VkSemaphoreCreateInfo semaphoreInfo{};
     semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
 
-    VkFenceCreateInfo fenceInfo{};
-    fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-    fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
-
     for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
         if (vkCreateSemaphore(device, &semaphoreInfo, nullptr, &imageAvailableSemaphores[i]) != VK_SUCCESS ||
-            vkCreateSemaphore(device, &semaphoreInfo, nullptr, &renderFinishedSemaphores[i]) != VK_SUCCESS ||
-            vkCreateFence(device, &fenceInfo, nullptr, &inFlightFences[i]) != VK_SUCCESS) {
+            vkCreateSemaphore(device, &semaphoreInfo, nullptr, &renderFinishedSemaphores[i]) != VK_SUCCESS) {
             throw std::runtime_error("failed to create synchronization objects for a frame!");
         }
     }
+
+    // Replaces the per-frame fences of both outputs, the swapchains still need the binary semaphores above
+    frameScheduler = std::make_unique<FrameScheduler>(device, std::vector<VkQueue>{graphicsQueue, computeQueue},
+                                                      MAX_FRAMES_IN_FLIGHT);
 }
 void VulkanMiragePathtracer::createSyncObjects2() {
     imageAvailableSemaphores2.resize(MAX_FRAMES_IN_FLIGHT);
     renderFinishedSemaphores2.resize(MAX_FRAMES_IN_FLIGHT);
-    inFlightFences2.resize(MAX_FRAMES_IN_FLIGHT);
 
     VkSemaphoreCreateInfo semaphoreInfo{};
     semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
 
-    VkFenceCreateInfo fenceInfo{};
-    fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-    fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
-
     for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
         if (vkCreateSemaphore(device, &semaphoreInfo, nullptr, &imageAvailableSemaphores2[i]) != VK_SUCCESS ||
-            vkCreateSemaphore(device, &semaphoreInfo, nullptr, &renderFinishedSemaphores2[i]) != VK_SUCCESS ||
-            vkCreateFence(device, &fenceInfo, nullptr, &inFlightFences2[i]) != VK_SUCCESS) {
+            vkCreateSemaphore(device, &semaphoreInfo, nullptr, &renderFinishedSemaphores2[i]) != VK_SUCCESS) {
             throw std::runtime_error("failed to create synchronization objects for a frame!");
         }
     }
 }
 
 void VulkanMiragePathtracer::recreateSwapChain() {
-    int width = 0, height = 0;
-
-    SDL_GetWindowSize(window, &width, &height);
-    while (isMinimized) {
-        SDL_Event event;
-        while (SDL_PollEvent(&event) && event.type == SDL_WINDOWEVENT && event.window.event ==
-               SDL_WINDOWEVENT_RESTORED) {
-            isMinimized = false;
-        }
+    // The window can be minimized before its event arrives, it is skipped until restored instead of waited for
+    VkSurfaceCapabilitiesKHR capabilities;
+    vkGetPhysicalDeviceSurfaceCapabilitiesKHR(physicalDevice, surface, &capabilities);
+    if (capabilities.currentExtent.width == 0 || capabilities.currentExtent.height == 0) {
+        isMinimized = true;
+        return;
     }
 
-    vkDeviceWaitIdle(device);
-
-    cleanupSwapChain();
+    // No device idle here, the old resources are destroyed once the frames still using them have completed
+    retireSwapChainResources(swapChain);
 
     createSwapChain();
     createImageViews();
@@ -1678,17 +2230,60 @@ void VulkanMiragePathtracer::recreateSwapChain() {
     createFramebuffers();
 
     //imgui
-    QueueFamilyIndices indices = findQueueFamilies(physicalDevice);
     ImGui_ImplVulkan_SetMinImageCount(minImages);
-    ImGui_ImplVulkanH_CreateOrResizeWindow(instance, physicalDevice, device, &imguiWindow,
-                                           indices.graphicsFamily.value(), nullptr, width, height, minImages);
 }
 
-void VulkanMiragePathtracer::cleanupSwapChain() {
-    vkDestroyImageView(device, depthImageView, nullptr);
-    vkDestroyImage(device, depthImage, nullptr);
-    vkFreeMemory(device, depthImageMemory, nullptr);
+void VulkanMiragePathtracer::retireSwapChainResources(VkSwapchainKHR oldSwapChain) {
+    // The depth buffer is a wrapper, it retires on its own when createDepthResources() replaces it
+    deletionQueue.retire([device = device, oldSwapChain, framebuffers = swapChainFramebuffers,
+                             imageViews = swapChainImageViews]() {
+        for (auto framebuffer: framebuffers) {
+            vkDestroyFramebuffer(device, framebuffer, nullptr);
+        }
+
+        for (auto imageView: imageViews) {
+            vkDestroyImageView(device, imageView, nullptr);
+        }
+
+        vkDestroySwapchainKHR(device, oldSwapChain, nullptr);
+    });
+}
+
+void VulkanMiragePathtracer::recreateRaytracingSwapChain() {
+    VkSurfaceCapabilitiesKHR capabilities;
+    vkGetPhysicalDeviceSurfaceCapabilitiesKHR(physicalDevice, surface2, &capabilities);
+    if (capabilities.currentExtent.width == 0 || capabilities.currentExtent.height == 0) {
+        raytracingWindowMinimized = true;
+        return;
+    }
+
+    // No wait here either. The image count can change and every copy is recorded against one image, so the
+    // copies get new buffers; the old ones are freed with the old swapchain once the frames using them completed.
+    // Storage images follow the new extent slot by slot, see recordRaytracingCommandBuffers().
+    VkSwapchainKHR oldSwapChain = raycastingSwapChain;
+    createSwapChain2();
+    deletionQueue.retire([device = device, oldSwapChain]() {
+        vkDestroySwapchainKHR(device, oldSwapChain, nullptr);
+    });
+
+    createRaytracingCommandBuffers();
+}
+
+void VulkanMiragePathtracer::applyPresentMode() {
+    presentModeChanged = false;
+    recreateSwapChain();
+    recreateRaytracingSwapChain();
+}
+
+uint64_t VulkanMiragePathtracer::completedFrameValue() const {
+    return frameScheduler->completedValue();
+}
 
+void VulkanMiragePathtracer::collectRetiredResources() {
+    deletionQueue.collect(completedFrameValue());
+}
+
+void VulkanMiragePathtracer::cleanupSwapChain() {
     for (size_t i = 0; i < swapChainFramebuffers.size(); i++) {
         vkDestroyFramebuffer(device, swapChainFramebuffers[i], nullptr);
     }
@@ -1701,7 +2296,12 @@ void VulkanMiragePathtracer::cleanupSwapChain() {
 }
 
 void VulkanMiragePathtracer::createVertexBuffer() {
-    VkDeviceSize bufferSize = sizeof(Vertex) * model->meshes[0].get()->vertices.size();
+    // Every mesh goes into the same buffer, the draw list addresses them through their vertex offset
+    std::vector<Vertex> vertices;
+    for (const auto &mesh: model->meshes) {
+        vertices.insert(vertices.end(), mesh->vertices.begin(), mesh->vertices.end());
+    }
+    VkDeviceSize bufferSize = sizeof(Vertex) * vertices.size();
 
     VkBuffer stagingBuffer;
     VkDeviceMemory stagingBufferMemory;
@@ -1711,13 +2311,15 @@ void VulkanMiragePathtracer::createVertexBuffer() {
 
     void *data;
     vkMapMemory(device, stagingBufferMemory, 0, bufferSize, 0, &data);
-    memcpy(data, model->meshes[0].get()->vertices.data(), (size_t) bufferSize);
+    memcpy(data, vertices.data(), (size_t) bufferSize);
     vkUnmapMemory(device, stagingBufferMemory);
 
-    createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
-                 VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, vertexBuffer, vertexBufferMemory);
+    // The visibility buffer resolve reads the vertices of the triangle behind each pixel
+    VK_CHECK_RESULT(createVksBuffer(VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT |
+                                    VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                                    &vertexBuffer, bufferSize, nullptr));
 
-    copyBuffer(stagingBuffer, vertexBuffer, bufferSize);
+    copyBuffer(stagingBuffer, vertexBuffer.buffer, bufferSize);
 
     vkDestroyBuffer(device, stagingBuffer, nullptr);
     vkFreeMemory(device, stagingBufferMemory, nullptr);
@@ -1762,7 +2364,16 @@ void VulkanMiragePathtracer::createDescriptorSetLayout() {
     samplerLayoutBinding.pImmutableSamplers = nullptr;
     samplerLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
 
-    std::array<VkDescriptorSetLayoutBinding, 2> bindings = {uboLayoutBinding, samplerLayoutBinding};
+    VkDescriptorSetLayoutBinding drawDataLayoutBinding{};
+    drawDataLayoutBinding.binding = 2;
+    drawDataLayoutBinding.descriptorCount = 1;
+    drawDataLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    drawDataLayoutBinding.pImmutableSamplers = nullptr;
+    drawDataLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+
+    std::array<VkDescriptorSetLayoutBinding, 3> bindings = {
+        uboLayoutBinding, samplerLayoutBinding, drawDataLayoutBinding
+    };
     VkDescriptorSetLayoutCreateInfo layoutInfo{};
     layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
     layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
@@ -1785,8 +2396,9 @@ void VulkanMiragePathtracer::updateUniformBuffer(uint32_t currentImage) {
     ubo.proj = glm::perspective(glm::radians(45.0f), swapChainExtent.width / (float) swapChainExtent.height, 0.1f,
                                 10.0f);
     ubo.proj[1][1] *= -1;
+    rasterViewProjection = ubo.proj * ubo.view * ubo.model;
 
-    memcpy(uniformBuffersMapped[currentImage], &ubo, sizeof(ubo));
+    memcpy(uniformBuffers[currentImage].mapped, &ubo, sizeof(ubo));
 }
 
 void VulkanMiragePathtracer::createImage(uint32_t width, uint32_t height, VkFormat format, VkImageTiling tiling,
@@ -1826,6 +2438,23 @@ void VulkanMiragePathtracer::createImage(uint32_t width, uint32_t height, VkForm
     vkBindImageMemory(device, image, imageMemory, 0);
 }
 
+vks::Image VulkanMiragePathtracer::createVksImage(uint32_t width, uint32_t height, VkFormat format,
+                                                  VkImageUsageFlags usage) {
+    vks::Image image;
+    image.device = device;
+    image.deletionQueue = &deletionQueue;
+    image.format = format;
+    image.extent = {width, height, 1};
+    createImage(width, height, format, VK_IMAGE_TILING_OPTIMAL, usage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                image.image, image.memory);
+
+    VkMemoryRequirements memRequirements;
+    vkGetImageMemoryRequirements(device, image.image, &memRequirements);
+    image.allocationSize = memRequirements.size;
+    vks::ResourceTracker::onCreate(vks::ResourceType::Image, image.allocationSize);
+    return image;
+}
+
 void VulkanMiragePathtracer::transitionImageLayout(VkImage image, VkFormat format, VkImageLayout oldLayout,
                                                    VkImageLayout newLayout) {
     VkCommandBuffer commandBuffer = beginSingleTimeCommands();
@@ -1920,7 +2549,27 @@ void VulkanMiragePathtracer::FramePresent(ImGui_ImplVulkanH_Window *wd) {
 }
 
 void VulkanMiragePathtracer::createIndexBuffer() {
-    VkDeviceSize bufferSize = sizeof(model->meshes[0].get()->indices[0]) * model->meshes[0].get()->indices.size();
+    // One draw per mesh, with the indices left relative to the mesh's own vertices
+    std::vector<uint32_t> indices;
+    rasterDraws.clear();
+    int32_t vertexOffset = 0;
+    for (const auto &mesh: model->meshes) {
+        RasterDraw draw{};
+        draw.indexCount = static_cast<uint32_t>(mesh->indices.size());
+        draw.firstIndex = static_cast<uint32_t>(indices.size());
+        draw.vertexOffset = vertexOffset;
+        draw.boundsMin = glm::vec3(std::numeric_limits<float>::max());
+        draw.boundsMax = glm::vec3(std::numeric_limits<float>::lowest());
+        for (const Vertex &vertex: mesh->vertices) {
+            draw.boundsMin = glm::min(draw.boundsMin, vertex.pos);
+            draw.boundsMax = glm::max(draw.boundsMax, vertex.pos);
+        }
+        rasterDraws.push_back(draw);
+
+        indices.insert(indices.end(), mesh->indices.begin(), mesh->indices.end());
+        vertexOffset += static_cast<int32_t>(mesh->vertices.size());
+    }
+    VkDeviceSize bufferSize = sizeof(uint32_t) * indices.size();
 
     VkBuffer stagingBuffer;
     VkDeviceMemory stagingBufferMemory;
@@ -1930,42 +2579,158 @@ void VulkanMiragePathtracer::createIndexBuffer() {
 
     void *data;
     vkMapMemory(device, stagingBufferMemory, 0, bufferSize, 0, &data);
-    memcpy(data, model->meshes[0].get()->indices.data(), (size_t) bufferSize);
+    memcpy(data, indices.data(), (size_t) bufferSize);
     vkUnmapMemory(device, stagingBufferMemory);
 
-    createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
-                 VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, indexBuffer, indexBufferMemory);
+    VK_CHECK_RESULT(createVksBuffer(VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT |
+                                    VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                                    &indexBuffer, bufferSize, nullptr));
 
-    copyBuffer(stagingBuffer, indexBuffer, bufferSize);
+    copyBuffer(stagingBuffer, indexBuffer.buffer, bufferSize);
 
     vkDestroyBuffer(device, stagingBuffer, nullptr);
     vkFreeMemory(device, stagingBufferMemory, nullptr);
 }
 
+void VulkanMiragePathtracer::createRasterDrawBuffers() {
+    vkCmdDrawIndexedIndirectCountKHR = reinterpret_cast<PFN_vkCmdDrawIndexedIndirectCountKHR>(vkGetDeviceProcAddr(
+        device, "vkCmdDrawIndexedIndirectCountKHR"));
+
+    // The scene instances do not exist yet, every slot allocates and writes its records before its first draw
+    rasterDrawBuffers.clear();
+    rasterDrawBuffers.resize(MAX_FRAMES_IN_FLIGHT);
+    rasterDrawRecordsDirty.assign(MAX_FRAMES_IN_FLIGHT, true);
+
+    occlusionCuller = std::make_unique<OcclusionCuller>(device, physicalDevice, deletionQueue, MAX_FRAMES_IN_FLIGHT);
+    occlusionCuller->setDepthImage(depthImage.view, swapChainExtent);
+
+    // Optional, the forward pass covers devices without it
+    if (!VisibilityBuffer::isSupported(physicalDevice, swapChainImageFormat)) {
+        if (rasterMode == RasterMode::VisibilityBuffer) {
+            std::cout << "Visibility buffer is not supported by the device, using the forward pass" << std::endl;
+        }
+        rasterMode = RasterMode::Forward;
+        return;
+    }
+    VisibilityBuffer::Geometry geometry{};
+    geometry.vertices = vertexBuffer.buffer;
+    geometry.indices = indexBuffer.buffer;
+    geometry.textureView = textureImage.view;
+    geometry.textureSampler = textureSampler;
+    try {
+        visibilityBuffer = std::make_unique<VisibilityBuffer>(device, physicalDevice, deletionQueue,
+                                                              MAX_FRAMES_IN_FLIGHT, findDepthFormat(), pipelineLayout,
+                                                              geometry);
+    } catch (const std::runtime_error &e) {
+        // Supported by the device but not usable, e.g. its shaders were not built
+        std::cerr << "Visibility buffer disabled, using the forward pass: " << e.what() << std::endl;
+        rasterMode = RasterMode::Forward;
+        return;
+    }
+    visibilityBuffer->setDepthImage(depthImage.view, swapChainExtent);
+}
+
+void VulkanMiragePathtracer::allocateRasterDrawBuffers(uint32_t frame, uint32_t capacity) {
+    // The replaced buffers retire through the deletion queue, this slot's previous frame was the last to read them
+    RasterDrawBuffers &drawBuffers = rasterDrawBuffers[frame];
+    drawBuffers.capacity = capacity;
+    const VkMemoryPropertyFlags hostVisible = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                                              VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+    VK_CHECK_RESULT(createVksBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, hostVisible, &drawBuffers.instances,
+                                    capacity * sizeof(CullInstance), nullptr));
+    VK_CHECK_RESULT(createVksBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, hostVisible, &drawBuffers.drawData,
+                                    capacity * sizeof(RasterDrawData), nullptr));
+    VK_CHECK_RESULT(drawBuffers.instances.map());
+    VK_CHECK_RESULT(drawBuffers.drawData.map());
+    occlusionCuller->setInstances(frame, drawBuffers.instances.buffer, capacity);
+    if (visibilityBuffer) {
+        visibilityBuffer->setFrameInputs(frame, uniformBuffers[frame].buffer, drawBuffers.instances.buffer,
+                                         drawBuffers.drawData.buffer);
+    }
+
+    VkWriteDescriptorSet drawDataWrite{};
+    drawDataWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    drawDataWrite.dstSet = descriptorSets[frame];
+    drawDataWrite.dstBinding = 2;
+    drawDataWrite.dstArrayElement = 0;
+    drawDataWrite.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    drawDataWrite.descriptorCount = 1;
+    drawDataWrite.pBufferInfo = &drawBuffers.drawData.descriptor;
+    vkUpdateDescriptorSets(device, 1, &drawDataWrite, 0, nullptr);
+}
+
+void VulkanMiragePathtracer::writeRasterDrawRecords(uint32_t frame) {
+    const uint32_t drawCount = static_cast<uint32_t>(sceneInstances.size());
+    if (drawCount > rasterDrawBuffers[frame].capacity || rasterDrawBuffers[frame].capacity == 0) {
+        allocateRasterDrawBuffers(frame, std::max({drawCount, rasterDrawBuffers[frame].capacity * 2, 1u}));
+    }
+
+    // Written only when the instances changed, a static scene costs nothing per frame
+    const RasterDrawBuffers &drawBuffers = rasterDrawBuffers[frame];
+    auto *instances = static_cast<CullInstance *>(drawBuffers.instances.mapped);
+    auto *drawData = static_cast<RasterDrawData *>(drawBuffers.drawData.mapped);
+    for (uint32_t i = 0; i < drawCount; i++) {
+        const RasterDraw &mesh = rasterDraws[blasMeshIndices[sceneInstances[i].blasIndex]];
+        CullInstance &instance = instances[i];
+        instance.command.indexCount = mesh.indexCount;
+        instance.command.instanceCount = 1;
+        instance.command.firstIndex = mesh.firstIndex;
+        instance.command.vertexOffset = mesh.vertexOffset;
+        // gl_InstanceIndex is the instance index, the vertex shader fetches its draw data with it
+        instance.command.firstInstance = i;
+
+        // The culler tests world space boxes, the box around the transformed mesh box is a bit larger but tight
+        // enough and only has to be built when the instance moves
+        const glm::mat4 &transform = sceneInstances[i].transform;
+        glm::vec3 boundsMin(std::numeric_limits<float>::max());
+        glm::vec3 boundsMax(std::numeric_limits<float>::lowest());
+        for (int corner = 0; corner < 8; corner++) {
+            const glm::vec3 local((corner & 1) ? mesh.boundsMax.x : mesh.boundsMin.x,
+                                  (corner & 2) ? mesh.boundsMax.y : mesh.boundsMin.y,
+                                  (corner & 4) ? mesh.boundsMax.z : mesh.boundsMin.z);
+            const glm::vec3 world = glm::vec3(transform * glm::vec4(local, 1.0f));
+            boundsMin = glm::min(boundsMin, world);
+            boundsMax = glm::max(boundsMax, world);
+        }
+        instance.boundsMin = glm::vec4(boundsMin, 1.0f);
+        instance.boundsMax = glm::vec4(boundsMax, 1.0f);
+
+        drawData[i].model = sceneInstances[i].transform;
+    }
+    rasterDrawRecordsDirty[frame] = false;
+}
+
 void VulkanMiragePathtracer::createUniformBuffers() {
     VkDeviceSize bufferSize = sizeof(UniformBufferObject);
 
     uniformBuffers.resize(MAX_FRAMES_IN_FLIGHT);
-    uniformBuffersMemory.resize(MAX_FRAMES_IN_FLIGHT);
-    uniformBuffersMapped.resize(MAX_FRAMES_IN_FLIGHT);
 
     for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
-        createBuffer(bufferSize, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-                     VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, uniformBuffers[i],
-                     uniformBuffersMemory[i]);
-
-        vkMapMemory(device, uniformBuffersMemory[i], 0, bufferSize, 0, &uniformBuffersMapped[i]);
+        VK_CHECK_RESULT(createVksBuffer(VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+                                        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                                        &uniformBuffers[i], bufferSize, nullptr));
+        VK_CHECK_RESULT(uniformBuffers[i].map());
     }
 }
 
 
-void VulkanMiragePathtracer::createAccelerationStructureBuffer(AccelerationStructure &accelerationStructure,
-                                                               VkAccelerationStructureBuildSizesInfoKHR buildSizeInfo) {
+void VulkanMiragePathtracer::createAccelerationStructureBuffer(vks::AccelerationStructure &accelerationStructure,
+                                                               VkAccelerationStructureBuildSizesInfoKHR buildSizeInfo,
+                                                               VkMemoryPropertyFlags memoryPropertyFlags) {
+    // Whatever the structure held before is retired
+    accelerationStructure.destroy();
+    accelerationStructure.device = device;
+    accelerationStructure.deletionQueue = &deletionQueue;
+    accelerationStructure.destroyFunction = vkDestroyAccelerationStructureKHR;
+    accelerationStructure.size = buildSizeInfo.accelerationStructureSize;
+
     VkBufferCreateInfo bufferCreateInfo{};
     bufferCreateInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
     bufferCreateInfo.size = buildSizeInfo.accelerationStructureSize;
     bufferCreateInfo.usage = VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_STORAGE_BIT_KHR |
                              VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT;
+    // Built by one-time commands on the graphics queue, updated and traced on the compute queue
+    shareWithComputeQueue(bufferCreateInfo);
     if (vkCreateBuffer(device, &bufferCreateInfo, nullptr, &accelerationStructure.buffer) != VK_SUCCESS) {
         throw std::runtime_error("Failed to create AS buffer");
     };
@@ -1978,22 +2743,15 @@ void VulkanMiragePathtracer::createAccelerationStructureBuffer(AccelerationStruc
     memoryAllocateInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
     memoryAllocateInfo.pNext = &memoryAllocateFlagsInfo;
     memoryAllocateInfo.allocationSize = memoryRequirements.size;
-    memoryAllocateInfo.memoryTypeIndex = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT; //Can fuck up but u knoow
+    memoryAllocateInfo.memoryTypeIndex = getMemoryType(physicalDevice, memoryRequirements.memoryTypeBits,
+                                                       memoryPropertyFlags);
     if (vkAllocateMemory(device, &memoryAllocateInfo, nullptr, &accelerationStructure.memory) != VK_SUCCESS) {
         throw std::runtime_error("Failed to allocate memory");
     };
     if (vkBindBufferMemory(device, accelerationStructure.buffer, accelerationStructure.memory, 0) != VK_SUCCESS) {
         throw std::runtime_error("Failed to bind buffer memory");
     };
-}
-
-void VulkanMiragePathtracer::deleteScratchBuffer(RayTracingScratchBuffer &scratchBuffer) {
-    if (scratchBuffer.memory != VK_NULL_HANDLE) {
-        vkFreeMemory(device, scratchBuffer.memory, nullptr);
-    }
-    if (scratchBuffer.handle != VK_NULL_HANDLE) {
-        vkDestroyBuffer(device, scratchBuffer.handle, nullptr);
-    }
+    vks::ResourceTracker::onCreate(vks::ResourceType::AccelerationStructure, accelerationStructure.size);
 }
 
 VkCommandBuffer VulkanMiragePathtracer::beginSingleTimeCommands() {
@@ -2029,14 +2787,34 @@ void VulkanMiragePathtracer::endSingleTimeCommands(VkCommandBuffer commandBuffer
     vkFreeCommandBuffers(device, commandPool, 1, &commandBuffer);
 }
 
-void VulkanMiragePathtracer::createBottomLevelAccelerationStructure() {
-    uint32_t indexCount = static_cast<uint32_t>(model->meshes[0]->indices.size());
-
+void VulkanMiragePathtracer::createBottomLevelAccelerationStructures() {
     // Setup identity transform matrix
     VkTransformMatrixKHR transformMatrix = glmMat4ToVkTransformMatrixKHR(glm::mat4(1.0f));
 
-    
-    
+    // Every mesh is appended to one vertex and one index buffer, the build ranges select the mesh
+    std::vector<Vertex> vertices;
+    std::vector<uint32_t> indices;
+    std::vector<VkAccelerationStructureBuildRangeInfoKHR> buildRanges;
+    std::vector<const Mesh *> blasMeshes;
+    for (uint32_t meshIndex: blasMeshIndices) {
+        const auto &mesh = model->meshes[meshIndex];
+        const uint32_t triangleCount = static_cast<uint32_t>(mesh->indices.size() / 3);
+
+        VkAccelerationStructureBuildRangeInfoKHR buildRange{};
+        buildRange.primitiveCount = triangleCount;
+        buildRange.primitiveOffset = static_cast<uint32_t>(indices.size() * sizeof(uint32_t));
+        buildRange.firstVertex = static_cast<uint32_t>(vertices.size());
+        buildRange.transformOffset = 0;
+        buildRanges.push_back(buildRange);
+        blasMeshes.push_back(mesh.get());
+
+        vertices.insert(vertices.end(), mesh->vertices.begin(), mesh->vertices.end());
+        indices.insert(indices.end(), mesh->indices.begin(), mesh->indices.begin() + triangleCount * 3);
+    }
+    if (buildRanges.empty()) {
+        throw std::runtime_error("failed to build acceleration structures, the model has no triangles!");
+    }
+
     // Create buffers
     // For the sake of simplicity we won't stage the vertex data to the GPU memory
     // Vertex buffer
@@ -2045,9 +2823,9 @@ void VulkanMiragePathtracer::createBottomLevelAccelerationStructure() {
             VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_BUILD_INPUT_READ_ONLY_BIT_KHR,
             VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
             &vertexBuffer2,
-            model->meshes[0]->vertices.size() * sizeof(Vertex),
-            model->meshes[0]->vertices.data()) != VK_SUCCESS) {
-        std::runtime_error("failed to create buffer");
+            vertices.size() * sizeof(Vertex),
+            vertices.data()) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create buffer");
     };
 
     // Index buffer
@@ -2056,9 +2834,9 @@ void VulkanMiragePathtracer::createBottomLevelAccelerationStructure() {
         VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_BUILD_INPUT_READ_ONLY_BIT_KHR,
         VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
         &indexBuffer2,
-        model->meshes[0]->indices.size() * sizeof(uint32_t),
-        model->meshes[0]->indices.data())) {
-        std::runtime_error("failed to create buffer");
+        indices.size() * sizeof(uint32_t),
+        indices.data()) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create buffer");
     };
     // Transform buffer
     if (createVksBuffer(
@@ -2067,136 +2845,542 @@ void VulkanMiragePathtracer::createBottomLevelAccelerationStructure() {
         VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
         &unformBuffer2,
         sizeof(VkTransformMatrixKHR),
-        &transformMatrix)) {
+        &transformMatrix) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create buffer");
     };
 
     VkDeviceOrHostAddressConstKHR vertexBufferDeviceAddress{};
     VkDeviceOrHostAddressConstKHR indexBufferDeviceAddress{};
     VkDeviceOrHostAddressConstKHR transformBufferDeviceAddress{};
 
-    VkBufferDeviceAddressInfoKHR bufferDeviceAI{};
-    bufferDeviceAI.sType = VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO;
-    bufferDeviceAI.buffer = vertexBuffer2.buffer;
-    vertexBufferDeviceAddress.deviceAddress = vkGetBufferDeviceAddressKHR(device, &bufferDeviceAI);
+    vertexBufferDeviceAddress.deviceAddress = getBufferDeviceAddress(vertexBuffer2.buffer);
+    indexBufferDeviceAddress.deviceAddress = getBufferDeviceAddress(indexBuffer2.buffer);
+    transformBufferDeviceAddress.deviceAddress = getBufferDeviceAddress(unformBuffer2.buffer);
 
-    bufferDeviceAI.sType = VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO;
-    bufferDeviceAI.buffer = indexBuffer2.buffer;
-    indexBufferDeviceAddress.deviceAddress = vkGetBufferDeviceAddressKHR(device, &bufferDeviceAI);
+    const size_t blasCount = buildRanges.size();
 
-    bufferDeviceAI.sType = VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO;
-    bufferDeviceAI.buffer = unformBuffer2.buffer;
-    transformBufferDeviceAddress.deviceAddress = vkGetBufferDeviceAddressKHR(device, &bufferDeviceAI);
+    // Host builds read the geometry straight from the vectors above
+    VkDeviceOrHostAddressConstKHR vertexHostAddress{};
+    VkDeviceOrHostAddressConstKHR indexHostAddress{};
+    VkDeviceOrHostAddressConstKHR transformHostAddress{};
+    vertexHostAddress.hostAddress = vertices.data();
+    indexHostAddress.hostAddress = indices.data();
+    transformHostAddress.hostAddress = &transformMatrix;
 
-    // Build
-    VkAccelerationStructureGeometryKHR accelerationStructureGeometry{};
-    accelerationStructureGeometry.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_GEOMETRY_KHR;
-    accelerationStructureGeometry.flags = VK_GEOMETRY_OPAQUE_BIT_KHR;
-    accelerationStructureGeometry.geometryType = VK_GEOMETRY_TYPE_TRIANGLES_KHR;
-    accelerationStructureGeometry.geometry.triangles.sType =
-            VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_GEOMETRY_TRIANGLES_DATA_KHR;
-    accelerationStructureGeometry.geometry.triangles.vertexFormat = VK_FORMAT_R32G32B32_SFLOAT;
-    accelerationStructureGeometry.geometry.triangles.vertexData = vertexBufferDeviceAddress;
-    accelerationStructureGeometry.geometry.triangles.maxVertex = 100;
-    accelerationStructureGeometry.geometry.triangles.vertexStride = sizeof(Vertex);
-    accelerationStructureGeometry.geometry.triangles.indexType = VK_INDEX_TYPE_UINT32;
-    accelerationStructureGeometry.geometry.triangles.indexData = indexBufferDeviceAddress;
-    accelerationStructureGeometry.geometry.triangles.transformData.deviceAddress = 0;
-    accelerationStructureGeometry.geometry.triangles.transformData.hostAddress = nullptr;
-    accelerationStructureGeometry.geometry.triangles.transformData = transformBufferDeviceAddress;
+    // Static geometry that was built before on this device and driver is loaded instead of rebuilt
+    const AccelerationStructureCache::Key cacheKey = createAccelerationStructureCacheKey(vertices, indices, buildRanges);
+    if (useAccelerationStructureCache && loadCachedBottomLevelAccelerationStructures(cacheKey, blasCount)) {
+        queryBottomLevelDeviceAddresses();
+        return;
+    }
+    const VkDeviceSize scratchAlignment = accelerationStructureProperties.minAccelerationStructureScratchOffsetAlignment;
+
+    // The geometry and build infos point into each other, so both vectors are sized up front and never grow
+    std::vector<VkAccelerationStructureGeometryKHR> geometries(blasCount);
+    std::vector<VkAccelerationStructureBuildGeometryInfoKHR> buildGeometryInfos(blasCount);
+    std::vector<VkDeviceSize> scratchOffsets(blasCount);
+    VkDeviceSize scratchSize = 0;
+
+    bottomLevelAccelerationStructures.clear();
+    bottomLevelAccelerationStructures.resize(blasCount);
+
+    for (size_t i = 0; i < blasCount; i++) {
+        const Mesh &mesh = *blasMeshes[i];
+
+        VkAccelerationStructureGeometryKHR &geometry = geometries[i];
+        geometry.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_GEOMETRY_KHR;
+        geometry.flags = VK_GEOMETRY_OPAQUE_BIT_KHR;
+        geometry.geometryType = VK_GEOMETRY_TYPE_TRIANGLES_KHR;
+        geometry.geometry.triangles.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_GEOMETRY_TRIANGLES_DATA_KHR;
+        geometry.geometry.triangles.vertexFormat = VK_FORMAT_R32G32B32_SFLOAT;
+        geometry.geometry.triangles.vertexData = useHostAccelerationStructureBuilds
+                                                     ? vertexHostAddress
+                                                     : vertexBufferDeviceAddress;
+        // maxVertex is relative to firstVertex of the build range
+        geometry.geometry.triangles.maxVertex = static_cast<uint32_t>(mesh.vertices.size()) - 1;
+        geometry.geometry.triangles.vertexStride = sizeof(Vertex);
+        geometry.geometry.triangles.indexType = VK_INDEX_TYPE_UINT32;
+        geometry.geometry.triangles.indexData = useHostAccelerationStructureBuilds
+                                                    ? indexHostAddress
+                                                    : indexBufferDeviceAddress;
+        geometry.geometry.triangles.transformData = useHostAccelerationStructureBuilds
+                                                        ? transformHostAddress
+                                                        : transformBufferDeviceAddress;
+
+        VkAccelerationStructureBuildGeometryInfoKHR &buildGeometryInfo = buildGeometryInfos[i];
+        buildGeometryInfo.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_BUILD_GEOMETRY_INFO_KHR;
+        buildGeometryInfo.type = VK_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL_KHR;
+        buildGeometryInfo.flags = VK_BUILD_ACCELERATION_STRUCTURE_PREFER_FAST_TRACE_BIT_KHR;
+        if (compactAccelerationStructures) {
+            buildGeometryInfo.flags |= VK_BUILD_ACCELERATION_STRUCTURE_ALLOW_COMPACTION_BIT_KHR;
+        }
+        buildGeometryInfo.mode = VK_BUILD_ACCELERATION_STRUCTURE_MODE_BUILD_KHR;
+        buildGeometryInfo.geometryCount = 1;
+        buildGeometryInfo.pGeometries = &geometry;
+
+        // Get size info
+        VkAccelerationStructureBuildSizesInfoKHR buildSizesInfo{};
+        buildSizesInfo.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_BUILD_SIZES_INFO_KHR;
+        vkGetAccelerationStructureBuildSizesKHR(
+            device,
+            useHostAccelerationStructureBuilds
+                ? VK_ACCELERATION_STRUCTURE_BUILD_TYPE_HOST_KHR
+                : VK_ACCELERATION_STRUCTURE_BUILD_TYPE_DEVICE_KHR,
+            &buildGeometryInfo,
+            &buildRanges[i].primitiveCount,
+            &buildSizesInfo);
+
+        // Structures built on the host have to live in memory the host can write
+        vks::AccelerationStructure &blas = bottomLevelAccelerationStructures[i];
+        createAccelerationStructureBuffer(blas, buildSizesInfo,
+                                          useHostAccelerationStructureBuilds
+                                              ? VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                                                VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
+                                              : VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+        VkAccelerationStructureCreateInfoKHR accelerationStructureCreateInfo{};
+        accelerationStructureCreateInfo.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_CREATE_INFO_KHR;
+        accelerationStructureCreateInfo.buffer = blas.buffer;
+        accelerationStructureCreateInfo.size = buildSizesInfo.accelerationStructureSize;
+        accelerationStructureCreateInfo.type = VK_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL_KHR;
+        if (vkCreateAccelerationStructureKHR(device, &accelerationStructureCreateInfo, nullptr, &blas.handle) !=
+            VK_SUCCESS) {
+            throw std::runtime_error("failed to create acceleration structure!");
+        }
+        buildGeometryInfo.dstAccelerationStructure = blas.handle;
 
-    // Get size info
-    VkAccelerationStructureBuildGeometryInfoKHR accelerationStructureBuildGeometryInfo{};
-    accelerationStructureBuildGeometryInfo.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_BUILD_GEOMETRY_INFO_KHR;
-    accelerationStructureBuildGeometryInfo.type = VK_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL_KHR;
-    accelerationStructureBuildGeometryInfo.flags = VK_BUILD_ACCELERATION_STRUCTURE_PREFER_FAST_TRACE_BIT_KHR;
-    accelerationStructureBuildGeometryInfo.geometryCount = 1;
-    accelerationStructureBuildGeometryInfo.pGeometries = &accelerationStructureGeometry;
+        // Every build gets its own aligned region of the shared scratch buffer
+        scratchOffsets[i] = scratchSize;
+        scratchSize += alignedVkSize(buildSizesInfo.buildScratchSize, scratchAlignment);
+    }
 
-    const uint32_t numTriangles = 100;
-    VkAccelerationStructureBuildSizesInfoKHR accelerationStructureBuildSizesInfo{};
-    accelerationStructureBuildSizesInfo.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_BUILD_SIZES_INFO_KHR;
-    vkGetAccelerationStructureBuildSizesKHR(
-        device,
-        VK_ACCELERATION_STRUCTURE_BUILD_TYPE_DEVICE_KHR,
-        &accelerationStructureBuildGeometryInfo,
-        &numTriangles,
-        &accelerationStructureBuildSizesInfo);
+    std::vector<const VkAccelerationStructureBuildRangeInfoKHR *> buildRangePointers(blasCount);
+    for (size_t i = 0; i < blasCount; i++) {
+        buildRangePointers[i] = &buildRanges[i];
+    }
 
-    createAccelerationStructureBuffer(bottomLevelAS, accelerationStructureBuildSizesInfo);
+    // One scratch buffer for all builds, padded so its base address can be aligned as well
+    vks::ScratchBuffer scratchBuffer;
+    std::vector<uint8_t> hostScratchBuffer;
+    VkCommandBuffer commandBuffer = createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY);
+    if (useHostAccelerationStructureBuilds) {
+        hostScratchBuffer.resize(scratchSize + scratchAlignment);
+        auto *scratchBase = reinterpret_cast<uint8_t *>(
+            alignedVkSize(reinterpret_cast<VkDeviceSize>(hostScratchBuffer.data()), scratchAlignment));
+        for (size_t i = 0; i < blasCount; i++) {
+            buildGeometryInfos[i].scratchData.hostAddress = scratchBase + scratchOffsets[i];
+        }
 
-    VkAccelerationStructureCreateInfoKHR accelerationStructureCreateInfo{};
-    accelerationStructureCreateInfo.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_CREATE_INFO_KHR;
-    accelerationStructureCreateInfo.buffer = bottomLevelAS.buffer;
-    accelerationStructureCreateInfo.size = accelerationStructureBuildSizesInfo.accelerationStructureSize;
-    accelerationStructureCreateInfo.type = VK_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL_KHR;
-    vkCreateAccelerationStructureKHR(device, &accelerationStructureCreateInfo, nullptr, &bottomLevelAS.handle);
+        // Build all acceleration structures on the host, the worker threads split the work between them. The
+        // join blocks, the raytracing pipeline and the TLAS need every BLAS before the first frame anyway
+        VkDeferredOperationKHR deferredOperation = deferredOperationPool->createOperation();
+        VkResult buildResult = vkBuildAccelerationStructuresKHR(
+            device,
+            deferredOperation,
+            static_cast<uint32_t>(blasCount),
+            buildGeometryInfos.data(),
+            buildRangePointers.data());
+        buildResult = deferredOperationPool->join(deferredOperation, buildResult);
+        deferredOperationPool->destroyOperation(deferredOperation);
+        if (buildResult != VK_SUCCESS) {
+            throw std::runtime_error("failed to build acceleration structures on the host!");
+        }
+    } else {
+        scratchBuffer = createScratchBuffer(scratchSize + scratchAlignment);
+        const VkDeviceAddress scratchBase = alignedVkSize(scratchBuffer.deviceAddress, scratchAlignment);
+        for (size_t i = 0; i < blasCount; i++) {
+            buildGeometryInfos[i].scratchData.deviceAddress = scratchBase + scratchOffsets[i];
+        }
 
-    // Create a small scratch buffer used during build of the bottom level acceleration structure
-    RayTracingScratchBuffer scratchBuffer = createScratchBuffer(accelerationStructureBuildSizesInfo.buildScratchSize);
+        // Build all acceleration structures on the device with a single command
+        vkCmdBuildAccelerationStructuresKHR(
+            commandBuffer,
+            static_cast<uint32_t>(blasCount),
+            buildGeometryInfos.data(),
+            buildRangePointers.data());
+    }
 
-    VkAccelerationStructureBuildGeometryInfoKHR accelerationBuildGeometryInfo{};
-    accelerationBuildGeometryInfo.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_BUILD_GEOMETRY_INFO_KHR;
-    accelerationBuildGeometryInfo.type = VK_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL_KHR;
-    accelerationBuildGeometryInfo.flags = VK_BUILD_ACCELERATION_STRUCTURE_PREFER_FAST_TRACE_BIT_KHR;
-    accelerationBuildGeometryInfo.mode = VK_BUILD_ACCELERATION_STRUCTURE_MODE_BUILD_KHR;
-    accelerationBuildGeometryInfo.dstAccelerationStructure = bottomLevelAS.handle;
-    accelerationBuildGeometryInfo.geometryCount = 1;
-    accelerationBuildGeometryInfo.pGeometries = &accelerationStructureGeometry;
-    accelerationBuildGeometryInfo.scratchData.deviceAddress = scratchBuffer.deviceAddress;
+    if (compactAccelerationStructures) {
+        VkQueryPoolCreateInfo queryPoolCreateInfo{};
+        queryPoolCreateInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+        queryPoolCreateInfo.queryType = VK_QUERY_TYPE_ACCELERATION_STRUCTURE_COMPACTED_SIZE_KHR;
+        queryPoolCreateInfo.queryCount = static_cast<uint32_t>(blasCount);
+        VkQueryPool queryPool;
+        VK_CHECK_RESULT(vkCreateQueryPool(device, &queryPoolCreateInfo, nullptr, &queryPool));
+
+        // The compacted size can only be queried once the builds have finished writing
+        VkMemoryBarrier buildBarrier{};
+        buildBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        buildBarrier.srcAccessMask = VK_ACCESS_ACCELERATION_STRUCTURE_WRITE_BIT_KHR;
+        buildBarrier.dstAccessMask = VK_ACCESS_ACCELERATION_STRUCTURE_READ_BIT_KHR;
+        vkCmdPipelineBarrier(commandBuffer,
+                             VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR,
+                             VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR,
+                             0, 1, &buildBarrier, 0, nullptr, 0, nullptr);
+
+        std::vector<VkAccelerationStructureKHR> handles;
+        handles.reserve(blasCount);
+        for (const auto &blas: bottomLevelAccelerationStructures) {
+            handles.push_back(blas.handle);
+        }
+        vkCmdResetQueryPool(commandBuffer, queryPool, 0, static_cast<uint32_t>(blasCount));
+        vkCmdWriteAccelerationStructuresPropertiesKHR(
+            commandBuffer,
+            static_cast<uint32_t>(handles.size()),
+            handles.data(),
+            VK_QUERY_TYPE_ACCELERATION_STRUCTURE_COMPACTED_SIZE_KHR,
+            queryPool,
+            0);
+
+        // The sizes are needed on the host before the compacted copies can be allocated, so this one waits
+        flushCommandBuffer(commandBuffer);
+        compactBottomLevelAccelerationStructures(queryPool);
+        vkDestroyQueryPool(device, queryPool, nullptr);
+    } else {
+        submitCommandBuffer(commandBuffer);
+    }
 
-    VkAccelerationStructureBuildRangeInfoKHR accelerationStructureBuildRangeInfo{};
-    accelerationStructureBuildRangeInfo.primitiveCount = numTriangles;
-    accelerationStructureBuildRangeInfo.primitiveOffset = 0;
-    accelerationStructureBuildRangeInfo.firstVertex = 0;
-    accelerationStructureBuildRangeInfo.transformOffset = 0;
-    std::vector<VkAccelerationStructureBuildRangeInfoKHR *> accelerationBuildStructureRangeInfos = {
-        &accelerationStructureBuildRangeInfo
-    };
+    if (useAccelerationStructureCache) {
+        storeBottomLevelAccelerationStructureCache(cacheKey);
+    }
 
-    // Build the acceleration structure on the device via a one-time command buffer submission
-    // Some implementations may support acceleration structure building on the host (VkPhysicalDeviceAccelerationStructureFeaturesKHR->accelerationStructureHostCommands), but we prefer device builds
-    VkCommandBuffer commandBuffer = createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY);
-    vkCmdBuildAccelerationStructuresKHR(
-        commandBuffer,
-        1,
-        &accelerationBuildGeometryInfo,
-        accelerationBuildStructureRangeInfos.data());
-    flushCommandBuffer(commandBuffer);
+    queryBottomLevelDeviceAddresses();
 
-    VkAccelerationStructureDeviceAddressInfoKHR accelerationDeviceAddressInfo{};
-    accelerationDeviceAddressInfo.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_DEVICE_ADDRESS_INFO_KHR;
-    accelerationDeviceAddressInfo.accelerationStructure = bottomLevelAS.handle;
-    bottomLevelAS.deviceAddress = vkGetAccelerationStructureDeviceAddressKHR(device, &accelerationDeviceAddressInfo);
+    // The build is still running on the GPU, the scratch buffer retires itself when it goes out of scope
+}
 
-    deleteScratchBuffer(scratchBuffer);
+void VulkanMiragePathtracer::queryBottomLevelDeviceAddresses() {
+    for (auto &blas: bottomLevelAccelerationStructures) {
+        VkAccelerationStructureDeviceAddressInfoKHR accelerationDeviceAddressInfo{};
+        accelerationDeviceAddressInfo.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_DEVICE_ADDRESS_INFO_KHR;
+        accelerationDeviceAddressInfo.accelerationStructure = blas.handle;
+        blas.deviceAddress = vkGetAccelerationStructureDeviceAddressKHR(device, &accelerationDeviceAddressInfo);
+    }
 }
 
-void VulkanMiragePathtracer::createTopLevelAccelerationStructure() {
-    VkTransformMatrixKHR transformMatrix = glmMat4ToVkTransformMatrixKHR(glm::mat4(1.0f));
+AccelerationStructureCache::Key VulkanMiragePathtracer::createAccelerationStructureCacheKey(
+    const std::vector<Vertex> &vertices, const std::vector<uint32_t> &indices,
+    const std::vector<VkAccelerationStructureBuildRangeInfoKHR> &buildRanges) const {
+    // Anything that changes the built structures has to be part of the hash
+    uint64_t geometryHash = AccelerationStructureCache::hash(vertices.data(), vertices.size() * sizeof(Vertex));
+    geometryHash = AccelerationStructureCache::hash(indices.data(), indices.size() * sizeof(uint32_t), geometryHash);
+    geometryHash = AccelerationStructureCache::hash(buildRanges.data(),
+                                                    buildRanges.size() * sizeof(VkAccelerationStructureBuildRangeInfoKHR),
+                                                    geometryHash);
+    geometryHash = AccelerationStructureCache::hash(&compactAccelerationStructures, sizeof(compactAccelerationStructures),
+                                                    geometryHash);
+
+    AccelerationStructureCache::Key key{};
+    key.geometryHash = geometryHash;
+    std::copy(std::begin(physicalDeviceIdProperties.deviceUUID), std::end(physicalDeviceIdProperties.deviceUUID),
+              key.deviceUUID.begin());
+    std::copy(std::begin(physicalDeviceIdProperties.driverUUID), std::end(physicalDeviceIdProperties.driverUUID),
+              key.driverUUID.begin());
+    return key;
+}
 
+bool VulkanMiragePathtracer::loadCachedBottomLevelAccelerationStructures(const AccelerationStructureCache::Key &key,
+                                                                         size_t blasCount) {
+    std::vector<std::vector<uint8_t> > blobs;
+    if (!accelerationStructureCache.load(key, blobs) || blobs.size() != blasCount) {
+        return false;
+    }
 
-    VkAccelerationStructureInstanceKHR instance{};
-    instance.transform = transformMatrix;
-    instance.instanceCustomIndex = 0;
-    instance.mask = 0xFF;
-    instance.instanceShaderBindingTableRecordOffset = 0;
-    instance.flags = VK_GEOMETRY_INSTANCE_TRIANGLE_FACING_CULL_DISABLE_BIT_KHR;
-    instance.accelerationStructureReference = bottomLevelAS.deviceAddress;
+    // The driver has the final word on whether serialized data can be loaded
+    VkDeviceSize stagingSize = 0;
+    std::vector<VkDeviceSize> stagingOffsets(blasCount);
+    for (size_t i = 0; i < blasCount; i++) {
+        // The query reads 2 * VK_UUID_SIZE bytes from the blob, a truncated one must not get that far
+        if (AccelerationStructureCache::deserializedSize(blobs[i]) == 0) {
+            std::cout << "Acceleration structure cache is truncated, rebuilding" << std::endl;
+            return false;
+        }
+        VkAccelerationStructureVersionInfoKHR versionInfo{};
+        versionInfo.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_VERSION_INFO_KHR;
+        versionInfo.pVersionData = blobs[i].data();
+        VkAccelerationStructureCompatibilityKHR compatibility = VK_ACCELERATION_STRUCTURE_COMPATIBILITY_INCOMPATIBLE_KHR;
+        vkGetDeviceAccelerationStructureCompatibilityKHR(device, &versionInfo, &compatibility);
+        if (compatibility != VK_ACCELERATION_STRUCTURE_COMPATIBILITY_COMPATIBLE_KHR) {
+            std::cout << "Acceleration structure cache is not compatible with this driver, rebuilding" << std::endl;
+            return false;
+        }
+        stagingOffsets[i] = stagingSize;
+        stagingSize += alignedVkSize(blobs[i].size(), serializedDataAlignment);
+    }
 
-    // Buffer for instance data
-    vks::Buffer instancesBuffer;
+    // Deserialization reads from a device address, the serialized data is uploaded into one host visible buffer
+    vks::Buffer stagingBuffer;
     if (createVksBuffer(
             VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT |
             VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_BUILD_INPUT_READ_ONLY_BIT_KHR,
             VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-            &instancesBuffer,
-            sizeof(VkAccelerationStructureInstanceKHR),
-            &instance) != VK_SUCCESS) {
+            &stagingBuffer,
+            stagingSize + serializedDataAlignment,
+            nullptr) != VK_SUCCESS) {
         throw std::runtime_error("failed to create buffer");
     };
+    VK_CHECK_RESULT(stagingBuffer.map());
+    const VkDeviceAddress stagingAddress = getBufferDeviceAddress(stagingBuffer.buffer);
+    const VkDeviceAddress stagingBase = alignedVkSize(stagingAddress, serializedDataAlignment);
+    auto *stagingData = static_cast<uint8_t *>(stagingBuffer.mapped) + (stagingBase - stagingAddress);
+
+    bottomLevelAccelerationStructures.clear();
+    bottomLevelAccelerationStructures.resize(blasCount);
+
+    VkCommandBuffer commandBuffer = createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY);
+    for (size_t i = 0; i < blasCount; i++) {
+        memcpy(stagingData + stagingOffsets[i], blobs[i].data(), blobs[i].size());
+
+        vks::AccelerationStructure &blas = bottomLevelAccelerationStructures[i];
+        VkAccelerationStructureBuildSizesInfoKHR sizeInfo{};
+        sizeInfo.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_BUILD_SIZES_INFO_KHR;
+        sizeInfo.accelerationStructureSize = AccelerationStructureCache::deserializedSize(blobs[i]);
+        createAccelerationStructureBuffer(blas, sizeInfo);
+
+        VkAccelerationStructureCreateInfoKHR accelerationStructureCreateInfo{};
+        accelerationStructureCreateInfo.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_CREATE_INFO_KHR;
+        accelerationStructureCreateInfo.buffer = blas.buffer;
+        accelerationStructureCreateInfo.size = sizeInfo.accelerationStructureSize;
+        accelerationStructureCreateInfo.type = VK_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL_KHR;
+        if (vkCreateAccelerationStructureKHR(device, &accelerationStructureCreateInfo, nullptr, &blas.handle) !=
+            VK_SUCCESS) {
+            throw std::runtime_error("failed to create acceleration structure!");
+        }
+
+        VkCopyMemoryToAccelerationStructureInfoKHR copyInfo{};
+        copyInfo.sType = VK_STRUCTURE_TYPE_COPY_MEMORY_TO_ACCELERATION_STRUCTURE_INFO_KHR;
+        copyInfo.src.deviceAddress = stagingBase + stagingOffsets[i];
+        copyInfo.dst = blas.handle;
+        copyInfo.mode = VK_COPY_ACCELERATION_STRUCTURE_MODE_DESERIALIZE_KHR;
+        vkCmdCopyMemoryToAccelerationStructureKHR(commandBuffer, &copyInfo);
+    }
+    submitCommandBuffer(commandBuffer);
+
+    std::cout << "Loaded " << blasCount << " bottom level acceleration structures from the cache" << std::endl;
+    // The staging buffer retires itself once the copies have completed
+    return true;
+}
+
+void VulkanMiragePathtracer::storeBottomLevelAccelerationStructureCache(const AccelerationStructureCache::Key &key) {
+    const uint32_t blasCount = static_cast<uint32_t>(bottomLevelAccelerationStructures.size());
 
-    VkDeviceOrHostAddressConstKHR instanceDataDeviceAddress{};
-    instanceDataDeviceAddress.deviceAddress = getBufferDeviceAddress(instancesBuffer.buffer);
+    VkQueryPoolCreateInfo queryPoolCreateInfo{};
+    queryPoolCreateInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+    queryPoolCreateInfo.queryType = VK_QUERY_TYPE_ACCELERATION_STRUCTURE_SERIALIZATION_SIZE_KHR;
+    queryPoolCreateInfo.queryCount = blasCount;
+    VkQueryPool queryPool;
+    VK_CHECK_RESULT(vkCreateQueryPool(device, &queryPoolCreateInfo, nullptr, &queryPool));
+
+    std::vector<VkAccelerationStructureKHR> handles;
+    handles.reserve(blasCount);
+    for (const auto &blas: bottomLevelAccelerationStructures) {
+        handles.push_back(blas.handle);
+    }
+
+    // Wait for the builds (or compaction copies) before reading the structures
+    VkMemoryBarrier buildBarrier{};
+    buildBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    buildBarrier.srcAccessMask = VK_ACCESS_ACCELERATION_STRUCTURE_WRITE_BIT_KHR;
+    buildBarrier.dstAccessMask = VK_ACCESS_ACCELERATION_STRUCTURE_READ_BIT_KHR;
+
+    VkCommandBuffer commandBuffer = createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY);
+    vkCmdPipelineBarrier(commandBuffer,
+                         VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR,
+                         VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR,
+                         0, 1, &buildBarrier, 0, nullptr, 0, nullptr);
+    vkCmdResetQueryPool(commandBuffer, queryPool, 0, blasCount);
+    vkCmdWriteAccelerationStructuresPropertiesKHR(
+        commandBuffer,
+        blasCount,
+        handles.data(),
+        VK_QUERY_TYPE_ACCELERATION_STRUCTURE_SERIALIZATION_SIZE_KHR,
+        queryPool,
+        0);
+    flushCommandBuffer(commandBuffer);
+
+    std::vector<VkDeviceSize> serializedSizes(blasCount);
+    VK_CHECK_RESULT(vkGetQueryPoolResults(
+        device,
+        queryPool,
+        0,
+        blasCount,
+        serializedSizes.size() * sizeof(VkDeviceSize),
+        serializedSizes.data(),
+        sizeof(VkDeviceSize),
+        VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT));
+    vkDestroyQueryPool(device, queryPool, nullptr);
+
+    VkDeviceSize readbackSize = 0;
+    std::vector<VkDeviceSize> readbackOffsets(blasCount);
+    for (uint32_t i = 0; i < blasCount; i++) {
+        readbackOffsets[i] = readbackSize;
+        readbackSize += alignedVkSize(serializedSizes[i], serializedDataAlignment);
+    }
+
+    vks::Buffer readbackBuffer;
+    if (createVksBuffer(
+            VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+            &readbackBuffer,
+            readbackSize + serializedDataAlignment,
+            nullptr) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create buffer");
+    };
+    const VkDeviceAddress readbackAddress = getBufferDeviceAddress(readbackBuffer.buffer);
+    const VkDeviceAddress readbackBase = alignedVkSize(readbackAddress, serializedDataAlignment);
+
+    commandBuffer = createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY);
+    for (uint32_t i = 0; i < blasCount; i++) {
+        VkCopyAccelerationStructureToMemoryInfoKHR copyInfo{};
+        copyInfo.sType = VK_STRUCTURE_TYPE_COPY_ACCELERATION_STRUCTURE_TO_MEMORY_INFO_KHR;
+        copyInfo.src = handles[i];
+        copyInfo.dst.deviceAddress = readbackBase + readbackOffsets[i];
+        copyInfo.mode = VK_COPY_ACCELERATION_STRUCTURE_MODE_SERIALIZE_KHR;
+        vkCmdCopyAccelerationStructureToMemoryKHR(commandBuffer, &copyInfo);
+    }
+
+    VkMemoryBarrier hostBarrier{};
+    hostBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    hostBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    hostBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+    vkCmdPipelineBarrier(commandBuffer,
+                         VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR,
+                         VK_PIPELINE_STAGE_HOST_BIT,
+                         0, 1, &hostBarrier, 0, nullptr, 0, nullptr);
+    flushCommandBuffer(commandBuffer);
+
+    VK_CHECK_RESULT(readbackBuffer.map());
+    const auto *readbackData = static_cast<const uint8_t *>(readbackBuffer.mapped) + (readbackBase - readbackAddress);
+    std::vector<std::vector<uint8_t> > blobs(blasCount);
+    for (uint32_t i = 0; i < blasCount; i++) {
+        const uint8_t *blob = readbackData + readbackOffsets[i];
+        blobs[i].assign(blob, blob + serializedSizes[i]);
+    }
+
+    if (!accelerationStructureCache.store(key, blobs)) {
+        std::cerr << "failed to write the acceleration structure cache" << std::endl;
+    }
+}
+
+void VulkanMiragePathtracer::compactBottomLevelAccelerationStructures(VkQueryPool queryPool) {
+    const size_t blasCount = bottomLevelAccelerationStructures.size();
+
+    std::vector<VkDeviceSize> compactedSizes(blasCount);
+    VK_CHECK_RESULT(vkGetQueryPoolResults(
+        device,
+        queryPool,
+        0,
+        static_cast<uint32_t>(blasCount),
+        compactedSizes.size() * sizeof(VkDeviceSize),
+        compactedSizes.data(),
+        sizeof(VkDeviceSize),
+        VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT));
+
+    std::vector<vks::AccelerationStructure> compactedStructures(blasCount);
+    VkDeviceSize originalTotal = 0;
+    VkDeviceSize compactedTotal = 0;
+
+    VkCommandBuffer commandBuffer = createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY);
+    for (size_t i = 0; i < blasCount; i++) {
+        vks::AccelerationStructure &original = bottomLevelAccelerationStructures[i];
+        vks::AccelerationStructure &compacted = compactedStructures[i];
+
+        VkAccelerationStructureBuildSizesInfoKHR compactedSizeInfo{};
+        compactedSizeInfo.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_BUILD_SIZES_INFO_KHR;
+        compactedSizeInfo.accelerationStructureSize = compactedSizes[i];
+        createAccelerationStructureBuffer(compacted, compactedSizeInfo);
+
+        VkAccelerationStructureCreateInfoKHR accelerationStructureCreateInfo{};
+        accelerationStructureCreateInfo.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_CREATE_INFO_KHR;
+        accelerationStructureCreateInfo.buffer = compacted.buffer;
+        accelerationStructureCreateInfo.size = compactedSizes[i];
+        accelerationStructureCreateInfo.type = VK_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL_KHR;
+        if (vkCreateAccelerationStructureKHR(device, &accelerationStructureCreateInfo, nullptr, &compacted.handle) !=
+            VK_SUCCESS) {
+            throw std::runtime_error("failed to create compacted acceleration structure!");
+        }
+
+        VkCopyAccelerationStructureInfoKHR copyInfo{};
+        copyInfo.sType = VK_STRUCTURE_TYPE_COPY_ACCELERATION_STRUCTURE_INFO_KHR;
+        copyInfo.src = original.handle;
+        copyInfo.dst = compacted.handle;
+        copyInfo.mode = VK_COPY_ACCELERATION_STRUCTURE_MODE_COMPACT_KHR;
+        vkCmdCopyAccelerationStructureKHR(commandBuffer, &copyInfo);
+
+        const uint32_t meshIndex = blasMeshIndices[i];
+        const std::string &meshName = model->meshes[meshIndex]->name;
+        std::cout << "Mesh " << meshIndex;
+        if (!meshName.empty()) {
+            std::cout << " (" << meshName << ")";
+        }
+        std::cout << ": " << original.size << " -> " << compactedSizes[i] << " bytes ("
+                << (original.size > 0 ? 100 * compactedSizes[i] / original.size : 100) << "% of the build size)" << std::endl;
+        originalTotal += original.size;
+        compactedTotal += compactedSizes[i];
+    }
+    submitCommandBuffer(commandBuffer);
+
+    std::cout << "BLAS compaction: " << originalTotal << " -> " << compactedTotal << " bytes, saved "
+            << originalTotal - compactedTotal << " bytes" << std::endl;
+
+    // The originals retire through the deletion queue, after the copies have completed
+    bottomLevelAccelerationStructures = std::move(compactedStructures);
+}
+
+void VulkanMiragePathtracer::createTopLevelAccelerationStructure() {
+    // Start with one identity instance per bottom level acceleration structure
+    sceneInstances.clear();
+    for (size_t i = 0; i < bottomLevelAccelerationStructures.size(); i++) {
+        sceneInstances.push_back({static_cast<uint32_t>(i), glm::mat4(1.0f)});
+    }
+
+    tlasUpdateCmdBuffers.resize(MAX_FRAMES_IN_FLIGHT);
+    for (auto &cmdBuffer: tlasUpdateCmdBuffers) {
+        VkCommandBufferAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        allocInfo.commandPool = raytracingCommandPool;
+        allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        allocInfo.commandBufferCount = 1;
+        if (vkAllocateCommandBuffers(device, &allocInfo, &cmdBuffer.handle) != VK_SUCCESS) {
+            throw std::runtime_error("failed to allocate command buffers!");
+        }
+        cmdBuffer.device = device;
+        cmdBuffer.deletionQueue = &deletionQueue;
+        cmdBuffer.pool = raytracingCommandPool;
+        vks::ResourceTracker::onCreate(vks::ResourceType::CommandBuffer, 0);
+    }
+
+    allocateTopLevelAccelerationStructure(static_cast<uint32_t>(sceneInstances.size()));
+
+    // The initial build goes through a one-time command buffer, later builds through the per frame ones
+    VkCommandBuffer commandBuffer = createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY);
+    recordTopLevelAccelerationStructureBuild(commandBuffer, 0, VK_BUILD_ACCELERATION_STRUCTURE_MODE_BUILD_KHR);
+    submitCommandBuffer(commandBuffer);
+    tlasBuiltInstanceCount = static_cast<uint32_t>(sceneInstances.size());
+
+    VkAccelerationStructureDeviceAddressInfoKHR accelerationDeviceAddressInfo{};
+    accelerationDeviceAddressInfo.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_DEVICE_ADDRESS_INFO_KHR;
+    accelerationDeviceAddressInfo.accelerationStructure = topLevelAS.handle;
+    topLevelAS.deviceAddress = vkGetAccelerationStructureDeviceAddressKHR(device, &accelerationDeviceAddressInfo);
+}
+
+void VulkanMiragePathtracer::allocateTopLevelAccelerationStructure(uint32_t instanceCapacity) {
+    tlasInstanceCapacity = instanceCapacity;
+
+    // Persistent, mapped instance buffers. Each frame in flight writes its own while the others may still be read.
+    instanceBuffers.resize(MAX_FRAMES_IN_FLIGHT);
+    for (auto &instanceBuffer: instanceBuffers) {
+        if (createVksBuffer(
+                VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT |
+                VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_BUILD_INPUT_READ_ONLY_BIT_KHR,
+                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                &instanceBuffer,
+                instanceCapacity * sizeof(VkAccelerationStructureInstanceKHR),
+                nullptr) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create buffer");
+        };
+        VK_CHECK_RESULT(instanceBuffer.map());
+    }
 
     VkAccelerationStructureGeometryKHR accelerationStructureGeometry{};
     accelerationStructureGeometry.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_GEOMETRY_KHR;
@@ -2205,7 +3389,6 @@ void VulkanMiragePathtracer::createTopLevelAccelerationStructure() {
     accelerationStructureGeometry.geometry.instances.sType =
             VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_GEOMETRY_INSTANCES_DATA_KHR;
     accelerationStructureGeometry.geometry.instances.arrayOfPointers = VK_FALSE;
-    accelerationStructureGeometry.geometry.instances.data = instanceDataDeviceAddress;
 
     // Get size info
     /*
@@ -2214,19 +3397,17 @@ void VulkanMiragePathtracer::createTopLevelAccelerationStructure() {
     VkAccelerationStructureBuildGeometryInfoKHR accelerationStructureBuildGeometryInfo{};
     accelerationStructureBuildGeometryInfo.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_BUILD_GEOMETRY_INFO_KHR;
     accelerationStructureBuildGeometryInfo.type = VK_ACCELERATION_STRUCTURE_TYPE_TOP_LEVEL_KHR;
-    accelerationStructureBuildGeometryInfo.flags = VK_BUILD_ACCELERATION_STRUCTURE_PREFER_FAST_TRACE_BIT_KHR;
+    accelerationStructureBuildGeometryInfo.flags = tlasBuildFlags;
     accelerationStructureBuildGeometryInfo.geometryCount = 1;
     accelerationStructureBuildGeometryInfo.pGeometries = &accelerationStructureGeometry;
 
-    uint32_t primitive_count = 1;
-
     VkAccelerationStructureBuildSizesInfoKHR accelerationStructureBuildSizesInfo{};
     accelerationStructureBuildSizesInfo.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_BUILD_SIZES_INFO_KHR;
     vkGetAccelerationStructureBuildSizesKHR(
         device,
         VK_ACCELERATION_STRUCTURE_BUILD_TYPE_DEVICE_KHR,
         &accelerationStructureBuildGeometryInfo,
-        &primitive_count,
+        &instanceCapacity,
         &accelerationStructureBuildSizesInfo);
 
     createAccelerationStructureBuffer(topLevelAS, accelerationStructureBuildSizesInfo);
@@ -2236,47 +3417,173 @@ void VulkanMiragePathtracer::createTopLevelAccelerationStructure() {
     accelerationStructureCreateInfo.buffer = topLevelAS.buffer;
     accelerationStructureCreateInfo.size = accelerationStructureBuildSizesInfo.accelerationStructureSize;
     accelerationStructureCreateInfo.type = VK_ACCELERATION_STRUCTURE_TYPE_TOP_LEVEL_KHR;
-    vkCreateAccelerationStructureKHR(device, &accelerationStructureCreateInfo, nullptr, &topLevelAS.handle);
+    if (vkCreateAccelerationStructureKHR(device, &accelerationStructureCreateInfo, nullptr, &topLevelAS.handle) !=
+        VK_SUCCESS) {
+        throw std::runtime_error("failed to create acceleration structure!");
+    }
+
+    // Builds and updates are serialized on the queue, so they can share one scratch buffer
+    tlasScratchBuffer = createScratchBuffer(std::max(accelerationStructureBuildSizesInfo.buildScratchSize,
+                                                     accelerationStructureBuildSizesInfo.updateScratchSize));
+}
 
-    // Create a small scratch buffer used during build of the top level acceleration structure
-    RayTracingScratchBuffer scratchBuffer = createScratchBuffer(accelerationStructureBuildSizesInfo.buildScratchSize);
+void VulkanMiragePathtracer::recordTopLevelAccelerationStructureBuild(VkCommandBuffer commandBuffer, uint32_t frame,
+                                                                      VkBuildAccelerationStructureModeKHR mode) {
+    const uint32_t instanceCount = static_cast<uint32_t>(sceneInstances.size());
+
+    auto *instances = static_cast<VkAccelerationStructureInstanceKHR *>(instanceBuffers[frame].mapped);
+    for (uint32_t i = 0; i < instanceCount; i++) {
+        VkAccelerationStructureInstanceKHR &instance = instances[i];
+        instance = {};
+        instance.transform = glmMat4ToVkTransformMatrixKHR(sceneInstances[i].transform);
+        instance.instanceCustomIndex = sceneInstances[i].blasIndex;
+        instance.mask = 0xFF;
+        instance.instanceShaderBindingTableRecordOffset = 0;
+        instance.flags = VK_GEOMETRY_INSTANCE_TRIANGLE_FACING_CULL_DISABLE_BIT_KHR;
+        instance.accelerationStructureReference =
+                bottomLevelAccelerationStructures[sceneInstances[i].blasIndex].deviceAddress;
+    }
+
+    VkAccelerationStructureGeometryKHR accelerationStructureGeometry{};
+    accelerationStructureGeometry.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_GEOMETRY_KHR;
+    accelerationStructureGeometry.geometryType = VK_GEOMETRY_TYPE_INSTANCES_KHR;
+    accelerationStructureGeometry.flags = VK_GEOMETRY_OPAQUE_BIT_KHR;
+    accelerationStructureGeometry.geometry.instances.sType =
+            VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_GEOMETRY_INSTANCES_DATA_KHR;
+    accelerationStructureGeometry.geometry.instances.arrayOfPointers = VK_FALSE;
+    accelerationStructureGeometry.geometry.instances.data.deviceAddress =
+            getBufferDeviceAddress(instanceBuffers[frame].buffer);
 
     VkAccelerationStructureBuildGeometryInfoKHR accelerationBuildGeometryInfo{};
     accelerationBuildGeometryInfo.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_BUILD_GEOMETRY_INFO_KHR;
     accelerationBuildGeometryInfo.type = VK_ACCELERATION_STRUCTURE_TYPE_TOP_LEVEL_KHR;
-    accelerationBuildGeometryInfo.flags = VK_BUILD_ACCELERATION_STRUCTURE_PREFER_FAST_TRACE_BIT_KHR;
-    accelerationBuildGeometryInfo.mode = VK_BUILD_ACCELERATION_STRUCTURE_MODE_BUILD_KHR;
+    accelerationBuildGeometryInfo.flags = tlasBuildFlags;
+    accelerationBuildGeometryInfo.mode = mode;
+    // An update refits the structure in place
+    accelerationBuildGeometryInfo.srcAccelerationStructure =
+            mode == VK_BUILD_ACCELERATION_STRUCTURE_MODE_UPDATE_KHR ? topLevelAS.handle : VK_NULL_HANDLE;
     accelerationBuildGeometryInfo.dstAccelerationStructure = topLevelAS.handle;
     accelerationBuildGeometryInfo.geometryCount = 1;
     accelerationBuildGeometryInfo.pGeometries = &accelerationStructureGeometry;
-    accelerationBuildGeometryInfo.scratchData.deviceAddress = scratchBuffer.deviceAddress;
+    accelerationBuildGeometryInfo.scratchData.deviceAddress = tlasScratchBuffer.deviceAddress;
 
     VkAccelerationStructureBuildRangeInfoKHR accelerationStructureBuildRangeInfo{};
-    accelerationStructureBuildRangeInfo.primitiveCount = 1;
+    accelerationStructureBuildRangeInfo.primitiveCount = instanceCount;
     accelerationStructureBuildRangeInfo.primitiveOffset = 0;
     accelerationStructureBuildRangeInfo.firstVertex = 0;
     accelerationStructureBuildRangeInfo.transformOffset = 0;
-    std::vector<VkAccelerationStructureBuildRangeInfoKHR *> accelerationBuildStructureRangeInfos = {
-        &accelerationStructureBuildRangeInfo
-    };
+    const VkAccelerationStructureBuildRangeInfoKHR *accelerationBuildStructureRangeInfo =
+            &accelerationStructureBuildRangeInfo;
+
+    // Waits for the bottom level builds, earlier reads of the TLAS by the trace and the last use of the scratch buffer
+    VkMemoryBarrier buildBarrier{};
+    buildBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    buildBarrier.srcAccessMask = VK_ACCESS_ACCELERATION_STRUCTURE_READ_BIT_KHR |
+                                 VK_ACCESS_ACCELERATION_STRUCTURE_WRITE_BIT_KHR;
+    buildBarrier.dstAccessMask = VK_ACCESS_ACCELERATION_STRUCTURE_READ_BIT_KHR |
+                                 VK_ACCESS_ACCELERATION_STRUCTURE_WRITE_BIT_KHR;
+    vkCmdPipelineBarrier(commandBuffer,
+                         VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR |
+                         VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_KHR,
+                         VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR,
+                         0, 1, &buildBarrier, 0, nullptr, 0, nullptr);
 
-    // Build the acceleration structure on the device via a one-time command buffer submission
-    // Some implementations may support acceleration structure building on the host (VkPhysicalDeviceAccelerationStructureFeaturesKHR->accelerationStructureHostCommands), but we prefer device builds
-    VkCommandBuffer commandBuffer = createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY);
     vkCmdBuildAccelerationStructuresKHR(
         commandBuffer,
         1,
         &accelerationBuildGeometryInfo,
-        accelerationBuildStructureRangeInfos.data());
-    flushCommandBuffer(commandBuffer);
+        &accelerationBuildStructureRangeInfo);
+
+    // The trace reads the result
+    VkMemoryBarrier traceBarrier{};
+    traceBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    traceBarrier.srcAccessMask = VK_ACCESS_ACCELERATION_STRUCTURE_WRITE_BIT_KHR;
+    traceBarrier.dstAccessMask = VK_ACCESS_ACCELERATION_STRUCTURE_READ_BIT_KHR;
+    vkCmdPipelineBarrier(commandBuffer,
+                         VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR,
+                         VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_KHR,
+                         0, 1, &traceBarrier, 0, nullptr, 0, nullptr);
+
+    if (mode == VK_BUILD_ACCELERATION_STRUCTURE_MODE_BUILD_KHR) {
+        tlasFramesSinceRebuild = 0;
+    } else {
+        tlasFramesSinceRebuild++;
+    }
+}
 
-    VkAccelerationStructureDeviceAddressInfoKHR accelerationDeviceAddressInfo{};
-    accelerationDeviceAddressInfo.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_DEVICE_ADDRESS_INFO_KHR;
-    accelerationDeviceAddressInfo.accelerationStructure = topLevelAS.handle;
-    topLevelAS.deviceAddress = vkGetAccelerationStructureDeviceAddressKHR(device, &accelerationDeviceAddressInfo);
+VkCommandBuffer VulkanMiragePathtracer::updateTopLevelAccelerationStructure(uint32_t frame) {
+    if (!tlasTopologyDirty && !tlasTransformsDirty) {
+        return VK_NULL_HANDLE;
+    }
+
+    const uint32_t instanceCount = static_cast<uint32_t>(sceneInstances.size());
+    if (instanceCount > tlasInstanceCapacity) {
+        // Growing replaces the TLAS handle, which the descriptor set of every frame in flight still points to
+        frameScheduler->waitSubmitted();
+        allocateTopLevelAccelerationStructure(std::max(instanceCount, tlasInstanceCapacity * 2));
+        updateAccelerationStructureDescriptor();
+        tlasTopologyDirty = true;
+    }
+
+    // Only transforms changed: refit in place, unless the structure has been refitted for too long
+    VkBuildAccelerationStructureModeKHR mode = VK_BUILD_ACCELERATION_STRUCTURE_MODE_UPDATE_KHR;
+    if (tlasTopologyDirty || instanceCount != tlasBuiltInstanceCount ||
+        tlasFramesSinceRebuild >= tlasRebuildInterval) {
+        mode = VK_BUILD_ACCELERATION_STRUCTURE_MODE_BUILD_KHR;
+    }
+
+    VkCommandBuffer commandBuffer = tlasUpdateCmdBuffers[frame].handle;
+    vkResetCommandBuffer(commandBuffer, 0);
+    VkCommandBufferBeginInfo beginInfo{};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    VK_CHECK_RESULT(vkBeginCommandBuffer(commandBuffer, &beginInfo));
+    recordTopLevelAccelerationStructureBuild(commandBuffer, frame, mode);
+    VK_CHECK_RESULT(vkEndCommandBuffer(commandBuffer));
+
+    tlasBuiltInstanceCount = instanceCount;
+    tlasTopologyDirty = false;
+    tlasTransformsDirty = false;
+    return commandBuffer;
+}
+
+void VulkanMiragePathtracer::setInstanceTransform(size_t instanceIndex, const glm::mat4 &transform) {
+    sceneInstances.at(instanceIndex).transform = transform;
+    tlasTransformsDirty = true;
+    rasterDrawRecordsDirty.assign(MAX_FRAMES_IN_FLIGHT, true);
+}
+
+void VulkanMiragePathtracer::setSceneInstances(std::vector<SceneInstance> instances) {
+    for (const auto &instance: instances) {
+        if (instance.blasIndex >= bottomLevelAccelerationStructures.size()) {
+            throw std::runtime_error("scene instance references a missing acceleration structure!");
+        }
+    }
+    sceneInstances = std::move(instances);
+    tlasTopologyDirty = true;
+    rasterDrawRecordsDirty.assign(MAX_FRAMES_IN_FLIGHT, true);
+}
+
+void VulkanMiragePathtracer::updateAccelerationStructureDescriptor() {
+    VkWriteDescriptorSetAccelerationStructureKHR descriptorAccelerationStructureInfo{};
+    descriptorAccelerationStructureInfo.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET_ACCELERATION_STRUCTURE_KHR;
+    descriptorAccelerationStructureInfo.accelerationStructureCount = 1;
+    descriptorAccelerationStructureInfo.pAccelerationStructures = &topLevelAS.handle;
 
-    deleteScratchBuffer(scratchBuffer);
-    instancesBuffer.destroy();
+    // The sets are created after the first TLAS, nothing to patch before that
+    for (VkDescriptorSet descriptorSet: raytracingDescriptorSets) {
+        VkWriteDescriptorSet accelerationStructureWrite{};
+        accelerationStructureWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        // The specialized acceleration structure descriptor has to be chained
+        accelerationStructureWrite.pNext = &descriptorAccelerationStructureInfo;
+        accelerationStructureWrite.dstSet = descriptorSet;
+        accelerationStructureWrite.dstBinding = 0;
+        accelerationStructureWrite.descriptorCount = 1;
+        accelerationStructureWrite.descriptorType = VK_DESCRIPTOR_TYPE_ACCELERATION_STRUCTURE_KHR;
+        vkUpdateDescriptorSets(device, 1, &accelerationStructureWrite, 0, VK_NULL_HANDLE);
+    }
+    // Updating a bound set invalidates the command buffers it was recorded into
+    markRaytracingCommandBuffersDirty();
 }
 
 VkResult VulkanMiragePathtracer::createVksBuffer(VkBufferUsageFlags usageFlags,
@@ -2291,13 +3598,17 @@ VkResult VulkanMiragePathtracer::createVksBuffer(VkBufferUsageFlags usageFlags,
                     &instance));
      */
 
+    // Release whatever the buffer held before, then let the new handles retire through the deletion queue
+    buffer->destroy();
     buffer->device = device;
+    buffer->deletionQueue = &deletionQueue;
     // Create the buffer handle
     VkBufferCreateInfo bufferCreateInfo = {};
     bufferCreateInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
     bufferCreateInfo.usage = usageFlags; // This should be a valid combination of VkBufferCreateFlagBits values.
     bufferCreateInfo.size = size;
     bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE; // For example, use exclusive mode
+    shareWithComputeQueue(bufferCreateInfo);
     if (vkCreateBuffer(device, &bufferCreateInfo, nullptr, &buffer->buffer) != VK_SUCCESS) {
         throw std::runtime_error("failed to create a buffer");
     };
@@ -2320,6 +3631,7 @@ VkResult VulkanMiragePathtracer::createVksBuffer(VkBufferUsageFlags usageFlags,
     if (vkAllocateMemory(device, &memAlloc, nullptr, &buffer->memory) != VK_SUCCESS) {
         throw std::runtime_error("failed to allocate memory");
     };
+    vks::ResourceTracker::onCreate(vks::ResourceType::Buffer, size);
 
     buffer->alignment = memReqs.alignment;
     buffer->size = size;
@@ -2345,13 +3657,17 @@ VkResult VulkanMiragePathtracer::createVksBuffer(VkBufferUsageFlags usageFlags,
     return buffer->bind();
 }
 
-RayTracingScratchBuffer VulkanMiragePathtracer::createScratchBuffer(VkDeviceSize size) {
-    RayTracingScratchBuffer scratchBuffer{};
+vks::ScratchBuffer VulkanMiragePathtracer::createScratchBuffer(VkDeviceSize size) {
+    vks::ScratchBuffer scratchBuffer;
+    scratchBuffer.device = device;
+    scratchBuffer.deletionQueue = &deletionQueue;
+    scratchBuffer.size = size;
 
     VkBufferCreateInfo bufferCreateInfo{};
     bufferCreateInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
     bufferCreateInfo.size = size;
     bufferCreateInfo.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT;
+    shareWithComputeQueue(bufferCreateInfo);
     if (vkCreateBuffer(device, &bufferCreateInfo, nullptr, &scratchBuffer.handle) != VK_SUCCESS) {
         throw std::runtime_error("Failed to create scratch buffer");
     };
@@ -2367,13 +3683,15 @@ RayTracingScratchBuffer VulkanMiragePathtracer::createScratchBuffer(VkDeviceSize
     memoryAllocateInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
     memoryAllocateInfo.pNext = &memoryAllocateFlagsInfo;
     memoryAllocateInfo.allocationSize = memoryRequirements.size;
-    memoryAllocateInfo.memoryTypeIndex = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+    memoryAllocateInfo.memoryTypeIndex = getMemoryType(physicalDevice, memoryRequirements.memoryTypeBits,
+                                                       VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
     if (vkAllocateMemory(device, &memoryAllocateInfo, nullptr, &scratchBuffer.memory)) {
         throw std::runtime_error("Failed to allocate memory");
     };
     if (vkBindBufferMemory(device, scratchBuffer.handle, scratchBuffer.memory, 0)) {
         throw std::runtime_error("Failed to bind buffer memory");
     };
+    vks::ResourceTracker::onCreate(vks::ResourceType::Buffer, size);
 
     VkBufferDeviceAddressInfoKHR bufferDeviceAddressInfo{};
     bufferDeviceAddressInfo.sType = VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO;
@@ -2404,13 +3722,28 @@ uint32_t VulkanMiragePathtracer::getMemoryType(VkPhysicalDevice physicalDevice,
     throw std::runtime_error("failed to find suitable memory type!");
 }
 
-void VulkanMiragePathtracer::createStorageImage() {
+void VulkanMiragePathtracer::createStorageImages() {
+    storageImages.clear();
+    storageImages.resize(MAX_FRAMES_IN_FLIGHT);
+    for (uint32_t frame = 0; frame < storageImages.size(); frame++) {
+        createStorageImage(frame, raytracingOutputExtent());
+    }
+}
+
+void VulkanMiragePathtracer::createStorageImage(uint32_t frame, VkExtent2D extent) {
+    // Every trace transitions its image from UNDEFINED, a new image needs no layout transition of its own
+    vks::Image storageImage;
+    storageImage.device = device;
+    storageImage.deletionQueue = &deletionQueue;
+    storageImage.format = VK_FORMAT_B8G8R8A8_UNORM;
+    storageImage.extent = {extent.width, extent.height, 1};
+
     VkImageCreateInfo image{};
     image.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
     image.imageType = VK_IMAGE_TYPE_2D;
     image.format = VK_FORMAT_B8G8R8A8_UNORM;
-    image.extent.width = 800;
-    image.extent.height = 800;
+    image.extent.width = extent.width;
+    image.extent.height = extent.height;
     image.extent.depth = 1;
     image.mipLevels = 1;
     image.arrayLayers = 1;
@@ -2429,6 +3762,8 @@ void VulkanMiragePathtracer::createStorageImage() {
                                                        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
     VK_CHECK_RESULT(vkAllocateMemory(device, &memoryAllocateInfo, nullptr, &storageImage.memory));
     VK_CHECK_RESULT(vkBindImageMemory(device, storageImage.image, storageImage.memory, 0));
+    storageImage.allocationSize = memReqs.size;
+    vks::ResourceTracker::onCreate(vks::ResourceType::Image, storageImage.allocationSize);
 
     VkImageViewCreateInfo colorImageView{};
     colorImageView.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
@@ -2443,24 +3778,42 @@ void VulkanMiragePathtracer::createStorageImage() {
     colorImageView.image = storageImage.image;
     VK_CHECK_RESULT(vkCreateImageView(device, &colorImageView, nullptr, &storageImage.view));
 
-    VkCommandBuffer cmdBuffer = createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY);
-    setImageLayout(cmdBuffer, storageImage.image,
-                   VK_IMAGE_LAYOUT_UNDEFINED,
-                   VK_IMAGE_LAYOUT_GENERAL,
-                   {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1});
-    flushCommandBuffer(cmdBuffer);
+    // The replaced image goes to the deletion queue
+    storageImages[frame] = std::move(storageImage);
+}
+
+void VulkanMiragePathtracer::writeStorageImageDescriptor(uint32_t frame) {
+    VkDescriptorImageInfo storageImageDescriptor{};
+    storageImageDescriptor.imageView = storageImages[frame].view;
+    storageImageDescriptor.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+    VkWriteDescriptorSet resultImageWrite = writeDescriptorSet(raytracingDescriptorSets[frame],
+                                                               VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1,
+                                                               &storageImageDescriptor);
+    vkUpdateDescriptorSets(device, 1, &resultImageWrite, 0, VK_NULL_HANDLE);
+}
+
+VkExtent2D VulkanMiragePathtracer::raytracingOutputExtent() const {
+    if (headless) {
+        return {config.width, config.height};
+    }
+    return swapChainExtent2;
 }
 
 void VulkanMiragePathtracer::createUniformBuffer() {
-    VK_CHECK_RESULT(createVksBuffer(
-        VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-        &ubo,
-        sizeof(uniformData),
-        &uniformData));
-    VK_CHECK_RESULT(ubo.map());
+    // Each frame in flight writes its own copy, the one a running trace reads is never touched by the CPU
+    ubos.resize(MAX_FRAMES_IN_FLIGHT);
+    for (uint32_t i = 0; i < ubos.size(); i++) {
+        VK_CHECK_RESULT(createVksBuffer(
+            VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+            &ubos[i],
+            sizeof(uniformData),
+            &uniformData));
+        VK_CHECK_RESULT(ubos[i].map());
 
-    updateUniformBuffers();
+        updateUniformBuffers(i);
+    }
 }
 
 void VulkanMiragePathtracer::createShaderBindingTable() {
@@ -2490,6 +3843,19 @@ void VulkanMiragePathtracer::createShaderBindingTable() {
     memcpy(raygenShaderBindingTable.mapped, shaderHandleStorage.data(), handleSize);
     memcpy(missShaderBindingTable.mapped, shaderHandleStorage.data() + handleSizeAligned, handleSize);
     memcpy(hitShaderBindingTable.mapped, shaderHandleStorage.data() + handleSizeAligned * 2, handleSize);
+
+    // The regions never change for the lifetime of the tables, resolve the addresses once
+    shaderBindingTableRegions.raygen.deviceAddress = getBufferDeviceAddress(raygenShaderBindingTable.buffer);
+    shaderBindingTableRegions.raygen.stride = handleSizeAligned;
+    shaderBindingTableRegions.raygen.size = handleSizeAligned;
+    shaderBindingTableRegions.miss.deviceAddress = getBufferDeviceAddress(missShaderBindingTable.buffer);
+    shaderBindingTableRegions.miss.stride = handleSizeAligned;
+    shaderBindingTableRegions.miss.size = handleSizeAligned;
+    shaderBindingTableRegions.hit.deviceAddress = getBufferDeviceAddress(hitShaderBindingTable.buffer);
+    shaderBindingTableRegions.hit.stride = handleSizeAligned;
+    shaderBindingTableRegions.hit.size = handleSizeAligned;
+    shaderBindingTableRegions.callable = {};
+    markRaytracingCommandBuffersDirty();
 }
 
 void VulkanMiragePathtracer::createRayTracingPipeline() {
@@ -2537,7 +3903,7 @@ void VulkanMiragePathtracer::createRayTracingPipeline() {
 
     // Ray generation group
     {
-        string filePath = "C:/Users/redkc/CLionProjects/VulkanMiragePathtracer/res/shaders/raygenRgen.spv";
+        string filePath = "res/shaders/raygenRgen.spv";
         shaderStages.push_back(loadShader(filePath, VK_SHADER_STAGE_RAYGEN_BIT_KHR));
         VkRayTracingShaderGroupCreateInfoKHR shaderGroup{};
         shaderGroup.sType = VK_STRUCTURE_TYPE_RAY_TRACING_SHADER_GROUP_CREATE_INFO_KHR;
@@ -2551,7 +3917,7 @@ void VulkanMiragePathtracer::createRayTracingPipeline() {
 
     // Miss group
     {
-        string filePath = "C:/Users/redkc/CLionProjects/VulkanMiragePathtracer/res/shaders/missRmiss.spv";
+        string filePath = "res/shaders/missRmiss.spv";
 
         shaderStages.push_back(loadShader(filePath, VK_SHADER_STAGE_MISS_BIT_KHR));
         VkRayTracingShaderGroupCreateInfoKHR shaderGroup{};
@@ -2566,7 +3932,7 @@ void VulkanMiragePathtracer::createRayTracingPipeline() {
 
     // Closest hit group
     {
-        string filePath = "C:/Users/redkc/CLionProjects/VulkanMiragePathtracer/res/shaders/closesthitRchit.spv";
+        string filePath = "res/shaders/closesthitRchit.spv";
 
         shaderStages.push_back(loadShader(filePath, VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR));
         VkRayTracingShaderGroupCreateInfoKHR shaderGroup{};
@@ -2730,6 +4096,34 @@ void VulkanMiragePathtracer::setImageLayout(
         1, &imageMemoryBarrier);
 }
 
+void VulkanMiragePathtracer::storageImageBarrier(VkCommandBuffer commandBuffer, VkImage image,
+                                                 VkImageLayout oldLayout, VkImageLayout newLayout,
+                                                 uint32_t srcQueueFamily, uint32_t dstQueueFamily,
+                                                 VkPipelineStageFlags srcStage, VkAccessFlags srcAccess,
+                                                 VkPipelineStageFlags dstStage, VkAccessFlags dstAccess) {
+    VkImageMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.srcAccessMask = srcAccess;
+    barrier.dstAccessMask = dstAccess;
+    barrier.oldLayout = oldLayout;
+    barrier.newLayout = newLayout;
+    barrier.srcQueueFamilyIndex = srcQueueFamily;
+    barrier.dstQueueFamilyIndex = dstQueueFamily;
+    barrier.image = image;
+    barrier.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+
+    vkCmdPipelineBarrier(commandBuffer, srcStage, dstStage, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+}
+
+void VulkanMiragePathtracer::shareWithComputeQueue(VkBufferCreateInfo &createInfo) const {
+    if (graphicsQueueFamily == computeQueueFamily) {
+        return;
+    }
+    createInfo.sharingMode = VK_SHARING_MODE_CONCURRENT;
+    createInfo.queueFamilyIndexCount = static_cast<uint32_t>(sharedQueueFamilies.size());
+    createInfo.pQueueFamilyIndices = sharedQueueFamilies.data();
+}
+
 VkPipelineShaderStageCreateInfo VulkanMiragePathtracer::loadShader(std::string fileName, VkShaderStageFlagBits stage) {
     VkPipelineShaderStageCreateInfo shaderStage = {};
     shaderStage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
@@ -2773,56 +4167,38 @@ VkImageView VulkanMiragePathtracer::createImageView(VkImage image, VkFormat form
 }
 
 void VulkanMiragePathtracer::createDescriptorSets2() {
+    const uint32_t setCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
     std::vector<VkDescriptorPoolSize> poolSizes = {
-        {VK_DESCRIPTOR_TYPE_ACCELERATION_STRUCTURE_KHR, 1},
-        {VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1},
-        {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1}
+        {VK_DESCRIPTOR_TYPE_ACCELERATION_STRUCTURE_KHR, setCount},
+        {VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, setCount},
+        {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, setCount}
     };
     VkDescriptorPoolCreateInfo descriptorPoolCreateInfo{};
     descriptorPoolCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
     descriptorPoolCreateInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
     descriptorPoolCreateInfo.pPoolSizes = poolSizes.data();
-    descriptorPoolCreateInfo.maxSets = 1;
+    descriptorPoolCreateInfo.maxSets = setCount;
     VK_CHECK_RESULT(vkCreateDescriptorPool(device, &descriptorPoolCreateInfo, nullptr, &rayTracingDescriptorPool));
 
+    std::vector<VkDescriptorSetLayout> layouts(setCount, raytracingDescriptorSetLayout);
     VkDescriptorSetAllocateInfo descriptorSetAllocateInfo{};
     descriptorSetAllocateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
     descriptorSetAllocateInfo.descriptorPool = rayTracingDescriptorPool;
-    descriptorSetAllocateInfo.pSetLayouts = &raytracingDescriptorSetLayout;
-    descriptorSetAllocateInfo.descriptorSetCount = 1;
-    VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &descriptorSetAllocateInfo, &raytracingDescriptorSet));
-
-    VkWriteDescriptorSetAccelerationStructureKHR descriptorAccelerationStructureInfo{};
-    descriptorAccelerationStructureInfo.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET_ACCELERATION_STRUCTURE_KHR;
-    descriptorAccelerationStructureInfo.accelerationStructureCount = 1;
-    descriptorAccelerationStructureInfo.pAccelerationStructures = &topLevelAS.handle;
-
-    VkWriteDescriptorSet accelerationStructureWrite{};
-    accelerationStructureWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-    // The specialized acceleration structure descriptor has to be chained
-    accelerationStructureWrite.pNext = &descriptorAccelerationStructureInfo;
-    accelerationStructureWrite.dstSet = raytracingDescriptorSet;
-    accelerationStructureWrite.dstBinding = 0;
-    accelerationStructureWrite.descriptorCount = 1;
-    accelerationStructureWrite.descriptorType = VK_DESCRIPTOR_TYPE_ACCELERATION_STRUCTURE_KHR;
-
-    VkDescriptorImageInfo storageImageDescriptor{};
-    storageImageDescriptor.imageView = storageImage.view;
-    storageImageDescriptor.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
-
-    VkWriteDescriptorSet resultImageWrite = writeDescriptorSet(raytracingDescriptorSet,
-                                                               VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1,
-                                                               &storageImageDescriptor);
-    VkWriteDescriptorSet uniformBufferWrite = writeDescriptorSet(raytracingDescriptorSet,
-                                                                 VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 2, &ubo.descriptor);
-
-    std::vector<VkWriteDescriptorSet> writeDescriptorSets = {
-        accelerationStructureWrite,
-        resultImageWrite,
-        uniformBufferWrite
-    };
-    vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0,
-                           VK_NULL_HANDLE);
+    descriptorSetAllocateInfo.pSetLayouts = layouts.data();
+    descriptorSetAllocateInfo.descriptorSetCount = setCount;
+    raytracingDescriptorSets.resize(setCount);
+    VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &descriptorSetAllocateInfo, raytracingDescriptorSets.data()));
+
+    // Every frame gets its own output image and uniform buffer, the TLAS is shared
+    for (uint32_t i = 0; i < setCount; i++) {
+        writeStorageImageDescriptor(i);
+
+        VkWriteDescriptorSet uniformBufferWrite = writeDescriptorSet(raytracingDescriptorSets[i],
+                                                                     VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 2,
+                                                                     &ubos[i].descriptor);
+        vkUpdateDescriptorSets(device, 1, &uniformBufferWrite, 0, VK_NULL_HANDLE);
+    }
+    updateAccelerationStructureDescriptor();
 }
 
 VkCommandBuffer VulkanMiragePathtracer::
@@ -2851,9 +4227,9 @@ void VulkanMiragePathtracer::flushCommandBuffer(VkCommandBuffer commandBuffer) {
         return;
     }
 
-    if (vkEndCommandBuffer(commandBuffer)) {
+    if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
         throw std::runtime_error("Failed to end command buffer");
-    };
+    }
 
     VkSubmitInfo submitInfo{};
     submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
@@ -2863,29 +4239,162 @@ void VulkanMiragePathtracer::flushCommandBuffer(VkCommandBuffer commandBuffer) {
     VkFenceCreateInfo fenceInfo{};
     fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
     VkFence fence;
-    if (vkCreateFence(device, &fenceInfo, nullptr, &fence));
+    VK_CHECK_RESULT(vkCreateFence(device, &fenceInfo, nullptr, &fence));
     // Submit to the queue
-    if (vkQueueSubmit(presentQueue, 1, &submitInfo, fence));
+    VK_CHECK_RESULT(vkQueueSubmit(graphicsQueue, 1, &submitInfo, fence));
     // Wait for the fence to signal that command buffer has finished executing
-    if (vkWaitForFences(device, 1, &fence, VK_TRUE, UINT64_MAX));
+    VK_CHECK_RESULT(vkWaitForFences(device, 1, &fence, VK_TRUE, UINT64_MAX));
     vkDestroyFence(device, fence, nullptr);
-    if (free) {
+    // Every caller allocated the buffer from commandPool for this one submit
+    vkFreeCommandBuffers(device, commandPool, 1, &commandBuffer);
+}
+
+void VulkanMiragePathtracer::submitCommandBuffer(VkCommandBuffer commandBuffer) {
+    if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to end command buffer");
+    }
+
+    VkSubmitInfo submitInfo{};
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &commandBuffer;
+    // No fence, the frame timeline signaled by later submissions on this queue tells when the work is done
+    if (vkQueueSubmit(graphicsQueue, 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to submit command buffer");
+    }
+
+    deletionQueue.retire([device = device, commandPool = commandPool, commandBuffer]() {
         vkFreeCommandBuffers(device, commandPool, 1, &commandBuffer);
+    });
+}
+
+void VulkanMiragePathtracer::updateUniformBuffers(uint32_t frame) {
+    // Same camera as the CPU backend, with the aspect ratio of the image this frame traces into
+    const VkExtent3D &extent = storageImages[frame].extent;
+    updateUniformBuffers(frame, RaytracingCamera::createDefault(extent.width / (float) extent.height));
+}
+
+void VulkanMiragePathtracer::updateUniformBuffers(uint32_t frame, const RaytracingCamera &camera) {
+    uniformData.projInverse = camera.projInverse;
+    uniformData.viewInverse = camera.viewInverse;
+    memcpy(ubos[frame].mapped, &uniformData, sizeof(uniformData));
+}
+
+void VulkanMiragePathtracer::recordFrameTime() {
+    const auto now = std::chrono::high_resolution_clock::now();
+    if (frameTimeReportStart == std::chrono::high_resolution_clock::time_point{}) {
+        frameTimeReportStart = now;
+        return;
+    }
+    frameTimeSamples++;
+
+    const float elapsed = std::chrono::duration<float, std::chrono::milliseconds::period>(
+        now - frameTimeReportStart).count();
+    if (elapsed >= 1000.0f) {
+        averageFrameTime = elapsed / static_cast<float>(frameTimeSamples);
+        frameTimeReportStart = now;
+        frameTimeSamples = 0;
+    }
+}
+
+void VulkanMiragePathtracer::drawFramePacingUi() {
+    static const char *presentModeNames[] = {"FIFO", "FIFO relaxed", "Mailbox", "Immediate"};
+    int selectedPresentMode = static_cast<int>(presentMode);
+    if (ImGui::Combo("Present mode", &selectedPresentMode, presentModeNames, IM_ARRAYSIZE(presentModeNames))) {
+        presentMode = static_cast<PresentMode>(selectedPresentMode);
+        // The swapchains are in use until this frame is presented, they are recreated before the next one
+        presentModeChanged = true;
+    }
+    if (presentMode != PresentMode::Fifo && activePresentMode == VK_PRESENT_MODE_FIFO_KHR && !presentModeChanged) {
+        ImGui::TextDisabled("Not supported by the surface, using FIFO");
+    }
+
+    int targetFrameRate = static_cast<int>(framePacer.getTargetFrameRate());
+    if (ImGui::SliderInt("Target FPS", &targetFrameRate, 0, 360, targetFrameRate == 0 ? "Unlimited" : "%d")) {
+        framePacer.setTargetFrameRate(static_cast<uint32_t>(targetFrameRate));
+    }
+
+    const FramePacer::Stats &stats = framePacer.getStats();
+    ImGui::Text("Input to submit: %.2f ms", stats.inputToSubmit);
+    ImGui::Text("Submit to present: %.2f ms", stats.submitToPresent);
+    ImGui::Text("Submit to GPU done: %.2f ms", stats.submitToGpuDone);
+    ImGui::Text("Input to GPU done: %.2f ms", stats.inputToGpuDone);
+}
+
+void VulkanMiragePathtracer::drawRasterModeUi() {
+    if (!visibilityBuffer) {
+        ImGui::TextDisabled("Visibility buffer not available");
+        return;
+    }
+
+    // Both modes share the depth buffer and the culler, the next recorded frame simply uses the other one
+    static const char *rasterModeNames[] = {"Forward", "Visibility buffer"};
+    int selectedRasterMode = static_cast<int>(rasterMode);
+    if (ImGui::Combo("Raster mode", &selectedRasterMode, rasterModeNames, IM_ARRAYSIZE(rasterModeNames))) {
+        rasterMode = static_cast<RasterMode>(selectedRasterMode);
+    }
+    if (rasterMode == RasterMode::VisibilityBuffer) {
+        static const char *outputNames[] = {"Shaded", "Instance IDs", "Triangle IDs"};
+        int selectedOutput = static_cast<int>(visibilityOutput);
+        if (ImGui::Combo("Output", &selectedOutput, outputNames, IM_ARRAYSIZE(outputNames))) {
+            visibilityOutput = static_cast<VisibilityBuffer::Output>(selectedOutput);
+        }
+    }
+}
+
+void VulkanMiragePathtracer::drawSceneUi() {
+    // Changing the copy count replaces the instances and rebuilds the TLAS, spinning only refits it
+    if (ImGui::SliderInt("Scene copies", &sceneCopies, 1, maxSceneCopies)) {
+        setSceneInstances(createSceneCopies(static_cast<uint32_t>(sceneCopies)));
     }
+    ImGui::Checkbox("Spin copies", &spinSceneCopies);
 }
 
-void VulkanMiragePathtracer::updateUniformBuffers() {
-    UniformBufferObject ubo2{};
-    
-    uniformData.projInverse = glm::inverse(glm::perspective(glm::radians(90.0f), 800 / (float) 800, 0.1f,100.0f));
-    uniformData.viewInverse =  glm::inverse(glm::lookAt(glm::vec3(2.0f, 2.0f, 2.0f), glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f)));
-    memcpy(ubo.mapped, &uniformData, sizeof(uniformData));
+std::vector<SceneInstance> VulkanMiragePathtracer::createSceneCopies(uint32_t copies) {
+    // Copies are lined up along x, one model width plus a margin apart
+    glm::vec3 min(std::numeric_limits<float>::max());
+    glm::vec3 max(std::numeric_limits<float>::lowest());
+    for (const auto &mesh: model->meshes) {
+        for (const Vertex &vertex: mesh->vertices) {
+            min = glm::min(min, vertex.pos);
+            max = glm::max(max, vertex.pos);
+        }
+    }
+    sceneCopySpacing = min.x <= max.x ? (max.x - min.x) * 1.25f : 1.0f;
+
+    std::vector<SceneInstance> instances;
+    instances.reserve(copies * bottomLevelAccelerationStructures.size());
+    for (uint32_t copy = 0; copy < copies; copy++) {
+        for (size_t i = 0; i < bottomLevelAccelerationStructures.size(); i++) {
+            instances.push_back({static_cast<uint32_t>(i), sceneCopyTransform(copy, 0.0f)});
+        }
+    }
+    sceneCopyAngle = 0.0f;
+    return instances;
+}
+
+glm::mat4 VulkanMiragePathtracer::sceneCopyTransform(uint32_t copy, float angle) const {
+    const glm::mat4 translation = glm::translate(glm::mat4(1.0f), glm::vec3(copy * sceneCopySpacing, 0.0f, 0.0f));
+    return glm::rotate(translation, angle, glm::vec3(0.0f, 0.0f, 1.0f));
+}
+
+void VulkanMiragePathtracer::spinSceneInstances() {
+    // Advances by the measured frame time, so the speed does not depend on the frame rate
+    sceneCopyAngle = std::fmod(sceneCopyAngle + averageFrameTime * 0.001f, glm::two_pi<float>());
+    const size_t meshCount = bottomLevelAccelerationStructures.size();
+    for (size_t i = 0; i < sceneInstances.size(); i++) {
+        setInstanceTransform(i, sceneCopyTransform(static_cast<uint32_t>(i / meshCount), sceneCopyAngle));
+    }
 }
 
 uint32_t VulkanMiragePathtracer::alignedSize(uint32_t value, uint32_t alignment) {
     return (value + alignment - 1) & ~(alignment - 1);
 }
 
+VkDeviceSize VulkanMiragePathtracer::alignedVkSize(VkDeviceSize value, VkDeviceSize alignment) {
+    return (value + alignment - 1) & ~(alignment - 1);
+}
+
 VkShaderModule VulkanMiragePathtracer::toolLoadShader(const char *fileName, VkDevice device) {
     std::ifstream is(fileName, std::ios::binary | std::ios::in | std::ios::ate);
 
@@ -2942,11 +4451,13 @@ VkWriteDescriptorSet VulkanMiragePathtracer::writeDescriptorSet(VkDescriptorSet
 }
 
 void VulkanMiragePathtracer::createDescriptorPool() {
-    std::array<VkDescriptorPoolSize, 2> poolSizes{};
+    std::array<VkDescriptorPoolSize, 3> poolSizes{};
     poolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
     poolSizes[0].descriptorCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
     poolSizes[1].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
     poolSizes[1].descriptorCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT * 2);
+    poolSizes[2].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    poolSizes[2].descriptorCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
     //TODO ensure i don't wase space couse imgui XD
 
     VkDescriptorPoolCreateInfo poolInfo{};
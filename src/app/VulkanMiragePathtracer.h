@@ -32,14 +32,30 @@ assert(res == VK_SUCCESS);
 #include <iostream>
 #include <stdexcept>
 #include <cstdlib>
+#include <memory>
 #include <optional>
 #include <vector>
 
+#include "AccelerationStructureCache.h"
+#include "DeferredOperationPool.h"
+#include "DeletionQueue.h"
+#include "FramePacer.h"
+#include "FrameScheduler.h"
+#include "JobSystem.h"
+#include "OcclusionCuller.h"
+#include "ParallelCommandRecorder.h"
+#include "RaytracingCamera.h"
+#include "ReadbackRing.h"
+#include "RendererConfig.h"
+#include "VisibilityBuffer.h"
 #include "VulkanBuffer.h"
+#include "VulkanResources.h"
 
 struct QueueFamilyIndices {
     std::optional<uint32_t> graphicsFamily;
     std::optional<uint32_t> presentFamily;
+    /** @brief A compute family without graphics when the device has one, so tracing overlaps raster work */
+    std::optional<uint32_t> computeFamily;
 
     bool isComplete() {
         return graphicsFamily.has_value() && presentFamily.has_value();
@@ -59,25 +75,72 @@ struct UniformBufferObject {
     alignas(16) glm::mat4 proj;
 };
 
-// Holds data for a ray tracing scratch buffer that is used as a temporary storage
-struct RayTracingScratchBuffer {
-    uint64_t deviceAddress = 0;
-    VkBuffer handle = VK_NULL_HANDLE;
-    VkDeviceMemory memory = VK_NULL_HANDLE;
+/**
+ * @brief Geometry of one mesh inside the shared vertex and index buffers, every instance of the mesh draws it
+ */
+struct RasterDraw {
+    uint32_t indexCount;
+    uint32_t firstIndex;
+    int32_t vertexOffset;
+    /** @brief Bounds of the mesh's own vertices, moved into world space per instance for culling */
+    glm::vec3 boundsMin;
+    glm::vec3 boundsMax;
 };
 
-// Ray tracing acceleration structure
-struct AccelerationStructure {
-    VkAccelerationStructureKHR handle;
-    uint64_t deviceAddress = 0;
-    VkDeviceMemory memory;
-    VkBuffer buffer;
+/**
+ * @brief Per-instance data of the raster pass, the vertex shader reads it at the firstInstance of its draw record
+ */
+struct RasterDrawData {
+    glm::mat4 model;
+};
+
+/**
+ * @brief Per-instance records of the raster pass for one frame slot, persistently mapped. The draws themselves are
+ * compacted from them on the GPU by the occlusion culler.
+ */
+struct RasterDrawBuffers {
+    /** @brief One CullInstance per scene instance */
+    vks::Buffer instances;
+    /** @brief One RasterDrawData per scene instance */
+    vks::Buffer drawData;
+    uint32_t capacity = 0;
+};
+
+/**
+ * @brief One instance in the top level acceleration structure
+ */
+struct SceneInstance {
+    uint32_t blasIndex;
+    glm::mat4 transform;
+};
+
+/**
+ * @brief Thrown when no physical device supports the extensions the ray tracing pipeline needs, or when a headless
+ * run cannot create a Vulkan instance at all, lets the caller fall back to the CPU backend.
+ */
+class NoSuitableDeviceError : public std::runtime_error {
+public:
+    using std::runtime_error::runtime_error;
 };
 
 class VulkanMiragePathtracer {
 public:
+    VulkanMiragePathtracer() = default;
+
+    explicit VulkanMiragePathtracer(const RendererConfig &config);
+
     void run();
 
+    /**
+     * @brief Moves an instance. The TLAS is refitted in place on the next ray traced frame.
+     */
+    void setInstanceTransform(size_t instanceIndex, const glm::mat4 &transform);
+
+    /**
+     * @brief Replaces all instances. The TLAS is fully rebuilt on the next ray traced frame.
+     */
+    void setSceneInstances(std::vector<SceneInstance> instances);
+
     PFN_vkGetBufferDeviceAddressKHR vkGetBufferDeviceAddressKHR;
     PFN_vkCreateAccelerationStructureKHR vkCreateAccelerationStructureKHR;
     PFN_vkDestroyAccelerationStructureKHR vkDestroyAccelerationStructureKHR;
@@ -85,19 +148,23 @@ public:
     PFN_vkGetAccelerationStructureDeviceAddressKHR vkGetAccelerationStructureDeviceAddressKHR;
     PFN_vkCmdBuildAccelerationStructuresKHR vkCmdBuildAccelerationStructuresKHR;
     PFN_vkBuildAccelerationStructuresKHR vkBuildAccelerationStructuresKHR;
+    PFN_vkCmdWriteAccelerationStructuresPropertiesKHR vkCmdWriteAccelerationStructuresPropertiesKHR;
+    PFN_vkCmdCopyAccelerationStructureKHR vkCmdCopyAccelerationStructureKHR;
+    PFN_vkCmdCopyAccelerationStructureToMemoryKHR vkCmdCopyAccelerationStructureToMemoryKHR;
+    PFN_vkCmdCopyMemoryToAccelerationStructureKHR vkCmdCopyMemoryToAccelerationStructureKHR;
+    PFN_vkGetDeviceAccelerationStructureCompatibilityKHR vkGetDeviceAccelerationStructureCompatibilityKHR;
     PFN_vkCmdTraceRaysKHR vkCmdTraceRaysKHR;
+    PFN_vkCmdDrawIndexedIndirectCountKHR vkCmdDrawIndexedIndirectCountKHR;
     PFN_vkGetRayTracingShaderGroupHandlesKHR vkGetRayTracingShaderGroupHandlesKHR;
     PFN_vkCreateRayTracingPipelinesKHR vkCreateRayTracingPipelinesKHR;
 
     VkPhysicalDeviceRayTracingPipelinePropertiesKHR rayTracingPipelineProperties{};
     VkPhysicalDeviceAccelerationStructureFeaturesKHR accelerationStructureFeatures{};
+    VkPhysicalDeviceAccelerationStructurePropertiesKHR accelerationStructureProperties{};
+    VkPhysicalDeviceIDProperties physicalDeviceIdProperties{};
 
-    struct StorageImage {
-        VkDeviceMemory memory;
-        VkImage image;
-        VkImageView view;
-        VkFormat format;
-    } storageImage;
+    // One per frame in flight, so a trace never writes the image the previous frame is still copying out
+    std::vector<vks::Image> storageImages;
 
 private:
     void initWindow();
@@ -114,13 +181,39 @@ private:
 
     void loadModel();
 
-    void createAccelerationStructure();
-
     void createAccelarationStructure();
 
     void prepareRaytracing();
 
-    void buildCommandBuffers();
+    void createRaytracingCommandBuffers();
+
+    /**
+     * @brief Every frame slot records its trace and copies again the next time it is used
+     */
+    void markRaytracingCommandBuffersDirty();
+
+    /**
+     * @brief Records the trace of a frame slot and its copy to every swapchain image. Resizes the slot's storage
+     * image first when the output extent changed. The frame that last used the slot has to be complete.
+     */
+    void recordRaytracingCommandBuffers(uint32_t frame);
+
+    /**
+     * @brief Records the trace on the compute queue, it hands the storage image over to the graphics queue
+     */
+    void recordTraceCommandBuffer(uint32_t frame);
+
+    /**
+     * @brief Records the trace of a frame slot into its storage image, which is left in the general layout
+     */
+    void recordTraceRays(VkCommandBuffer commandBuffer, uint32_t frame);
+
+    /**
+     * @brief Records the copy of the storage image into the swapchain image on the graphics queue
+     */
+    void recordRaytracingCommandBuffer(uint32_t frame, uint32_t imageIndex);
+
+    uint32_t raytracingCommandBufferIndex(uint32_t frame, uint32_t imageIndex) const;
 
     void initVulkan();
 
@@ -132,8 +225,27 @@ private:
 
     void mainLoop();
 
+    /**
+     * @return False once the application should quit
+     */
+    bool handleEvent(const SDL_Event &event);
+
+    /**
+     * @brief Headless: traces the default camera or every keyframe of the camera path, reads the storage image back
+     * and writes each frame to its output path
+     */
+    void renderToFile();
+
+    /**
+     * @brief Records the trace of a frame slot and the copy of its storage image into the next readback slot
+     */
+    void recordReadback(VkCommandBuffer commandBuffer, uint32_t frame, ReadbackRing &readbackRing,
+                        uint64_t frameValue);
+
     void cleanup();
 
+    void cleanupRaster();
+
     void createRenderPass();
 
     bool checkValidationLayerSupport();
@@ -184,7 +296,7 @@ private:
     void DestroyDebugUtilsMessengerEXT(VkInstance instance, VkDebugUtilsMessengerEXT debugMessenger,
                                        const VkAllocationCallbacks *pAllocator);
 
-    SwapChainSupportDetails querySwapChainSupport(VkPhysicalDevice device);
+    SwapChainSupportDetails querySwapChainSupport(VkPhysicalDevice device, VkSurfaceKHR presentSurface);
 
     VkSurfaceFormatKHR chooseSwapSurfaceFormat(const std::vector<VkSurfaceFormatKHR> &availableFormats);
 
@@ -196,6 +308,17 @@ private:
 
     void createSwapChain2();
 
+    /**
+     * @brief Recreates the ray traced window's swapchain and the copies recorded against its images. Frames in flight
+     * keep presenting from the old swapchain, it is destroyed once they have completed.
+     */
+    void recreateRaytracingSwapChain();
+
+    /**
+     * @brief Recreates both swapchains with the present mode picked in the UI
+     */
+    void applyPresentMode();
+
     void createFramebuffers();
 
     void createCommandPool();
@@ -210,11 +333,69 @@ private:
 
     void recordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t imageIndex);
 
+    /**
+     * @brief Draws one of the culler's draw lists with one indirect count draw, the commands recorded do not grow
+     * with the scene
+     *
+     * @param pipeline The forward pipeline, or the visibility buffer's ID pipeline
+     */
+    void recordRasterDraws(VkCommandBuffer commandBuffer, VkPipeline pipeline, OcclusionCuller::Phase phase);
+
+    /**
+     * @brief Begins one of the two render passes of the raster frame with secondary buffer contents
+     */
+    void beginRasterRenderPass(VkCommandBuffer commandBuffer, VkRenderPass pass, uint32_t imageIndex);
+
+    void createRasterDrawBuffers();
+
+    /**
+     * @brief Grows the instance record buffers of a frame slot and points its descriptor set and the culler at them
+     */
+    void allocateRasterDrawBuffers(uint32_t frame, uint32_t capacity);
+
+    /**
+     * @brief Writes one instance record per scene instance into the buffers of a frame slot
+     */
+    void writeRasterDrawRecords(uint32_t frame);
+
     void recordCommandBuffer2(VkCommandBuffer commandBuffer, uint32_t imageIndex);
 
+    /**
+     * @brief Waits for the frame slot and acquires both swapchain images, before any input of the frame is read
+     */
+    void acquireFrame();
+
+    /**
+     * @brief Updates the uniforms, records and submits the frame acquired by acquireFrame() and presents it
+     */
     void drawFrame();
 
-    void drawFrame2();
+    /**
+     * @brief Present mode, frame rate target and the latency measured by the frame pacer
+     */
+    void drawFramePacingUi();
+
+    /**
+     * @brief Forward or visibility buffer shading of the raster window, and what the visibility buffer shows
+     */
+    void drawRasterModeUi();
+
+    /**
+     * @brief Number of copies of the model and whether they spin, drives setSceneInstances and setInstanceTransform
+     */
+    void drawSceneUi();
+
+    /**
+     * @brief One instance per mesh for each copy, the copies side by side
+     */
+    std::vector<SceneInstance> createSceneCopies(uint32_t copies);
+
+    glm::mat4 sceneCopyTransform(uint32_t copy, float angle) const;
+
+    /**
+     * @brief Rotates every copy a little further, only the transforms change so the TLAS is refitted
+     */
+    void spinSceneInstances();
 
     void createSyncObjects();
 
@@ -224,6 +405,16 @@ private:
 
     void cleanupSwapChain();
 
+    void cleanupRaytracing();
+
+    void reportLeakedResources();
+
+    void retireSwapChainResources(VkSwapchainKHR oldSwapChain);
+
+    uint64_t completedFrameValue() const;
+
+    void collectRetiredResources();
+
     void createVertexBuffer();
 
     uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties);
@@ -242,6 +433,12 @@ private:
     void createImage(uint32_t width, uint32_t height, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage,
                      VkMemoryPropertyFlags properties, VkImage &image, VkDeviceMemory &imageMemory);
 
+    /**
+     * @brief Device local, optimally tiled image owned by a wrapper that retires through the deletion queue. The
+     * view is left to the caller.
+     */
+    vks::Image createVksImage(uint32_t width, uint32_t height, VkFormat format, VkImageUsageFlags usage);
+
     void transitionImageLayout(VkImage image, VkFormat format, VkImageLayout oldLayout, VkImageLayout newLayout);
 
     void copyBufferToImage(VkBuffer buffer, VkImage image, uint32_t width, uint32_t height);
@@ -254,32 +451,112 @@ private:
 
     void createUniformBuffers();
 
-    void createAccelerationStructureBuffer(AccelerationStructure &accelerationStructure,
-                                           VkAccelerationStructureBuildSizesInfoKHR buildSizeInfo);
-
-    void deleteScratchBuffer(RayTracingScratchBuffer &scratchBuffer);
+    void createAccelerationStructureBuffer(vks::AccelerationStructure &accelerationStructure,
+                                           VkAccelerationStructureBuildSizesInfoKHR buildSizeInfo,
+                                           VkMemoryPropertyFlags memoryPropertyFlags =
+                                                   VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
 
     VkCommandBuffer beginSingleTimeCommands();
 
     void endSingleTimeCommands(VkCommandBuffer commandBuffer);
 
-    void createBottomLevelAccelerationStructure();
+    /**
+     * @brief Builds one bottom level acceleration structure per mesh.
+     *
+     * All meshes share the combined vertex and index buffers and a single scratch buffer, and every build is
+     * recorded into the same vkCmdBuildAccelerationStructuresKHR call. A host build is joined before returning,
+     * it runs on every core but still during initialization, nothing renders until it has finished.
+     */
+    void createBottomLevelAccelerationStructures();
+
+    /**
+     * @brief Replaces every bottom level acceleration structure with a compacted copy.
+     *
+     * @param queryPool Holds the compacted sizes written after the build, one query per BLAS.
+     */
+    void compactBottomLevelAccelerationStructures(VkQueryPool queryPool);
+
+    void queryBottomLevelDeviceAddresses();
+
+    AccelerationStructureCache::Key createAccelerationStructureCacheKey(
+        const std::vector<Vertex> &vertices, const std::vector<uint32_t> &indices,
+        const std::vector<VkAccelerationStructureBuildRangeInfoKHR> &buildRanges) const;
+
+    /**
+     * @brief Deserializes the bottom level acceleration structures from the cache.
+     *
+     * @return False when there is no usable cache for the key, nothing is created then.
+     */
+    bool loadCachedBottomLevelAccelerationStructures(const AccelerationStructureCache::Key &key, size_t blasCount);
+
+    /**
+     * @brief Serializes the freshly built bottom level acceleration structures into the cache. Waits for the GPU.
+     */
+    void storeBottomLevelAccelerationStructureCache(const AccelerationStructureCache::Key &key);
 
     /*
 		The top level acceleration structure contains the scene's object instances
 	*/
     void createTopLevelAccelerationStructure();
 
+    /**
+     * @brief (Re)creates the TLAS, its per frame instance buffers and its scratch buffer for up to instanceCapacity instances.
+     */
+    void allocateTopLevelAccelerationStructure(uint32_t instanceCapacity);
+
+    /**
+     * @brief Writes the instances into the frame's instance buffer and records a TLAS build or in-place update.
+     */
+    void recordTopLevelAccelerationStructureBuild(VkCommandBuffer commandBuffer, uint32_t frame,
+                                                  VkBuildAccelerationStructureModeKHR mode);
+
+    /**
+     * @brief Records the TLAS work needed for this frame.
+     *
+     * @return The command buffer to submit ahead of the trace, or VK_NULL_HANDLE when nothing changed.
+     */
+    VkCommandBuffer updateTopLevelAccelerationStructure(uint32_t frame);
+
+    void updateAccelerationStructureDescriptor();
+
     VkResult createVksBuffer(VkBufferUsageFlags usageFlags, VkMemoryPropertyFlags memoryPropertyFlags,
                              vks::Buffer *buffer, VkDeviceSize size, void *data);
 
-    RayTracingScratchBuffer createScratchBuffer(VkDeviceSize size);
+    vks::ScratchBuffer createScratchBuffer(VkDeviceSize size);
 
     uint64_t getBufferDeviceAddress(VkBuffer buffer);
 
     uint32_t getMemoryType(VkPhysicalDevice physicalDevice, uint32_t typeFilter, VkMemoryPropertyFlags properties);
 
-    void createStorageImage();
+    void createStorageImages();
+
+    /**
+     * @brief Replaces the storage image of a frame slot, the old one is destroyed once its last frame has completed
+     */
+    void createStorageImage(uint32_t frame, VkExtent2D extent);
+
+    void writeStorageImageDescriptor(uint32_t frame);
+
+    /**
+     * @brief Size of the ray traced output: the ray traced window, or the configured size when headless
+     */
+    VkExtent2D raytracingOutputExtent() const;
+
+    /**
+     * @brief Transitions a storage image and, when tracing runs on its own queue family, releases or acquires it.
+     *
+     * The release is recorded on the source queue and the matching acquire, with the same layouts, on the
+     * destination queue. With a single family it is a plain layout transition.
+     */
+    void storageImageBarrier(VkCommandBuffer commandBuffer, VkImage image, VkImageLayout oldLayout,
+                             VkImageLayout newLayout, uint32_t srcQueueFamily, uint32_t dstQueueFamily,
+                             VkPipelineStageFlags srcStage, VkAccessFlags srcAccess, VkPipelineStageFlags dstStage,
+                             VkAccessFlags dstAccess);
+
+    /**
+     * @brief Buffers read by the ray tracing passes are shared by the graphics and compute families
+     */
+    void shareWithComputeQueue(VkBufferCreateInfo &createInfo) const;
 
     void createUniformBuffer();
 
@@ -297,12 +574,30 @@ private:
     VkPipelineShaderStageCreateInfo loadShader(std::string fileName, VkShaderStageFlagBits stage);
 
     const int MAX_FRAMES_IN_FLIGHT = 2;
+    /** @brief Readback slots of a headless render, frames beyond the two traced at once are being encoded */
+    static constexpr uint32_t readbackRingSize = 4;
     const int minImages = 2;
 
     bool framebufferResized = false;
     bool isMinimized = false;
-
-    vks::Buffer ubo;
+    bool raytracingWindowResized = false;
+    bool raytracingWindowMinimized = false;
+    PresentMode presentMode = PresentMode::Fifo;
+    /** @brief What the surface actually gave us for presentMode */
+    VkPresentModeKHR activePresentMode = VK_PRESENT_MODE_FIFO_KHR;
+    bool presentModeChanged = false;
+    /** @brief Switched back to Forward when the device cannot run the visibility buffer */
+    RasterMode rasterMode = RasterMode::Forward;
+    /** @brief Shading, or the instance or triangle IDs as an AOV */
+    VisibilityBuffer::Output visibilityOutput = VisibilityBuffer::Output::Shaded;
+    FramePacer framePacer;
+    /** @brief Swapchain images of the frame between acquireFrame() and drawFrame() */
+    uint32_t acquiredImageIndex = 0;
+    uint32_t acquiredRaytracingImageIndex = 0;
+    bool rasterImageAcquired = false;
+    bool raytracingImageAcquired = false;
+
+    std::vector<vks::Buffer> ubos;
 
     VkTransformMatrixKHR glmMat4ToVkTransformMatrixKHR(const glm::mat4& mat);
 
@@ -311,21 +606,57 @@ private:
         glm::mat4 projInverse;
     } uniformData;
     
-    const uint32_t WIDTH = 800;
-    const uint32_t HEIGHT = 600;
+    RendererConfig config;
+    /** @brief Set when rendering to a file, no SDL window, surface, swapchain or raster pass is created */
+    bool headless = false;
     Model *model;
-    VkBuffer vertexBuffer;
+    vks::Buffer vertexBuffer;
     vks::Buffer vertexBuffer2;
     vks::Buffer indexBuffer2;
     vks::Buffer unformBuffer2;
-    VkDeviceMemory vertexBufferMemory;
-
 
-    AccelerationStructure bottomLevelAS;
-    AccelerationStructure topLevelAS{};
 
-    VkBuffer lowASBuffer;
-    VkDeviceMemory lowASBufferMemory;
+    /** @brief One bottom level acceleration structure per mesh with triangles, in the order of blasMeshIndices */
+    std::vector<vks::AccelerationStructure> bottomLevelAccelerationStructures;
+    /** @brief Index into model->meshes of every BLAS, meshes without triangles are skipped */
+    std::vector<uint32_t> blasMeshIndices;
+    /** @brief Static geometry is built with ALLOW_COMPACTION and copied into right-sized buffers */
+    bool compactAccelerationStructures = true;
+    bool useAccelerationStructureCache = true;
+    /**
+     * @brief Build BLASes on the CPU when the implementation reports accelerationStructureHostCommands.
+     *
+     * Mostly software implementations do, there the device build is just as much CPU work but on a single thread.
+     * Discrete GPUs always build on the device. The build is joined during initialization either way, it does not
+     * overlap the first frames.
+     */
+    bool preferHostAccelerationStructureBuilds = true;
+    bool useHostAccelerationStructureBuilds = false;
+    std::unique_ptr<DeferredOperationPool> deferredOperationPool;
+    AccelerationStructureCache accelerationStructureCache{config.cacheDirectoryPath()};
+    /** @brief Serialized acceleration structure data has to live at 256 byte aligned device addresses */
+    static constexpr VkDeviceSize serializedDataAlignment = 256;
+    vks::AccelerationStructure topLevelAS;
+
+    std::vector<SceneInstance> sceneInstances;
+    std::vector<vks::Buffer> instanceBuffers;
+    std::vector<vks::CommandBuffer> tlasUpdateCmdBuffers;
+    vks::ScratchBuffer tlasScratchBuffer;
+    const VkBuildAccelerationStructureFlagsKHR tlasBuildFlags =
+            VK_BUILD_ACCELERATION_STRUCTURE_PREFER_FAST_TRACE_BIT_KHR |
+            VK_BUILD_ACCELERATION_STRUCTURE_ALLOW_UPDATE_BIT_KHR;
+    uint32_t tlasInstanceCapacity = 0;
+    uint32_t tlasBuiltInstanceCount = 0;
+    uint32_t tlasFramesSinceRebuild = 0;
+    /** @brief Refits degrade the tree, so after this many updates in a row the TLAS is rebuilt from scratch */
+    uint32_t tlasRebuildInterval = 120;
+    bool tlasTransformsDirty = false;
+    bool tlasTopologyDirty = false;
+    static constexpr int maxSceneCopies = 64;
+    int sceneCopies = 1;
+    bool spinSceneCopies = false;
+    float sceneCopySpacing = 1.0f;
+    float sceneCopyAngle = 0.0f;
 
 
     ImGuiIO io;
@@ -334,46 +665,70 @@ private:
     };
     ImVec4 clear_color = ImVec4(0.45f, 0.55f, 0.60f, 1.00f);
     ImGui_ImplVulkanH_Window imguiWindow;
-    VkImage depthImage;
-    VkDeviceMemory depthImageMemory;
-    VkImageView depthImageView;
+    /** @brief Replaced on every swapchain recreation, the old one retires with the frames still using it */
+    vks::Image depthImage;
 
     VkImageView createImageView(VkImage image, VkFormat format, VkImageAspectFlags aspectFlags);
 
     bool rasteryzation = true;
     
-    VkImageView textureImageView;
     VkSampler textureSampler;
     VkPipelineStageFlags sourceStage;
     VkPipelineStageFlags destinationStage;
-    VkBuffer indexBuffer;
-    VkDeviceMemory indexBufferMemory;
-    VkImage textureImage;
-    VkDeviceMemory textureImageMemory;
+    vks::Buffer indexBuffer;
+    vks::Image textureImage;
     VkBuffer stagingBuffer;
     VkDeviceMemory stagingBufferMemory;
     VkDescriptorPool descriptorPool;
     VkDescriptorPool rayTracingDescriptorPool;
     std::vector<VkDescriptorSet> descriptorSets;
-    std::vector<VkBuffer> uniformBuffers;
-    std::vector<VkDeviceMemory> uniformBuffersMemory;
-    std::vector<void *> uniformBuffersMapped;
+    /** @brief Persistently mapped, one per frame in flight */
+    std::vector<vks::Buffer> uniformBuffers;
     VkDescriptorSetLayout descriptorSetLayout;
     VkPipelineLayout pipelineLayout;
     uint32_t currentFrame = 0;
-    uint32_t currentFrame2 = 0;
     std::vector<VkSemaphore> imageAvailableSemaphores;
     std::vector<VkSemaphore> renderFinishedSemaphores;
-    std::vector<VkFence> inFlightFences;
     std::vector<VkSemaphore> imageAvailableSemaphores2;
     std::vector<VkSemaphore> renderFinishedSemaphores2;
-    std::vector<VkFence> inFlightFences2;
-    std::vector<VkCommandBuffer> commandBuffers;
-    std::vector<VkCommandBuffer> drawCmdBuffers;
+    // Signals the deletion queue frame value on a timeline once a frame completes, for raster and ray tracing
+    std::unique_ptr<FrameScheduler> frameScheduler;
+    DeletionQueue deletionQueue;
+    std::chrono::high_resolution_clock::time_point frameTimeReportStart{};
+    uint32_t frameTimeSamples = 0;
+    float averageFrameTime = 0.0f;
+    std::unique_ptr<JobSystem> jobSystem;
+    /** @brief One per mesh in the order of model->meshes, a scene instance finds its draw through blasMeshIndices */
+    std::vector<RasterDraw> rasterDraws;
+    std::vector<RasterDrawBuffers> rasterDrawBuffers;
+    /** @brief Per frame slot, set when the scene instances change */
+    std::vector<bool> rasterDrawRecordsDirty;
+    std::unique_ptr<OcclusionCuller> occlusionCuller;
+    /** @brief Projection, view and model of the raster camera, the culler tests the world space bounds with it */
+    glm::mat4 rasterViewProjection{1.0f};
+    /** @brief Counters of the last completed raster frame */
+    OcclusionCuller::Stats cullStats{};
+    /** @brief Null on devices without the visibility buffer's requirements */
+    std::unique_ptr<VisibilityBuffer> visibilityBuffer;
+    /** @brief Secondary buffers and pools of the raster pass, per frame slot */
+    std::unique_ptr<ParallelCommandRecorder> rasterRecorder;
+    /** @brief Copies of the ray traced output, one per frame slot and swapchain image, on the graphics queue */
+    std::vector<vks::CommandBuffer> drawCmdBuffers;
+    /** @brief One trace per frame slot, on the compute queue */
+    std::vector<vks::CommandBuffer> traceCmdBuffers;
     VkCommandPool commandPool;
+    /** @brief Compute family, for the trace and the acceleration structure updates */
     VkCommandPool raytracingCommandPool;
+    /** @brief Graphics family, for the copies into the ray traced swapchain */
+    VkCommandPool raytracingCopyCommandPool;
     VkPipeline graphicsPipeline;
+    /** @brief Clears and draws what was visible last frame, leaves the depth for the depth pyramid */
     VkRenderPass renderPass;
+    /**
+     * @brief Compatible with renderPass, loads its output and draws the disoccluded instances and the UI. After the
+     * visibility buffer's resolve it only draws the UI.
+     */
+    VkRenderPass lateRenderPass;
     VkRenderPass raytracingRenderPass;
     std::vector<VkFramebuffer> swapChainFramebuffers;
     std::vector<VkFramebuffer> raytracingSwapChainFramebuffers;
@@ -383,10 +738,18 @@ private:
     VkExtent2D swapChainExtent2;
     std::vector<VkImage> swapChainImages;
     std::vector<VkImage> raycastSwapChainImages;
-    VkSwapchainKHR swapChain;
-    VkSwapchainKHR raycastingSwapChain;
+    VkSwapchainKHR swapChain = VK_NULL_HANDLE;
+    VkSwapchainKHR raycastingSwapChain = VK_NULL_HANDLE;
     VkQueue presentQueue;
     VkQueue graphicsQueue;
+    /** @brief Same as graphicsQueue when the device has no separate compute family */
+    VkQueue computeQueue;
+    uint32_t graphicsQueueFamily = 0;
+    uint32_t computeQueueFamily = 0;
+    std::array<uint32_t, 2> sharedQueueFamilies{};
+    /** @brief Queue indices of the frame scheduler passes */
+    static constexpr uint32_t graphicsQueueSlot = 0;
+    static constexpr uint32_t computeQueueSlot = 1;
     VkDevice device;
     VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
     SDL_Window *window;
@@ -398,9 +761,19 @@ private:
 
     VkPipeline raytracingPipeline;
     VkPipelineLayout raytracingPipelineLayout;
-    VkDescriptorSet raytracingDescriptorSet;
+    std::vector<VkDescriptorSet> raytracingDescriptorSets;
     VkDescriptorSetLayout raytracingDescriptorSetLayout;
 
+    struct ShaderBindingTableRegions {
+        VkStridedDeviceAddressRegionKHR raygen{};
+        VkStridedDeviceAddressRegionKHR miss{};
+        VkStridedDeviceAddressRegionKHR hit{};
+        VkStridedDeviceAddressRegionKHR callable{};
+    } shaderBindingTableRegions;
+    // Set whenever the pipeline, the shader binding table or a descriptor bound by the trace changes. Per frame
+    // slot, a slot is recorded again once the frame that last used it has completed.
+    std::vector<bool> raytracingCommandBuffersDirty;
+
     vks::Buffer raygenShaderBindingTable;
     vks::Buffer missShaderBindingTable;
     vks::Buffer hitShaderBindingTable;
@@ -411,10 +784,21 @@ private:
 
     void flushCommandBuffer(VkCommandBuffer commandBuffer);
 
-    void updateUniformBuffers();
+    void submitCommandBuffer(VkCommandBuffer commandBuffer);
+
+    void updateUniformBuffers(uint32_t frame);
+
+    void updateUniformBuffers(uint32_t frame, const RaytracingCamera &camera);
+
+    /**
+     * @brief Accumulates the CPU time between frames and updates the average shown in the UI once per second
+     */
+    void recordFrameTime();
 
     static uint32_t alignedSize(uint32_t value, uint32_t alignment);
 
+    static VkDeviceSize alignedVkSize(VkDeviceSize value, VkDeviceSize alignment);
+
     std::vector<VkRayTracingShaderGroupCreateInfoKHR> shaderGroups{};
 
     VkShaderModule toolLoadShader(const char *fileName, VkDevice device);
@@ -0,0 +1,227 @@
+//
+// Created by redkc on 19/10/2026.
+//
+
+#include "VulkanResources.h"
+
+#include <utility>
+
+namespace vks {
+    std::array<std::atomic<int64_t>, ResourceTracker::typeCount> ResourceTracker::counts{};
+    std::array<std::atomic<int64_t>, ResourceTracker::typeCount> ResourceTracker::bytes{};
+
+    void ResourceTracker::onCreate(ResourceType type, VkDeviceSize size) {
+        counts[static_cast<size_t>(type)] += 1;
+        bytes[static_cast<size_t>(type)] += static_cast<int64_t>(size);
+    }
+
+    void ResourceTracker::onRelease(ResourceType type, VkDeviceSize size) {
+        counts[static_cast<size_t>(type)] -= 1;
+        bytes[static_cast<size_t>(type)] -= static_cast<int64_t>(size);
+    }
+
+    int64_t ResourceTracker::liveCount(ResourceType type) {
+        return counts[static_cast<size_t>(type)];
+    }
+
+    int64_t ResourceTracker::liveBytes(ResourceType type) {
+        return bytes[static_cast<size_t>(type)];
+    }
+
+    int64_t ResourceTracker::totalLiveCount() {
+        int64_t total = 0;
+        for (const auto &count: counts) {
+            total += count;
+        }
+        return total;
+    }
+
+    const char *ResourceTracker::name(ResourceType type) {
+        switch (type) {
+            case ResourceType::Buffer:
+                return "buffer";
+            case ResourceType::Image:
+                return "image";
+            case ResourceType::AccelerationStructure:
+                return "acceleration structure";
+            case ResourceType::CommandBuffer:
+                return "command buffer";
+            default:
+                return "unknown";
+        }
+    }
+
+    void DeviceResource::release(std::function<void()> &&deleter) const {
+        if (deletionQueue != nullptr) {
+            deletionQueue->retire(std::move(deleter));
+        } else {
+            deleter();
+        }
+    }
+
+    // ---- Image ----
+    Image::Image(Image &&other) noexcept {
+        *this = std::move(other);
+    }
+
+    Image &Image::operator=(Image &&other) noexcept {
+        if (this != &other) {
+            destroy();
+            device = other.device;
+            deletionQueue = other.deletionQueue;
+            image = std::exchange(other.image, VK_NULL_HANDLE);
+            memory = std::exchange(other.memory, VK_NULL_HANDLE);
+            view = std::exchange(other.view, VK_NULL_HANDLE);
+            format = other.format;
+            extent = other.extent;
+            allocationSize = std::exchange(other.allocationSize, 0);
+        }
+        return *this;
+    }
+
+    Image::~Image() {
+        destroy();
+    }
+
+    void Image::destroy() {
+        if (image == VK_NULL_HANDLE && memory == VK_NULL_HANDLE && view == VK_NULL_HANDLE) {
+            return;
+        }
+        ResourceTracker::onRelease(ResourceType::Image, allocationSize);
+        release([device = device, image = image, memory = memory, view = view]() {
+            if (view) {
+                vkDestroyImageView(device, view, nullptr);
+            }
+            if (image) {
+                vkDestroyImage(device, image, nullptr);
+            }
+            if (memory) {
+                vkFreeMemory(device, memory, nullptr);
+            }
+        });
+        image = VK_NULL_HANDLE;
+        memory = VK_NULL_HANDLE;
+        view = VK_NULL_HANDLE;
+        allocationSize = 0;
+    }
+
+    // ---- ScratchBuffer ----
+    ScratchBuffer::ScratchBuffer(ScratchBuffer &&other) noexcept {
+        *this = std::move(other);
+    }
+
+    ScratchBuffer &ScratchBuffer::operator=(ScratchBuffer &&other) noexcept {
+        if (this != &other) {
+            destroy();
+            device = other.device;
+            deletionQueue = other.deletionQueue;
+            deviceAddress = std::exchange(other.deviceAddress, 0);
+            handle = std::exchange(other.handle, VK_NULL_HANDLE);
+            memory = std::exchange(other.memory, VK_NULL_HANDLE);
+            size = std::exchange(other.size, 0);
+        }
+        return *this;
+    }
+
+    ScratchBuffer::~ScratchBuffer() {
+        destroy();
+    }
+
+    void ScratchBuffer::destroy() {
+        if (handle == VK_NULL_HANDLE && memory == VK_NULL_HANDLE) {
+            return;
+        }
+        ResourceTracker::onRelease(ResourceType::Buffer, size);
+        release([device = device, handle = handle, memory = memory]() {
+            if (handle) {
+                vkDestroyBuffer(device, handle, nullptr);
+            }
+            if (memory) {
+                vkFreeMemory(device, memory, nullptr);
+            }
+        });
+        handle = VK_NULL_HANDLE;
+        memory = VK_NULL_HANDLE;
+        deviceAddress = 0;
+        size = 0;
+    }
+
+    // ---- AccelerationStructure ----
+    AccelerationStructure::AccelerationStructure(AccelerationStructure &&other) noexcept {
+        *this = std::move(other);
+    }
+
+    AccelerationStructure &AccelerationStructure::operator=(AccelerationStructure &&other) noexcept {
+        if (this != &other) {
+            destroy();
+            device = other.device;
+            deletionQueue = other.deletionQueue;
+            handle = std::exchange(other.handle, VK_NULL_HANDLE);
+            deviceAddress = std::exchange(other.deviceAddress, 0);
+            memory = std::exchange(other.memory, VK_NULL_HANDLE);
+            buffer = std::exchange(other.buffer, VK_NULL_HANDLE);
+            size = std::exchange(other.size, 0);
+            destroyFunction = other.destroyFunction;
+        }
+        return *this;
+    }
+
+    AccelerationStructure::~AccelerationStructure() {
+        destroy();
+    }
+
+    void AccelerationStructure::destroy() {
+        if (handle == VK_NULL_HANDLE && buffer == VK_NULL_HANDLE && memory == VK_NULL_HANDLE) {
+            return;
+        }
+        ResourceTracker::onRelease(ResourceType::AccelerationStructure, size);
+        release([device = device, handle = handle, buffer = buffer, memory = memory,
+                    destroyFunction = destroyFunction]() {
+            if (handle && destroyFunction) {
+                destroyFunction(device, handle, nullptr);
+            }
+            if (buffer) {
+                vkDestroyBuffer(device, buffer, nullptr);
+            }
+            if (memory) {
+                vkFreeMemory(device, memory, nullptr);
+            }
+        });
+        handle = VK_NULL_HANDLE;
+        deviceAddress = 0;
+        memory = VK_NULL_HANDLE;
+        buffer = VK_NULL_HANDLE;
+        size = 0;
+    }
+
+    // ---- CommandBuffer ----
+    CommandBuffer::CommandBuffer(CommandBuffer &&other) noexcept {
+        *this = std::move(other);
+    }
+
+    CommandBuffer &CommandBuffer::operator=(CommandBuffer &&other) noexcept {
+        if (this != &other) {
+            destroy();
+            device = other.device;
+            deletionQueue = other.deletionQueue;
+            pool = other.pool;
+            handle = std::exchange(other.handle, VK_NULL_HANDLE);
+        }
+        return *this;
+    }
+
+    CommandBuffer::~CommandBuffer() {
+        destroy();
+    }
+
+    void CommandBuffer::destroy() {
+        if (handle == VK_NULL_HANDLE) {
+            return;
+        }
+        ResourceTracker::onRelease(ResourceType::CommandBuffer, 0);
+        release([device = device, pool = pool, handle = handle]() {
+            vkFreeCommandBuffers(device, pool, 1, &handle);
+        });
+        handle = VK_NULL_HANDLE;
+    }
+}
@@ -0,0 +1,145 @@
+//
+// Created by redkc on 19/10/2026.
+//
+
+#ifndef VULKANRESOURCES_H
+#define VULKANRESOURCES_H
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+
+#include "vulkan/vulkan.h"
+#include "DeletionQueue.h"
+
+namespace vks {
+    enum class ResourceType {
+        Buffer,
+        Image,
+        AccelerationStructure,
+        CommandBuffer,
+        Count
+    };
+
+    /**
+     * @brief Counts the live GPU objects created through the owning wrappers below.
+     *
+     * Every wrapper reports its creation and its release, so after shutdown all counters have to be back at zero.
+     * Anything else is a leak.
+     */
+    class ResourceTracker {
+    public:
+        static void onCreate(ResourceType type, VkDeviceSize bytes);
+
+        static void onRelease(ResourceType type, VkDeviceSize bytes);
+
+        static int64_t liveCount(ResourceType type);
+
+        static int64_t liveBytes(ResourceType type);
+
+        static int64_t totalLiveCount();
+
+        static const char *name(ResourceType type);
+
+    private:
+        static constexpr size_t typeCount = static_cast<size_t>(ResourceType::Count);
+        static std::array<std::atomic<int64_t>, typeCount> counts;
+        static std::array<std::atomic<int64_t>, typeCount> bytes;
+    };
+
+    /**
+     * @brief Common state of the owning wrappers.
+     *
+     * When a deletion queue is set, releasing hands the Vulkan handles off to it so they are destroyed once the GPU
+     * has finished the frame that last used them. Without a queue the handles are destroyed immediately.
+     */
+    struct DeviceResource {
+        VkDevice device = VK_NULL_HANDLE;
+        DeletionQueue *deletionQueue = nullptr;
+
+    protected:
+        void release(std::function<void()> &&deleter) const;
+    };
+
+    /**
+     * @brief Move-only image with its backing memory and a default view
+     */
+    struct Image : DeviceResource {
+        VkImage image = VK_NULL_HANDLE;
+        VkDeviceMemory memory = VK_NULL_HANDLE;
+        VkImageView view = VK_NULL_HANDLE;
+        VkFormat format = VK_FORMAT_UNDEFINED;
+        VkExtent3D extent = {0, 0, 0};
+        VkDeviceSize allocationSize = 0;
+
+        Image() = default;
+        Image(const Image &) = delete;
+        Image &operator=(const Image &) = delete;
+        Image(Image &&other) noexcept;
+        Image &operator=(Image &&other) noexcept;
+        ~Image();
+
+        void destroy();
+    };
+
+    /**
+     * @brief Move-only scratch buffer used while building acceleration structures
+     */
+    struct ScratchBuffer : DeviceResource {
+        uint64_t deviceAddress = 0;
+        VkBuffer handle = VK_NULL_HANDLE;
+        VkDeviceMemory memory = VK_NULL_HANDLE;
+        VkDeviceSize size = 0;
+
+        ScratchBuffer() = default;
+        ScratchBuffer(const ScratchBuffer &) = delete;
+        ScratchBuffer &operator=(const ScratchBuffer &) = delete;
+        ScratchBuffer(ScratchBuffer &&other) noexcept;
+        ScratchBuffer &operator=(ScratchBuffer &&other) noexcept;
+        ~ScratchBuffer();
+
+        void destroy();
+    };
+
+    /**
+     * @brief Move-only acceleration structure together with the buffer it lives in
+     */
+    struct AccelerationStructure : DeviceResource {
+        VkAccelerationStructureKHR handle = VK_NULL_HANDLE;
+        uint64_t deviceAddress = 0;
+        VkDeviceMemory memory = VK_NULL_HANDLE;
+        VkBuffer buffer = VK_NULL_HANDLE;
+        VkDeviceSize size = 0;
+        /** @brief The extension entry point has to be loaded at runtime, so the wrapper carries it around */
+        PFN_vkDestroyAccelerationStructureKHR destroyFunction = nullptr;
+
+        AccelerationStructure() = default;
+        AccelerationStructure(const AccelerationStructure &) = delete;
+        AccelerationStructure &operator=(const AccelerationStructure &) = delete;
+        AccelerationStructure(AccelerationStructure &&other) noexcept;
+        AccelerationStructure &operator=(AccelerationStructure &&other) noexcept;
+        ~AccelerationStructure();
+
+        void destroy();
+    };
+
+    /**
+     * @brief Move-only command buffer that is returned to its pool on release
+     */
+    struct CommandBuffer : DeviceResource {
+        VkCommandPool pool = VK_NULL_HANDLE;
+        VkCommandBuffer handle = VK_NULL_HANDLE;
+
+        CommandBuffer() = default;
+        CommandBuffer(const CommandBuffer &) = delete;
+        CommandBuffer &operator=(const CommandBuffer &) = delete;
+        CommandBuffer(CommandBuffer &&other) noexcept;
+        CommandBuffer &operator=(CommandBuffer &&other) noexcept;
+        ~CommandBuffer();
+
+        void destroy();
+    };
+}
+
+
+#endif //VULKANRESOURCES_H
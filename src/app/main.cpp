@@ -5,14 +5,31 @@
 #include <iostream>
 #include <cstdlib>
 #include <vector>
+#include "RendererConfig.h"
 #include "VulkanMiragePathtracer.h"
+#include "cpu/CpuRenderer.h"
 
 int SDL_main(int argc, char *argv[]) {
 
-    VulkanMiragePathtracer app;
-
     try {
-        app.run();
+        RendererConfig config = RendererConfig::fromArguments(argc, argv);
+
+        if (config.backend == RendererBackend::Vulkan) {
+            try {
+                VulkanMiragePathtracer app(config);
+                app.run();
+                return EXIT_SUCCESS;
+            } catch (const NoSuitableDeviceError &e) {
+                if (!config.allowCpuFallback) {
+                    throw;
+                }
+                std::cerr << e.what() << " Falling back to the CPU renderer." << std::endl;
+                config.backend = RendererBackend::Cpu;
+            }
+        }
+
+        CpuRenderer renderer(config);
+        renderer.run();
     } catch (const std::exception& e) {
         std::cerr << e.what() << std::endl;
         return EXIT_FAILURE;
@@ -20,4 +37,3 @@ int SDL_main(int argc, char *argv[]) {
 
     return EXIT_SUCCESS;
 }
-
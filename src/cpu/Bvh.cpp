@@ -0,0 +1,321 @@
+//
+// Created by redkc on 19/10/2026.
+//
+
+#include "Bvh.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <limits>
+#include <thread>
+
+namespace cpu {
+    namespace {
+        struct Bounds {
+            glm::vec3 min = glm::vec3(std::numeric_limits<float>::max());
+            glm::vec3 max = glm::vec3(-std::numeric_limits<float>::max());
+
+            void grow(const glm::vec3 &point) {
+                min = glm::min(min, point);
+                max = glm::max(max, point);
+            }
+
+            void grow(const Bounds &other) {
+                min = glm::min(min, other.min);
+                max = glm::max(max, other.max);
+            }
+
+            float area() const {
+                const glm::vec3 extent = max - min;
+                if (extent.x < 0.0f) {
+                    return 0.0f;
+                }
+                return 2.0f * (extent.x * extent.y + extent.y * extent.z + extent.z * extent.x);
+            }
+        };
+
+        struct Bin {
+            Bounds bounds;
+            uint32_t count = 0;
+        };
+    }
+
+    struct Bvh::BuildState {
+        const BvhBuildSettings &settings;
+        std::vector<Bounds> triangleBounds;
+        std::vector<glm::vec3> centroids;
+        std::vector<uint32_t> indices;
+        std::atomic<uint32_t> nodeCount{1};
+        std::atomic<int32_t> spareThreads{0};
+        std::atomic<uint32_t> depth{0};
+    };
+
+    void Bvh::build(std::vector<Triangle> input, const BvhBuildSettings &settings) {
+        nodes.clear();
+        triangles.clear();
+        depth = 0;
+        if (input.empty()) {
+            return;
+        }
+
+        const uint32_t triangleCount = static_cast<uint32_t>(input.size());
+        BuildState state{settings};
+        state.triangleBounds.resize(triangleCount);
+        state.centroids.resize(triangleCount);
+        state.indices.resize(triangleCount);
+        for (uint32_t i = 0; i < triangleCount; i++) {
+            Bounds &bounds = state.triangleBounds[i];
+            bounds.grow(input[i].v0);
+            bounds.grow(input[i].v1);
+            bounds.grow(input[i].v2);
+            state.centroids[i] = (bounds.min + bounds.max) * 0.5f;
+            state.indices[i] = i;
+        }
+
+        const uint32_t threadCount = settings.threadCount > 0
+                                         ? settings.threadCount
+                                         : std::max(1u, std::thread::hardware_concurrency());
+        state.spareThreads = static_cast<int32_t>(threadCount) - 1;
+
+        // A binary tree over n leaves never has more than 2n - 1 nodes, the unused tail is trimmed afterwards
+        nodes.resize(2 * static_cast<size_t>(triangleCount) - 1);
+        buildNode(state, 0, 0, triangleCount, 1);
+        nodes.resize(state.nodeCount);
+        depth = state.depth;
+
+        // Store the triangles in leaf order so a leaf reads one contiguous range
+        triangles.reserve(triangleCount);
+        for (uint32_t index: state.indices) {
+            triangles.push_back(input[index]);
+        }
+    }
+
+    void Bvh::buildNode(BuildState &state, uint32_t nodeIndex, uint32_t first, uint32_t count, uint32_t level) {
+        uint32_t deepest = state.depth.load();
+        while (level > deepest && !state.depth.compare_exchange_weak(deepest, level)) {
+        }
+
+        BvhNode &node = nodes[nodeIndex];
+        Bounds bounds;
+        Bounds centroidBounds;
+        for (uint32_t i = first; i < first + count; i++) {
+            bounds.grow(state.triangleBounds[state.indices[i]]);
+            centroidBounds.grow(state.centroids[state.indices[i]]);
+        }
+        node.boundsMin = bounds.min;
+        node.boundsMax = bounds.max;
+
+        auto makeLeaf = [&]() {
+            node.first = first;
+            node.count = count;
+        };
+
+        // The traversal stack is fixed size, so pathological inputs end in a large leaf instead of a deeper tree
+        if (count <= 2 || level >= maxDepth) {
+            makeLeaf();
+            return;
+        }
+
+        // Evaluate the SAH at the bin boundaries of every axis
+        const uint32_t binCount = std::max(2u, state.settings.binCount);
+        std::vector<Bin> bins(binCount);
+        std::vector<float> costs(binCount - 1);
+        float bestCost = std::numeric_limits<float>::max();
+        int bestAxis = -1;
+        uint32_t bestSplit = 0;
+        for (int axis = 0; axis < 3; axis++) {
+            const float axisMin = centroidBounds.min[axis];
+            const float axisExtent = centroidBounds.max[axis] - axisMin;
+            if (axisExtent <= 0.0f) {
+                continue;
+            }
+            const float binScale = static_cast<float>(binCount) / axisExtent;
+
+            std::fill(bins.begin(), bins.end(), Bin{});
+            for (uint32_t i = first; i < first + count; i++) {
+                const uint32_t index = state.indices[i];
+                const uint32_t bin = std::min(binCount - 1,
+                                              static_cast<uint32_t>((state.centroids[index][axis] - axisMin) *
+                                                                    binScale));
+                bins[bin].count++;
+                bins[bin].bounds.grow(state.triangleBounds[index]);
+            }
+
+            // Sweep from the left and from the right to get both sides of every split in linear time
+            Bounds leftBounds;
+            uint32_t leftCount = 0;
+            for (uint32_t split = 0; split < binCount - 1; split++) {
+                leftBounds.grow(bins[split].bounds);
+                leftCount += bins[split].count;
+                costs[split] = leftBounds.area() * static_cast<float>(leftCount);
+            }
+            Bounds rightBounds;
+            uint32_t rightCount = 0;
+            for (uint32_t split = binCount - 1; split > 0; split--) {
+                rightBounds.grow(bins[split].bounds);
+                rightCount += bins[split].count;
+                const float cost = costs[split - 1] + rightBounds.area() * static_cast<float>(rightCount);
+                if (cost < bestCost) {
+                    bestCost = cost;
+                    bestAxis = axis;
+                    bestSplit = split;
+                }
+            }
+        }
+
+        // All centroids in one point, nothing left to split on
+        if (bestAxis < 0) {
+            if (count <= state.settings.maxLeafSize) {
+                makeLeaf();
+                return;
+            }
+            bestAxis = 0;
+        }
+
+        const float leafCost = bounds.area() * static_cast<float>(count);
+        if (state.settings.traversalCost * bounds.area() + bestCost >= leafCost &&
+            count <= state.settings.maxLeafSize) {
+            makeLeaf();
+            return;
+        }
+
+        uint32_t *begin = state.indices.data() + first;
+        uint32_t *end = begin + count;
+        uint32_t *middle;
+        const float axisMin = centroidBounds.min[bestAxis];
+        const float axisExtent = centroidBounds.max[bestAxis] - axisMin;
+        if (axisExtent > 0.0f) {
+            const float binScale = static_cast<float>(binCount) / axisExtent;
+            middle = std::partition(begin, end, [&](uint32_t index) {
+                const uint32_t bin = std::min(binCount - 1,
+                                              static_cast<uint32_t>((state.centroids[index][bestAxis] - axisMin) *
+                                                                    binScale));
+                return bin < bestSplit;
+            });
+        } else {
+            middle = begin;
+        }
+        // Degenerate split, fall back to halving the range
+        if (middle == begin || middle == end) {
+            middle = begin + count / 2;
+        }
+
+        const uint32_t leftCount = static_cast<uint32_t>(middle - begin);
+        const uint32_t leftIndex = state.nodeCount.fetch_add(2);
+        node.first = leftIndex;
+        node.count = 0;
+
+        // Large subtrees go to another thread while this one carries on with the other side
+        const uint32_t rightCount = count - leftCount;
+        bool spawn = leftCount >= state.settings.parallelThreshold && rightCount >= state.settings.parallelThreshold;
+        if (spawn && state.spareThreads.fetch_sub(1) <= 0) {
+            state.spareThreads.fetch_add(1);
+            spawn = false;
+        }
+        if (spawn) {
+            std::thread worker(&Bvh::buildNode, this, std::ref(state), leftIndex, first, leftCount, level + 1);
+            buildNode(state, leftIndex + 1, first + leftCount, rightCount, level + 1);
+            worker.join();
+            state.spareThreads.fetch_add(1);
+        } else {
+            buildNode(state, leftIndex, first, leftCount, level + 1);
+            buildNode(state, leftIndex + 1, first + leftCount, rightCount, level + 1);
+        }
+    }
+
+    bool Bvh::intersect(const Ray &ray, Hit &hit) const {
+        if (nodes.empty()) {
+            return false;
+        }
+
+        const glm::vec3 inverseDirection = 1.0f / ray.direction;
+        auto intersectBounds = [&](const BvhNode &node, float tMax) {
+            const glm::vec3 t0 = (node.boundsMin - ray.origin) * inverseDirection;
+            const glm::vec3 t1 = (node.boundsMax - ray.origin) * inverseDirection;
+            const glm::vec3 tNear = glm::min(t0, t1);
+            const glm::vec3 tFar = glm::max(t0, t1);
+            const float entry = std::max(std::max(tNear.x, tNear.y), std::max(tNear.z, ray.tMin));
+            const float exit = std::min(std::min(tFar.x, tFar.y), std::min(tFar.z, tMax));
+            return entry <= exit ? entry : std::numeric_limits<float>::max();
+        };
+
+        bool found = false;
+        float closest = ray.tMax;
+        uint32_t stack[maxDepth];
+        uint32_t stackSize = 0;
+        uint32_t current = 0;
+        if (intersectBounds(nodes[0], closest) == std::numeric_limits<float>::max()) {
+            return false;
+        }
+
+        while (true) {
+            const BvhNode &node = nodes[current];
+            if (node.isLeaf()) {
+                for (uint32_t i = node.first; i < node.first + node.count; i++) {
+                    float t;
+                    glm::vec2 barycentrics;
+                    if (intersectTriangle(ray, triangles[i], t, barycentrics) && t < closest) {
+                        closest = t;
+                        hit.t = t;
+                        hit.barycentrics = barycentrics;
+                        hit.triangleIndex = i;
+                        found = true;
+                    }
+                }
+            } else {
+                // Visit the nearer child first and keep the other one for later
+                uint32_t nearChild = node.first;
+                uint32_t farChild = node.first + 1;
+                float nearDistance = intersectBounds(nodes[nearChild], closest);
+                float farDistance = intersectBounds(nodes[farChild], closest);
+                if (farDistance < nearDistance) {
+                    std::swap(nearChild, farChild);
+                    std::swap(nearDistance, farDistance);
+                }
+                if (nearDistance != std::numeric_limits<float>::max()) {
+                    if (farDistance != std::numeric_limits<float>::max()) {
+                        stack[stackSize++] = farChild;
+                    }
+                    current = nearChild;
+                    continue;
+                }
+            }
+
+            if (stackSize == 0) {
+                break;
+            }
+            current = stack[--stackSize];
+        }
+        return found;
+    }
+
+    bool intersectTriangle(const Ray &ray, const Triangle &triangle, float &t, glm::vec2 &barycentrics) {
+        const glm::vec3 edge1 = triangle.v1 - triangle.v0;
+        const glm::vec3 edge2 = triangle.v2 - triangle.v0;
+        const glm::vec3 p = glm::cross(ray.direction, edge2);
+        const float determinant = glm::dot(edge1, p);
+        if (std::fabs(determinant) < 1e-12f) {
+            return false;
+        }
+        const float inverseDeterminant = 1.0f / determinant;
+
+        const glm::vec3 s = ray.origin - triangle.v0;
+        const float u = glm::dot(s, p) * inverseDeterminant;
+        if (u < 0.0f || u > 1.0f) {
+            return false;
+        }
+        const glm::vec3 q = glm::cross(s, edge1);
+        const float v = glm::dot(ray.direction, q) * inverseDeterminant;
+        if (v < 0.0f || u + v > 1.0f) {
+            return false;
+        }
+
+        t = glm::dot(edge2, q) * inverseDeterminant;
+        if (t < ray.tMin || t > ray.tMax) {
+            return false;
+        }
+        barycentrics = glm::vec2(u, v);
+        return true;
+    }
+}
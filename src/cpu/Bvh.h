@@ -0,0 +1,117 @@
+//
+// Created by redkc on 19/10/2026.
+//
+
+#ifndef BVH_H
+#define BVH_H
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+namespace cpu {
+    struct Triangle {
+        glm::vec3 v0;
+        glm::vec3 v1;
+        glm::vec3 v2;
+        /** @brief Index of the mesh in Model::meshes, the CPU equivalent of the instance custom index */
+        uint32_t meshIndex;
+        /** @brief Index of the triangle inside its mesh, the CPU equivalent of PrimitiveIndex() */
+        uint32_t primitiveIndex;
+    };
+
+    struct Ray {
+        glm::vec3 origin;
+        float tMin;
+        glm::vec3 direction;
+        float tMax;
+    };
+
+    struct Hit {
+        float t;
+        /** @brief Barycentrics of v1 and v2, the same convention as the closest hit shader attributes */
+        glm::vec2 barycentrics;
+        uint32_t triangleIndex;
+    };
+
+    /**
+     * @brief Node of the binary BVH, 32 bytes so two children share a cache line.
+     *
+     * Leaves have count > 0 and index their triangles through first. Interior nodes have count == 0 and their
+     * children are stored next to each other at first and first + 1.
+     */
+    struct BvhNode {
+        glm::vec3 boundsMin;
+        uint32_t first;
+        glm::vec3 boundsMax;
+        uint32_t count;
+
+        bool isLeaf() const {
+            return count > 0;
+        }
+    };
+
+    struct BvhBuildSettings {
+        /** @brief Number of bins the SAH is evaluated at per axis */
+        uint32_t binCount = 16;
+        /** @brief Leaves are never larger than this, even when the SAH would rather stop splitting */
+        uint32_t maxLeafSize = 8;
+        /**
+         * @brief Cost of visiting a node relative to one triangle test. The SIMD kernels test a whole leaf for about
+         * the price of one triangle, so the wide BVH wants larger values to fill its packs.
+         */
+        float traversalCost = 1.0f;
+        /** @brief Subtrees with fewer triangles than this are built on the thread that reached them */
+        uint32_t parallelThreshold = 4096;
+        /** @brief 0 uses every hardware thread */
+        uint32_t threadCount = 0;
+    };
+
+    /**
+     * @brief Binned SAH bounding volume hierarchy over triangles, built top-down in parallel.
+     *
+     * The split of every node only touches its own range of triangles, so once a node is split its two subtrees are
+     * built independently and large ones are handed to another thread.
+     */
+    class Bvh {
+    public:
+        void build(std::vector<Triangle> triangles, const BvhBuildSettings &settings = {});
+
+        /**
+         * @brief Finds the closest hit along the ray. Triangles are two-sided, like the TLAS instances.
+         */
+        bool intersect(const Ray &ray, Hit &hit) const;
+
+        const std::vector<BvhNode> &getNodes() const {
+            return nodes;
+        }
+
+        const std::vector<Triangle> &getTriangles() const {
+            return triangles;
+        }
+
+        uint32_t getDepth() const {
+            return depth;
+        }
+
+        /** @brief Upper bound on the tree depth, which is also the size of the traversal stack */
+        static constexpr uint32_t maxDepth = 64;
+
+    private:
+        struct BuildState;
+
+        void buildNode(BuildState &state, uint32_t nodeIndex, uint32_t first, uint32_t count, uint32_t level);
+
+        std::vector<BvhNode> nodes;
+        std::vector<Triangle> triangles;
+        uint32_t depth = 0;
+    };
+
+    /**
+     * @brief Ray/triangle test (Möller–Trumbore) without backface culling.
+     */
+    bool intersectTriangle(const Ray &ray, const Triangle &triangle, float &t, glm::vec2 &barycentrics);
+}
+
+
+#endif //BVH_H
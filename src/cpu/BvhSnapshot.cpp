@@ -0,0 +1,230 @@
+//
+// Created by redkc on 19/10/2026.
+//
+
+#include "BvhSnapshot.h"
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <random>
+#include <sstream>
+#include <vector>
+
+namespace cpu {
+    namespace {
+        constexpr uint32_t snapshotMagic = 0x56424d56; // "VMBV"
+        constexpr uint64_t sectionAlignment = 64;
+        constexpr uint64_t fnvOffsetBasis = 14695981039346656037ull;
+        constexpr uint64_t fnvPrime = 1099511628211ull;
+
+        struct SnapshotHeader {
+            uint32_t magic;
+            uint32_t version;
+            uint64_t sourceKey;
+            // Layout of the arrays, a build with different struct sizes cannot use the file
+            uint32_t nodeSize;
+            uint32_t packSize;
+            uint32_t triangleSize;
+            uint32_t rootLeaf;
+            uint64_t nodeOffset;
+            uint64_t nodeCount;
+            uint64_t packOffset;
+            uint64_t packCount;
+            uint64_t triangleOffset;
+            uint64_t triangleCount;
+            uint64_t fileSize;
+            uint64_t payloadChecksum;
+            /** @brief Checksum of the header with this field set to 0 */
+            uint64_t headerChecksum;
+        };
+
+        /**
+         * @brief FNV-1a over 64-bit words, with the tail bytes folded in one at a time. Much faster than the
+         * bytewise variant on large payloads.
+         */
+        uint64_t checksum(const uint8_t *data, size_t size, uint64_t seed = fnvOffsetBasis) {
+            uint64_t result = seed;
+            size_t i = 0;
+            for (; i + sizeof(uint64_t) <= size; i += sizeof(uint64_t)) {
+                uint64_t word;
+                std::memcpy(&word, data + i, sizeof(word));
+                result ^= word;
+                result *= fnvPrime;
+            }
+            for (; i < size; i++) {
+                result ^= data[i];
+                result *= fnvPrime;
+            }
+            return result;
+        }
+
+        uint64_t headerChecksum(SnapshotHeader header) {
+            header.headerChecksum = 0;
+            return checksum(reinterpret_cast<const uint8_t *>(&header), sizeof(header));
+        }
+
+        uint64_t alignOffset(uint64_t offset) {
+            return (offset + sectionAlignment - 1) & ~(sectionAlignment - 1);
+        }
+    }
+
+    uint64_t BvhSnapshot::sourceKey(const std::string &modelPath) {
+        std::error_code error;
+        const uint64_t size = std::filesystem::file_size(modelPath, error);
+        if (error) {
+            return 0;
+        }
+        const auto modified = std::filesystem::last_write_time(modelPath, error);
+        if (error) {
+            return 0;
+        }
+        const int64_t modifiedTicks = modified.time_since_epoch().count();
+
+        uint64_t key = checksum(reinterpret_cast<const uint8_t *>(modelPath.data()), modelPath.size());
+        key = checksum(reinterpret_cast<const uint8_t *>(&size), sizeof(size), key);
+        key = checksum(reinterpret_cast<const uint8_t *>(&modifiedTicks), sizeof(modifiedTicks), key);
+        // The builder settings shape the tree too
+        key = checksum(reinterpret_cast<const uint8_t *>(&WideBvh::binaryTraversalCost),
+                       sizeof(WideBvh::binaryTraversalCost), key);
+        return key;
+    }
+
+    std::string BvhSnapshot::path(const std::string &directory, uint64_t sourceKey) {
+        std::ostringstream name;
+        name << directory << "/bvh_" << std::hex << std::setw(16) << std::setfill('0') << sourceKey << ".bin";
+        return name.str();
+    }
+
+    bool BvhSnapshot::write(const std::string &path, const WideBvh &bvh, uint64_t sourceKey) {
+        std::error_code error;
+        const std::filesystem::path directory = std::filesystem::path(path).parent_path();
+        if (!directory.empty()) {
+            std::filesystem::create_directories(directory, error);
+            if (error) {
+                return false;
+            }
+        }
+
+        const auto nodes = bvh.getNodes();
+        const auto packs = bvh.getPacks();
+        const auto triangles = bvh.getTriangles();
+
+        SnapshotHeader header{};
+        header.magic = snapshotMagic;
+        header.version = version;
+        header.sourceKey = sourceKey;
+        header.nodeSize = sizeof(WideBvhNode);
+        header.packSize = sizeof(TrianglePack8);
+        header.triangleSize = sizeof(Triangle);
+        header.rootLeaf = bvh.getRootLeaf();
+        header.nodeOffset = alignOffset(sizeof(SnapshotHeader));
+        header.nodeCount = nodes.size();
+        header.packOffset = alignOffset(header.nodeOffset + nodes.size_bytes());
+        header.packCount = packs.size();
+        header.triangleOffset = alignOffset(header.packOffset + packs.size_bytes());
+        header.triangleCount = triangles.size();
+        header.fileSize = header.triangleOffset + triangles.size_bytes();
+
+        // Two processes building the same model would otherwise write into one temporary file
+        std::ostringstream temporaryName;
+        temporaryName << path << "." << std::hex << std::random_device{}() << ".tmp";
+        const std::string temporaryPath = temporaryName.str();
+        {
+            std::ofstream file(temporaryPath, std::ios::binary | std::ios::trunc);
+            if (!file.is_open()) {
+                return false;
+            }
+
+            // The header goes in last, once the payload checksum is known
+            // Large enough for the header block and for any padding between sections
+            const std::vector<uint8_t> zeros(header.nodeOffset, 0);
+            file.write(reinterpret_cast<const char *>(zeros.data()), static_cast<std::streamsize>(header.nodeOffset));
+
+            // Sections and their padding are checksummed exactly as they end up in the file. Every section but the
+            // last one has a size that is a multiple of 8, so chaining the word checksum equals one pass over the file
+            uint64_t payloadChecksum = fnvOffsetBasis;
+            uint64_t position = header.nodeOffset;
+            auto writeSection = [&](uint64_t offset, const void *data, size_t size) {
+                const size_t padding = offset - position;
+                file.write(reinterpret_cast<const char *>(zeros.data()), static_cast<std::streamsize>(padding));
+                payloadChecksum = checksum(zeros.data(), padding, payloadChecksum);
+                file.write(static_cast<const char *>(data), static_cast<std::streamsize>(size));
+                payloadChecksum = checksum(static_cast<const uint8_t *>(data), size, payloadChecksum);
+                position = offset + size;
+            };
+            writeSection(header.nodeOffset, nodes.data(), nodes.size_bytes());
+            writeSection(header.packOffset, packs.data(), packs.size_bytes());
+            writeSection(header.triangleOffset, triangles.data(), triangles.size_bytes());
+
+            header.payloadChecksum = payloadChecksum;
+            header.headerChecksum = headerChecksum(header);
+            file.seekp(0);
+            file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+            if (!file.good()) {
+                file.close();
+                std::filesystem::remove(temporaryPath, error);
+                return false;
+            }
+        }
+
+        std::filesystem::rename(temporaryPath, path, error);
+        if (error) {
+            std::filesystem::remove(temporaryPath, error);
+            return false;
+        }
+        return true;
+    }
+
+    bool BvhSnapshot::open(const std::string &path, uint64_t sourceKey, bool verifyPayload) {
+        bvh.assign({}, {}, {}, WideBvhNode::emptyChild);
+        if (!file.open(path)) {
+            return false;
+        }
+
+        auto reject = [&]() {
+            bvh.assign({}, {}, {}, WideBvhNode::emptyChild);
+            file.close();
+            return false;
+        };
+
+        if (file.size() < sizeof(SnapshotHeader)) {
+            return reject();
+        }
+        SnapshotHeader header{};
+        std::memcpy(&header, file.data(), sizeof(header));
+        if (header.magic != snapshotMagic ||
+            header.version != version ||
+            header.headerChecksum != headerChecksum(header) ||
+            header.sourceKey != sourceKey ||
+            header.nodeSize != sizeof(WideBvhNode) ||
+            header.packSize != sizeof(TrianglePack8) ||
+            header.triangleSize != sizeof(Triangle) ||
+            header.fileSize != file.size()) {
+            return reject();
+        }
+
+        // The sections have to lie inside the file and keep the alignment of their structs
+        auto sectionValid = [&](uint64_t offset, uint64_t count, uint64_t elementSize) {
+            return offset % sectionAlignment == 0 && offset <= header.fileSize &&
+                   count <= (header.fileSize - offset) / elementSize;
+        };
+        if (header.nodeOffset < sizeof(SnapshotHeader) ||
+            !sectionValid(header.nodeOffset, header.nodeCount, sizeof(WideBvhNode)) ||
+            !sectionValid(header.packOffset, header.packCount, sizeof(TrianglePack8)) ||
+            !sectionValid(header.triangleOffset, header.triangleCount, sizeof(Triangle))) {
+            return reject();
+        }
+        if (verifyPayload &&
+            checksum(file.data() + header.nodeOffset, header.fileSize - header.nodeOffset) != header.payloadChecksum) {
+            return reject();
+        }
+
+        bvh.assign({reinterpret_cast<const WideBvhNode *>(file.data() + header.nodeOffset), header.nodeCount},
+                   {reinterpret_cast<const TrianglePack8 *>(file.data() + header.packOffset), header.packCount},
+                   {reinterpret_cast<const Triangle *>(file.data() + header.triangleOffset), header.triangleCount},
+                   header.rootLeaf);
+        return true;
+    }
+}
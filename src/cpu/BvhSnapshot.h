@@ -0,0 +1,73 @@
+//
+// Created by redkc on 19/10/2026.
+//
+
+#ifndef BVHSNAPSHOT_H
+#define BVHSNAPSHOT_H
+#include <cstdint>
+#include <string>
+
+#include "MappedFile.h"
+#include "WideBvh.h"
+
+namespace cpu {
+    /**
+     * @brief On-disk copy of a WideBvh and its triangles that is used straight from a memory mapping.
+     *
+     * The file is a header followed by the node, pack and triangle arrays exactly as they are laid out in memory,
+     * each at a 64-byte aligned offset. Every reference inside them is an index, so after the single mmap the
+     * WideBvh simply views the mapped arrays, with no fix-up pass and no copy. Processes that open the same snapshot
+     * therefore share one page-cache copy of the scene.
+     *
+     * The header carries a format version, the struct sizes it was written with, a key of the source model and
+     * checksums of itself and of the payload. A snapshot that does not match any of them is rejected.
+     */
+    class BvhSnapshot {
+    public:
+        BvhSnapshot() = default;
+        BvhSnapshot(const BvhSnapshot &) = delete;
+        BvhSnapshot &operator=(const BvhSnapshot &) = delete;
+
+        /**
+         * @brief Identifies the state of a model file: its path, size and modification time.
+         *
+         * @return 0 when the file does not exist.
+         */
+        static uint64_t sourceKey(const std::string &modelPath);
+
+        /**
+         * @brief Where the snapshot of a model lives inside directory.
+         */
+        static std::string path(const std::string &directory, uint64_t sourceKey);
+
+        /**
+         * @brief Writes bvh to path, through a temporary file so readers never see half a snapshot.
+         */
+        static bool write(const std::string &path, const WideBvh &bvh, uint64_t sourceKey);
+
+        /**
+         * @brief Maps the snapshot at path and points getBvh() at it.
+         *
+         * @param verifyPayload Also checksums the node and triangle data, which reads the whole file once.
+         * @return False when the file is missing, damaged, written by another format version or for another source.
+         */
+        bool open(const std::string &path, uint64_t sourceKey, bool verifyPayload = true);
+
+        const WideBvh &getBvh() const {
+            return bvh;
+        }
+
+        size_t getMappedSize() const {
+            return file.size();
+        }
+
+        static constexpr uint32_t version = 1;
+
+    private:
+        MappedFile file;
+        WideBvh bvh;
+    };
+}
+
+
+#endif //BVHSNAPSHOT_H
@@ -0,0 +1,172 @@
+//
+// Created by redkc on 19/10/2026.
+//
+
+#include "CompressedWideBvh.h"
+
+#include <algorithm>
+#include <bit>
+#include <limits>
+#include <stdexcept>
+
+#include "WideBvh.h"
+
+namespace cpu {
+    void CompressedWideBvh::build(const Bvh &bvh) {
+        nodes.clear();
+        packs.clear();
+        triangles = bvh.getTriangles();
+        rootLeafPacks = 0;
+        if (bvh.getNodes().empty()) {
+            return;
+        }
+
+        const BvhNode &root = bvh.getNodes()[0];
+        if (root.isLeaf()) {
+            rootLeafPacks = appendLeafPacks(bvh, root);
+            return;
+        }
+        nodes.emplace_back();
+        buildNode(bvh, 0, 0);
+    }
+
+    void CompressedWideBvh::buildNode(const Bvh &bvh, uint32_t binaryIndex, uint32_t nodeIndex) {
+        const std::vector<BvhNode> &binaryNodes = bvh.getNodes();
+        uint32_t children[simdWidth];
+        const uint32_t childCount = WideBvh::collapseChildren(bvh, binaryIndex, children);
+
+        glm::vec3 boundsMin[simdWidth];
+        glm::vec3 boundsMax[simdWidth];
+        uint32_t interiorCount = 0;
+        for (uint32_t i = 0; i < childCount; i++) {
+            boundsMin[i] = binaryNodes[children[i]].boundsMin;
+            boundsMax[i] = binaryNodes[children[i]].boundsMax;
+            interiorCount += binaryNodes[children[i]].isLeaf() ? 0 : 1;
+        }
+
+        // Reserve the slots of all interior children up front so they end up next to each other
+        const uint32_t childBase = static_cast<uint32_t>(nodes.size());
+        nodes.resize(nodes.size() + interiorCount);
+        const uint32_t packBase = static_cast<uint32_t>(packs.size());
+
+        CompressedWideBvhNode &node = nodes[nodeIndex];
+        node.bounds.set(boundsMin, boundsMax, childCount);
+        node.childBase = childBase;
+        node.packBase = packBase;
+        std::fill(std::begin(node.childOffset), std::end(node.childOffset), 0);
+        std::fill(std::begin(node.packCount), std::end(node.packCount), 0);
+
+        uint32_t interiorOffset = 0;
+        for (uint32_t i = 0; i < childCount; i++) {
+            const BvhNode &child = binaryNodes[children[i]];
+            if (child.isLeaf()) {
+                const uint32_t packOffset = static_cast<uint32_t>(packs.size()) - packBase;
+                const uint32_t packCount = appendLeafPacks(bvh, child);
+                if (packOffset > std::numeric_limits<uint8_t>::max() ||
+                    packCount > std::numeric_limits<uint8_t>::max()) {
+                    throw std::runtime_error("failed to compress BVH node, its leaves are too large!");
+                }
+                nodes[nodeIndex].childOffset[i] = static_cast<uint8_t>(packOffset);
+                nodes[nodeIndex].packCount[i] = static_cast<uint8_t>(packCount);
+            } else {
+                nodes[nodeIndex].childOffset[i] = static_cast<uint8_t>(interiorOffset++);
+            }
+        }
+
+        // Only now recurse, the leaf packs of this node had to be appended in one run first
+        interiorOffset = 0;
+        for (uint32_t i = 0; i < childCount; i++) {
+            if (!binaryNodes[children[i]].isLeaf()) {
+                buildNode(bvh, children[i], childBase + interiorOffset++);
+            }
+        }
+    }
+
+    uint32_t CompressedWideBvh::appendLeafPacks(const Bvh &bvh, const BvhNode &leaf) {
+        const uint32_t packCount = (leaf.count + simdWidth - 1) / simdWidth;
+        for (uint32_t pack = 0; pack < packCount; pack++) {
+            TrianglePack8 &triangles8 = packs.emplace_back();
+            triangles8.clear();
+            const uint32_t first = leaf.first + pack * simdWidth;
+            const uint32_t count = std::min(simdWidth, leaf.first + leaf.count - first);
+            for (uint32_t lane = 0; lane < count; lane++) {
+                triangles8.set(lane, bvh.getTriangles()[first + lane], first + lane);
+            }
+        }
+        return packCount;
+    }
+
+    bool CompressedWideBvh::intersect(const Ray &ray, Hit &hit) const {
+        bool found = false;
+        float closest = ray.tMax;
+
+        auto intersectLeaf = [&](uint32_t firstPack, uint32_t packCount) {
+            for (uint32_t pack = firstPack; pack < firstPack + packCount; pack++) {
+                float t;
+                glm::vec2 barycentrics;
+                uint32_t lane;
+                if (intersectTriangles8(packs[pack], ray, closest, t, barycentrics, lane)) {
+                    closest = t;
+                    hit.t = t;
+                    hit.barycentrics = barycentrics;
+                    hit.triangleIndex = packs[pack].triangleIndex[lane];
+                    found = true;
+                }
+            }
+        };
+
+        if (nodes.empty()) {
+            intersectLeaf(0, rootLeafPacks);
+            return found;
+        }
+
+        const glm::vec3 inverseDirection = 1.0f / ray.direction;
+        struct StackEntry {
+            uint32_t index;
+            /** @brief 0 for interior nodes, otherwise index is the first pack of a leaf */
+            uint32_t packCount;
+            float distance;
+        };
+        StackEntry stack[stackSize];
+        uint32_t stackCount = 0;
+        stack[stackCount++] = {0, 0, ray.tMin};
+
+        while (stackCount > 0) {
+            const StackEntry entry = stack[--stackCount];
+            if (entry.distance > closest) {
+                continue;
+            }
+            if (entry.packCount > 0) {
+                intersectLeaf(entry.index, entry.packCount);
+                continue;
+            }
+
+            const CompressedWideBvhNode &node = nodes[entry.index];
+            alignas(32) float distances[simdWidth];
+            uint32_t mask = intersectQuantizedBoxes8(node.bounds, ray.origin, inverseDirection, ray.tMin, closest,
+                                                     distances);
+
+            // Push the hit children far to near so the nearest one is popped first
+            StackEntry hits[simdWidth];
+            uint32_t hitCount = 0;
+            for (; mask != 0; mask &= mask - 1) {
+                const uint32_t lane = static_cast<uint32_t>(std::countr_zero(mask));
+                const uint32_t packCount = node.packCount[lane];
+                StackEntry child{
+                    (packCount > 0 ? node.packBase : node.childBase) + node.childOffset[lane], packCount,
+                    distances[lane]
+                };
+                uint32_t position = hitCount++;
+                while (position > 0 && hits[position - 1].distance < child.distance) {
+                    hits[position] = hits[position - 1];
+                    position--;
+                }
+                hits[position] = child;
+            }
+            for (uint32_t i = 0; i < hitCount; i++) {
+                stack[stackCount++] = hits[i];
+            }
+        }
+        return found;
+    }
+}
@@ -0,0 +1,83 @@
+//
+// Created by redkc on 19/10/2026.
+//
+
+#include "CpuRaytracer.h"
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+
+namespace cpu {
+    void Image::resize(uint32_t newWidth, uint32_t newHeight) {
+        width = newWidth;
+        height = newHeight;
+        pixels.assign(static_cast<size_t>(width) * height, glm::vec4(0.0f));
+    }
+
+    void Image::toBgra8(std::vector<uint8_t> &bgra) const {
+        bgra.resize(pixels.size() * 4);
+        for (size_t i = 0; i < pixels.size(); i++) {
+            const glm::vec4 color = glm::clamp(pixels[i], 0.0f, 1.0f);
+            bgra[i * 4 + 0] = static_cast<uint8_t>(color.z * 255.0f + 0.5f);
+            bgra[i * 4 + 1] = static_cast<uint8_t>(color.y * 255.0f + 0.5f);
+            bgra[i * 4 + 2] = static_cast<uint8_t>(color.x * 255.0f + 0.5f);
+            bgra[i * 4 + 3] = static_cast<uint8_t>(color.w * 255.0f + 0.5f);
+        }
+    }
+
+    CpuRaytracer::CpuRaytracer(const WideBvh &bvh) : bvh(bvh) {
+    }
+
+    void CpuRaytracer::render(const glm::mat4 &viewInverse, const glm::mat4 &projInverse, Image &image,
+                              uint32_t threadCount) const {
+        if (threadCount == 0) {
+            threadCount = std::max(1u, std::thread::hardware_concurrency());
+        }
+        threadCount = std::min(threadCount, std::max(1u, image.height));
+
+        // Rows are handed out one at a time, so threads that get cheap rows simply take more of them
+        std::atomic<uint32_t> nextRow{0};
+        auto worker = [&]() {
+            for (uint32_t y = nextRow++; y < image.height; y = nextRow++) {
+                for (uint32_t x = 0; x < image.width; x++) {
+                    const Ray ray = generateRay(viewInverse, projInverse, x, y, image.width, image.height);
+                    image.pixels[static_cast<size_t>(y) * image.width + x] = glm::vec4(shade(ray), 0.0f);
+                }
+            }
+        };
+
+        std::vector<std::thread> threads;
+        threads.reserve(threadCount - 1);
+        for (uint32_t i = 1; i < threadCount; i++) {
+            threads.emplace_back(worker);
+        }
+        worker();
+        for (auto &thread: threads) {
+            thread.join();
+        }
+    }
+
+    Ray CpuRaytracer::generateRay(const glm::mat4 &viewInverse, const glm::mat4 &projInverse, uint32_t x, uint32_t y,
+                                  uint32_t width, uint32_t height) {
+        const glm::vec2 pixelCenter = glm::vec2(static_cast<float>(x), static_cast<float>(y)) + glm::vec2(0.5f);
+        const glm::vec2 inUV = pixelCenter / glm::vec2(static_cast<float>(width), static_cast<float>(height));
+        const glm::vec2 d = inUV * 2.0f - glm::vec2(1.0f);
+        const glm::vec4 target = projInverse * glm::vec4(d.x, d.y, 1.0f, 1.0f);
+
+        Ray ray{};
+        ray.origin = glm::vec3(viewInverse * glm::vec4(0.0f, 0.0f, 0.0f, 1.0f));
+        ray.direction = glm::vec3(viewInverse * glm::vec4(glm::normalize(glm::vec3(target)), 0.0f));
+        ray.tMin = 0.001f;
+        ray.tMax = 10000.0f;
+        return ray;
+    }
+
+    glm::vec3 CpuRaytracer::shade(const Ray &ray) const {
+        Hit hit{};
+        if (!bvh.intersect(ray, hit)) {
+            return glm::vec3(0.0f, 0.0f, 0.5f);
+        }
+        return glm::vec3(1.0f - hit.barycentrics.x - hit.barycentrics.y, hit.barycentrics.x, hit.barycentrics.y);
+    }
+}
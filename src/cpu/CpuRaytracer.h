@@ -0,0 +1,62 @@
+//
+// Created by redkc on 19/10/2026.
+//
+
+#ifndef CPURAYTRACER_H
+#define CPURAYTRACER_H
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "Bvh.h"
+#include "WideBvh.h"
+
+namespace cpu {
+    /**
+     * @brief RGBA float image, row major with the first row at the top like the storage image.
+     */
+    struct Image {
+        uint32_t width = 0;
+        uint32_t height = 0;
+        std::vector<glm::vec4> pixels;
+
+        void resize(uint32_t newWidth, uint32_t newHeight);
+
+        /**
+         * @brief Converts to 8-bit BGRA, the layout of the swapchain and storage image.
+         */
+        void toBgra8(std::vector<uint8_t> &bgra) const;
+    };
+
+    /**
+     * @brief Traces the primary rays of raygen.rgen against a WideBvh and shades them like the ray tracing pipeline.
+     *
+     * A hit returns the barycentric coordinates (closesthit.rchit) and a miss returns dark blue (miss.rmiss), so the
+     * images of both backends can be compared directly.
+     */
+    class CpuRaytracer {
+    public:
+        explicit CpuRaytracer(const WideBvh &bvh);
+
+        /**
+         * @brief Renders every pixel of image, the rows are split between threadCount threads (0 uses all cores).
+         */
+        void render(const glm::mat4 &viewInverse, const glm::mat4 &projInverse, Image &image,
+                    uint32_t threadCount = 0) const;
+
+        /**
+         * @brief Builds the ray raygen.rgen launches for a pixel.
+         */
+        static Ray generateRay(const glm::mat4 &viewInverse, const glm::mat4 &projInverse, uint32_t x, uint32_t y,
+                               uint32_t width, uint32_t height);
+
+        glm::vec3 shade(const Ray &ray) const;
+
+    private:
+        const WideBvh &bvh;
+    };
+}
+
+
+#endif //CPURAYTRACER_H
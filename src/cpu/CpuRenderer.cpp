@@ -0,0 +1,168 @@
+//
+// Created by redkc on 19/10/2026.
+//
+
+#include "CpuRenderer.h"
+
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+
+#include <SDL2/SDL.h>
+
+#include "ModelTriangles.h"
+#include "model/Model.h"
+#include "app/CameraPath.h"
+#include "app/ImageEncoder.h"
+#include "app/RaytracingCamera.h"
+
+CpuRenderer::CpuRenderer(const RendererConfig &config) : config(config) {
+}
+
+void CpuRenderer::run() {
+    loadScene();
+    image.resize(config.width, config.height);
+    if (!config.outputPath.empty()) {
+        renderToFile();
+    } else {
+        mainLoop();
+    }
+}
+
+void CpuRenderer::loadScene() {
+    const uint64_t sourceKey = cpu::BvhSnapshot::sourceKey(config.modelPath);
+    if (config.useBvhSnapshot && sourceKey != 0) {
+        const auto start = std::chrono::high_resolution_clock::now();
+        if (snapshot.open(cpu::BvhSnapshot::path(config.cacheDirectoryPath(), sourceKey), sourceKey)) {
+            const auto end = std::chrono::high_resolution_clock::now();
+            scene = &snapshot.getBvh();
+            std::cout << "CPU BVH: mapped snapshot with " << scene->getTriangles().size() << " triangles, "
+                    << scene->getNodes().size() << " wide nodes in "
+                    << std::chrono::duration<double, std::milli>(end - start).count() << " ms ("
+                    << cpu::simdInstructionSet() << ")" << std::endl;
+            return;
+        }
+    }
+    buildScene(sourceKey);
+}
+
+void CpuRenderer::buildScene(uint64_t sourceKey) {
+    const Model model(config.modelPath);
+    std::vector<cpu::Triangle> triangles = cpu::collectTriangles(model);
+    const size_t triangleCount = triangles.size();
+
+    cpu::BvhBuildSettings settings{};
+    settings.threadCount = config.threadCount;
+    settings.traversalCost = cpu::WideBvh::binaryTraversalCost;
+
+    const auto start = std::chrono::high_resolution_clock::now();
+    cpu::Bvh bvh;
+    bvh.build(std::move(triangles), settings);
+    wideBvh.build(bvh);
+    const auto end = std::chrono::high_resolution_clock::now();
+    scene = &wideBvh;
+
+    std::cout << "CPU BVH: " << triangleCount << " triangles, " << bvh.getNodes().size() << " binary nodes, "
+            << wideBvh.getNodes().size() << " wide nodes, depth " << bvh.getDepth() << ", built in "
+            << std::chrono::duration<double, std::milli>(end - start).count() << " ms ("
+            << cpu::simdInstructionSet() << ")" << std::endl;
+
+    if (config.useBvhSnapshot && sourceKey != 0 &&
+        !cpu::BvhSnapshot::write(cpu::BvhSnapshot::path(config.cacheDirectoryPath(), sourceKey), wideBvh, sourceKey)) {
+        std::cerr << "failed to write the BVH snapshot, the scene will be rebuilt on the next launch" << std::endl;
+    }
+}
+
+void CpuRenderer::renderToFile() {
+    const float aspect = config.width / (float) config.height;
+    // The tracer already uses every thread, one encoder thread only has to keep up with it
+    ImageEncoder imageEncoder(1);
+    if (config.cameraPath.empty()) {
+        renderFrameToFile(RaytracingCamera::createDefault(aspect), config.outputPath, imageEncoder);
+    } else {
+        const std::vector<RaytracingCamera> cameras = CameraPath::load(config.cameraPath, aspect);
+        for (uint32_t frame = 0; frame < cameras.size(); frame++) {
+            renderFrameToFile(cameras[frame], config.frameOutputPath(frame), imageEncoder);
+        }
+    }
+    imageEncoder.waitIdle();
+}
+
+void CpuRenderer::renderFrameToFile(const RaytracingCamera &camera, const std::string &path,
+                                    ImageEncoder &imageEncoder) {
+    const cpu::CpuRaytracer raytracer(*scene);
+
+    const auto start = std::chrono::high_resolution_clock::now();
+    raytracer.render(camera.viewInverse, camera.projInverse, image, config.threadCount);
+    const auto end = std::chrono::high_resolution_clock::now();
+    std::cout << "CPU frame rendered in " << std::chrono::duration<double, std::milli>(end - start).count() << " ms"
+            << std::endl;
+
+    // The next frame renders into image while this one is encoded from a copy
+    auto pixels = std::make_shared<std::vector<glm::vec4>>(image.pixels);
+    ImageEncoder::Job job;
+    job.path = path;
+    job.width = image.width;
+    job.height = image.height;
+    job.pixelFormat = ImageEncoder::PixelFormat::Rgba32f;
+    job.pixels = pixels->data();
+    // Keeps the copy alive until the worker has written it
+    job.onDone = [pixels]() {};
+    imageEncoder.submit(std::move(job));
+}
+
+void CpuRenderer::mainLoop() {
+    SDL_Window *window = SDL_CreateWindow("My App (CPU)",
+                                          SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED,
+                                          static_cast<int>(config.width), static_cast<int>(config.height),
+                                          SDL_WINDOW_SHOWN);
+    if (window == nullptr) {
+        throw std::runtime_error("Failed to create window: " + std::string(SDL_GetError()));
+    }
+    SDL_Surface *frame = SDL_CreateRGBSurfaceWithFormat(0, static_cast<int>(config.width),
+                                                        static_cast<int>(config.height), 32,
+                                                        SDL_PIXELFORMAT_ARGB8888);
+    if (frame == nullptr) {
+        SDL_DestroyWindow(window);
+        throw std::runtime_error("Failed to create surface: " + std::string(SDL_GetError()));
+    }
+    // The miss and hit shaders write an alpha of 0, blending would make the whole frame invisible
+    SDL_SetSurfaceBlendMode(frame, SDL_BLENDMODE_NONE);
+
+    const RaytracingCamera camera = RaytracingCamera::createDefault(config.width / (float) config.height);
+    const cpu::CpuRaytracer raytracer(*scene);
+    std::vector<uint8_t> bgra;
+
+    bool running = true;
+    while (running) {
+        SDL_Event event;
+        while (SDL_PollEvent(&event)) {
+            if (event.type == SDL_QUIT) {
+                running = false;
+            }
+        }
+
+        raytracer.render(camera.viewInverse, camera.projInverse, image, config.threadCount);
+        image.toBgra8(bgra);
+
+        // ARGB8888 is stored as B, G, R, A in memory on little endian machines, the same as the storage image
+        SDL_LockSurface(frame);
+        const size_t rowSize = static_cast<size_t>(config.width) * 4;
+        for (uint32_t y = 0; y < config.height; y++) {
+            memcpy(static_cast<uint8_t *>(frame->pixels) + static_cast<size_t>(y) * frame->pitch,
+                   bgra.data() + y * rowSize, rowSize);
+        }
+        SDL_UnlockSurface(frame);
+
+        SDL_Surface *windowSurface = SDL_GetWindowSurface(window);
+        if (windowSurface != nullptr) {
+            SDL_BlitSurface(frame, nullptr, windowSurface, nullptr);
+            SDL_UpdateWindowSurface(window);
+        }
+    }
+
+    SDL_FreeSurface(frame);
+    SDL_DestroyWindow(window);
+}
@@ -0,0 +1,49 @@
+//
+// Created by redkc on 19/10/2026.
+//
+
+#ifndef CPURENDERER_H
+#define CPURENDERER_H
+#include "BvhSnapshot.h"
+#include "CpuRaytracer.h"
+#include "WideBvh.h"
+#include "app/ImageEncoder.h"
+#include "app/RaytracingCamera.h"
+#include "app/RendererConfig.h"
+
+/**
+ * @brief Software fallback for machines without a GPU that supports VK_KHR_ray_tracing_pipeline.
+ *
+ * Loads the same model as the Vulkan backend, builds a Bvh over all of its meshes, collapses it into a WideBvh for
+ * the SIMD kernels and traces it with the camera of raygen.rgen. The result is kept as a BvhSnapshot, so later
+ * launches map it instead of loading and building again. With an output path a single frame, or every keyframe
+ * of a camera path, is written to disk, otherwise the frames are presented in an SDL window through a plain surface
+ * blit, so no Vulkan device is needed at all.
+ */
+class CpuRenderer {
+public:
+    explicit CpuRenderer(const RendererConfig &config);
+
+    void run();
+
+private:
+    void loadScene();
+
+    void buildScene(uint64_t sourceKey);
+
+    void renderToFile();
+
+    void renderFrameToFile(const RaytracingCamera &camera, const std::string &path, ImageEncoder &imageEncoder);
+
+    void mainLoop();
+
+    RendererConfig config;
+    cpu::BvhSnapshot snapshot;
+    cpu::WideBvh wideBvh;
+    /** @brief Either the mapped snapshot or wideBvh */
+    const cpu::WideBvh *scene = nullptr;
+    cpu::Image image;
+};
+
+
+#endif //CPURENDERER_H
@@ -0,0 +1,56 @@
+//
+// Created by redkc on 19/10/2026.
+//
+
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace cpu {
+    /**
+     * @brief Read-only memory mapping of a whole file.
+     *
+     * The mapping is shared, so every process that maps the same file reads the same page-cache copy of it.
+     */
+    class MappedFile {
+    public:
+        MappedFile() = default;
+        MappedFile(const MappedFile &) = delete;
+        MappedFile &operator=(const MappedFile &) = delete;
+        MappedFile(MappedFile &&other) noexcept;
+        MappedFile &operator=(MappedFile &&other) noexcept;
+        ~MappedFile();
+
+        /**
+         * @brief Maps path, closing any earlier mapping first. Returns false when the file is missing or empty.
+         */
+        bool open(const std::string &path);
+
+        void close();
+
+        const uint8_t *data() const {
+            return mapping;
+        }
+
+        size_t size() const {
+            return length;
+        }
+
+        bool isOpen() const {
+            return mapping != nullptr;
+        }
+
+    private:
+        const uint8_t *mapping = nullptr;
+        size_t length = 0;
+#ifdef _WIN32
+        void *fileHandle = nullptr;
+        void *mappingHandle = nullptr;
+#endif
+    };
+}
+
+
+#endif //MAPPEDFILE_H
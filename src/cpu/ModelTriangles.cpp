@@ -0,0 +1,33 @@
+//
+// Created by redkc on 19/10/2026.
+//
+
+#include "ModelTriangles.h"
+
+#include "model/Model.h"
+
+namespace cpu {
+    std::vector<Triangle> collectTriangles(const Model &model) {
+        size_t totalTriangles = 0;
+        for (const auto &mesh: model.meshes) {
+            totalTriangles += mesh->indices.size() / 3;
+        }
+
+        std::vector<Triangle> triangles;
+        triangles.reserve(totalTriangles);
+        for (uint32_t meshIndex = 0; meshIndex < model.meshes.size(); meshIndex++) {
+            const Mesh &mesh = *model.meshes[meshIndex];
+            const uint32_t triangleCount = static_cast<uint32_t>(mesh.indices.size() / 3);
+            for (uint32_t i = 0; i < triangleCount; i++) {
+                Triangle triangle{};
+                triangle.v0 = mesh.vertices[mesh.indices[i * 3 + 0]].pos;
+                triangle.v1 = mesh.vertices[mesh.indices[i * 3 + 1]].pos;
+                triangle.v2 = mesh.vertices[mesh.indices[i * 3 + 2]].pos;
+                triangle.meshIndex = meshIndex;
+                triangle.primitiveIndex = i;
+                triangles.push_back(triangle);
+            }
+        }
+        return triangles;
+    }
+}
@@ -0,0 +1,23 @@
+//
+// Created by redkc on 19/10/2026.
+//
+
+#ifndef MODELTRIANGLES_H
+#define MODELTRIANGLES_H
+#include <vector>
+
+#include "Bvh.h"
+
+class Model;
+
+namespace cpu {
+    /**
+     * @brief Flattens Mesh::vertices / Mesh::indices of every mesh into world space triangles for the BVH build.
+     *
+     * The meshes are placed with identity transforms, the same as the TLAS instances of the Vulkan backend.
+     */
+    std::vector<Triangle> collectTriangles(const Model &model);
+}
+
+
+#endif //MODELTRIANGLES_H
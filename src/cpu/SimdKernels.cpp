@@ -0,0 +1,450 @@
+//
+// Created by redkc on 19/10/2026.
+//
+
+#include "SimdKernels.h"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <limits>
+
+#if defined(MIRAGE_SIMD_AVX2) || defined(MIRAGE_SIMD_SSE4)
+#include <immintrin.h>
+#endif
+
+namespace cpu {
+    namespace {
+        constexpr float determinantEpsilon = 1e-12f;
+    }
+
+    void TrianglePack8::clear() {
+        std::fill(std::begin(v0x), std::end(v0x), 0.0f);
+        std::fill(std::begin(v0y), std::end(v0y), 0.0f);
+        std::fill(std::begin(v0z), std::end(v0z), 0.0f);
+        std::fill(std::begin(e1x), std::end(e1x), 0.0f);
+        std::fill(std::begin(e1y), std::end(e1y), 0.0f);
+        std::fill(std::begin(e1z), std::end(e1z), 0.0f);
+        std::fill(std::begin(e2x), std::end(e2x), 0.0f);
+        std::fill(std::begin(e2y), std::end(e2y), 0.0f);
+        std::fill(std::begin(e2z), std::end(e2z), 0.0f);
+        std::fill(std::begin(triangleIndex), std::end(triangleIndex), 0u);
+    }
+
+    void TrianglePack8::set(uint32_t lane, const Triangle &triangle, uint32_t index) {
+        const glm::vec3 edge1 = triangle.v1 - triangle.v0;
+        const glm::vec3 edge2 = triangle.v2 - triangle.v0;
+        v0x[lane] = triangle.v0.x;
+        v0y[lane] = triangle.v0.y;
+        v0z[lane] = triangle.v0.z;
+        e1x[lane] = edge1.x;
+        e1y[lane] = edge1.y;
+        e1z[lane] = edge1.z;
+        e2x[lane] = edge2.x;
+        e2y[lane] = edge2.y;
+        e2z[lane] = edge2.z;
+        triangleIndex[lane] = index;
+    }
+
+    void BoxPack8::clear() {
+        // Inverted bounds, the caller masks these lanes out anyway
+        std::fill(std::begin(minX), std::end(minX), std::numeric_limits<float>::max());
+        std::fill(std::begin(minY), std::end(minY), std::numeric_limits<float>::max());
+        std::fill(std::begin(minZ), std::end(minZ), std::numeric_limits<float>::max());
+        std::fill(std::begin(maxX), std::end(maxX), -std::numeric_limits<float>::max());
+        std::fill(std::begin(maxY), std::end(maxY), -std::numeric_limits<float>::max());
+        std::fill(std::begin(maxZ), std::end(maxZ), -std::numeric_limits<float>::max());
+    }
+
+    void BoxPack8::set(uint32_t lane, const glm::vec3 &boundsMin, const glm::vec3 &boundsMax) {
+        minX[lane] = boundsMin.x;
+        minY[lane] = boundsMin.y;
+        minZ[lane] = boundsMin.z;
+        maxX[lane] = boundsMax.x;
+        maxY[lane] = boundsMax.y;
+        maxZ[lane] = boundsMax.z;
+    }
+
+    void QuantizedBoxPack8::set(const glm::vec3 *boundsMin, const glm::vec3 *boundsMax, uint32_t count) {
+        glm::vec3 unionMin(std::numeric_limits<float>::max());
+        glm::vec3 unionMax(-std::numeric_limits<float>::max());
+        for (uint32_t i = 0; i < count; i++) {
+            unionMin = glm::min(unionMin, boundsMin[i]);
+            unionMax = glm::max(unionMax, boundsMax[i]);
+        }
+        origin = count > 0 ? unionMin : glm::vec3(0.0f);
+        validMask = static_cast<uint8_t>((1u << count) - 1);
+
+        uint8_t *planesMin[3] = {minX, minY, minZ};
+        uint8_t *planesMax[3] = {maxX, maxY, maxZ};
+        for (int axis = 0; axis < 3; axis++) {
+            std::fill(planesMin[axis], planesMin[axis] + simdWidth, 0);
+            std::fill(planesMax[axis], planesMax[axis] + simdWidth, 0);
+
+            // Smallest power of two that spreads the extent over 255 steps, flat axes keep the smallest scale
+            int power = -126;
+            const float extent = count > 0 ? unionMax[axis] - origin[axis] : 0.0f;
+            if (extent > 0.0f) {
+                std::frexp(extent / 255.0f, &power);
+                power = std::clamp(power, -126, 127);
+            }
+
+            for (;; power++) {
+                const float scale = std::ldexp(1.0f, power);
+                bool fits = true;
+                for (uint32_t i = 0; i < count && fits; i++) {
+                    float low = std::clamp(std::floor((boundsMin[i][axis] - origin[axis]) / scale), 0.0f, 255.0f);
+                    float high = std::clamp(std::ceil((boundsMax[i][axis] - origin[axis]) / scale), 0.0f, 255.0f);
+                    // The subtraction rounds, so step outwards until the decoded planes really contain the box
+                    while (low > 0.0f && origin[axis] + low * scale > boundsMin[i][axis]) {
+                        low -= 1.0f;
+                    }
+                    while (high < 255.0f && origin[axis] + high * scale < boundsMax[i][axis]) {
+                        high += 1.0f;
+                    }
+                    fits = origin[axis] + low * scale <= boundsMin[i][axis] &&
+                           origin[axis] + high * scale >= boundsMax[i][axis];
+                    planesMin[axis][i] = static_cast<uint8_t>(low);
+                    planesMax[axis][i] = static_cast<uint8_t>(high);
+                }
+                if (fits || power >= 127) {
+                    break;
+                }
+            }
+            exponent[axis] = static_cast<int8_t>(power);
+        }
+    }
+
+    glm::vec3 QuantizedBoxPack8::scale() const {
+        return glm::vec3(std::ldexp(1.0f, exponent[0]), std::ldexp(1.0f, exponent[1]), std::ldexp(1.0f, exponent[2]));
+    }
+
+    void QuantizedBoxPack8::decode(BoxPack8 &boxes) const {
+        boxes.clear();
+        const glm::vec3 planeScale = scale();
+        for (uint32_t i = 0; i < simdWidth; i++) {
+            if (validMask & (1u << i)) {
+                boxes.set(i, origin + glm::vec3(minX[i], minY[i], minZ[i]) * planeScale,
+                          origin + glm::vec3(maxX[i], maxY[i], maxZ[i]) * planeScale);
+            }
+        }
+    }
+
+#if defined(MIRAGE_SIMD_AVX2)
+    uint32_t intersectBoxes8(const BoxPack8 &boxes, const glm::vec3 &origin, const glm::vec3 &inverseDirection,
+                             float tMin, float tMax, float entryDistances[simdWidth]) {
+        const __m256 originX = _mm256_set1_ps(origin.x);
+        const __m256 originY = _mm256_set1_ps(origin.y);
+        const __m256 originZ = _mm256_set1_ps(origin.z);
+        const __m256 inverseX = _mm256_set1_ps(inverseDirection.x);
+        const __m256 inverseY = _mm256_set1_ps(inverseDirection.y);
+        const __m256 inverseZ = _mm256_set1_ps(inverseDirection.z);
+
+        const __m256 t0x = _mm256_mul_ps(_mm256_sub_ps(_mm256_load_ps(boxes.minX), originX), inverseX);
+        const __m256 t1x = _mm256_mul_ps(_mm256_sub_ps(_mm256_load_ps(boxes.maxX), originX), inverseX);
+        const __m256 t0y = _mm256_mul_ps(_mm256_sub_ps(_mm256_load_ps(boxes.minY), originY), inverseY);
+        const __m256 t1y = _mm256_mul_ps(_mm256_sub_ps(_mm256_load_ps(boxes.maxY), originY), inverseY);
+        const __m256 t0z = _mm256_mul_ps(_mm256_sub_ps(_mm256_load_ps(boxes.minZ), originZ), inverseZ);
+        const __m256 t1z = _mm256_mul_ps(_mm256_sub_ps(_mm256_load_ps(boxes.maxZ), originZ), inverseZ);
+
+        __m256 entry = _mm256_max_ps(_mm256_min_ps(t0x, t1x), _mm256_min_ps(t0y, t1y));
+        entry = _mm256_max_ps(entry, _mm256_min_ps(t0z, t1z));
+        entry = _mm256_max_ps(entry, _mm256_set1_ps(tMin));
+        __m256 exit = _mm256_min_ps(_mm256_max_ps(t0x, t1x), _mm256_max_ps(t0y, t1y));
+        exit = _mm256_min_ps(exit, _mm256_max_ps(t0z, t1z));
+        exit = _mm256_min_ps(exit, _mm256_set1_ps(tMax));
+
+        _mm256_storeu_ps(entryDistances, entry);
+        return static_cast<uint32_t>(_mm256_movemask_ps(_mm256_cmp_ps(entry, exit, _CMP_LE_OQ)));
+    }
+
+    uint32_t intersectQuantizedBoxes8(const QuantizedBoxPack8 &boxes, const glm::vec3 &origin,
+                                      const glm::vec3 &inverseDirection, float tMin, float tMax,
+                                      float entryDistances[simdWidth]) {
+        const glm::vec3 planeScale = boxes.scale();
+        // Widen the eight bytes of a plane to floats and decode them in one fused multiply add
+        auto decode = [](const uint8_t *planes, float scale, float planeOrigin) {
+            const __m128i bytes = _mm_loadl_epi64(reinterpret_cast<const __m128i *>(planes));
+            return _mm256_fmadd_ps(_mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(bytes)), _mm256_set1_ps(scale),
+                                   _mm256_set1_ps(planeOrigin));
+        };
+
+        const __m256 originX = _mm256_set1_ps(origin.x);
+        const __m256 originY = _mm256_set1_ps(origin.y);
+        const __m256 originZ = _mm256_set1_ps(origin.z);
+        const __m256 inverseX = _mm256_set1_ps(inverseDirection.x);
+        const __m256 inverseY = _mm256_set1_ps(inverseDirection.y);
+        const __m256 inverseZ = _mm256_set1_ps(inverseDirection.z);
+
+        const __m256 t0x = _mm256_mul_ps(_mm256_sub_ps(decode(boxes.minX, planeScale.x, boxes.origin.x), originX),
+                                         inverseX);
+        const __m256 t1x = _mm256_mul_ps(_mm256_sub_ps(decode(boxes.maxX, planeScale.x, boxes.origin.x), originX),
+                                         inverseX);
+        const __m256 t0y = _mm256_mul_ps(_mm256_sub_ps(decode(boxes.minY, planeScale.y, boxes.origin.y), originY),
+                                         inverseY);
+        const __m256 t1y = _mm256_mul_ps(_mm256_sub_ps(decode(boxes.maxY, planeScale.y, boxes.origin.y), originY),
+                                         inverseY);
+        const __m256 t0z = _mm256_mul_ps(_mm256_sub_ps(decode(boxes.minZ, planeScale.z, boxes.origin.z), originZ),
+                                         inverseZ);
+        const __m256 t1z = _mm256_mul_ps(_mm256_sub_ps(decode(boxes.maxZ, planeScale.z, boxes.origin.z), originZ),
+                                         inverseZ);
+
+        __m256 entry = _mm256_max_ps(_mm256_min_ps(t0x, t1x), _mm256_min_ps(t0y, t1y));
+        entry = _mm256_max_ps(entry, _mm256_min_ps(t0z, t1z));
+        entry = _mm256_max_ps(entry, _mm256_set1_ps(tMin));
+        __m256 exit = _mm256_min_ps(_mm256_max_ps(t0x, t1x), _mm256_max_ps(t0y, t1y));
+        exit = _mm256_min_ps(exit, _mm256_max_ps(t0z, t1z));
+        exit = _mm256_min_ps(exit, _mm256_set1_ps(tMax));
+
+        _mm256_storeu_ps(entryDistances, entry);
+        return static_cast<uint32_t>(_mm256_movemask_ps(_mm256_cmp_ps(entry, exit, _CMP_LE_OQ))) & boxes.validMask;
+    }
+
+    bool intersectTriangles8(const TrianglePack8 &triangles, const Ray &ray, float tMax, float &t,
+                             glm::vec2 &barycentrics, uint32_t &lane) {
+        const __m256 directionX = _mm256_set1_ps(ray.direction.x);
+        const __m256 directionY = _mm256_set1_ps(ray.direction.y);
+        const __m256 directionZ = _mm256_set1_ps(ray.direction.z);
+        const __m256 e1x = _mm256_load_ps(triangles.e1x);
+        const __m256 e1y = _mm256_load_ps(triangles.e1y);
+        const __m256 e1z = _mm256_load_ps(triangles.e1z);
+        const __m256 e2x = _mm256_load_ps(triangles.e2x);
+        const __m256 e2y = _mm256_load_ps(triangles.e2y);
+        const __m256 e2z = _mm256_load_ps(triangles.e2z);
+
+        // p = cross(direction, edge2)
+        const __m256 px = _mm256_fmsub_ps(directionY, e2z, _mm256_mul_ps(directionZ, e2y));
+        const __m256 py = _mm256_fmsub_ps(directionZ, e2x, _mm256_mul_ps(directionX, e2z));
+        const __m256 pz = _mm256_fmsub_ps(directionX, e2y, _mm256_mul_ps(directionY, e2x));
+        const __m256 determinant = _mm256_fmadd_ps(e1x, px, _mm256_fmadd_ps(e1y, py, _mm256_mul_ps(e1z, pz)));
+        const __m256 absDeterminant = _mm256_andnot_ps(_mm256_set1_ps(-0.0f), determinant);
+        __m256 valid = _mm256_cmp_ps(absDeterminant, _mm256_set1_ps(determinantEpsilon), _CMP_GE_OQ);
+        const __m256 inverseDeterminant = _mm256_div_ps(_mm256_set1_ps(1.0f), determinant);
+
+        // s = origin - v0
+        const __m256 sx = _mm256_sub_ps(_mm256_set1_ps(ray.origin.x), _mm256_load_ps(triangles.v0x));
+        const __m256 sy = _mm256_sub_ps(_mm256_set1_ps(ray.origin.y), _mm256_load_ps(triangles.v0y));
+        const __m256 sz = _mm256_sub_ps(_mm256_set1_ps(ray.origin.z), _mm256_load_ps(triangles.v0z));
+        const __m256 u = _mm256_mul_ps(_mm256_fmadd_ps(sx, px, _mm256_fmadd_ps(sy, py, _mm256_mul_ps(sz, pz))),
+                                       inverseDeterminant);
+
+        // q = cross(s, edge1)
+        const __m256 qx = _mm256_fmsub_ps(sy, e1z, _mm256_mul_ps(sz, e1y));
+        const __m256 qy = _mm256_fmsub_ps(sz, e1x, _mm256_mul_ps(sx, e1z));
+        const __m256 qz = _mm256_fmsub_ps(sx, e1y, _mm256_mul_ps(sy, e1x));
+        const __m256 v = _mm256_mul_ps(
+            _mm256_fmadd_ps(directionX, qx, _mm256_fmadd_ps(directionY, qy, _mm256_mul_ps(directionZ, qz))),
+            inverseDeterminant);
+        const __m256 distance = _mm256_mul_ps(_mm256_fmadd_ps(e2x, qx, _mm256_fmadd_ps(e2y, qy, _mm256_mul_ps(e2z, qz))),
+                                              inverseDeterminant);
+
+        const __m256 zero = _mm256_setzero_ps();
+        valid = _mm256_and_ps(valid, _mm256_cmp_ps(u, zero, _CMP_GE_OQ));
+        valid = _mm256_and_ps(valid, _mm256_cmp_ps(v, zero, _CMP_GE_OQ));
+        valid = _mm256_and_ps(valid, _mm256_cmp_ps(_mm256_add_ps(u, v), _mm256_set1_ps(1.0f), _CMP_LE_OQ));
+        valid = _mm256_and_ps(valid, _mm256_cmp_ps(distance, _mm256_set1_ps(ray.tMin), _CMP_GE_OQ));
+        valid = _mm256_and_ps(valid, _mm256_cmp_ps(distance, _mm256_set1_ps(tMax), _CMP_LT_OQ));
+
+        const int validMask = _mm256_movemask_ps(valid);
+        if (validMask == 0) {
+            return false;
+        }
+
+        // Horizontal minimum over the valid lanes, then look up which lane it came from
+        __m256 candidates = _mm256_blendv_ps(_mm256_set1_ps(std::numeric_limits<float>::infinity()), distance, valid);
+        __m256 minimum = _mm256_min_ps(candidates, _mm256_permute2f128_ps(candidates, candidates, 1));
+        minimum = _mm256_min_ps(minimum, _mm256_shuffle_ps(minimum, minimum, _MM_SHUFFLE(1, 0, 3, 2)));
+        minimum = _mm256_min_ps(minimum, _mm256_shuffle_ps(minimum, minimum, _MM_SHUFFLE(2, 3, 0, 1)));
+        const int closestMask = _mm256_movemask_ps(_mm256_cmp_ps(candidates, minimum, _CMP_EQ_OQ)) & validMask;
+
+        alignas(32) float uLanes[simdWidth];
+        alignas(32) float vLanes[simdWidth];
+        alignas(32) float tLanes[simdWidth];
+        _mm256_store_ps(uLanes, u);
+        _mm256_store_ps(vLanes, v);
+        _mm256_store_ps(tLanes, distance);
+        lane = static_cast<uint32_t>(std::countr_zero(static_cast<uint32_t>(closestMask)));
+        t = tLanes[lane];
+        barycentrics = glm::vec2(uLanes[lane], vLanes[lane]);
+        return true;
+    }
+
+    const char *simdInstructionSet() {
+        return "AVX2";
+    }
+#elif defined(MIRAGE_SIMD_SSE4)
+    // Without AVX the eight lanes are processed as two SSE halves
+
+    uint32_t intersectBoxes8(const BoxPack8 &boxes, const glm::vec3 &origin, const glm::vec3 &inverseDirection,
+                             float tMin, float tMax, float entryDistances[simdWidth]) {
+        const __m128 originX = _mm_set1_ps(origin.x);
+        const __m128 originY = _mm_set1_ps(origin.y);
+        const __m128 originZ = _mm_set1_ps(origin.z);
+        const __m128 inverseX = _mm_set1_ps(inverseDirection.x);
+        const __m128 inverseY = _mm_set1_ps(inverseDirection.y);
+        const __m128 inverseZ = _mm_set1_ps(inverseDirection.z);
+
+        uint32_t mask = 0;
+        for (uint32_t half = 0; half < simdWidth; half += 4) {
+            const __m128 t0x = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(boxes.minX + half), originX), inverseX);
+            const __m128 t1x = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(boxes.maxX + half), originX), inverseX);
+            const __m128 t0y = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(boxes.minY + half), originY), inverseY);
+            const __m128 t1y = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(boxes.maxY + half), originY), inverseY);
+            const __m128 t0z = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(boxes.minZ + half), originZ), inverseZ);
+            const __m128 t1z = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(boxes.maxZ + half), originZ), inverseZ);
+
+            __m128 entry = _mm_max_ps(_mm_min_ps(t0x, t1x), _mm_min_ps(t0y, t1y));
+            entry = _mm_max_ps(entry, _mm_min_ps(t0z, t1z));
+            entry = _mm_max_ps(entry, _mm_set1_ps(tMin));
+            __m128 exit = _mm_min_ps(_mm_max_ps(t0x, t1x), _mm_max_ps(t0y, t1y));
+            exit = _mm_min_ps(exit, _mm_max_ps(t0z, t1z));
+            exit = _mm_min_ps(exit, _mm_set1_ps(tMax));
+
+            _mm_storeu_ps(entryDistances + half, entry);
+            mask |= static_cast<uint32_t>(_mm_movemask_ps(_mm_cmple_ps(entry, exit))) << half;
+        }
+        return mask;
+    }
+
+    bool intersectTriangles8(const TrianglePack8 &triangles, const Ray &ray, float tMax, float &t,
+                             glm::vec2 &barycentrics, uint32_t &lane) {
+        const __m128 directionX = _mm_set1_ps(ray.direction.x);
+        const __m128 directionY = _mm_set1_ps(ray.direction.y);
+        const __m128 directionZ = _mm_set1_ps(ray.direction.z);
+        const __m128 zero = _mm_setzero_ps();
+
+        bool found = false;
+        float closest = tMax;
+        for (uint32_t half = 0; half < simdWidth; half += 4) {
+            const __m128 e1x = _mm_load_ps(triangles.e1x + half);
+            const __m128 e1y = _mm_load_ps(triangles.e1y + half);
+            const __m128 e1z = _mm_load_ps(triangles.e1z + half);
+            const __m128 e2x = _mm_load_ps(triangles.e2x + half);
+            const __m128 e2y = _mm_load_ps(triangles.e2y + half);
+            const __m128 e2z = _mm_load_ps(triangles.e2z + half);
+
+            const __m128 px = _mm_sub_ps(_mm_mul_ps(directionY, e2z), _mm_mul_ps(directionZ, e2y));
+            const __m128 py = _mm_sub_ps(_mm_mul_ps(directionZ, e2x), _mm_mul_ps(directionX, e2z));
+            const __m128 pz = _mm_sub_ps(_mm_mul_ps(directionX, e2y), _mm_mul_ps(directionY, e2x));
+            const __m128 determinant = _mm_add_ps(_mm_add_ps(_mm_mul_ps(e1x, px), _mm_mul_ps(e1y, py)),
+                                                  _mm_mul_ps(e1z, pz));
+            const __m128 absDeterminant = _mm_andnot_ps(_mm_set1_ps(-0.0f), determinant);
+            __m128 valid = _mm_cmpge_ps(absDeterminant, _mm_set1_ps(determinantEpsilon));
+            const __m128 inverseDeterminant = _mm_div_ps(_mm_set1_ps(1.0f), determinant);
+
+            const __m128 sx = _mm_sub_ps(_mm_set1_ps(ray.origin.x), _mm_load_ps(triangles.v0x + half));
+            const __m128 sy = _mm_sub_ps(_mm_set1_ps(ray.origin.y), _mm_load_ps(triangles.v0y + half));
+            const __m128 sz = _mm_sub_ps(_mm_set1_ps(ray.origin.z), _mm_load_ps(triangles.v0z + half));
+            const __m128 u = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(sx, px), _mm_mul_ps(sy, py)),
+                                                   _mm_mul_ps(sz, pz)), inverseDeterminant);
+
+            const __m128 qx = _mm_sub_ps(_mm_mul_ps(sy, e1z), _mm_mul_ps(sz, e1y));
+            const __m128 qy = _mm_sub_ps(_mm_mul_ps(sz, e1x), _mm_mul_ps(sx, e1z));
+            const __m128 qz = _mm_sub_ps(_mm_mul_ps(sx, e1y), _mm_mul_ps(sy, e1x));
+            const __m128 v = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(directionX, qx), _mm_mul_ps(directionY, qy)),
+                                                   _mm_mul_ps(directionZ, qz)), inverseDeterminant);
+            const __m128 distance = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(e2x, qx), _mm_mul_ps(e2y, qy)),
+                                                          _mm_mul_ps(e2z, qz)), inverseDeterminant);
+
+            valid = _mm_and_ps(valid, _mm_cmpge_ps(u, zero));
+            valid = _mm_and_ps(valid, _mm_cmpge_ps(v, zero));
+            valid = _mm_and_ps(valid, _mm_cmple_ps(_mm_add_ps(u, v), _mm_set1_ps(1.0f)));
+            valid = _mm_and_ps(valid, _mm_cmpge_ps(distance, _mm_set1_ps(ray.tMin)));
+            valid = _mm_and_ps(valid, _mm_cmplt_ps(distance, _mm_set1_ps(closest)));
+
+            int validMask = _mm_movemask_ps(valid);
+            if (validMask == 0) {
+                continue;
+            }
+            alignas(16) float uLanes[4];
+            alignas(16) float vLanes[4];
+            alignas(16) float tLanes[4];
+            _mm_store_ps(uLanes, u);
+            _mm_store_ps(vLanes, v);
+            _mm_store_ps(tLanes, distance);
+            for (; validMask != 0; validMask &= validMask - 1) {
+                const uint32_t i = static_cast<uint32_t>(std::countr_zero(static_cast<uint32_t>(validMask)));
+                if (tLanes[i] < closest) {
+                    closest = tLanes[i];
+                    t = tLanes[i];
+                    barycentrics = glm::vec2(uLanes[i], vLanes[i]);
+                    lane = half + i;
+                    found = true;
+                }
+            }
+        }
+        return found;
+    }
+
+    uint32_t intersectQuantizedBoxes8(const QuantizedBoxPack8 &boxes, const glm::vec3 &origin,
+                                      const glm::vec3 &inverseDirection, float tMin, float tMax,
+                                      float entryDistances[simdWidth]) {
+        BoxPack8 decoded;
+        boxes.decode(decoded);
+        return intersectBoxes8(decoded, origin, inverseDirection, tMin, tMax, entryDistances) & boxes.validMask;
+    }
+
+    const char *simdInstructionSet() {
+        return "SSE4.1";
+    }
+#else
+    uint32_t intersectBoxes8(const BoxPack8 &boxes, const glm::vec3 &origin, const glm::vec3 &inverseDirection,
+                             float tMin, float tMax, float entryDistances[simdWidth]) {
+        uint32_t mask = 0;
+        for (uint32_t i = 0; i < simdWidth; i++) {
+            const glm::vec3 t0 = (glm::vec3(boxes.minX[i], boxes.minY[i], boxes.minZ[i]) - origin) * inverseDirection;
+            const glm::vec3 t1 = (glm::vec3(boxes.maxX[i], boxes.maxY[i], boxes.maxZ[i]) - origin) * inverseDirection;
+            const glm::vec3 near = glm::min(t0, t1);
+            const glm::vec3 far = glm::max(t0, t1);
+            const float entry = std::max(std::max(near.x, near.y), std::max(near.z, tMin));
+            const float exit = std::min(std::min(far.x, far.y), std::min(far.z, tMax));
+            entryDistances[i] = entry;
+            if (entry <= exit) {
+                mask |= 1u << i;
+            }
+        }
+        return mask;
+    }
+
+    bool intersectTriangles8(const TrianglePack8 &triangles, const Ray &ray, float tMax, float &t,
+                             glm::vec2 &barycentrics, uint32_t &lane) {
+        bool found = false;
+        float closest = tMax;
+        for (uint32_t i = 0; i < simdWidth; i++) {
+            const glm::vec3 edge1(triangles.e1x[i], triangles.e1y[i], triangles.e1z[i]);
+            const glm::vec3 edge2(triangles.e2x[i], triangles.e2y[i], triangles.e2z[i]);
+            const glm::vec3 p = glm::cross(ray.direction, edge2);
+            const float determinant = glm::dot(edge1, p);
+            if (std::fabs(determinant) < determinantEpsilon) {
+                continue;
+            }
+            const float inverseDeterminant = 1.0f / determinant;
+            const glm::vec3 s = ray.origin - glm::vec3(triangles.v0x[i], triangles.v0y[i], triangles.v0z[i]);
+            const float u = glm::dot(s, p) * inverseDeterminant;
+            const glm::vec3 q = glm::cross(s, edge1);
+            const float v = glm::dot(ray.direction, q) * inverseDeterminant;
+            const float distance = glm::dot(edge2, q) * inverseDeterminant;
+            if (u >= 0.0f && v >= 0.0f && u + v <= 1.0f && distance >= ray.tMin && distance < closest) {
+                closest = distance;
+                t = distance;
+                barycentrics = glm::vec2(u, v);
+                lane = i;
+                found = true;
+            }
+        }
+        return found;
+    }
+
+    uint32_t intersectQuantizedBoxes8(const QuantizedBoxPack8 &boxes, const glm::vec3 &origin,
+                                      const glm::vec3 &inverseDirection, float tMin, float tMax,
+                                      float entryDistances[simdWidth]) {
+        BoxPack8 decoded;
+        boxes.decode(decoded);
+        return intersectBoxes8(decoded, origin, inverseDirection, tMin, tMax, entryDistances) & boxes.validMask;
+    }
+
+    const char *simdInstructionSet() {
+        return "scalar";
+    }
+#endif
+}
@@ -0,0 +1,110 @@
+//
+// Created by redkc on 19/10/2026.
+//
+
+#ifndef SIMDKERNELS_H
+#define SIMDKERNELS_H
+#include <cstdint>
+
+#include <glm/glm.hpp>
+
+#include "Bvh.h"
+
+// The instruction set is picked at compile time, see MIRAGE_CPU_AVX2 in CMakeLists.txt
+#if defined(__AVX2__)
+#define MIRAGE_SIMD_AVX2 1
+#elif defined(__SSE4_1__) || defined(__AVX__)
+#define MIRAGE_SIMD_SSE4 1
+#endif
+
+namespace cpu {
+    constexpr uint32_t simdWidth = 8;
+
+    /**
+     * @brief Eight triangles in structure of arrays layout, stored as v0 and the two edges Möller–Trumbore needs.
+     *
+     * Unused lanes hold degenerate triangles (zero edges), which the kernel always rejects.
+     */
+    struct alignas(32) TrianglePack8 {
+        float v0x[simdWidth], v0y[simdWidth], v0z[simdWidth];
+        float e1x[simdWidth], e1y[simdWidth], e1z[simdWidth];
+        float e2x[simdWidth], e2y[simdWidth], e2z[simdWidth];
+        /** @brief Index of each lane's triangle in the triangle array of the BVH */
+        uint32_t triangleIndex[simdWidth];
+
+        void clear();
+
+        void set(uint32_t lane, const Triangle &triangle, uint32_t index);
+    };
+
+    /**
+     * @brief The bounds of the eight children of a wide BVH node in structure of arrays layout.
+     */
+    struct alignas(32) BoxPack8 {
+        float minX[simdWidth], minY[simdWidth], minZ[simdWidth];
+        float maxX[simdWidth], maxY[simdWidth], maxZ[simdWidth];
+
+        void clear();
+
+        void set(uint32_t lane, const glm::vec3 &boundsMin, const glm::vec3 &boundsMax);
+    };
+
+    /**
+     * @brief The eight child boxes of a compressed wide BVH node, quantized to 8 bits per plane. 64 bytes, one cache
+     * line.
+     *
+     * A plane q decodes to origin + q * 2^exponent. The scales are powers of two, so the decode is exact and the
+     * quantized boxes always contain the original ones.
+     */
+    struct QuantizedBoxPack8 {
+        glm::vec3 origin;
+        int8_t exponent[3];
+        /** @brief One bit per lane that holds a child */
+        uint8_t validMask;
+        uint8_t minX[simdWidth], minY[simdWidth], minZ[simdWidth];
+        uint8_t maxX[simdWidth], maxY[simdWidth], maxZ[simdWidth];
+
+        /**
+         * @brief Quantizes up to eight boxes conservatively against their common bounds.
+         */
+        void set(const glm::vec3 *boundsMin, const glm::vec3 *boundsMax, uint32_t count);
+
+        glm::vec3 scale() const;
+
+        void decode(BoxPack8 &boxes) const;
+    };
+
+    static_assert(sizeof(QuantizedBoxPack8) == 64, "QuantizedBoxPack8 has to fit one cache line");
+
+    /**
+     * @brief Slab test of one ray against eight boxes.
+     *
+     * @param entryDistances Receives the entry distance of every lane, only meaningful for lanes that hit.
+     * @return Bit mask of the lanes whose box is hit inside [tMin, tMax].
+     */
+    uint32_t intersectBoxes8(const BoxPack8 &boxes, const glm::vec3 &origin, const glm::vec3 &inverseDirection,
+                             float tMin, float tMax, float entryDistances[simdWidth]);
+
+    /**
+     * @brief intersectBoxes8 for quantized boxes, they are decoded in registers. Empty lanes never report a hit.
+     */
+    uint32_t intersectQuantizedBoxes8(const QuantizedBoxPack8 &boxes, const glm::vec3 &origin,
+                                      const glm::vec3 &inverseDirection, float tMin, float tMax,
+                                      float entryDistances[simdWidth]);
+
+    /**
+     * @brief Möller–Trumbore test of one ray against eight triangles at once, keeps the closest hit.
+     *
+     * Hits must lie in [ray.tMin, tMax). On success t, barycentrics and lane describe the closest one.
+     */
+    bool intersectTriangles8(const TrianglePack8 &triangles, const Ray &ray, float tMax, float &t,
+                             glm::vec2 &barycentrics, uint32_t &lane);
+
+    /**
+     * @brief Name of the instruction set the kernels were compiled for.
+     */
+    const char *simdInstructionSet();
+}
+
+
+#endif //SIMDKERNELS_H
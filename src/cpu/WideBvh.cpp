@@ -0,0 +1,189 @@
+//
+// Created by redkc on 19/10/2026.
+//
+
+#include "WideBvh.h"
+
+#include <algorithm>
+#include <bit>
+#include <limits>
+#include <stdexcept>
+
+namespace cpu {
+    namespace {
+        float surfaceArea(const BvhNode &node) {
+            const glm::vec3 extent = node.boundsMax - node.boundsMin;
+            return 2.0f * (extent.x * extent.y + extent.y * extent.z + extent.z * extent.x);
+        }
+    }
+
+    void WideBvh::build(const Bvh &bvh) {
+        ownedNodes.clear();
+        ownedPacks.clear();
+        ownedTriangles = bvh.getTriangles();
+        rootLeaf = WideBvhNode::emptyChild;
+        if (!bvh.getNodes().empty()) {
+            const BvhNode &root = bvh.getNodes()[0];
+            if (root.isLeaf()) {
+                rootLeaf = buildLeaf(bvh, root);
+            } else {
+                buildNode(bvh, 0);
+            }
+        }
+        nodes = ownedNodes;
+        packs = ownedPacks;
+        triangles = ownedTriangles;
+    }
+
+    void WideBvh::assign(std::span<const WideBvhNode> nodes, std::span<const TrianglePack8> packs,
+                         std::span<const Triangle> triangles, uint32_t rootLeaf) {
+        ownedNodes.clear();
+        ownedPacks.clear();
+        ownedTriangles.clear();
+        this->nodes = nodes;
+        this->packs = packs;
+        this->triangles = triangles;
+        this->rootLeaf = rootLeaf;
+    }
+
+    uint32_t WideBvh::collapseChildren(const Bvh &bvh, uint32_t binaryIndex, uint32_t children[simdWidth]) {
+        const std::vector<BvhNode> &binaryNodes = bvh.getNodes();
+        uint32_t childCount = 2;
+        children[0] = binaryNodes[binaryIndex].first;
+        children[1] = binaryNodes[binaryIndex].first + 1;
+        while (childCount < simdWidth) {
+            int32_t largest = -1;
+            float largestArea = -1.0f;
+            for (uint32_t i = 0; i < childCount; i++) {
+                const BvhNode &child = binaryNodes[children[i]];
+                if (!child.isLeaf() && surfaceArea(child) > largestArea) {
+                    largest = static_cast<int32_t>(i);
+                    largestArea = surfaceArea(child);
+                }
+            }
+            if (largest < 0) {
+                break;
+            }
+            const uint32_t opened = children[largest];
+            children[largest] = binaryNodes[opened].first;
+            children[childCount++] = binaryNodes[opened].first + 1;
+        }
+        return childCount;
+    }
+
+    uint32_t WideBvh::buildNode(const Bvh &bvh, uint32_t binaryIndex) {
+        const std::vector<BvhNode> &binaryNodes = bvh.getNodes();
+        uint32_t children[simdWidth];
+        const uint32_t childCount = collapseChildren(bvh, binaryIndex, children);
+
+        const uint32_t nodeIndex = static_cast<uint32_t>(ownedNodes.size());
+        ownedNodes.emplace_back();
+        ownedNodes[nodeIndex].bounds.clear();
+        std::fill(std::begin(ownedNodes[nodeIndex].children), std::end(ownedNodes[nodeIndex].children),
+                  WideBvhNode::emptyChild);
+
+        for (uint32_t i = 0; i < childCount; i++) {
+            const BvhNode &child = binaryNodes[children[i]];
+            // The recursion may reallocate the nodes, so nothing keeps a reference across it
+            const uint32_t reference = child.isLeaf() ? buildLeaf(bvh, child) : buildNode(bvh, children[i]);
+            ownedNodes[nodeIndex].bounds.set(i, child.boundsMin, child.boundsMax);
+            ownedNodes[nodeIndex].children[i] = reference;
+        }
+        return nodeIndex;
+    }
+
+    uint32_t WideBvh::buildLeaf(const Bvh &bvh, const BvhNode &leaf) {
+        const uint32_t firstPack = static_cast<uint32_t>(ownedPacks.size());
+        const uint32_t packCount = (leaf.count + simdWidth - 1) / simdWidth;
+        if (packCount > WideBvhNode::maxLeafPacks || firstPack + packCount > WideBvhNode::firstPackMask) {
+            throw std::runtime_error("failed to pack BVH leaf, the leaf or the scene is too large!");
+        }
+
+        for (uint32_t pack = 0; pack < packCount; pack++) {
+            TrianglePack8 &triangles8 = ownedPacks.emplace_back();
+            triangles8.clear();
+            const uint32_t first = leaf.first + pack * simdWidth;
+            const uint32_t count = std::min(simdWidth, leaf.first + leaf.count - first);
+            for (uint32_t lane = 0; lane < count; lane++) {
+                triangles8.set(lane, bvh.getTriangles()[first + lane], first + lane);
+            }
+        }
+        return WideBvhNode::makeLeafChild(firstPack, packCount);
+    }
+
+    bool WideBvh::intersect(const Ray &ray, Hit &hit) const {
+        bool found = false;
+        float closest = ray.tMax;
+
+        auto intersectLeaf = [&](uint32_t child) {
+            const uint32_t firstPack = child & WideBvhNode::firstPackMask;
+            const uint32_t packCount = (child & ~WideBvhNode::leafFlag) >> WideBvhNode::packCountShift;
+            for (uint32_t pack = firstPack; pack < firstPack + packCount; pack++) {
+                float t;
+                glm::vec2 barycentrics;
+                uint32_t lane;
+                if (intersectTriangles8(packs[pack], ray, closest, t, barycentrics, lane)) {
+                    closest = t;
+                    hit.t = t;
+                    hit.barycentrics = barycentrics;
+                    hit.triangleIndex = packs[pack].triangleIndex[lane];
+                    found = true;
+                }
+            }
+        };
+
+        if (rootLeaf != WideBvhNode::emptyChild) {
+            intersectLeaf(rootLeaf);
+            return found;
+        }
+        if (nodes.empty()) {
+            return false;
+        }
+
+        const glm::vec3 inverseDirection = 1.0f / ray.direction;
+        struct StackEntry {
+            uint32_t child;
+            float distance;
+        };
+        StackEntry stack[stackSize];
+        uint32_t stackCount = 0;
+        stack[stackCount++] = {0, ray.tMin};
+
+        while (stackCount > 0) {
+            const StackEntry entry = stack[--stackCount];
+            // The closest hit may have moved in front of this subtree since it was pushed
+            if (entry.distance > closest) {
+                continue;
+            }
+            if (entry.child & WideBvhNode::leafFlag) {
+                intersectLeaf(entry.child);
+                continue;
+            }
+
+            const WideBvhNode &node = nodes[entry.child];
+            alignas(32) float distances[simdWidth];
+            uint32_t mask = intersectBoxes8(node.bounds, ray.origin, inverseDirection, ray.tMin, closest, distances);
+
+            // Push the hit children far to near so the nearest one is popped first
+            StackEntry hits[simdWidth];
+            uint32_t hitCount = 0;
+            for (; mask != 0; mask &= mask - 1) {
+                const uint32_t lane = static_cast<uint32_t>(std::countr_zero(mask));
+                if (node.children[lane] == WideBvhNode::emptyChild) {
+                    continue;
+                }
+                StackEntry child{node.children[lane], distances[lane]};
+                uint32_t position = hitCount++;
+                while (position > 0 && hits[position - 1].distance < child.distance) {
+                    hits[position] = hits[position - 1];
+                    position--;
+                }
+                hits[position] = child;
+            }
+            for (uint32_t i = 0; i < hitCount; i++) {
+                stack[stackCount++] = hits[i];
+            }
+        }
+        return found;
+    }
+}
@@ -0,0 +1,117 @@
+//
+// Created by redkc on 19/10/2026.
+//
+
+#ifndef WIDEBVH_H
+#define WIDEBVH_H
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "Bvh.h"
+#include "SimdKernels.h"
+
+namespace cpu {
+    /**
+     * @brief Node with up to eight children whose boxes are tested with a single intersectBoxes8 call.
+     *
+     * A child is either another node or a leaf. Leaves reference a run of consecutive triangle packs, see
+     * makeLeafChild.
+     */
+    struct alignas(32) WideBvhNode {
+        BoxPack8 bounds;
+        uint32_t children[simdWidth];
+
+        static constexpr uint32_t emptyChild = 0xFFFFFFFFu;
+        static constexpr uint32_t leafFlag = 0x80000000u;
+        static constexpr uint32_t packCountShift = 24;
+        static constexpr uint32_t maxLeafPacks = 0x7Fu;
+        static constexpr uint32_t firstPackMask = (1u << packCountShift) - 1;
+
+        /** @brief Bit 31 marks a leaf, bits 24-30 hold the pack count and bits 0-23 the first pack */
+        static uint32_t makeLeafChild(uint32_t firstPack, uint32_t packCount) {
+            return leafFlag | (packCount << packCountShift) | firstPack;
+        }
+    };
+
+    /**
+     * @brief Eight-wide BVH collapsed from a binary Bvh, traversed with the SIMD kernels.
+     *
+     * Every wide node pulls in the children of its largest interior children until it has eight of them, so the tree
+     * keeps the SAH quality of the binary build while testing eight boxes per step. Leaf triangles are packed eight
+     * at a time in structure of arrays layout.
+     *
+     * All references inside the tree are indices, so traversal only needs views of the three arrays. They either
+     * point at the arrays build() fills or at memory owned by someone else, like a mapped BvhSnapshot.
+     */
+    class WideBvh {
+    public:
+        WideBvh() = default;
+        // The views may point into this object's own arrays, a copy would keep pointing at the original
+        WideBvh(const WideBvh &) = delete;
+        WideBvh &operator=(const WideBvh &) = delete;
+        WideBvh(WideBvh &&) noexcept = default;
+        WideBvh &operator=(WideBvh &&) noexcept = default;
+
+        void build(const Bvh &bvh);
+
+        /**
+         * @brief Uses arrays owned by the caller, which have to outlive this object. Nothing is copied.
+         */
+        void assign(std::span<const WideBvhNode> nodes, std::span<const TrianglePack8> packs,
+                    std::span<const Triangle> triangles, uint32_t rootLeaf);
+
+        bool intersect(const Ray &ray, Hit &hit) const;
+
+        /**
+         * @brief Picks the binary nodes that become the children of a wide node, by opening the interior child with
+         * the largest surface area until there are eight of them.
+         *
+         * @return The number of children written to children.
+         */
+        static uint32_t collapseChildren(const Bvh &bvh, uint32_t binaryIndex, uint32_t children[simdWidth]);
+
+        std::span<const WideBvhNode> getNodes() const {
+            return nodes;
+        }
+
+        std::span<const TrianglePack8> getPacks() const {
+            return packs;
+        }
+
+        std::span<const Triangle> getTriangles() const {
+            return triangles;
+        }
+
+        uint32_t getRootLeaf() const {
+            return rootLeaf;
+        }
+
+        /**
+         * @brief Traversal cost the binary build should use when it is collapsed into a WideBvh afterwards, found by
+         * measuring primary and incoherent rays. Leaves end up holding close to a full pack instead of one or two
+         * triangles.
+         */
+        static constexpr float binaryTraversalCost = 4.0f;
+
+        /** @brief Every level pushes at most seven siblings, and the tree is never deeper than the binary one */
+        static constexpr uint32_t stackSize = (simdWidth - 1) * Bvh::maxDepth + 1;
+
+    private:
+        uint32_t buildNode(const Bvh &bvh, uint32_t binaryIndex);
+
+        uint32_t buildLeaf(const Bvh &bvh, const BvhNode &leaf);
+
+        std::vector<WideBvhNode> ownedNodes;
+        std::vector<TrianglePack8> ownedPacks;
+        std::vector<Triangle> ownedTriangles;
+        std::span<const WideBvhNode> nodes;
+        std::span<const TrianglePack8> packs;
+        std::span<const Triangle> triangles;
+        /** @brief Set when the whole tree is a single leaf, which cannot be expressed as a node */
+        uint32_t rootLeaf = WideBvhNode::emptyChild;
+    };
+}
+
+
+#endif //WIDEBVH_H
@@ -3,6 +3,7 @@
 
 #include <map>
 #include <memory>
+#include <string>
 #include <vector>
 
 #include "Texture.h"
@@ -13,6 +14,8 @@ using namespace std;
 class Mesh {
 public:
     // mesh Data
+    // name from the model file, may be empty
+    std::string name;
     vector<Vertex> vertices;
     vector<uint32_t> indices;
     map<std::string, std::shared_ptr<Texture>> textures;
@@ -94,5 +94,7 @@ unique_ptr<Mesh> Model::processMesh(aiMesh *mesh, const aiScene *scene) {
     //  textures["texture_normal"] = loadMaterialTexture(material, aiTextureType_HEIGHT);
     //   textures["texture_height"] = loadMaterialTexture(material, aiTextureType_AMBIENT);
     // return a mesh object created from the extracted mesh data
-    return make_unique<Mesh>(vertices, indices, textures);
+    auto result = make_unique<Mesh>(vertices, indices, textures);
+    result->name = mesh->mName.C_Str();
+    return result;
 }
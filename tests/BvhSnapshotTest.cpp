@@ -0,0 +1,134 @@
+//
+// Created by redkc on 19/10/2026.
+//
+
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <span>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "cpu/Bvh.h"
+#include "cpu/BvhSnapshot.h"
+#include "cpu/WideBvh.h"
+
+#include "RandomScene.h"
+
+namespace {
+    class BvhSnapshotTest : public testing::Test {
+    protected:
+        void SetUp() override {
+            directory = std::filesystem::path(testing::TempDir()) / "bvh_snapshot_test";
+            std::filesystem::remove_all(directory);
+            std::filesystem::create_directories(directory);
+
+            std::mt19937 random(1);
+            std::vector<cpu::Triangle> triangles = scatterTriangles(5000, random);
+            rays = randomRays(2000, random);
+
+            cpu::BvhBuildSettings settings{};
+            settings.traversalCost = cpu::WideBvh::binaryTraversalCost;
+            cpu::Bvh bvh;
+            bvh.build(std::move(triangles), settings);
+            wideBvh.build(bvh);
+        }
+
+        void TearDown() override {
+            std::filesystem::remove_all(directory);
+        }
+
+        template<typename T>
+        static bool sameBytes(std::span<const T> a, std::span<const T> b) {
+            return a.size() == b.size() && std::memcmp(a.data(), b.data(), a.size_bytes()) == 0;
+        }
+
+        std::filesystem::path directory;
+        std::vector<cpu::Ray> rays;
+        cpu::WideBvh wideBvh;
+        static constexpr uint64_t sourceKey = 0x1234567890abcdefull;
+    };
+}
+
+TEST_F(BvhSnapshotTest, MapsTheTreeItWasWrittenFrom) {
+    const std::string path = cpu::BvhSnapshot::path(directory.string(), sourceKey);
+    ASSERT_TRUE(cpu::BvhSnapshot::write(path, wideBvh, sourceKey));
+
+    cpu::BvhSnapshot snapshot;
+    ASSERT_TRUE(snapshot.open(path, sourceKey));
+    const cpu::WideBvh &mapped = snapshot.getBvh();
+    EXPECT_TRUE(sameBytes(mapped.getNodes(), wideBvh.getNodes()));
+    EXPECT_TRUE(sameBytes(mapped.getPacks(), wideBvh.getPacks()));
+    EXPECT_TRUE(sameBytes(mapped.getTriangles(), wideBvh.getTriangles()));
+    EXPECT_EQ(mapped.getRootLeaf(), wideBvh.getRootLeaf());
+    EXPECT_GE(snapshot.getMappedSize(), wideBvh.getTriangles().size_bytes());
+
+    for (const cpu::Ray &ray: rays) {
+        cpu::Hit expected{};
+        cpu::Hit actual{};
+        ASSERT_EQ(mapped.intersect(ray, actual), wideBvh.intersect(ray, expected));
+        EXPECT_EQ(actual.t, expected.t);
+        EXPECT_EQ(actual.triangleIndex, expected.triangleIndex);
+    }
+
+    // The temporary file was renamed into place, nothing else is left in the directory
+    uint32_t files = 0;
+    for ([[maybe_unused]] const auto &entry: std::filesystem::directory_iterator(directory)) {
+        files++;
+    }
+    EXPECT_EQ(files, 1u);
+}
+
+TEST_F(BvhSnapshotTest, RejectsAnotherSource) {
+    const std::string path = cpu::BvhSnapshot::path(directory.string(), sourceKey);
+    ASSERT_TRUE(cpu::BvhSnapshot::write(path, wideBvh, sourceKey));
+
+    cpu::BvhSnapshot snapshot;
+    EXPECT_FALSE(snapshot.open(path, sourceKey + 1));
+    EXPECT_TRUE(snapshot.getBvh().getNodes().empty());
+    EXPECT_FALSE(snapshot.open((directory / "missing.bvh").string(), sourceKey));
+}
+
+TEST_F(BvhSnapshotTest, RejectsDamagedFiles) {
+    const std::string path = cpu::BvhSnapshot::path(directory.string(), sourceKey);
+    ASSERT_TRUE(cpu::BvhSnapshot::write(path, wideBvh, sourceKey));
+    const uintmax_t size = std::filesystem::file_size(path);
+
+    {
+        // One flipped byte in the middle of the payload
+        std::fstream file(path, std::ios::in | std::ios::out | std::ios::binary);
+        file.seekg(static_cast<std::streamoff>(size / 2));
+        char byte = 0;
+        file.read(&byte, 1);
+        byte = static_cast<char>(~byte);
+        file.seekp(static_cast<std::streamoff>(size / 2));
+        file.write(&byte, 1);
+    }
+    cpu::BvhSnapshot snapshot;
+    EXPECT_FALSE(snapshot.open(path, sourceKey));
+
+    std::filesystem::resize_file(path, size / 3);
+    EXPECT_FALSE(snapshot.open(path, sourceKey, false));
+}
+
+TEST_F(BvhSnapshotTest, SourceKeyFollowsTheModelFile) {
+    EXPECT_EQ(cpu::BvhSnapshot::sourceKey((directory / "missing.fbx").string()), 0u);
+
+    const std::string modelPath = (directory / "model.fbx").string();
+    {
+        std::ofstream model(modelPath);
+        model << "model";
+    }
+    const uint64_t key = cpu::BvhSnapshot::sourceKey(modelPath);
+    EXPECT_NE(key, 0u);
+    EXPECT_EQ(cpu::BvhSnapshot::sourceKey(modelPath), key);
+    {
+        std::ofstream model(modelPath, std::ios::app);
+        model << " with more data";
+    }
+    EXPECT_NE(cpu::BvhSnapshot::sourceKey(modelPath), key);
+}
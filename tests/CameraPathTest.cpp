@@ -0,0 +1,91 @@
+//
+// Created by redkc on 19/10/2026.
+//
+
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+
+#include <gtest/gtest.h>
+#include <glm/gtc/type_ptr.hpp>
+
+#include "app/CameraPath.h"
+
+namespace {
+    std::string writeCameraPath(const std::string &name, const std::string &contents) {
+        const std::string path = (std::filesystem::path(testing::TempDir()) / name).string();
+        std::ofstream file(path, std::ios::trunc);
+        file << contents;
+        return path;
+    }
+
+    void expectMatrixEq(const glm::mat4 &actual, const glm::mat4 &expected) {
+        for (int column = 0; column < 4; column++) {
+            for (int row = 0; row < 4; row++) {
+                EXPECT_FLOAT_EQ(actual[column][row], expected[column][row]) << "column " << column << " row " << row;
+            }
+        }
+    }
+
+    void expectCameraEq(const RaytracingCamera &actual, const RaytracingCamera &expected) {
+        expectMatrixEq(actual.viewInverse, expected.viewInverse);
+        expectMatrixEq(actual.projInverse, expected.projInverse);
+    }
+
+    std::string loadError(const std::string &path, float aspect) {
+        try {
+            CameraPath::load(path, aspect);
+        } catch (const std::runtime_error &error) {
+            return error.what();
+        }
+        return {};
+    }
+}
+
+TEST(CameraPath, LoadsEveryKeyframeInOrder) {
+    const float view[16] = {1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, -1, -2, -3, 1};
+    const float proj[16] = {1.5f, 0, 0, 0, 0, 2, 0, 0, 0, 0, -1, -1, 0, 0, -0.2f, 0};
+    std::string matrices = "matrices";
+    for (float value: view) {
+        matrices += " " + std::to_string(value);
+    }
+    for (float value: proj) {
+        matrices += " " + std::to_string(value);
+    }
+
+    const std::string path = writeCameraPath("camera_path_keyframes.txt",
+                                             "# orbit\n"
+                                             "\n"
+                                             "lookat 2 2 2  0 0 0  0 0 1\n"
+                                             "lookat 0 -5 1  0 0 1  0 0 1  45\n"
+                                             + matrices + "\n");
+    const float aspect = 16.0f / 9.0f;
+    const std::vector<RaytracingCamera> cameras = CameraPath::load(path, aspect);
+
+    ASSERT_EQ(cameras.size(), 3u);
+    // Without a field of view a lookat keyframe matches the default camera
+    expectCameraEq(cameras[0], RaytracingCamera::createDefault(aspect));
+    expectCameraEq(cameras[1], RaytracingCamera::createLookAt(glm::vec3(0, -5, 1), glm::vec3(0, 0, 1),
+                                                              glm::vec3(0, 0, 1), 45.0f, aspect));
+    expectCameraEq(cameras[2], RaytracingCamera::createFromMatrices(glm::make_mat4(view), glm::make_mat4(proj)));
+}
+
+TEST(CameraPath, ReportsTheLineOfAMalformedKeyframe) {
+    const std::string path = writeCameraPath("camera_path_malformed.txt",
+                                             "lookat 2 2 2  0 0 0  0 0 1\n"
+                                             "# the next one misses its up vector\n"
+                                             "lookat 2 2 2  0 0 0\n");
+    const std::string message = loadError(path, 1.0f);
+    EXPECT_NE(message.find("line 3"), std::string::npos) << message;
+
+    const std::string unknownKeyword = writeCameraPath("camera_path_unknown.txt", "orbit 1 2 3\n");
+    EXPECT_THROW(CameraPath::load(unknownKeyword, 1.0f), std::runtime_error);
+}
+
+TEST(CameraPath, RejectsMissingAndEmptyFiles) {
+    EXPECT_THROW(CameraPath::load(writeCameraPath("camera_path_empty.txt", "# nothing\n\n"), 1.0f),
+                 std::runtime_error);
+    EXPECT_THROW(CameraPath::load((std::filesystem::path(testing::TempDir()) / "no_such_path.txt").string(), 1.0f),
+                 std::runtime_error);
+}
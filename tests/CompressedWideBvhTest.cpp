@@ -0,0 +1,68 @@
+//
+// Created by redkc on 19/10/2026.
+//
+
+#include <cstdint>
+#include <random>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "cpu/Bvh.h"
+#include "cpu/CompressedWideBvh.h"
+#include "cpu/WideBvh.h"
+
+#include "RandomScene.h"
+
+namespace {
+    void expectSameHits(const cpu::Bvh &bvh, const cpu::CompressedWideBvh &compressed,
+                        const std::vector<cpu::Ray> &rays) {
+        uint32_t hits = 0;
+        for (size_t i = 0; i < rays.size(); i++) {
+            cpu::Hit expected{};
+            cpu::Hit actual{};
+            const bool expectedHit = bvh.intersect(rays[i], expected);
+            ASSERT_EQ(compressed.intersect(rays[i], actual), expectedHit) << "ray " << i;
+            if (!expectedHit) {
+                continue;
+            }
+            hits++;
+            // Both trees reorder the triangles, the primitive index is what identifies one
+            EXPECT_NEAR(actual.t, expected.t, 1e-4f * expected.t) << "ray " << i;
+            EXPECT_EQ(compressed.getTriangles()[actual.triangleIndex].primitiveIndex,
+                      bvh.getTriangles()[expected.triangleIndex].primitiveIndex) << "ray " << i;
+        }
+        // Rays that all miss would not prove anything
+        EXPECT_GT(hits, rays.size() / 10);
+    }
+}
+
+TEST(CompressedWideBvh, FindsTheSameHitsAsTheBinaryBvh) {
+    std::mt19937 random(1);
+    cpu::BvhBuildSettings settings{};
+    settings.traversalCost = cpu::WideBvh::binaryTraversalCost;
+    cpu::Bvh bvh;
+    bvh.build(scatterTriangles(20000, random), settings);
+    cpu::CompressedWideBvh compressed;
+    compressed.build(bvh);
+
+    EXPECT_FALSE(compressed.getNodes().empty());
+    expectSameHits(bvh, compressed, randomRays(20000, random));
+}
+
+TEST(CompressedWideBvh, HandlesASceneThatFitsInOneLeaf) {
+    std::mt19937 random(2);
+    cpu::Bvh bvh;
+    bvh.build(scatterTriangles(3, random));
+    cpu::CompressedWideBvh compressed;
+    compressed.build(bvh);
+
+    std::vector<cpu::Ray> rays;
+    for (const cpu::Triangle &triangle: bvh.getTriangles()) {
+        // Straight down through the centroid, and the same ray turned around
+        const glm::vec3 centroid = (triangle.v0 + triangle.v1 + triangle.v2) / 3.0f;
+        rays.push_back({centroid + glm::vec3(0.0f, 0.0f, 20.0f), 0.001f, glm::vec3(0.0f, 0.0f, -1.0f), 1000.0f});
+        rays.push_back({centroid + glm::vec3(0.0f, 0.0f, 20.0f), 0.001f, glm::vec3(0.0f, 0.0f, 1.0f), 1000.0f});
+    }
+    expectSameHits(bvh, compressed, rays);
+}
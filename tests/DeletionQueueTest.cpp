@@ -0,0 +1,91 @@
+//
+// Created by redkc on 19/10/2026.
+//
+
+#include <cstdint>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "app/DeletionQueue.h"
+
+TEST(DeletionQueue, RunsDeletersOnlyOnceTheirFrameCompleted) {
+    DeletionQueue deletionQueue;
+    std::vector<int> deleted;
+    deletionQueue.retire(3, [&]() { deleted.push_back(3); });
+    deletionQueue.retire(1, [&]() { deleted.push_back(1); });
+    deletionQueue.retire(2, [&]() { deleted.push_back(2); });
+
+    deletionQueue.collect(0);
+    EXPECT_TRUE(deleted.empty());
+    EXPECT_EQ(deletionQueue.pending(), 3u);
+
+    deletionQueue.collect(2);
+    EXPECT_EQ(deleted, (std::vector<int>{1, 2}));
+    EXPECT_EQ(deletionQueue.pending(), 1u);
+
+    // Collecting the same value again runs nothing twice
+    deletionQueue.collect(2);
+    EXPECT_EQ(deleted, (std::vector<int>{1, 2}));
+
+    deletionQueue.collect(3);
+    EXPECT_EQ(deleted, (std::vector<int>{1, 2, 3}));
+    EXPECT_EQ(deletionQueue.pending(), 0u);
+}
+
+TEST(DeletionQueue, RunsTheDeletersOfOneFrameInRetireOrder) {
+    DeletionQueue deletionQueue;
+    std::vector<int> deleted;
+    for (int i = 0; i < 5; i++) {
+        deletionQueue.retire([&deleted, i]() { deleted.push_back(i); });
+    }
+    deletionQueue.collect(deletionQueue.currentFrame());
+    EXPECT_EQ(deleted, (std::vector<int>{0, 1, 2, 3, 4}));
+}
+
+TEST(DeletionQueue, RetiresWithTheFrameBeingRecorded) {
+    DeletionQueue deletionQueue;
+    const uint64_t firstFrame = deletionQueue.currentFrame();
+    int deleted = 0;
+    deletionQueue.retire([&]() { deleted++; });
+    EXPECT_EQ(deletionQueue.advance(), firstFrame + 1);
+    EXPECT_EQ(deletionQueue.currentFrame(), firstFrame + 1);
+    deletionQueue.retire([&]() { deleted++; });
+
+    // The GPU finished the first frame, the second one may still use its resource
+    deletionQueue.collect(firstFrame);
+    EXPECT_EQ(deleted, 1);
+    EXPECT_EQ(deletionQueue.pending(), 1u);
+    deletionQueue.collect(firstFrame + 1);
+    EXPECT_EQ(deleted, 2);
+}
+
+TEST(DeletionQueue, FlushDrainsEverythingIncludingNewlyRetired) {
+    DeletionQueue deletionQueue;
+    std::vector<int> deleted;
+    deletionQueue.retire(100, [&]() { deleted.push_back(0); });
+    deletionQueue.retire(5, [&]() {
+        deleted.push_back(1);
+        // Releasing a resource can retire the ones it owned, a flush has to run those as well
+        deletionQueue.retire(200, [&]() { deleted.push_back(2); });
+    });
+
+    deletionQueue.flushAll();
+    EXPECT_EQ(deleted, (std::vector<int>{0, 1, 2}));
+    EXPECT_EQ(deletionQueue.pending(), 0u);
+}
+
+TEST(DeletionQueue, DeletersMayRetireWhileCollecting) {
+    DeletionQueue deletionQueue;
+    int deleted = 0;
+    deletionQueue.retire(1, [&]() {
+        deleted++;
+        deletionQueue.retire(2, [&]() { deleted++; });
+    });
+
+    deletionQueue.collect(1);
+    EXPECT_EQ(deleted, 1);
+    EXPECT_EQ(deletionQueue.pending(), 1u);
+    deletionQueue.collect(2);
+    EXPECT_EQ(deleted, 2);
+}
@@ -0,0 +1,17 @@
+//
+// Created by redkc on 19/10/2026.
+//
+
+#ifndef FAKEHANDLES_H
+#define FAKEHANDLES_H
+#include <cstdint>
+
+/**
+ * @brief A placeholder Vulkan handle for tests that never hand it to a driver, distinct values give distinct handles.
+ */
+template<typename T>
+T fakeHandle(uint64_t value) {
+    return reinterpret_cast<T>(static_cast<uintptr_t>(value));
+}
+
+#endif //FAKEHANDLES_H
@@ -0,0 +1,104 @@
+//
+// Created by redkc on 19/10/2026.
+//
+
+#include <chrono>
+#include <thread>
+
+#include <gtest/gtest.h>
+
+#include "app/FramePacer.h"
+
+namespace {
+    using Clock = std::chrono::steady_clock;
+
+    float millisecondsSince(Clock::time_point start) {
+        return std::chrono::duration<float, std::chrono::milliseconds::period>(Clock::now() - start).count();
+    }
+
+    void sleepMilliseconds(int milliseconds) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(milliseconds));
+    }
+}
+
+TEST(FramePacer, HoldsFramesToTheTargetRate) {
+    FramePacer framePacer(100);
+    // The first frame starts right away and sets the schedule, the next ones come one period apart
+    framePacer.waitForFrameStart();
+    const Clock::time_point start = Clock::now();
+    for (int i = 0; i < 20; i++) {
+        framePacer.waitForFrameStart();
+    }
+    const float elapsed = millisecondsSince(start);
+    EXPECT_GE(elapsed, 19.0f * 10.0f);
+    // Generous, a loaded machine oversleeps but must not drift by whole periods per frame
+    EXPECT_LT(elapsed, 20.0f * 10.0f * 3.0f);
+}
+
+TEST(FramePacer, DoesNotPaceWithoutATarget) {
+    FramePacer framePacer;
+    EXPECT_EQ(framePacer.getTargetFrameRate(), 0u);
+    const Clock::time_point start = Clock::now();
+    for (int i = 0; i < 100; i++) {
+        framePacer.waitForFrameStart();
+    }
+    EXPECT_LT(millisecondsSince(start), 50.0f);
+}
+
+TEST(FramePacer, ALateFrameDoesNotCatchUp) {
+    FramePacer framePacer(100);
+    framePacer.waitForFrameStart();
+    // Five periods late, the next frame starts at once instead of the five missed ones rushing through
+    sleepMilliseconds(50);
+    Clock::time_point start = Clock::now();
+    framePacer.waitForFrameStart();
+    EXPECT_LT(millisecondsSince(start), 8.0f);
+
+    start = Clock::now();
+    framePacer.waitForFrameStart();
+    EXPECT_GE(millisecondsSince(start), 8.0f);
+}
+
+TEST(FramePacer, ChangingTheRateRestartsTheSchedule) {
+    FramePacer framePacer(1);
+    framePacer.waitForFrameStart();
+    // A full second would be left at 1 fps, the new rate must not inherit it
+    framePacer.setTargetFrameRate(100);
+    EXPECT_EQ(framePacer.getTargetFrameRate(), 100u);
+    const Clock::time_point start = Clock::now();
+    framePacer.waitForFrameStart();
+    framePacer.waitForFrameStart();
+    EXPECT_LT(millisecondsSince(start), 500.0f);
+}
+
+TEST(FramePacer, AveragesLatenciesOfCompletedFramesOncePerInterval) {
+    FramePacer framePacer;
+    // Starts the report interval
+    framePacer.markCompleted(0);
+
+    framePacer.markInputSampled(1);
+    sleepMilliseconds(10);
+    framePacer.markSubmitted(1);
+    sleepMilliseconds(10);
+    framePacer.markPresented(1);
+
+    // Skipped before it was presented, it has nothing to report
+    framePacer.markInputSampled(2);
+    framePacer.markSubmitted(2);
+
+    // Unknown frames are ignored
+    framePacer.markSubmitted(7);
+    framePacer.markPresented(7);
+
+    framePacer.markCompleted(1);
+    EXPECT_EQ(framePacer.getStats().frames, 0u) << "reported before the interval was over";
+
+    sleepMilliseconds(1000);
+    framePacer.markCompleted(2);
+    const FramePacer::Stats &stats = framePacer.getStats();
+    EXPECT_EQ(stats.frames, 1u);
+    EXPECT_GE(stats.inputToSubmit, 10.0f);
+    EXPECT_GE(stats.submitToPresent, 10.0f);
+    EXPECT_GE(stats.submitToGpuDone, stats.submitToPresent);
+    EXPECT_NEAR(stats.inputToGpuDone, stats.inputToSubmit + stats.submitToGpuDone, 0.01f);
+}
@@ -0,0 +1,266 @@
+//
+// Created by redkc on 19/10/2026.
+//
+
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <stdexcept>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "app/FrameScheduler.h"
+
+#include "FakeHandles.h"
+
+namespace {
+    struct RecordedBatch {
+        std::vector<VkSemaphoreSubmitInfo> waits;
+        std::vector<VkCommandBuffer> commandBuffers;
+        std::vector<VkSemaphoreSubmitInfo> signals;
+    };
+
+    struct RecordedSubmit {
+        VkQueue queue;
+        std::vector<RecordedBatch> batches;
+    };
+
+    // Device state of the fake entry points below, reset by every test
+    std::vector<RecordedSubmit> submits;
+    std::map<VkSemaphore, uint64_t> semaphoreValues;
+    uint64_t nextSemaphore = 1;
+
+    VKAPI_ATTR VkResult VKAPI_CALL fakeQueueSubmit2(VkQueue queue, uint32_t submitCount,
+                                                    const VkSubmitInfo2 *pSubmits, VkFence) {
+        RecordedSubmit submit{queue, {}};
+        for (uint32_t i = 0; i < submitCount; i++) {
+            const VkSubmitInfo2 &info = pSubmits[i];
+            RecordedBatch batch;
+            batch.waits.assign(info.pWaitSemaphoreInfos, info.pWaitSemaphoreInfos + info.waitSemaphoreInfoCount);
+            for (uint32_t j = 0; j < info.commandBufferInfoCount; j++) {
+                batch.commandBuffers.push_back(info.pCommandBufferInfos[j].commandBuffer);
+            }
+            batch.signals.assign(info.pSignalSemaphoreInfos,
+                                 info.pSignalSemaphoreInfos + info.signalSemaphoreInfoCount);
+            // The work completes at once, timelines are signaled as soon as they are submitted
+            for (const VkSemaphoreSubmitInfo &signal: batch.signals) {
+                if (semaphoreValues.contains(signal.semaphore)) {
+                    semaphoreValues[signal.semaphore] = signal.value;
+                }
+            }
+            submit.batches.push_back(std::move(batch));
+        }
+        submits.push_back(std::move(submit));
+        return VK_SUCCESS;
+    }
+
+    VkCommandBuffer commandBuffer(uint64_t value) {
+        return fakeHandle<VkCommandBuffer>(0x1000 + value);
+    }
+
+    FrameScheduler::Pass pass(const char *name, uint64_t commandBufferValue, std::vector<uint32_t> dependencies = {}) {
+        FrameScheduler::Pass result;
+        result.name = name;
+        result.commandBuffers = {commandBuffer(commandBufferValue)};
+        result.dependencies = std::move(dependencies);
+        return result;
+    }
+
+    bool signals(const RecordedBatch &batch, VkSemaphore semaphore, uint64_t value) {
+        for (const VkSemaphoreSubmitInfo &signal: batch.signals) {
+            if (signal.semaphore == semaphore && signal.value == value) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    class FrameSchedulerTest : public testing::Test {
+    protected:
+        void SetUp() override {
+            submits.clear();
+            semaphoreValues.clear();
+            nextSemaphore = 1;
+        }
+
+        const VkDevice device = fakeHandle<VkDevice>(1);
+        const VkQueue graphicsQueue = fakeHandle<VkQueue>(2);
+        const VkQueue computeQueue = fakeHandle<VkQueue>(3);
+        const VkSemaphore acquireSemaphore = fakeHandle<VkSemaphore>(0x100);
+        const VkSemaphore presentSemaphore = fakeHandle<VkSemaphore>(0x101);
+    };
+}
+
+// The scheduler only needs these entry points, the test defines them instead of talking to a driver. Timeline
+// semaphores are the only semaphores it creates.
+VKAPI_ATTR PFN_vkVoidFunction VKAPI_CALL vkGetDeviceProcAddr(VkDevice, const char *pName) {
+    if (std::strcmp(pName, "vkQueueSubmit2KHR") == 0) {
+        return reinterpret_cast<PFN_vkVoidFunction>(&fakeQueueSubmit2);
+    }
+    return nullptr;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkCreateSemaphore(VkDevice, const VkSemaphoreCreateInfo *, const VkAllocationCallbacks *,
+                                                 VkSemaphore *pSemaphore) {
+    *pSemaphore = fakeHandle<VkSemaphore>(nextSemaphore++);
+    semaphoreValues[*pSemaphore] = 0;
+    return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkDestroySemaphore(VkDevice, VkSemaphore semaphore, const VkAllocationCallbacks *) {
+    semaphoreValues.erase(semaphore);
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkGetSemaphoreCounterValue(VkDevice, VkSemaphore semaphore, uint64_t *pValue) {
+    *pValue = semaphoreValues.at(semaphore);
+    return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkWaitSemaphores(VkDevice, const VkSemaphoreWaitInfo *pWaitInfo, uint64_t) {
+    // A wait for a value nobody submitted would block a real device forever
+    for (uint32_t i = 0; i < pWaitInfo->semaphoreCount; i++) {
+        if (semaphoreValues.at(pWaitInfo->pSemaphores[i]) < pWaitInfo->pValues[i]) {
+            return VK_TIMEOUT;
+        }
+    }
+    return VK_SUCCESS;
+}
+
+TEST_F(FrameSchedulerTest, PassesWithoutWaitsShareOneBatch) {
+    FrameScheduler scheduler(device, {graphicsQueue}, 2);
+    scheduler.beginFrame(1);
+    const uint32_t update = scheduler.addPass(pass("update", 1));
+    const uint32_t trace = scheduler.addPass(pass("trace", 2, {update}));
+    scheduler.addPass(pass("raster", 3, {trace}));
+    scheduler.submit();
+
+    ASSERT_EQ(submits.size(), 1u);
+    ASSERT_EQ(submits[0].batches.size(), 1u);
+    const RecordedBatch &batch = submits[0].batches[0];
+    EXPECT_TRUE(batch.waits.empty());
+    EXPECT_EQ(batch.commandBuffers, (std::vector{commandBuffer(1), commandBuffer(2), commandBuffer(3)}));
+    ASSERT_EQ(batch.signals.size(), 1u);
+    EXPECT_EQ(batch.signals[0].value, 1u);
+    EXPECT_EQ(scheduler.getLastBatchCount(), 1u);
+    EXPECT_EQ(scheduler.completedValue(), 1u);
+}
+
+TEST_F(FrameSchedulerTest, ReadyWorkIsNotHeldBackByAWait) {
+    FrameScheduler scheduler(device, {graphicsQueue}, 2);
+    scheduler.beginFrame(1);
+    FrameScheduler::Pass raster = pass("raster", 1);
+    raster.waits = {FrameScheduler::semaphoreInfo(acquireSemaphore, VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT)};
+    raster.signals = {FrameScheduler::semaphoreInfo(presentSemaphore, VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT)};
+    scheduler.addPass(raster);
+    scheduler.addPass(pass("trace", 2));
+    scheduler.submit();
+
+    // The trace was added last but goes first, it does not have to wait for the swapchain image
+    ASSERT_EQ(submits.size(), 1u);
+    ASSERT_EQ(submits[0].batches.size(), 2u);
+    const RecordedBatch &first = submits[0].batches[0];
+    EXPECT_TRUE(first.waits.empty());
+    EXPECT_EQ(first.commandBuffers, std::vector{commandBuffer(2)});
+    EXPECT_TRUE(first.signals.empty());
+
+    const RecordedBatch &second = submits[0].batches[1];
+    ASSERT_EQ(second.waits.size(), 1u);
+    EXPECT_EQ(second.waits[0].semaphore, acquireSemaphore);
+    EXPECT_EQ(second.commandBuffers, std::vector{commandBuffer(1)});
+    EXPECT_TRUE(signals(second, presentSemaphore, 0));
+    EXPECT_EQ(scheduler.getLastBatchCount(), 2u);
+}
+
+TEST_F(FrameSchedulerTest, NothingIsAppendedAfterASignal) {
+    FrameScheduler scheduler(device, {graphicsQueue}, 2);
+    scheduler.beginFrame(1);
+    FrameScheduler::Pass raster = pass("raster", 1);
+    raster.signals = {FrameScheduler::semaphoreInfo(presentSemaphore, VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT)};
+    const uint32_t rasterIndex = scheduler.addPass(raster);
+    scheduler.addPass(pass("readback", 2, {rasterIndex}));
+    scheduler.submit();
+
+    ASSERT_EQ(submits.size(), 1u);
+    ASSERT_EQ(submits[0].batches.size(), 2u);
+    EXPECT_EQ(submits[0].batches[0].commandBuffers, std::vector{commandBuffer(1)});
+    EXPECT_TRUE(signals(submits[0].batches[0], presentSemaphore, 0));
+    EXPECT_EQ(submits[0].batches[1].commandBuffers, std::vector{commandBuffer(2)});
+}
+
+TEST_F(FrameSchedulerTest, DependencyOnAnotherQueueWaitsOnItsTimeline) {
+    FrameScheduler scheduler(device, {graphicsQueue, computeQueue}, 2);
+    scheduler.beginFrame(1);
+    FrameScheduler::Pass trace = pass("trace", 1);
+    trace.queue = 1;
+    const uint32_t traceIndex = scheduler.addPass(trace);
+    scheduler.addPass(pass("raster", 2, {traceIndex}));
+    scheduler.submit();
+
+    // The compute queue goes first, so the timeline the graphics queue waits on is already signaled
+    ASSERT_EQ(submits.size(), 2u);
+    EXPECT_EQ(submits[0].queue, computeQueue);
+    EXPECT_EQ(submits[1].queue, graphicsQueue);
+    ASSERT_EQ(submits[0].batches.size(), 1u);
+    const RecordedBatch &traceBatch = submits[0].batches[0];
+    EXPECT_EQ(traceBatch.commandBuffers, std::vector{commandBuffer(1)});
+    ASSERT_EQ(traceBatch.signals.size(), 1u);
+    const VkSemaphore computeTimeline = traceBatch.signals[0].semaphore;
+    EXPECT_EQ(traceBatch.signals[0].value, 1u);
+
+    // The raster work waits for the trace, the frame signal additionally waits for the whole compute queue
+    ASSERT_EQ(submits[1].batches.size(), 2u);
+    const RecordedBatch &rasterBatch = submits[1].batches[0];
+    EXPECT_EQ(rasterBatch.commandBuffers, std::vector{commandBuffer(2)});
+    ASSERT_EQ(rasterBatch.waits.size(), 1u);
+    EXPECT_EQ(rasterBatch.waits[0].semaphore, computeTimeline);
+    EXPECT_EQ(rasterBatch.waits[0].value, 1u);
+
+    const RecordedBatch &frameBatch = submits[1].batches[1];
+    EXPECT_TRUE(frameBatch.commandBuffers.empty());
+    ASSERT_EQ(frameBatch.waits.size(), 1u);
+    EXPECT_EQ(frameBatch.waits[0].semaphore, computeTimeline);
+    EXPECT_EQ(scheduler.getLastBatchCount(), 3u);
+    EXPECT_EQ(scheduler.completedValue(), 1u);
+}
+
+TEST_F(FrameSchedulerTest, QueueGivenTwiceIsMerged) {
+    FrameScheduler scheduler(device, {graphicsQueue, graphicsQueue}, 2);
+    scheduler.beginFrame(1);
+    FrameScheduler::Pass trace = pass("trace", 1);
+    trace.queue = 1;
+    const uint32_t traceIndex = scheduler.addPass(trace);
+    scheduler.addPass(pass("raster", 2, {traceIndex}));
+    scheduler.submit();
+
+    ASSERT_EQ(submits.size(), 1u);
+    ASSERT_EQ(submits[0].batches.size(), 1u);
+    EXPECT_TRUE(submits[0].batches[0].waits.empty());
+    EXPECT_EQ(submits[0].batches[0].commandBuffers, (std::vector{commandBuffer(1), commandBuffer(2)}));
+}
+
+TEST_F(FrameSchedulerTest, FrameSlotsAreReusedOnceTheirFrameCompleted) {
+    FrameScheduler scheduler(device, {graphicsQueue}, 2);
+    for (uint64_t frame = 1; frame <= 4; frame++) {
+        // The fake device fails a wait for a frame that was never submitted
+        EXPECT_EQ(scheduler.beginFrame(frame), (frame - 1) % 2);
+        scheduler.submit();
+        EXPECT_EQ(scheduler.completedValue(), frame);
+    }
+    // Even a frame without passes signals the timeline
+    ASSERT_EQ(submits.size(), 4u);
+    EXPECT_EQ(submits[3].batches.size(), 1u);
+}
+
+TEST_F(FrameSchedulerTest, RejectsInvalidPassesAndFrameValues) {
+    FrameScheduler scheduler(device, {graphicsQueue}, 2);
+    scheduler.beginFrame(1);
+    FrameScheduler::Pass unknownQueue = pass("unknown queue", 1);
+    unknownQueue.queue = 1;
+    EXPECT_THROW(scheduler.addPass(unknownQueue), std::runtime_error);
+    EXPECT_THROW(scheduler.addPass(pass("unknown dependency", 2, {0})), std::runtime_error);
+    scheduler.submit();
+
+    EXPECT_THROW(scheduler.beginFrame(1), std::runtime_error);
+    EXPECT_THROW(FrameScheduler(device, {}, 2), std::runtime_error);
+}
@@ -0,0 +1,107 @@
+//
+// Created by redkc on 19/10/2026.
+//
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "app/ImageEncoder.h"
+
+namespace {
+    std::string tempPath(const std::string &name) {
+        return (std::filesystem::path(testing::TempDir()) / name).string();
+    }
+
+    std::vector<char> readFile(const std::string &path) {
+        std::ifstream file(path, std::ios::binary);
+        return {std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()};
+    }
+
+    void encode(const std::string &path, uint32_t width, uint32_t height, ImageEncoder::PixelFormat pixelFormat,
+                const void *pixels) {
+        ImageEncoder encoder(1);
+        ImageEncoder::Job job;
+        job.path = path;
+        job.width = width;
+        job.height = height;
+        job.pixelFormat = pixelFormat;
+        job.pixels = pixels;
+        encoder.submit(job);
+        encoder.waitIdle();
+    }
+}
+
+TEST(ImageEncoder, PicksTheFormatFromTheExtension) {
+    EXPECT_EQ(ImageEncoder::fileFormat("out.ppm"), ImageEncoder::FileFormat::Ppm);
+    EXPECT_EQ(ImageEncoder::fileFormat("frames/out.PNG"), ImageEncoder::FileFormat::Png);
+    EXPECT_EQ(ImageEncoder::fileFormat("out.jpeg"), ImageEncoder::FileFormat::Jpg);
+    EXPECT_EQ(ImageEncoder::fileFormat("out.hdr"), ImageEncoder::FileFormat::Hdr);
+    EXPECT_EQ(ImageEncoder::fileFormat("out.pfm"), ImageEncoder::FileFormat::Pfm);
+    EXPECT_THROW(ImageEncoder::fileFormat("out.exr"), std::runtime_error);
+    // A dot in a directory is not an extension
+    EXPECT_THROW(ImageEncoder::fileFormat("frames.ppm/out"), std::runtime_error);
+}
+
+TEST(ImageEncoder, WritesBgraPixelsAsPpm) {
+    // 2x1 BGRA, a red and a blue pixel
+    const uint8_t pixels[] = {0, 0, 255, 255, 255, 0, 0, 255};
+    const std::string path = tempPath("image_encoder.ppm");
+    encode(path, 2, 1, ImageEncoder::PixelFormat::Bgra8, pixels);
+
+    const std::string header = "P6\n2 1\n255\n";
+    const std::vector<char> file = readFile(path);
+    ASSERT_EQ(file.size(), header.size() + 6);
+    EXPECT_EQ(std::string(file.begin(), file.begin() + static_cast<std::ptrdiff_t>(header.size())), header);
+    const std::vector<uint8_t> rgb(file.begin() + static_cast<std::ptrdiff_t>(header.size()), file.end());
+    EXPECT_EQ(rgb, (std::vector<uint8_t>{255, 0, 0, 0, 0, 255}));
+}
+
+TEST(ImageEncoder, WritesFloatPixelsAsPfmBottomRowFirst) {
+    // 1x2 RGBA, values above 1 survive in a float file
+    const float pixels[] = {
+        4.0f, 0.5f, 0.25f, 1.0f,
+        0.0f, 1.0f, 2.0f, 1.0f,
+    };
+    const std::string path = tempPath("image_encoder.pfm");
+    encode(path, 1, 2, ImageEncoder::PixelFormat::Rgba32f, pixels);
+
+    const std::string header = "PF\n1 2\n-1.0\n";
+    const std::vector<char> file = readFile(path);
+    ASSERT_EQ(file.size(), header.size() + 6 * sizeof(float));
+    EXPECT_EQ(std::string(file.begin(), file.begin() + static_cast<std::ptrdiff_t>(header.size())), header);
+
+    // The negative scale promises little endian floats, which is what the host writes
+    float rgb[6];
+    std::memcpy(rgb, file.data() + header.size(), sizeof(rgb));
+    const float expected[] = {0.0f, 1.0f, 2.0f, 4.0f, 0.5f, 0.25f};
+    for (int i = 0; i < 6; i++) {
+        EXPECT_FLOAT_EQ(rgb[i], expected[i]) << "channel " << i;
+    }
+}
+
+TEST(ImageEncoder, ReportsFailedJobsAfterReleasingTheirPixels) {
+    const uint8_t pixels[4] = {};
+    std::atomic<int> released = 0;
+    ImageEncoder encoder(2);
+    ImageEncoder::Job job;
+    job.path = tempPath("no_such_directory/image_encoder.ppm");
+    job.width = 1;
+    job.height = 1;
+    job.pixels = pixels;
+    job.onDone = [&released]() { released++; };
+    encoder.submit(job);
+
+    EXPECT_THROW(encoder.waitIdle(), std::runtime_error);
+    EXPECT_EQ(released, 1);
+    EXPECT_EQ(encoder.finishedJobs(), 1u);
+    EXPECT_THROW(encoder.submit(job), std::runtime_error);
+}
@@ -0,0 +1,98 @@
+//
+// Created by redkc on 19/10/2026.
+//
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "app/JobSystem.h"
+
+TEST(JobSystem, RunsEveryItemExactlyOnce) {
+    JobSystem jobSystem(4);
+    ASSERT_EQ(jobSystem.threadCount(), 4u);
+
+    // Counts that do not split evenly, fewer items than threads, and a single item
+    for (uint32_t count: {1000u, 1001u, 3u, 1u}) {
+        std::vector<std::atomic<uint32_t> > visits(count);
+        std::vector<std::atomic<uint32_t> > threadRanges(jobSystem.threadCount());
+        jobSystem.parallelFor(count, 1, [&](uint32_t begin, uint32_t end, uint32_t threadIndex) {
+            ASSERT_LT(threadIndex, jobSystem.threadCount());
+            threadRanges[threadIndex]++;
+            for (uint32_t i = begin; i < end; i++) {
+                visits[i]++;
+            }
+        });
+        for (uint32_t i = 0; i < count; i++) {
+            EXPECT_EQ(visits[i], 1u) << "item " << i << " of " << count;
+        }
+        // Every thread index is handed out once per job at most
+        for (uint32_t i = 0; i < jobSystem.threadCount(); i++) {
+            EXPECT_LE(threadRanges[i], 1u) << "thread " << i;
+        }
+    }
+}
+
+TEST(JobSystem, ReturnsOnlyOnceEveryRangeIsDone) {
+    JobSystem jobSystem(4);
+    for (int repeat = 0; repeat < 50; repeat++) {
+        std::atomic<uint32_t> finishedRanges = 0;
+        jobSystem.parallelFor(4, 1, [&](uint32_t, uint32_t, uint32_t threadIndex) {
+            // The workers are slower than the caller, parallelFor must still wait for them
+            if (threadIndex != 0) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+            finishedRanges++;
+        });
+        ASSERT_EQ(finishedRanges, 4u) << "repeat " << repeat;
+    }
+}
+
+TEST(JobSystem, UsesOnlyTheCallerForSmallJobs) {
+    JobSystem jobSystem(4);
+    std::vector<uint32_t> threadIndices;
+    // Ten items with at least ten per thread is a single range, recorded without any locking
+    jobSystem.parallelFor(10, 10, [&](uint32_t begin, uint32_t end, uint32_t threadIndex) {
+        EXPECT_EQ(begin, 0u);
+        EXPECT_EQ(end, 10u);
+        threadIndices.push_back(threadIndex);
+    });
+    EXPECT_EQ(threadIndices, std::vector<uint32_t>{0});
+
+    bool ran = false;
+    jobSystem.parallelFor(0, 1, [&](uint32_t, uint32_t, uint32_t) { ran = true; });
+    EXPECT_FALSE(ran);
+}
+
+TEST(JobSystem, RethrowsTheErrorOfARangeAndKeepsWorking) {
+    JobSystem jobSystem(4);
+    EXPECT_THROW(jobSystem.parallelFor(4, 1, [](uint32_t, uint32_t, uint32_t threadIndex) {
+        if (threadIndex == 2) {
+            throw std::runtime_error("range failed");
+        }
+    }), std::runtime_error);
+
+    std::atomic<uint32_t> items = 0;
+    jobSystem.parallelFor(100, 1, [&](uint32_t begin, uint32_t end, uint32_t) { items += end - begin; });
+    EXPECT_EQ(items, 100u);
+}
+
+TEST(JobSystem, ShutsDownWithIdleAndJustStartedWorkers) {
+    // Destroyed before the workers ever reached their wait
+    for (int repeat = 0; repeat < 20; repeat++) {
+        JobSystem jobSystem(8);
+    }
+
+    // Destroyed right after a job, while the workers go back to sleep
+    std::atomic<uint32_t> items = 0;
+    for (int repeat = 0; repeat < 20; repeat++) {
+        JobSystem jobSystem(8);
+        jobSystem.parallelFor(64, 1, [&](uint32_t begin, uint32_t end, uint32_t) { items += end - begin; });
+    }
+    EXPECT_EQ(items, 20u * 64u);
+}
@@ -0,0 +1,41 @@
+//
+// Created by redkc on 19/10/2026.
+//
+
+#ifndef RANDOMSCENE_H
+#define RANDOMSCENE_H
+#include <cstdint>
+#include <random>
+#include <vector>
+
+#include "cpu/Bvh.h"
+
+/** @brief Small triangles of three meshes scattered through a box, randomRays() starts in and around it */
+inline std::vector<cpu::Triangle> scatterTriangles(uint32_t count, std::mt19937 &random) {
+    std::uniform_real_distribution<float> uniform(-1.0f, 1.0f);
+    auto randomVector = [&]() { return glm::vec3(uniform(random), uniform(random), uniform(random)); };
+
+    std::vector<cpu::Triangle> triangles;
+    triangles.reserve(count);
+    for (uint32_t i = 0; i < count; i++) {
+        const glm::vec3 center = randomVector() * 5.0f;
+        triangles.push_back({
+            center + randomVector() * 0.2f, center + randomVector() * 0.2f, center + randomVector() * 0.2f, i % 3, i
+        });
+    }
+    return triangles;
+}
+
+inline std::vector<cpu::Ray> randomRays(uint32_t count, std::mt19937 &random) {
+    std::uniform_real_distribution<float> uniform(-1.0f, 1.0f);
+    std::vector<cpu::Ray> rays;
+    rays.reserve(count);
+    for (uint32_t i = 0; i < count; i++) {
+        const glm::vec3 origin = glm::vec3(uniform(random), uniform(random), uniform(random)) * 6.0f;
+        const glm::vec3 direction = glm::normalize(glm::vec3(uniform(random), uniform(random), uniform(random)));
+        rays.push_back({origin, 0.001f, direction, 1000.0f});
+    }
+    return rays;
+}
+
+#endif //RANDOMSCENE_H
@@ -0,0 +1,259 @@
+//
+// Created by redkc on 19/10/2026.
+//
+
+#include <cstdint>
+#include <map>
+#include <optional>
+#include <stdexcept>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "app/ReadbackRing.h"
+
+#include "FakeHandles.h"
+
+namespace {
+    // Device state of the fake entry points below, reset by every test
+    std::map<VkBuffer, VkDeviceMemory> buffers;
+    std::map<VkDeviceMemory, std::vector<uint8_t> > allocations;
+    std::vector<VkDeviceMemory> mappedMemory;
+    std::vector<VkBuffer> copyTargets;
+    uint32_t invalidations = 0;
+    uint64_t nextHandle = 1;
+    /** @brief The allocation with this index fails, counting from 1, 0 never fails */
+    uint32_t failingAllocation = 0;
+    uint32_t allocationCount = 0;
+    std::vector<VkMemoryPropertyFlags> memoryTypes;
+
+    constexpr VkMemoryPropertyFlags hostVisible = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
+    constexpr VkMemoryPropertyFlags hostCoherent = VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+    constexpr VkMemoryPropertyFlags hostCached = VK_MEMORY_PROPERTY_HOST_CACHED_BIT;
+
+    class ReadbackRingTest : public testing::Test {
+    protected:
+        void SetUp() override {
+            buffers.clear();
+            allocations.clear();
+            mappedMemory.clear();
+            copyTargets.clear();
+            invalidations = 0;
+            nextHandle = 1;
+            failingAllocation = 0;
+            allocationCount = 0;
+            memoryTypes = {VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, hostVisible | hostCoherent, hostVisible | hostCached};
+        }
+
+        bool recordCopy(ReadbackRing &ring, uint64_t frameValue) const {
+            return ring.recordCopy(commandBuffer, image, extent, frameValue);
+        }
+
+        const VkDevice device = fakeHandle<VkDevice>(0x100);
+        const VkPhysicalDevice physicalDevice = fakeHandle<VkPhysicalDevice>(0x101);
+        const VkCommandBuffer commandBuffer = fakeHandle<VkCommandBuffer>(0x102);
+        const VkImage image = fakeHandle<VkImage>(0x103);
+        const VkExtent3D extent = {4, 2, 1};
+        const VkDeviceSize frameSize = 4 * 2 * 4;
+    };
+}
+
+// The ring only needs these entry points, the test defines them instead of talking to a driver. Memory is host
+// memory, so the pointers the ring hands out can be compared with the allocations.
+VKAPI_ATTR VkResult VKAPI_CALL vkCreateBuffer(VkDevice, const VkBufferCreateInfo *, const VkAllocationCallbacks *,
+                                              VkBuffer *pBuffer) {
+    *pBuffer = fakeHandle<VkBuffer>(nextHandle++);
+    buffers[*pBuffer] = VK_NULL_HANDLE;
+    return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkDestroyBuffer(VkDevice, VkBuffer buffer, const VkAllocationCallbacks *) {
+    if (buffer != VK_NULL_HANDLE) {
+        EXPECT_EQ(buffers.erase(buffer), 1u) << "destroyed an unknown buffer";
+    }
+}
+
+VKAPI_ATTR void VKAPI_CALL vkGetBufferMemoryRequirements(VkDevice, VkBuffer, VkMemoryRequirements *pRequirements) {
+    // Every type is allowed, the ring has to pick among them by their properties
+    pRequirements->size = 256;
+    pRequirements->alignment = 64;
+    pRequirements->memoryTypeBits = (1u << memoryTypes.size()) - 1;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkAllocateMemory(VkDevice, const VkMemoryAllocateInfo *pAllocateInfo,
+                                                const VkAllocationCallbacks *, VkDeviceMemory *pMemory) {
+    if (++allocationCount == failingAllocation) {
+        return VK_ERROR_OUT_OF_DEVICE_MEMORY;
+    }
+    *pMemory = fakeHandle<VkDeviceMemory>(nextHandle++);
+    allocations[*pMemory].resize(pAllocateInfo->allocationSize);
+    return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkFreeMemory(VkDevice, VkDeviceMemory memory, const VkAllocationCallbacks *) {
+    if (memory != VK_NULL_HANDLE) {
+        EXPECT_EQ(allocations.erase(memory), 1u) << "freed unknown memory";
+    }
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkBindBufferMemory(VkDevice, VkBuffer buffer, VkDeviceMemory memory, VkDeviceSize) {
+    buffers.at(buffer) = memory;
+    return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkMapMemory(VkDevice, VkDeviceMemory memory, VkDeviceSize, VkDeviceSize,
+                                           VkMemoryMapFlags, void **ppData) {
+    *ppData = allocations.at(memory).data();
+    mappedMemory.push_back(memory);
+    return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkUnmapMemory(VkDevice, VkDeviceMemory memory) {
+    std::erase(mappedMemory, memory);
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkInvalidateMappedMemoryRanges(VkDevice, uint32_t rangeCount,
+                                                              const VkMappedMemoryRange *) {
+    invalidations += rangeCount;
+    return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkGetPhysicalDeviceMemoryProperties(VkPhysicalDevice,
+                                                               VkPhysicalDeviceMemoryProperties *pProperties) {
+    *pProperties = {};
+    pProperties->memoryTypeCount = static_cast<uint32_t>(memoryTypes.size());
+    for (size_t i = 0; i < memoryTypes.size(); i++) {
+        pProperties->memoryTypes[i].propertyFlags = memoryTypes[i];
+    }
+}
+
+VKAPI_ATTR void VKAPI_CALL vkCmdCopyImageToBuffer(VkCommandBuffer, VkImage, VkImageLayout, VkBuffer dstBuffer,
+                                                  uint32_t, const VkBufferImageCopy *) {
+    copyTargets.push_back(dstBuffer);
+}
+
+VKAPI_ATTR void VKAPI_CALL vkCmdPipelineBarrier(VkCommandBuffer, VkPipelineStageFlags, VkPipelineStageFlags,
+                                                VkDependencyFlags, uint32_t, const VkMemoryBarrier *, uint32_t,
+                                                const VkBufferMemoryBarrier *, uint32_t,
+                                                const VkImageMemoryBarrier *) {
+}
+
+TEST_F(ReadbackRingTest, HandsOutCompletedFramesOldestFirst) {
+    ReadbackRing ring(device, physicalDevice, frameSize, 3);
+    ASSERT_TRUE(recordCopy(ring, 1));
+    ASSERT_TRUE(recordCopy(ring, 2));
+    EXPECT_EQ(ring.oldestPendingValue(), 1u);
+
+    // Nothing is done on the GPU yet, polling never waits for it
+    EXPECT_FALSE(ring.poll(0).has_value());
+
+    const std::optional<ReadbackRing::Frame> first = ring.poll(2);
+    ASSERT_TRUE(first.has_value());
+    EXPECT_EQ(first->frameValue, 1u);
+    EXPECT_EQ(first->slot, 0u);
+    EXPECT_EQ(first->size, frameSize);
+    EXPECT_EQ(first->data, allocations.at(buffers.at(copyTargets[0])).data());
+
+    const std::optional<ReadbackRing::Frame> second = ring.poll(2);
+    ASSERT_TRUE(second.has_value());
+    EXPECT_EQ(second->frameValue, 2u);
+    EXPECT_EQ(second->slot, 1u);
+    EXPECT_NE(second->data, first->data);
+
+    EXPECT_FALSE(ring.poll(2).has_value());
+    EXPECT_EQ(ring.oldestPendingValue(), 0u);
+}
+
+TEST_F(ReadbackRingTest, ReusesReleasedSlotsInOrderAndWrapsAround) {
+    ReadbackRing ring(device, physicalDevice, frameSize, 3);
+    for (uint64_t frameValue = 1; frameValue <= 3; frameValue++) {
+        ASSERT_TRUE(recordCopy(ring, frameValue));
+    }
+    ASSERT_EQ(copyTargets.size(), 3u);
+    EXPECT_NE(copyTargets[0], copyTargets[1]);
+    EXPECT_NE(copyTargets[1], copyTargets[2]);
+    EXPECT_NE(copyTargets[0], copyTargets[2]);
+
+    // Every slot is in flight, the frame is skipped and nothing is recorded for it
+    EXPECT_FALSE(ring.hasFreeSlot());
+    EXPECT_FALSE(recordCopy(ring, 4));
+    EXPECT_EQ(copyTargets.size(), 3u);
+
+    const std::optional<ReadbackRing::Frame> first = ring.poll(3);
+    const std::optional<ReadbackRing::Frame> second = ring.poll(3);
+    ASSERT_TRUE(first.has_value() && second.has_value());
+
+    // The second slot is given back first, but the ring continues with the first one
+    ring.release(second->slot);
+    EXPECT_FALSE(ring.hasFreeSlot());
+    ring.release(first->slot);
+    EXPECT_TRUE(ring.hasFreeSlot());
+
+    ASSERT_TRUE(recordCopy(ring, 5));
+    EXPECT_EQ(copyTargets.back(), copyTargets[0]);
+    ASSERT_TRUE(recordCopy(ring, 6));
+    EXPECT_EQ(copyTargets.back(), copyTargets[1]);
+    // The third slot still holds frame 3, which nobody polled
+    EXPECT_FALSE(recordCopy(ring, 7));
+
+    // Frame 3 is older than the wrapped frames 5 and 6 and comes out first
+    const std::optional<ReadbackRing::Frame> third = ring.poll(6);
+    ASSERT_TRUE(third.has_value());
+    EXPECT_EQ(third->frameValue, 3u);
+    EXPECT_EQ(third->slot, 2u);
+    const std::optional<ReadbackRing::Frame> wrapped = ring.poll(6);
+    ASSERT_TRUE(wrapped.has_value());
+    EXPECT_EQ(wrapped->frameValue, 5u);
+    EXPECT_EQ(wrapped->slot, 0u);
+}
+
+TEST_F(ReadbackRingTest, PrefersHostCachedMemoryAndInvalidatesIt) {
+    {
+        ReadbackRing ring(device, physicalDevice, frameSize, 2);
+        EXPECT_TRUE(ring.isHostCached());
+        ASSERT_TRUE(recordCopy(ring, 1));
+        ASSERT_TRUE(ring.poll(1).has_value());
+        // Cached but not coherent, the CPU has to invalidate before it reads
+        EXPECT_EQ(invalidations, 1u);
+    }
+
+    memoryTypes = {hostVisible | hostCoherent, hostVisible | hostCached | hostCoherent};
+    {
+        ReadbackRing ring(device, physicalDevice, frameSize, 2);
+        EXPECT_TRUE(ring.isHostCached());
+        ASSERT_TRUE(recordCopy(ring, 1));
+        ASSERT_TRUE(ring.poll(1).has_value());
+        EXPECT_EQ(invalidations, 1u);
+    }
+
+    memoryTypes = {VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, hostVisible | hostCoherent};
+    {
+        ReadbackRing ring(device, physicalDevice, frameSize, 2);
+        EXPECT_FALSE(ring.isHostCached());
+    }
+
+    memoryTypes = {VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT};
+    EXPECT_THROW(ReadbackRing(device, physicalDevice, frameSize, 2), std::runtime_error);
+}
+
+TEST_F(ReadbackRingTest, ReleasesEverySlotOnDestruction) {
+    {
+        ReadbackRing ring(device, physicalDevice, frameSize, 4);
+        EXPECT_EQ(buffers.size(), 4u);
+        EXPECT_EQ(allocations.size(), 4u);
+        EXPECT_EQ(mappedMemory.size(), 4u);
+    }
+    EXPECT_TRUE(buffers.empty());
+    EXPECT_TRUE(allocations.empty());
+    EXPECT_TRUE(mappedMemory.empty());
+}
+
+TEST_F(ReadbackRingTest, ReleasesTheCreatedSlotsWhenALaterOneFails) {
+    failingAllocation = 3;
+    EXPECT_THROW(ReadbackRing(device, physicalDevice, frameSize, 4), std::runtime_error);
+    EXPECT_TRUE(buffers.empty());
+    EXPECT_TRUE(allocations.empty());
+    EXPECT_TRUE(mappedMemory.empty());
+
+    EXPECT_THROW(ReadbackRing(device, physicalDevice, frameSize, 0), std::runtime_error);
+}
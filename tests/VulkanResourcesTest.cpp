@@ -0,0 +1,115 @@
+//
+// Created by redkc on 19/10/2026.
+//
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "app/DeletionQueue.h"
+#include "app/VulkanBuffer.h"
+#include "app/VulkanResources.h"
+
+#include "FakeHandles.h"
+
+namespace {
+    // The wrappers only call into Vulkan from their deleters. Every wrapper here retires into a queue that is never
+    // collected, so placeholder handles are enough and no device is needed.
+    vks::Buffer createBuffer(DeletionQueue &deletionQueue, VkDeviceSize size) {
+        vks::Buffer buffer;
+        buffer.deletionQueue = &deletionQueue;
+        buffer.buffer = fakeHandle<VkBuffer>(1);
+        buffer.memory = fakeHandle<VkDeviceMemory>(2);
+        buffer.size = size;
+        vks::ResourceTracker::onCreate(vks::ResourceType::Buffer, size);
+        return buffer;
+    }
+
+    vks::Image createImage(DeletionQueue &deletionQueue, VkDeviceSize size) {
+        vks::Image image;
+        image.deletionQueue = &deletionQueue;
+        image.image = fakeHandle<VkImage>(3);
+        image.memory = fakeHandle<VkDeviceMemory>(4);
+        image.view = fakeHandle<VkImageView>(5);
+        image.allocationSize = size;
+        vks::ResourceTracker::onCreate(vks::ResourceType::Image, size);
+        return image;
+    }
+
+    vks::AccelerationStructure createAccelerationStructure(DeletionQueue &deletionQueue, VkDeviceSize size) {
+        vks::AccelerationStructure accelerationStructure;
+        accelerationStructure.deletionQueue = &deletionQueue;
+        accelerationStructure.handle = fakeHandle<VkAccelerationStructureKHR>(6);
+        accelerationStructure.buffer = fakeHandle<VkBuffer>(7);
+        accelerationStructure.memory = fakeHandle<VkDeviceMemory>(8);
+        accelerationStructure.size = size;
+        vks::ResourceTracker::onCreate(vks::ResourceType::AccelerationStructure, size);
+        return accelerationStructure;
+    }
+}
+
+TEST(VulkanResources, MovedBufferIsReleasedOnce) {
+    DeletionQueue deletionQueue;
+    const int64_t liveBefore = vks::ResourceTracker::liveCount(vks::ResourceType::Buffer);
+    const int64_t bytesBefore = vks::ResourceTracker::liveBytes(vks::ResourceType::Buffer);
+    {
+        vks::Buffer buffer = createBuffer(deletionQueue, 256);
+        EXPECT_EQ(vks::ResourceTracker::liveCount(vks::ResourceType::Buffer), liveBefore + 1);
+
+        // A growing vector moves its elements, none of them may be released on the way
+        std::vector<vks::Buffer> buffers;
+        buffers.push_back(std::move(buffer));
+        buffers.push_back(createBuffer(deletionQueue, 512));
+        buffers.push_back(createBuffer(deletionQueue, 1024));
+        EXPECT_EQ(buffer.buffer, VK_NULL_HANDLE);
+        EXPECT_EQ(vks::ResourceTracker::liveCount(vks::ResourceType::Buffer), liveBefore + 3);
+        EXPECT_EQ(vks::ResourceTracker::liveBytes(vks::ResourceType::Buffer), bytesBefore + 256 + 512 + 1024);
+        EXPECT_EQ(deletionQueue.pending(), 0u);
+    }
+    EXPECT_EQ(vks::ResourceTracker::liveCount(vks::ResourceType::Buffer), liveBefore);
+    EXPECT_EQ(vks::ResourceTracker::liveBytes(vks::ResourceType::Buffer), bytesBefore);
+    EXPECT_EQ(deletionQueue.pending(), 3u);
+}
+
+TEST(VulkanResources, MoveAssignedImageRetiresTheReplacedOne) {
+    DeletionQueue deletionQueue;
+    const int64_t liveBefore = vks::ResourceTracker::liveCount(vks::ResourceType::Image);
+
+    vks::Image image = createImage(deletionQueue, 4096);
+    vks::Image replacement = createImage(deletionQueue, 8192);
+    EXPECT_EQ(vks::ResourceTracker::liveCount(vks::ResourceType::Image), liveBefore + 2);
+
+    image = std::move(replacement);
+    EXPECT_EQ(vks::ResourceTracker::liveCount(vks::ResourceType::Image), liveBefore + 1);
+    EXPECT_EQ(image.allocationSize, 8192u);
+    EXPECT_EQ(replacement.image, VK_NULL_HANDLE);
+    EXPECT_EQ(deletionQueue.pending(), 1u);
+
+    image.destroy();
+    // Destroying twice, or destroying an empty wrapper, releases nothing
+    image.destroy();
+    replacement.destroy();
+    EXPECT_EQ(vks::ResourceTracker::liveCount(vks::ResourceType::Image), liveBefore);
+    EXPECT_EQ(deletionQueue.pending(), 2u);
+}
+
+TEST(VulkanResources, AccelerationStructureIsReleasedByItsLastOwner) {
+    DeletionQueue deletionQueue;
+    const int64_t liveBefore = vks::ResourceTracker::liveCount(vks::ResourceType::AccelerationStructure);
+    const int64_t totalBefore = vks::ResourceTracker::totalLiveCount();
+    {
+        vks::AccelerationStructure first = createAccelerationStructure(deletionQueue, 65536);
+        vks::AccelerationStructure second(std::move(first));
+        vks::AccelerationStructure third;
+        third = std::move(second);
+        EXPECT_EQ(first.handle, VK_NULL_HANDLE);
+        EXPECT_EQ(second.handle, VK_NULL_HANDLE);
+        EXPECT_EQ(third.size, 65536u);
+        EXPECT_EQ(vks::ResourceTracker::liveCount(vks::ResourceType::AccelerationStructure), liveBefore + 1);
+    }
+    EXPECT_EQ(vks::ResourceTracker::liveCount(vks::ResourceType::AccelerationStructure), liveBefore);
+    EXPECT_EQ(vks::ResourceTracker::totalLiveCount(), totalBefore);
+    EXPECT_EQ(deletionQueue.pending(), 1u);
+}